@@ -0,0 +1,75 @@
+#include <iostream>
+#include <string>
+#include "../image/Image.h"
+#include "../scene_graph/NodeGroup.h"
+#include "AppConfig.h"
+#include "BatchCanvas.h"
+
+using namespace std;
+
+extern int outputWidth, outputHeight;
+
+BatchCanvas::BatchCanvas(const NodeGroup *iScene)
+    :Canvas()
+{
+    _Scene = iScene;
+    _warnedPixels = false;
+
+    // kept alive for _MapsPath
+    static string mapsDir;
+    mapsDir = (const char*)Config::Path::getInstance()->getMapsDir().toAscii().data();
+    _MapsPath = mapsDir.c_str();
+}
+
+BatchCanvas::~BatchCanvas()
+{
+    _Scene = 0;
+}
+
+void BatchCanvas::init()
+{
+    _Renderer = 0;
+}
+
+int BatchCanvas::width() const
+{
+    return outputWidth;
+}
+
+int BatchCanvas::height() const
+{
+    return outputHeight;
+}
+
+BBox<Vec3r> BatchCanvas::scene3DBBox() const
+{
+    return _Scene->bbox();
+}
+
+void BatchCanvas::readColorPixels(int x,int y,int w, int h, RGBImage& oImage) const
+{
+    if (!_warnedPixels)
+    {
+        cerr << "Warning: no frame buffer without a window; density queries read a blank canvas" << endl;
+        _warnedPixels = true;
+    }
+
+    float *rgb = new float[3*w*h];
+    for(int i=0;i<3*w*h;i++)
+        rgb[i] = 0;
+    oImage.setArray(rgb, width(), height(), w,h, x, y, false);
+}
+
+void BatchCanvas::readDepthPixels(int x,int y,int w, int h, GrayImage& oImage) const
+{
+    if (!_warnedPixels)
+    {
+        cerr << "Warning: no frame buffer without a window; density queries read a blank canvas" << endl;
+        _warnedPixels = true;
+    }
+
+    float *depth = new float[w*h];
+    for(int i=0;i<w*h;i++)
+        depth[i] = 1;
+    oImage.setArray(depth, width(), height(), w,h, x, y, false);
+}
@@ -0,0 +1,40 @@
+#ifndef  BATCHCANVAS_H
+# define BATCHCANVAS_H
+
+# include "../stroke/Canvas.h"
+
+class NodeGroup;
+
+/*! Canvas of a Controller that runs without a window or an OpenGL context
+ *  (see Controller::Controller(bool) and runBatch). Style modules are executed
+ *  as usual, but strokes are only drawn by the file renderers (SVG, PostScript);
+ *  the canvas itself has no pixels, so density queries read a blank image.
+ */
+class BatchCanvas : public Canvas
+{
+public:
+  /*! iScene: root of the loaded scene, for its bounding box */
+  explicit BatchCanvas(const NodeGroup *iScene);
+  virtual ~BatchCanvas();
+
+  /*! no renderer: Canvas::Draw only executes the style modules */
+  virtual void init();
+
+  virtual void readColorPixels(int x,int y,int w, int h, RGBImage& oImage) const;
+  virtual void readDepthPixels(int x,int y,int w, int h, GrayImage& oImage) const;
+
+  virtual void update() {}
+  virtual void RenderStroke(Stroke *iStroke) {}
+
+  /*! the size of the output image */
+  virtual int width() const;
+  virtual int height() const;
+
+  virtual BBox<Vec3r> scene3DBBox() const;
+
+private:
+  const NodeGroup *_Scene;
+  mutable bool _warnedPixels;
+};
+
+#endif // BATCHCANVAS_H
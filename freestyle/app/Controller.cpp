@@ -37,11 +37,14 @@
 #include "AppOptionsWindow.h"
 #include "AppAboutWindow.h"
 #include "AppCanvas.h"
+#include "BatchCanvas.h"
 #include "AppConfig.h"
 #include "AppDensityCurvesWindow.h"
 
 #include "../system/StringUtils.h"
+#include "../system/Stats.h"
 #include "../scene_graph/PLYFileLoader.h"
+#include "../scene_graph/TriangleMeshLoader.h"
 #include "../scene_graph/NodeShape.h"
 #include "../scene_graph/NodeTransform.h"
 #include "../scene_graph/NodeLight.h"
@@ -66,6 +69,8 @@
 #include "../stroke/SVGStrokeRenderer.h"
 #include "../stroke/TextStrokeRenderer.h"
 #include "../stroke/StyleModule.h"
+#include "../stroke/CompiledStyleModule.h"
+#include "../stroke/StrokeRenderer.h"
 
 
 extern bool useCameraFromRIB;
@@ -105,7 +110,7 @@ void printTestY()
 
 //------
 
-Controller::Controller()
+Controller::Controller(bool headless)
 {
     const QString sep(Config::DIR_SEP.c_str());
     const QString filename = Config::Path::getInstance()->getHomeDir() + sep +
@@ -131,6 +136,10 @@ Controller::Controller()
 
     _pMainWindow = NULL;
     _pView = NULL;
+    _pStyleWindow = NULL;
+    _pOptionsWindow = NULL;
+    _pDensityCurvesWindow = NULL;
+    _headless = headless;
 
     _edgeTesselationNature = (Nature::SILHOUETTE | Nature::BORDER | Nature::CREASE);
 
@@ -146,10 +155,15 @@ Controller::Controller()
     _cuspTrimThreshold = 0;
     _graftThreshold = 0;
     _VisibilityAlgo = ViewMapBuilder::ray_casting;
+    _OccluderStructure = ViewMapBuilder::occluder_grid;
+    _Grid = &_FastGrid;
 
     //_VisibilityAlgo = ViewMapBuilder::ray_casting_fast;
 
-    _Canvas = new AppCanvas;
+    if (_headless)
+        _Canvas = new BatchCanvas(_RootNode);
+    else
+        _Canvas = new AppCanvas;
 
     _inter = new PythonInterpreter;
     _EnableQI = true;
@@ -157,6 +171,13 @@ Controller::Controller()
     _ComputeSteerableViewMap = false;
     _ComputeSuggestive = true;
     _sphereRadius = 1.0;
+    _suggestiveContourKrDerivativeEpsilon = 0;
+
+    if (_headless)
+    {
+        _Canvas->init();
+        LoadOptions();
+    }
 }
 
 Controller::~Controller()
@@ -259,7 +280,7 @@ void Controller::SetView(AppGLWidget *iView)
 
     _pView = iView;
     //_pView2D->setGeometry(_pView->rect());
-    _Canvas->SetViewer(_pView);
+    static_cast<AppCanvas*>(_Canvas)->SetViewer(_pView);
 }
 
 void Controller::SetMainWindow(AppMainWindow *iMainWindow)
@@ -286,14 +307,15 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
     //_pMainWindow->setProgressLabel("Reading File");
     //_pMainWindow->setProgressLabel("Cleaning mesh");
 
-    _pMainWindow->DisplayMessage("Reading File");
-    _pMainWindow->DisplayMessage("Cleaning Mesh");
+    displayMessage("Reading File");
+    displayMessage("Cleaning Mesh");
 
     PLYFileLoader sceneLoader(iFileName);
 
     //_RootNode->AddChild(BuildSceneTest());
 
     _Chrono.start();
+    StatsTimer loadTimer("PLYLoad");
 
     NodeGroup *maxScene = sceneLoader.Load();
 
@@ -306,13 +328,54 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
         //    return 1;
     }
 
+    loadTimer.stop();
     printf("Mesh cleaning    : %lf\n", _Chrono.stop());
     fflush(stdout);
-    _SceneNumFaces += sceneLoader.numFacesRead();
 
-    if(sceneLoader.minEdgeSize() < _minEdgeSize)
+    return BuildScene(maxScene, sceneLoader.numFacesRead(), sceneLoader.minEdgeSize(), iFileName, wiggleFactor);
+}
+
+// same as Load3DSFile, for a mesh handed over in memory by the tessellator
+int Controller::LoadMesh(const TriangleMeshData& iMesh, const char *iName, double wiggleFactor)
+{
+    if (_pView)
+        _pView->setUpdateMode(false);
+
+    _ProgressBar->reset();
+    _ProgressBar->setLabelText("Loading Mesh");
+    _ProgressBar->setTotalSteps(3);
+    _ProgressBar->setProgress(0);
+
+    displayMessage("Building scene");
+
+    TriangleMeshLoader sceneLoader(iMesh);
+
+    _Chrono.start();
+    StatsTimer loadTimer("MeshLoad");
+
+    NodeGroup *meshScene = sceneLoader.Load();
+
+    if (meshScene == NULL) {
+        printf("UNABLE TO LOAD MESH %s\n",iName);
+        fflush(stdout);
+        exit(1);
+    }
+
+    loadTimer.stop();
+    printf("Mesh loading     : %lf\n", _Chrono.stop());
+    fflush(stdout);
+
+    return BuildScene(meshScene, sceneLoader.numFacesRead(), sceneLoader.minEdgeSize(), iName, wiggleFactor);
+}
+
+// shared by Load3DSFile and LoadMesh: builds the winged edge structure and the grid for a newly loaded scene
+int Controller::BuildScene(NodeGroup *maxScene, unsigned iNumFaces, real iMinEdgeSize, const char *iFileName, double wiggleFactor)
+{
+    _SceneNumFaces += iNumFaces;
+
+    if(iMinEdgeSize < _minEdgeSize)
     {
-        _minEdgeSize = sceneLoader.minEdgeSize();
+        _minEdgeSize = iMinEdgeSize;
         _EPSILON = _minEdgeSize*1e-6;
         if(_EPSILON < DBL_MIN)
             _EPSILON = 0.0;
@@ -320,7 +383,7 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
 
     cout << "Epsilon computed : " << (double)_EPSILON << endl;
 
-    printf("Faces read: %d, Num faces: %d\n", sceneLoader.numFacesRead(), _SceneNumFaces);
+    printf("Faces read: %d, Num faces: %d\n", iNumFaces, _SceneNumFaces);
 
     _ProgressBar->setProgress(1);
 
@@ -335,11 +398,15 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
     _RootNode->UpdateBBox(); // FIXME: Correct that by making a Renderer to compute the bbox
 
 
-    _pView->SetModel(_RootNode);
-    _pView->FitBBox();
+    if (_pView)
+    {
+        _pView->SetModel(_RootNode);
+        _pView->FitBBox();
+    }
 
-    _pMainWindow->DisplayMessage("Building Winged Edge structure");
+    displayMessage("Building Winged Edge structure");
     _Chrono.start();
+    StatsTimer wedgeTimer("WEdgeBuilding");
 
     WXEdgeBuilder wx_builder;
     maxScene->accept(wx_builder);
@@ -380,14 +447,20 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
 
 
 
+    wedgeTimer.stop();
     printf("WEdge building   : %lf\n", _Chrono.stop());
 
     _ProgressBar->setProgress(2);
 
-    _pMainWindow->DisplayMessage("Building Grid");
+    displayMessage("Building Grid");
     _Chrono.start();
+    StatsTimer gridTimer("GridBuilding");
 
-    _Grid.clear();
+    _Grid->clear();
+    if (_OccluderStructure == ViewMapBuilder::occluder_bvh)
+        _Grid = &_OccluderBVH;
+    else
+        _Grid = &_FastGrid;
     Vec3r size;
     for(unsigned int i=0; i<3; i++)
     {
@@ -397,22 +470,28 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
             cout << "Warning: the bbox size is 0 in dimension "<<i<<endl;
         }
     }
-    _Grid.configure(Vec3r(_RootNode->bbox().getMin() - size / 20.0), size,
+    _Grid->configure(Vec3r(_RootNode->bbox().getMin() - size / 20.0), size,
                     _SceneNumFaces);
 
     // Fill in the grid:
-    WFillGrid fillGridRenderer(&_Grid, _winged_edge);
+    WFillGrid fillGridRenderer(_Grid, _winged_edge);
     fillGridRenderer.fillGrid();
+    _Grid->finalizeOccluders();
 
+    gridTimer.stop();
+    Stats::instance()->addCount("GridBuilding", "faces", _SceneNumFaces);
     printf("Grid building    : %lf\n", _Chrono.stop());
 
     // DEBUG
-    _Grid.displayDebug();
+    _Grid->displayDebug();
 
     _ProgressBar->setProgress(3);
 
-    _pView->SetDebug(_DebugNode);
-    _pView->SetPODebug(_PODebugNode);
+    if (_pView)
+    {
+        _pView->SetDebug(_DebugNode);
+        _pView->SetPODebug(_PODebugNode);
+    }
 
     //delete stuff
     //  if(0 != ws_builder)
@@ -420,7 +499,8 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
     //      delete ws_builder;
     //      ws_builder = 0;
     //    }
-    _pView->updateGL();
+    if (_pView)
+        _pView->updateGL();
     QFileInfo qfi(iFileName);
     string basename((const char*)qfi.fileName().toAscii().data());
     _ListOfModels.push_back(basename);
@@ -437,7 +517,8 @@ int Controller::Load3DSFile(const char *iFileName, double wiggleFactor)
 void Controller::CloseFile()
 {
     WShape::SetCurrentId(0);
-    _pView->DetachModel();
+    if (_pView)
+        _pView->DetachModel();
     _ListOfModels.clear();
     if(NULL != _RootNode)
     {
@@ -448,7 +529,8 @@ void Controller::CloseFile()
         _RootNode->clearBBox();
     }
 
-    _pView->DetachSilhouette();
+    if (_pView)
+        _pView->DetachSilhouette();
     if (NULL != _SilhouetteNode)
     {
         int ref = _SilhouetteNode->destroy();
@@ -497,7 +579,8 @@ void Controller::CloseFile()
     //	}
     //  }
 
-    _pView->DetachDebug();
+    if (_pView)
+        _pView->DetachDebug();
     if(NULL != _DebugNode)
     {
         int ref = _DebugNode->destroy();
@@ -505,7 +588,8 @@ void Controller::CloseFile()
             _DebugNode->addRef();
     }
 
-    _pView->DetachPODebug();
+    if (_pView)
+        _pView->DetachPODebug();
     if (NULL != _PODebugNode)
     {
         int ref = _PODebugNode->destroy();
@@ -533,7 +617,7 @@ void Controller::CloseFile()
     _Canvas->Erase();
 
     // clears the grid
-    _Grid.clear();
+    _Grid->clear();
     _SceneNumFaces = 0;
     _minEdgeSize = DBL_MAX;
     //  _pView2D->DetachScene();
@@ -788,7 +872,8 @@ void Controller::ComputeViewMap()
         _ViewMap = 0;
     }
 
-    _pView->DetachDebug();
+    if (_pView)
+        _pView->DetachDebug();
     if(NULL != _DebugNode)
     {
         int ref = _DebugNode->destroy();
@@ -796,7 +881,8 @@ void Controller::ComputeViewMap()
             _DebugNode->addRef();
     }
 
-    _pView->DetachPODebug();
+    if (_pView)
+        _pView->DetachPODebug();
     if (NULL != _PODebugNode)
     {
         int ref = _PODebugNode->destroy();
@@ -804,12 +890,14 @@ void Controller::ComputeViewMap()
             _PODebugNode->addRef();
     }
 
-    _pView->DetachSilhouette();
+    if (_pView)
+        _pView->DetachSilhouette();
     if (NULL != _SilhouetteNode)
     {
         int ref = _SilhouetteNode->destroy();
         if(0 == ref)
             delete _SilhouetteNode;
+        _SilhouetteNode = NULL;
     }
 
 
@@ -821,12 +909,17 @@ void Controller::ComputeViewMap()
     //----------------------------------------------------------
     // Save the viewpoint context at the view level in order
     // to be able to restore it later:
-    _pView->saveCameraState();
+    // (a headless controller has no view: it always uses the RIF camera)
+    assert(_pView != NULL || useCameraFromRIB);
+    if (_pView)
+    {
+        _pView->saveCameraState();
 
-    // Restore the context of view:
-    // we need to perform all these operations while the
-    // 3D context is on.
-    _pView->Set3DContext();
+        // Restore the context of view:
+        // we need to perform all these operations while the
+        // 3D context is on.
+        _pView->Set3DContext();
+    }
     float src[3] = { 0, 0, 0 };
     float vp_tmp[3];
     real mv[4][4];
@@ -899,6 +992,7 @@ void Controller::ComputeViewMap()
     //----------------------------------------------------------
 
     _Chrono.start();
+    StatsTimer featureTimer("FeatureLines");
     if (_SceneNumFaces > 2000){
         edgeDetector.SetProgressBar(_ProgressBar);
     }
@@ -914,6 +1008,7 @@ void Controller::ComputeViewMap()
     // after this step, a bunch of faces have flagged facelayers attached with "ta" and "tb" values
     // indicating where smooth edges lie
 
+    featureTimer.stop();
     real duration = _Chrono.stop();
     printf("Feature lines    : %lf\n", duration);
 
@@ -928,7 +1023,7 @@ void Controller::ComputeViewMap()
     vmBuilder.SetTransform(mv, proj, viewport, focalLength, aspect, fovy_radian);
     vmBuilder.SetFrustum(znear, zfar);
 
-    vmBuilder.SetGrid(&_Grid);
+    vmBuilder.SetGrid(_Grid);
 
     vmBuilder.SetUseConsistency(_useConsistency);
 
@@ -944,27 +1039,31 @@ void Controller::ComputeViewMap()
     sTesselator3d.SetNature(_edgeTesselationNature);
     
     _Chrono.start();
+    StatsTimer viewMapTimer("BuildViewMap");
     // Build View Map
     _ViewMap = vmBuilder.BuildViewMap(*_winged_edge, _VisibilityAlgo, _EPSILON);
     _ViewMap->setScene3dBBox(_RootNode->bbox());
 
     assert(_ViewMap->ViewEdges().size() > 0);
 
-    //Tesselate the 3D edges:
-    sTesselator3d.SetShowVisibleOnly(true);
-    sTesselator3d.SetColoring(ViewMapTesselator3D::TYPE);
-    _SilhouetteNode = sTesselator3d.Tesselate(_ViewMap);
-    _SilhouetteNode->addRef();
+    //Tesselate the 3D edges (only drawn by the view):
+    if (_pView)
+    {
+        sTesselator3d.SetShowVisibleOnly(true);
+        sTesselator3d.SetColoring(ViewMapTesselator3D::TYPE);
+        _SilhouetteNode = sTesselator3d.Tesselate(_ViewMap);
+        _SilhouetteNode->addRef();
 
-    sTesselator3d.SetShowVisibleOnly(false);
-    sTesselator3d.SetColoring(ViewMapTesselator3D::TYPE);
-    _ViewMapVisNode = sTesselator3d.Tesselate(_ViewMap);
-    _ViewMapVisNode->addRef();
+        sTesselator3d.SetShowVisibleOnly(false);
+        sTesselator3d.SetColoring(ViewMapTesselator3D::TYPE);
+        _ViewMapVisNode = sTesselator3d.Tesselate(_ViewMap);
+        _ViewMapVisNode->addRef();
 
-    sTesselator3d.SetShowVisibleOnly(true);
-    sTesselator3d.SetColoring(ViewMapTesselator3D::ID_COLOR);
-    _ViewMapColorNode = sTesselator3d.Tesselate(_ViewMap);
-    _ViewMapColorNode->addRef();
+        sTesselator3d.SetShowVisibleOnly(true);
+        sTesselator3d.SetColoring(ViewMapTesselator3D::ID_COLOR);
+        _ViewMapColorNode = sTesselator3d.Tesselate(_ViewMap);
+        _ViewMapColorNode->addRef();
+    }
 
     // Tesselate 2D edges
     //  _ProjectedSilhouette = sTesselator2d.Tesselate(_ViewMap);
@@ -972,7 +1071,8 @@ void Controller::ComputeViewMap()
 
 
     _DebugNode->AddChild(visDebugNode);
-    _pView->SetDebug(_DebugNode);
+    if (_pView)
+        _pView->SetDebug(_DebugNode);
 
     // generate region debugging vis
 
@@ -993,7 +1093,8 @@ void Controller::ComputeViewMap()
       _DebugNode = regionDebugNode;
       _DebugNode->addRef();
       */
-        _pView->SetPODebug(_PODebugNode);
+        if (_pView)
+            _pView->SetPODebug(_PODebugNode);
     }
 
     if (_VisibilityAlgo == ViewMapBuilder::punch_out)
@@ -1012,10 +1113,12 @@ void Controller::ComputeViewMap()
       _DebugNode->addRef();
       _pView->SetDebug(_DebugNode);
       */
-        _pView->SetPODebug(_PODebugNode);
+        if (_pView)
+            _pView->SetPODebug(_PODebugNode);
     }
 
 
+    viewMapTimer.stop();
     duration = _Chrono.stop();
     printf("ViewMap building : %lf\n", duration);
 
@@ -1125,13 +1228,16 @@ void Controller::ComputeViewMap()
     //====================================================================
     // END FIXME GLDEBUG
 
-    _pView->AddSilhouette(_SilhouetteNode);
-    _pView->AddViewMapVisNode(_ViewMapVisNode);
-    _pView->AddViewMapColorNode(_ViewMapColorNode);
-    //_pView->AddSilhouette(_WRoot);
-    //_pView->Add2DSilhouette(_ProjectedSilhouette);
-    //_pView->Add2DVisibleSilhouette(_VisibleProjectedSilhouette);
-    _pView->AddDebug(_DebugNode);
+    if (_pView)
+    {
+        _pView->AddSilhouette(_SilhouetteNode);
+        _pView->AddViewMapVisNode(_ViewMapVisNode);
+        _pView->AddViewMapColorNode(_ViewMapColorNode);
+        //_pView->AddSilhouette(_WRoot);
+        //_pView->Add2DSilhouette(_ProjectedSilhouette);
+        //_pView->Add2DVisibleSilhouette(_VisibleProjectedSilhouette);
+        _pView->AddDebug(_DebugNode);
+    }
 
     // Draw the steerable density map:
     //--------------------------------
@@ -1146,6 +1252,12 @@ void Controller::ComputeSteerableViewMap(){
     if((!_Canvas) || (!_ViewMap))
         return;
 
+    // the steerable maps are rendered offscreen by the view
+    if (_pView == NULL) {
+        cerr << "Warning: the steerable view map needs a window; not computed" << endl;
+        return;
+    }
+
     if(_ProgressBar){
         _ProgressBar->reset();
         _ProgressBar->setLabelText("Computing Steerable ViewMap");
@@ -1276,6 +1388,22 @@ void Controller::setVisibilityAlgo(ViewMapBuilder::visibility_algo alg, bool use
 }
 
 
+void Controller::setOccluderStructure(ViewMapBuilder::occluder_structure s)
+{
+    _OccluderStructure = s;
+}
+
+void Controller::setCheckConcurrentLayers(bool iCheck)
+{
+    _Canvas->SetCheckConcurrentLayers(iCheck);
+}
+
+unsigned Controller::concurrentLayerMismatches() const
+{
+    return _Canvas->concurrentLayerMismatches();
+}
+
+
 void Controller::toggleVisibilityAlgo() 
 {
     if (_VisibilityAlgo == ViewMapBuilder::region_based)
@@ -1354,31 +1482,45 @@ void Controller::DrawStrokes()
         return;
 
     _Chrono.start();
-    _Canvas->Draw();
+    {
+        StatsTimer timer("DrawStrokes");
+        _Canvas->Draw();
+    }
     real d = _Chrono.stop();
     cout << "Strokes drawing  : " << (double)d << endl;
     resetModified();
 }
 
 
+StyleModule * Controller::newStyleModule(const char *iFileName)
+{
+    if (CompiledStyleModule::isCompiled(iFileName))
+        return new CompiledStyleModule(iFileName);
+    return new StyleModule(iFileName, _inter);
+}
+
 void Controller::InsertStyleModule(unsigned index, const char *iFileName)
 {
-    QFileInfo fi(iFileName);
-    QString ext = fi.suffix();
-    assert(ext == "py");
-    if (ext != "py") {
-        cerr << "Error: Cannot load \"" << fi.fileName().toAscii().data()
-             << "\", unknown extension" << endl;
-        return;
+    if (!CompiledStyleModule::isCompiled(iFileName)) {
+        QFileInfo fi(iFileName);
+        QString ext = fi.suffix();
+        if (ext != "py") {
+            cerr << "Error: Cannot load \"" << fi.fileName().toAscii().data()
+                 << "\", unknown extension" << endl;
+            return;
+        }
     }
-    StyleModule* sm = new StyleModule(iFileName, _inter);
+    StyleModule* sm = newStyleModule(iFileName);
     _Canvas->InsertStyleModule(index, sm);
 
 }
 
 void Controller::AddStyleModule(const char *iFileName)
 {
-    _pStyleWindow->Add(iFileName);
+    if (_pStyleWindow)
+        _pStyleWindow->Add(iFileName);
+    else
+        InsertStyleModule(_Canvas->getNumStyleModules(), iFileName);
 }
 
 void Controller::RemoveStyleModule(unsigned index)
@@ -1389,7 +1531,8 @@ void Controller::RemoveStyleModule(unsigned index)
 void Controller::Clear()
 {
     _Canvas->Clear();
-    _pStyleWindow->clearPlayList();
+    if (_pStyleWindow)
+        _pStyleWindow->clearPlayList();
 
     //  _pStyleWindow->PlayList->setCurrentCell(0,0);
     //  _pStyleWindow->PlayList->clear();
@@ -1397,7 +1540,7 @@ void Controller::Clear()
 
 void Controller::ReloadStyleModule(unsigned index, const char * iFileName)
 {
-    StyleModule* sm = new StyleModule(iFileName, _inter);
+    StyleModule* sm = newStyleModule(iFileName);
     _Canvas->ReplaceStyleModule(index, sm);
 }
 
@@ -1438,12 +1581,14 @@ void Controller::SwapStyleModules(unsigned i1, unsigned i2)
 void Controller::toggleLayer(unsigned index, bool iDisplay)
 {
     _Canvas->SetVisible(index, iDisplay);
-    _pView->updateGL();
+    if (_pView)
+        _pView->updateGL();
 }
 
 void Controller::setModified(unsigned index, bool iMod)
 {
-    _pStyleWindow->setModified(index, iMod);
+    if (_pStyleWindow)
+        _pStyleWindow->setModified(index, iMod);
     _Canvas->setModified(index, iMod);
     updateCausalStyleModules(index + 1);
 }
@@ -1452,7 +1597,8 @@ void Controller::updateCausalStyleModules(unsigned index) {
     vector<unsigned> vec;
     _Canvas->causalStyleModules(vec, index);
     for (vector<unsigned>::const_iterator it = vec.begin(); it != vec.end(); it++) {
-        _pStyleWindow->setModified(*it, true);
+        if (_pStyleWindow)
+            _pStyleWindow->setModified(*it, true);
         _Canvas->setModified(*it, true);
     }
 }
@@ -1465,8 +1611,13 @@ void Controller::savePSLayers(const QString& baseName, bool polyline, int polyli
     for(int i=0; i<_Canvas->getNumStyleModules(); i++){
         QString currentName(baseName);
         QString moduleName(_Canvas->getStyleModule(i)->getFileName().c_str());
-        moduleName.chop(3);
-        int idx = moduleName.lastIndexOf('/');
+        int idx;
+        if (CompiledStyleModule::isCompiled(_Canvas->getStyleModule(i)->getFileName()))
+            idx = moduleName.lastIndexOf(':');  // "<library>:<module>"
+        else {
+            moduleName.chop(3);
+            idx = moduleName.lastIndexOf('/');
+        }
         currentName.replace('#',moduleName.right(moduleName.size()-idx-1));
         printf("\topen %s\n",currentName.toAscii().data());
         PSStrokeRenderer psRenderer((const char*)currentName.toAscii().data(), outputWidth, outputHeight, polyline, polylineWidth);
@@ -1489,6 +1640,7 @@ void Controller::saveTextSnapshot(const QString& iFileName){
 
 void Controller::SaveSVG(const char * svgFilename, bool polyline, int polylineWidth)
 {
+    StatsTimer timer("SaveSVG");
     SVGStrokeRenderer svgRenderer( svgFilename, outputWidth, outputHeight, polyline, polylineWidth );
     _Canvas->Canvas::Render(&svgRenderer);
     printf("\topen %s\n", svgFilename);
@@ -1500,7 +1652,8 @@ void Controller::captureMovie() {
 
 void Controller::resetModified(bool iMod)
 {
-    _pStyleWindow->resetModified(iMod);
+    if (_pStyleWindow)
+        _pStyleWindow->resetModified(iMod);
     _Canvas->resetModified(iMod);
 }
 
@@ -1596,8 +1749,89 @@ void		Controller::resetInterpreter() {
         _inter->reset();
 }
 
+void Controller::LoadOptions()
+{
+    // Same options file and defaults as AppOptionsWindow, which
+    // propagates them itself when there is a GUI.
+    const QString sep(Config::DIR_SEP.c_str());
+    QString filename = Config::Path::getInstance()->getHomeDir() + sep + Config::OPTIONS_DIR + sep + Config::OPTIONS_FILE;
+    ConfigIO options(filename, Config::APPLICATION_NAME + "Options");
+    options.loadFile();
+
+    Config::Path * cpath = Config::Path::getInstance();
+    QString str;
+
+    // Directories
+    if (options.getValue("default_path/models/path", str))
+        str = cpath->getModelsPath();
+    ViewMapIO::Options::setModelsPath((const char*)str.toAscii().data());
+    if (options.getValue("default_path/python/path", str))
+        str = cpath->getPythonPath();
+    PythonInterpreter::Options::setPythonPath((const char*)str.toAscii().data());
+    if (options.getValue("default_path/patterns/path", str))
+        str = cpath->getPatternsPath();
+    TextureManager::Options::setPatternsPath((const char*)str.toAscii().data());
+    if (options.getValue("default_path/brushes/path", str))
+        str = cpath->getBrushesPath();
+    TextureManager::Options::setBrushesPath((const char*)str.toAscii().data());
+
+    // Papers Textures
+    vector<string> papers;
+    unsigned papers_nb;
+    if (options.getValue("papers/nb", papers_nb)) {
+        papers.push_back((const char*)(cpath->getPapersDir() + Config::DEFAULT_PAPER_TEXTURE).toAscii().data());
+    } else {
+        for (unsigned i = 0; i < papers_nb; i++) {
+            QString path;
+            QTextStream(&path) << "papers/texture" << i << "/filename";
+            options.getValue(path, str);
+            papers.push_back((const char*)str.toAscii().data());
+        }
+    }
+    TextureManager::Options::setPaperTextures(papers);
+
+    // ViewMap Format
+    bool b;
+    if (options.getValue("default_viewmap_format/float_vectors", b))
+        b = false;
+    if (b)
+        ViewMapIO::Options::addFlags(ViewMapIO::Options::FLOAT_VECTORS);
+    else
+        ViewMapIO::Options::rmFlags(ViewMapIO::Options::FLOAT_VECTORS);
+    if (options.getValue("default_viewmap_format/no_occluders", b))
+        b = false;
+    if (b)
+        ViewMapIO::Options::addFlags(ViewMapIO::Options::NO_OCCLUDERS);
+    else
+        ViewMapIO::Options::rmFlags(ViewMapIO::Options::NO_OCCLUDERS);
+    if (options.getValue("default_viewmap_format/compute_steerable", b))
+        b = false;
+    setComputeSteerableViewMapFlag(b);
+
+    // Visibility
+    if (options.getValue("default_visibility/exhaustive_computation", b))
+        b = true;
+    setQuantitativeInvisibility(b);
+
+    // Ridges and Valleys, Suggestive Contours
+    double r;
+    if (options.getValue("default_ridges/sphere_radius", r))
+        r = Config::DEFAULT_SPHERE_RADIUS;
+    setSphereRadius(r);
+    if (options.getValue("default_ridges/enable", b))
+        b = false;
+    setComputeRidgesAndValleysFlag(b);
+    if (options.getValue("default_suggestive_contours/enable", b))
+        b = false;
+    setComputeSuggestiveContoursFlag(b);
+    if (options.getValue("default_suggestive_contours/dkr_epsilon", r))
+        r = Config::DEFAULT_DKR_EPSILON;
+    setSuggestiveContourKrDerivativeEpsilon(r);
+}
+
 void Controller::displayMessage(const char * msg, bool persistent){
-    _pMainWindow->DisplayMessage(msg, persistent);
+    if (_pMainWindow)
+        _pMainWindow->DisplayMessage(msg, persistent);
 }
 
 void Controller::displayDensityCurves(int x, int y){
@@ -1641,6 +1875,8 @@ void Controller::displayDensityCurves(int x, int y){
 
 void Controller::printRowCount() const 
 { 
+    if (_pStyleWindow == NULL)
+        return;
     printf("rowCount: %d, currentRow: %d\n", _pStyleWindow->PlayList->rowCount(),
            _pStyleWindow->PlayList->currentRow());
 
@@ -35,6 +35,7 @@
 # include "../rendering/GLUtils.h"
 # include "../geometry/FastGrid.h"
 # include "../geometry/HashGrid.h"
+# include "../geometry/OccluderBVH.h"
 # include "../view_map/ViewMapBuilder.h"
 # include "../system/TimeUtils.h"
 # include "../system/Precision.h"
@@ -45,11 +46,12 @@ class AppProgressBar;
 class AppGLWidget;
 class AppMainWindow;
 class NodeGroup;
+struct TriangleMeshData;
 class WShape;
 class SShape;
 class ViewMap;
 class ViewEdge;
-class AppCanvas;
+class Canvas;
 class InteractiveShader;
 class Shader;
 class AppInteractiveShaderWindow;
@@ -60,12 +62,17 @@ class AppDensityCurvesWindow;
 class Controller
 {
 public:
-  Controller() ;
+  /*! headless: no window, view or OpenGL context. The scene is seen through the camera
+   *  given by the RIF (useCameraFromRIB), strokes are only written to files, and the
+   *  options are read from the options file rather than from the options window. */
+  Controller(bool headless = false) ;
   ~Controller() ;
+  bool headless() const {return _headless;}
   
   void SetView(AppGLWidget *iView);
   void SetMainWindow(AppMainWindow *iMainWindow); 
   int  Load3DSFile(const char *iFileName, double jiggleFactor = 0);
+  int  LoadMesh(const TriangleMeshData& iMesh, const char *iName, double jiggleFactor = 0);
   void CloseFile();
   void LoadViewMapFile(const char *iFileName, bool only_camera = false);
   void SaveViewMapFile(const char *iFileName);
@@ -106,10 +113,13 @@ public:
   NodeGroup* debugNode() {return _DebugNode;}
   AppGLWidget * view() {return _pView;}
   NodeGroup* debugScene() {return _DebugNode;}
-  Grid& grid() {return _Grid;}
+  Grid& grid() {return *_Grid;}
   
   void toggleVisibilityAlgo();
   void setVisibilityAlgo(ViewMapBuilder::visibility_algo alg, bool useConsistency);
+  void setOccluderStructure(ViewMapBuilder::occluder_structure s); // takes effect when the next scene is loaded
+  void setCheckConcurrentLayers(bool iCheck); // see Canvas::SetCheckConcurrentLayers
+  unsigned concurrentLayerMismatches() const;
 
   void SetCuspTrimThreshold(real threshold) { _cuspTrimThreshold = threshold; }
     void SetGraftThreshold(real threshold) { _graftThreshold = threshold; }
@@ -148,6 +158,7 @@ public:
   QString	getBrowserCmd() const;
 
   void resetInterpreter();
+  void LoadOptions(); // the settings of AppOptionsWindow that affect the output, for a headless controller
   Interpreter * interpreter() { return _inter; }
   void printRowCount() const; 
 
@@ -168,6 +179,11 @@ public:
 
 private:
 
+  // a Python style module, or a CompiledStyleModule for "<library>:<module>"
+  StyleModule * newStyleModule(const char *iFileName);
+
+  int  BuildScene(NodeGroup *iScene, unsigned iNumFaces, real iMinEdgeSize, const char *iName, double wiggleFactor);
+
   // Main Window:
   AppMainWindow *_pMainWindow;
 
@@ -221,15 +237,19 @@ private:
   // edges tesselation nature
   int _edgeTesselationNature;
 
-  FastGrid _Grid;
-  //HashGrid _Grid;
+  FastGrid _FastGrid;
+  //HashGrid _FastGrid;
+  OccluderBVH _OccluderBVH;
+  Grid * _Grid;  // whichever of the above is selected by _OccluderStructure
+  ViewMapBuilder::occluder_structure _OccluderStructure;
   
   unsigned int _SceneNumFaces;
   real _minEdgeSize;
   real _EPSILON;
   real _bboxDiag;
 
-  AppCanvas *_Canvas;
+  Canvas *_Canvas;  // an AppCanvas, or a BatchCanvas when headless
+  bool _headless;
 
   AppStyleWindow *_pStyleWindow;
   AppOptionsWindow *_pOptionsWindow;
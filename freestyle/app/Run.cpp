@@ -27,6 +27,8 @@
 #include "AppConfig.h"
 #include "AppGLWidget.h"
 #include "Run.h"
+#include "../scene_graph/TriangleMeshLoader.h"
+#include "../system/Stats.h"
 
 // Global
 Controller	*g_pController;
@@ -274,6 +276,84 @@ void clearStylesFS()
     styleNames.clear();
 }
 
+// mesh handed over in memory by the RIF, until the scene is loaded; when empty, run() reads meshFilename instead
+TriangleMeshData inputMesh;
+
+void setMeshFS(std::vector<double> & vertices, std::vector<double> & normals, std::vector<float> & vertexUserData,
+               std::vector<unsigned> & faces, std::vector<int> & faceUserData, bool meshSilhouettes)
+{
+    clearMeshFS();
+
+    inputMesh.vertices.swap(vertices);
+    inputMesh.normals.swap(normals);
+    inputMesh.vertexUserData.swap(vertexUserData);
+    inputMesh.faces.swap(faces);
+    inputMesh.faceUserData.swap(faceUserData);
+    inputMesh.meshSilhouettes = meshSilhouettes;
+}
+
+void clearMeshFS()
+{
+    // swapping with empty vectors releases the memory, which assigning an empty mesh would not
+    std::vector<real>().swap(inputMesh.vertices);
+    std::vector<real>().swap(inputMesh.normals);
+    std::vector<float>().swap(inputMesh.vertexUserData);
+    std::vector<unsigned>().swap(inputMesh.faces);
+    std::vector<int>().swap(inputMesh.faceUserData);
+    inputMesh.meshSilhouettes = true;
+}
+
+// load the mesh handed over by setMeshFS, if any, and release it; otherwise read meshFilename
+void loadMeshFS(const char * meshFilename, double wiggleFactor)
+{
+    if (inputMesh.numFaces() > 0)
+    {
+        g_pController->LoadMesh(inputMesh,meshFilename,wiggleFactor);
+        clearMeshFS();
+    }
+    else
+        g_pController->Load3DSFile(meshFilename,wiggleFactor);
+}
+
+// cast the visibility rays through an OccluderBVH rather than a FastGrid
+bool useOccluderBVH = false;
+
+void setOccluderBVHFS(bool useBVH)
+{
+    useOccluderBVH = useBVH;
+}
+
+// also run the concurrent style modules one after the other, and compare their strokes (see Canvas::SetCheckConcurrentLayers)
+bool checkConcurrentLayers = false;
+
+void setCheckConcurrentLayersFS(bool check)
+{
+    checkConcurrentLayers = check;
+}
+
+// stage timings and counters, so that the RIF can add its own stages to the per-frame report (see Stats)
+double statsWallTimeFS()
+{
+    return Stats::wallTime();
+}
+
+void statsAddTimeFS(const char * stage, double seconds)
+{
+    Stats::instance()->addTime(stage, seconds);
+    Stats::instance()->sampleMemory(stage);
+}
+
+void statsAddCountFS(const char * stage, const char * counter, long long value)
+{
+    Stats::instance()->addCount(stage, counter, value);
+}
+
+void statsWriteReportFS(const char * filename, const char * frame)
+{
+    Stats::instance()->writeReport(filename, frame);
+    Stats::instance()->reset();
+}
+
 QApplication *app = NULL;
 AppMainWindow *mainWindow = NULL;
 
@@ -393,7 +473,10 @@ void run(const char * meshFilename, const char * snapshotFilename, const char *
 
     printf("Wiggle Factor = %f\n", wiggleFactor);
 
-    g_pController->Load3DSFile(meshFilename,wiggleFactor);
+    g_pController->setOccluderStructure(useOccluderBVH ? ViewMapBuilder::occluder_bvh : ViewMapBuilder::occluder_grid);
+    g_pController->setCheckConcurrentLayers(checkConcurrentLayers);
+
+    loadMeshFS(meshFilename,wiggleFactor);
 
     setupCamera( top,  bottom,  left,  right, pixelaspect,  aspectratio, near,  far, focalLength, worldTransform);
 
@@ -443,6 +526,8 @@ void run(const char * meshFilename, const char * snapshotFilename, const char *
     // draw it on the image
 
     g_pController->DrawStrokes();
+    if (checkConcurrentLayers)
+        printf("Concurrent layers differing from a serial run: %u\n", g_pController->concurrentLayerMismatches());
 
     CHECK_FOR_ERROR;
 
@@ -471,6 +556,112 @@ void run(const char * meshFilename, const char * snapshotFilename, const char *
 
 
 
+// Same pipeline as run(), on a headless controller: no QApplication, window or
+// OpenGL context, so it works without a display. Only the vector outputs are
+// written (there is no frame buffer to snapshot).
+void runBatch(const char * meshFilename, const char * outputEPSPolyline, const char * outputEPSThick,
+              Matrix4x4 worldTransform,
+              float left, float right, float bottom, float top,
+              float pixelaspect, float aspectratio,
+              float near, float far, float focalLength,
+              int outputWidthArg, int outputHeightArg,
+              int visAlgorithm, bool useConsistency,
+              double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
+              const char * pythonLibPath, bool saveLayers)
+{
+    outputWidth = outputWidthArg;
+    outputHeight = outputHeightArg;
+
+    // no window: the window viewport is the output one
+    windowWidth = outputWidthArg;
+    windowHeight = outputHeightArg;
+
+    orientableSurfaces = true;
+
+    if (g_pController != NULL && !g_pController->headless())
+    {
+        printf("Error: runBatch called after run() created a window\n");
+        exit(1);
+    }
+
+    static Config::Path *pathconfig = NULL;
+
+    if (g_pController == NULL)
+    {
+        // sets the paths
+        pathconfig = new Config::Path;
+        g_pController = new Controller(true);
+    }
+    else
+    {
+        // delete the old data from the controller
+        g_pController->CloseFile();
+        g_pController->Clear();  // clears the canvas and removes style modules
+    }
+
+    if (pythonLibPath != NULL && strlen(pythonLibPath) > 0)
+    {
+        char * cmd = new char[25+strlen(pythonLibPath)];
+        sprintf(cmd,"sys.path.append('%s')",pythonLibPath);
+
+        g_pController->interpreter()->interpretCmd("import sys");
+        g_pController->interpreter()->interpretCmd(cmd);
+
+        delete [] cmd;
+    }
+
+    int i=0;
+    for(vector<const char*>::iterator it = styleNames.begin(); it!=styleNames.end(); it++)
+    {
+        g_pController->AddStyleModule(*it);
+        g_pController->toggleLayer(i++, true);
+    }
+
+    g_pController->setOccluderStructure(useOccluderBVH ? ViewMapBuilder::occluder_bvh : ViewMapBuilder::occluder_grid);
+    g_pController->setCheckConcurrentLayers(checkConcurrentLayers);
+
+    loadMeshFS(meshFilename,wiggleFactor);
+
+    setupCamera( top,  bottom,  left,  right, pixelaspect,  aspectratio, near,  far, focalLength, worldTransform);
+
+    ViewMapBuilder::visibility_algo va;
+
+    switch(visAlgorithm)
+    {
+    case 0: va = ViewMapBuilder::ray_casting; break;
+    case 1: va = ViewMapBuilder::region_based; break;
+    case 2: va = ViewMapBuilder::punch_out; break;
+    default: printf("Invalid visibility algorithm specified\n"); exit(1);
+    }
+
+    g_pController->setVisibilityAlgo( va, useConsistency );
+
+    g_pController->SetCuspTrimThreshold(cuspTrimThreshold);
+    g_pController->SetGraftThreshold(graftThreshold);
+
+    g_pController->ComputeViewMap();
+
+    // executes the style modules; the strokes are only rendered to the files below
+    g_pController->DrawStrokes();
+    if (checkConcurrentLayers)
+        printf("Concurrent layers differing from a serial run: %u\n", g_pController->concurrentLayerMismatches());
+
+    if(saveLayers){
+        g_pController->savePSLayers(outputEPSPolyline, true, 2);
+        g_pController->savePSLayers(outputEPSThick, false, 0);
+    }else{
+        g_pController->savePSSnapshot(outputEPSPolyline, true, 2);
+        printf("\topen %s\n",outputEPSPolyline);
+        g_pController->savePSSnapshot(outputEPSThick, false, 0);
+        printf("\topen %s\n",outputEPSThick);
+        QString svgName = QString(outputEPSPolyline);
+        svgName.chop(3);
+        svgName.append("svg");
+        g_pController->SaveSVG(qPrintable(svgName), true, 1);
+    }
+}
+
+
 
 
 
@@ -541,3 +732,24 @@ void addRIFFacing(int faceNum, int vfint)
   RIFfacings[faceNum] = vfint;
 }
 */
+
+void runBatch2(const char * meshFilename, const char * svgFilename, const char * psFilename,
+               float worldTransform[16],
+               float left, float right, float bottom, float top,
+               float pixelaspect, float aspectratio,
+               float near, float far, float focalLength,
+               int outputWidthArg, int outputHeightArg,
+               int visAlgorithm, bool useConsistency,
+               double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
+               const char * pythonLibPath, bool saveLayers)
+{
+    Matrix4x4 worldTransformMatrix
+            (worldTransform[0],worldTransform[1],worldTransform[2],worldTransform[3],
+             worldTransform[4],worldTransform[5],worldTransform[6],worldTransform[7],
+             worldTransform[8],worldTransform[9],worldTransform[10],worldTransform[11],
+             worldTransform[12],worldTransform[13],worldTransform[14],worldTransform[15]);
+
+    runBatch(meshFilename,svgFilename,psFilename, worldTransformMatrix,left,right,bottom,top,pixelaspect,
+             aspectratio,near,far,focalLength,outputWidthArg,outputHeightArg,
+             visAlgorithm,useConsistency,cuspTrimThreshold, graftThreshold, wiggleFactor, pythonLibPath,saveLayers);
+}
@@ -1,4 +1,5 @@
 #include <Python.h>
+#include <vector>
 
 // Data structure for passing Matrix data between C++ and Python
 struct Matrix4x4
@@ -64,6 +65,12 @@ public:
 void addStyleFS(const char * styleFilename);
 void clearStylesFS();
 
+// hand the tessellated mesh over in memory instead of through a PLY file. The arrays are swapped in, leaving the
+// caller's empty; the next run() or runBatch() loads the mesh and releases it
+void setMeshFS(std::vector<double> & vertices, std::vector<double> & normals, std::vector<float> & vertexUserData,
+               std::vector<unsigned> & faces, std::vector<int> & faceUserData, bool meshSilhouettes);
+void clearMeshFS();
+
 void run(const char * meshFilename, const char * snapshotFilename, const char * outputEPSPolyline, const char * outputEPSThick,
          Matrix4x4 worldTransform,
          float top, float bottom, float left, float right,
@@ -75,6 +82,17 @@ void run(const char * meshFilename, const char * snapshotFilename, const char *
          double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
          const char * pythonLibPath, bool saveLayers);
 
+// run() without a window or OpenGL context (no TIFF snapshot, no interactive session)
+void runBatch(const char * meshFilename, const char * outputEPSPolyline, const char * outputEPSThick,
+              Matrix4x4 worldTransform,
+              float left, float right, float bottom, float top,
+              float pixelaspect, float aspectratio,
+              float near, float far, float focalLength,
+              int outputWidthArg, int outputHeightArg,
+              int visAlgorithm, bool useConsistency,
+              double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
+              const char * pythonLibPath, bool saveLayers);
+
 #ifndef CHECK_FOR_ERROR
 #  ifdef NDEBUG
 #     define CHECK_FOR_ERROR   ;
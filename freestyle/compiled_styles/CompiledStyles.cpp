@@ -0,0 +1,159 @@
+//
+//  Filename         : CompiledStyles.cpp
+//  Purpose          : C++ versions of the production style modules of
+//                     scripts/freestyle/style_modules, see CompiledStyleModule.h
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <math.h>
+#include <vector>
+#include "../stroke/CompiledStyleModule.h"
+#include "../stroke/Operators.h"
+#include "../stroke/Predicates1D.h"
+#include "../stroke/ChainingIterators.h"
+#include "../stroke/BasicStrokeShaders.h"
+#include "../stroke/Stroke.h"
+#include "../stroke/StrokeIterators.h"
+
+using namespace std;
+
+//
+//  Python helpers of the style modules, ported with the same arithmetic
+//  so that the strokes are identical
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// logical_operators.py
+class NotUP1D : public UnaryPredicate1D
+{
+public:
+  NotUP1D(UnaryPredicate1D& pred) : _pred(pred) {}
+  virtual string getName() const { return "NotUP1D"; }
+  virtual bool operator()(Interface1D& inter) { return !_pred(inter); }
+private:
+  UnaryPredicate1D& _pred;
+};
+
+// shaders.py
+class ConstantThicknessShader : public StrokeShader
+{
+public:
+  ConstantThicknessShader(double thickness) : _thickness(thickness) {}
+  virtual string getName() const { return "pyConstantThicknessShader"; }
+  virtual void shade(Stroke& stroke) const {
+    for(StrokeInternal::StrokeVertexIterator it = stroke.strokeVerticesBegin(); !it.isEnd(); ++it) {
+      double t = _thickness/2.0;
+      it->attribute().setThickness(t, t);
+    }
+  }
+private:
+  double _thickness;
+};
+
+// shaders.py
+static double smoothC(double a, double exp)
+{
+  return pow(a, exp)*pow(2.0, exp);
+}
+
+// shaders.py: thickest at the extremities unless the stroke is a loop
+class NonLinearVaryingThicknessShader : public StrokeShader
+{
+public:
+  NonLinearVaryingThicknessShader(double thicknessExtremity, double thicknessMiddle, double exponent)
+    : _thicknessMin(thicknessMiddle), _thicknessMax(thicknessExtremity), _exponent(exponent) {}
+  virtual string getName() const { return "pyNonLinearVaryingThicknessShader"; }
+  virtual void shade(Stroke& stroke) const {
+    StrokeInternal::StrokeVertexIterator lastPt = stroke.strokeVerticesEnd();
+    --lastPt;
+    bool isLoop = (stroke.strokeVerticesBegin()->getPoint() - lastPt->getPoint()).norm() < 0.5;
+
+    int n = stroke.strokeVerticesSize();
+    int i = 0;
+    for(StrokeInternal::StrokeVertexIterator it = stroke.strokeVerticesBegin(); !it.isEnd(); ++it, ++i) {
+      StrokeAttribute& att = it->attribute();
+      if (isLoop) {
+        att.setThickness(_thicknessMin/2.0, _thicknessMin/2.0);
+      } else {
+        double c;
+        if (i < double(n)/2.0)
+          c = double(i)/double(n);
+        else
+          c = double(n-i-1)/double(n);
+        c = smoothC(c, _exponent);
+        double t = (1.0 - c)*_thicknessMax + c*_thicknessMin;
+        att.setThickness(t/2.0, t/2.0);
+      }
+    }
+  }
+private:
+  double _thicknessMin;
+  double _thicknessMax;
+  double _exponent;
+};
+
+//
+//  Style modules
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// the selection and chaining of plain.py and taper.py: visible silhouettes
+static void selectAndChainVisible()
+{
+  Predicates1D::QuantitativeInvisibilityUP1D visible(0);
+  Operators::select(visible);
+  ChainSilhouetteIterator chaining;
+  NotUP1D invisible(visible);
+  Operators::bidirectionalChain(chaining, invisible);
+}
+
+// plain.py
+static int plain()
+{
+  selectAndChainVisible();
+  StrokeShaders::ConstantColorShader color(1, 1, 1);
+  ConstantThicknessShader thickness(4);
+  vector<StrokeShader*> shaders;
+  shaders.push_back(&color);
+  shaders.push_back(&thickness);
+  Predicates1D::TrueUP1D all;
+  Operators::create(all, shaders);
+  return 0;
+}
+REGISTER_CONCURRENT_STYLE_MODULE(plain)
+
+// taper.py
+static int taper()
+{
+  selectAndChainVisible();
+  StrokeShaders::ConstantColorShader color(1, 1, 1);
+  NonLinearVaryingThicknessShader thickness(0.5, 4, 0.6);
+  vector<StrokeShader*> shaders;
+  shaders.push_back(&color);
+  shaders.push_back(&thickness);
+  Predicates1D::TrueUP1D all;
+  Operators::create(all, shaders);
+  return 0;
+}
+REGISTER_CONCURRENT_STYLE_MODULE(taper)
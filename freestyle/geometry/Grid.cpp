@@ -63,7 +63,7 @@ void firstIntersectionGridVisitor::examineOccluder(Polygon3r *occ){
                     t_ = tmp_t;
                 }
             }else{
-                occ->userdata2 = 0;
+                ray_.unmark(occ);
             }
         }
     }
@@ -223,8 +223,22 @@ void Grid::insertOccluder(Polygon3r* occluder) {
   }
 }
 
-bool Grid::nextRayCell(Vec3u& current_cell, Vec3u& next_cell) {
-  next_cell = current_cell;
+void Grid::beginRay(GridRay& ray) {
+  if (ray._stamps.size() != _occluders.size()) {
+    ray._stamps.assign(_occluders.size(), 0);
+    ray._timestamp = 0;
+  }
+  // start over when the stamps wrap around
+  if (++ray._timestamp == 0) {
+    ray._stamps.assign(_occluders.size(), 0);
+    ray._timestamp = 1;
+  }
+}
+
+bool Grid::nextRayCell(GridRay& ray) {
+  Vec3u& next_cell = ray._current_cell;
+  Vec3r& ray_dir = ray._ray_dir;
+  Vec3r& pt = ray._pt;
   real t_min, t;
   unsigned i;
  
@@ -238,12 +252,12 @@ bool Grid::nextRayCell(Vec3u& current_cell, Vec3u& next_cell) {
   // to the intersections with the plans:
   // x = _cell_size[0], y = _cell_size[1], z = _cell_size[2]
   for (i = 0; i < 3; i++) {
-    if (_ray_dir[i] == 0)
+    if (ray_dir[i] == 0)
       continue;
-    if (_ray_dir[i] > 0)
-      t = (_cell_size[i] - _pt[i]) / _ray_dir[i];
+    if (ray_dir[i] > 0)
+      t = (_cell_size[i] - pt[i]) / ray_dir[i];
     else
-      t = -_pt[i] / _ray_dir[i];
+      t = -pt[i] / ray_dir[i];
     if (t < t_min) {
       t_min = t;
       coord = i;
@@ -253,31 +267,31 @@ bool Grid::nextRayCell(Vec3u& current_cell, Vec3u& next_cell) {
   // We use the parametric line equation and
   // the found t (tamx) to compute the
   // B coordinates:
-  Vec3r pt_tmp(_pt);
-  _pt = pt_tmp + t_min * _ray_dir;
+  Vec3r pt_tmp(pt);
+  pt = pt_tmp + t_min * ray_dir;
     
   // We express B coordinates in the next cell
   // coordinates system. We just have to
   // set the coordinate coord of B to 0
   // of _CellSize[coord] depending on the sign
   // of _u[coord]
-  if (_ray_dir[coord] > 0) {
+  if (ray_dir[coord] > 0) {
     next_cell[coord]++;
-    _pt[coord] -= _cell_size[coord];
+    pt[coord] -= _cell_size[coord];
     // if we are out of the grid, we must stop
     if (next_cell[coord] >= _cells_nb[coord])
       return false;
   }
   else {
     int tmp = next_cell[coord] - 1;
-    _pt[coord] = _cell_size[coord];
+    pt[coord] = _cell_size[coord];
     if (tmp < 0)
       return false;
     next_cell[coord]--;
   }
 
-  _t += t_min;
-  if (_t >= _t_end)
+  ray._t += t_min;
+  if (ray._t >= ray._t_end)
     return false;
 
   return true;
@@ -286,25 +300,25 @@ bool Grid::nextRayCell(Vec3u& current_cell, Vec3u& next_cell) {
 void Grid::castRay(const Vec3r& orig,
 		   const Vec3r& end,
 		   OccludersSet& occluders,
-		   unsigned timestamp) {
+		   GridRay& ray) {
   //  printf("inGrid = %s, orig = %f %f %f\n", inGrid(orig) ? "TRUE" : "FALSE", orig[0], orig[1], orig[2]);
   
 
-  initRay(orig, end, timestamp);
+  initRay(orig, end, ray);
   allOccludersGridVisitor visitor(occluders);
-  castRayInternal(visitor);
+  castRayInternal(visitor, ray);
 }
 
 void Grid::castInfiniteRay(const Vec3r& orig,
 			   const Vec3r& dir,
 			   OccludersSet& occluders,
-			   unsigned timestamp) {
+			   GridRay& ray) {
   Vec3r end = Vec3r(orig + FLT_MAX * dir / dir.norm());
-  bool inter = initInfiniteRay(orig, dir, timestamp);
+  bool inter = initInfiniteRay(orig, dir, ray);
   if(!inter)
       return;
   allOccludersGridVisitor visitor(occluders);
-  castRayInternal(visitor);
+  castRayInternal(visitor, ray);
 }
   
 Polygon3r* Grid::castRayToFindFirstIntersection(const Vec3r& orig,
@@ -312,15 +326,15 @@ Polygon3r* Grid::castRayToFindFirstIntersection(const Vec3r& orig,
                    double& t,
                    double& u,
                    double& v,
-                   unsigned timestamp){
+                   GridRay& ray){
     Polygon3r *occluder = 0;
     Vec3r end = Vec3r(orig + FLT_MAX * dir / dir.norm());
-    bool inter = initInfiniteRay(orig, dir, timestamp);
+    bool inter = initInfiniteRay(orig, dir, ray);
     if(!inter){
         return 0;
     }
-    firstIntersectionGridVisitor visitor(orig,dir,_cell_size);
-    castRayInternal(visitor);
+    firstIntersectionGridVisitor visitor(orig,dir,_cell_size,ray);
+    castRayInternal(visitor, ray);
     occluder = visitor.occluder();
     t = visitor.t_;
     u = visitor.u_;
@@ -330,17 +344,16 @@ Polygon3r* Grid::castRayToFindFirstIntersection(const Vec3r& orig,
 
 void Grid::initRay (const Vec3r &orig,
 		    const Vec3r& end,
-		    unsigned timestamp) {
-  _ray_dir = end - orig;
-  _t_end = _ray_dir.norm();
-  _t = 0;
-  _ray_dir.normalize();
-  _timestamp = timestamp;
+		    GridRay& ray) {
+  beginRay(ray);
+  ray._ray_dir = end - orig;
+  ray._t_end = ray._ray_dir.norm();
+  ray._t = 0;
+  ray._ray_dir.normalize();
 
   for(unsigned i = 0; i < 3; i++) {
-    _current_cell[i] = (unsigned)floor((orig[i] - _orig[i]) / _cell_size[i]);
-    unsigned u = _current_cell[i];
-    _pt[i] = orig[i] - _orig[i] - _current_cell[i] * _cell_size[i];
+    ray._current_cell[i] = (unsigned)floor((orig[i] - _orig[i]) / _cell_size[i]);
+    ray._pt[i] = orig[i] - _orig[i] - ray._current_cell[i] * _cell_size[i];
   }
   //_ray_occluders.clear();
 
@@ -348,12 +361,12 @@ void Grid::initRay (const Vec3r &orig,
 
 bool Grid::initInfiniteRay (const Vec3r &orig,
 		    const Vec3r& dir,
-		    unsigned timestamp) {
-  _ray_dir = dir;
-  _t_end = FLT_MAX;
-  _t = 0;
-  _ray_dir.normalize();
-  _timestamp = timestamp;
+		    GridRay& ray) {
+  beginRay(ray);
+  ray._ray_dir = dir;
+  ray._t_end = FLT_MAX;
+  ray._t = 0;
+  ray._ray_dir.normalize();
 
   // check whether the origin is in or out the box:
   Vec3r boxMin(_orig);
@@ -361,22 +374,20 @@ bool Grid::initInfiniteRay (const Vec3r &orig,
   BBox<Vec3r> box(boxMin, boxMax);
   if(box.inside(orig)){
       for(unsigned i = 0; i < 3; i++) {
-          _current_cell[i] = (unsigned)floor((orig[i] - _orig[i]) / _cell_size[i]);
-          unsigned u = _current_cell[i];
-          _pt[i] = orig[i] - _orig[i] - _current_cell[i] * _cell_size[i];
+          ray._current_cell[i] = (unsigned)floor((orig[i] - _orig[i]) / _cell_size[i]);
+          ray._pt[i] = orig[i] - _orig[i] - ray._current_cell[i] * _cell_size[i];
       }
   }else{
       // is the ray intersecting the box?
       real tmin(-1.0), tmax(-1.0);
-      if(GeomUtils::intersectRayBBox(orig, _ray_dir, boxMin, boxMax, 0, _t_end, tmin, tmax)){
+      if(GeomUtils::intersectRayBBox(orig, ray._ray_dir, boxMin, boxMax, 0, ray._t_end, tmin, tmax)){
         assert(tmin != -1.0);
-        Vec3r newOrig = orig + tmin*_ray_dir;
+        Vec3r newOrig = orig + tmin*ray._ray_dir;
         for(unsigned i = 0; i < 3; i++) {
-            _current_cell[i] = (unsigned)floor((newOrig[i] - _orig[i]) / _cell_size[i]);
-            if(_current_cell[i] == _cells_nb[i])
-                _current_cell[i] = _cells_nb[i] - 1;
-            unsigned u = _current_cell[i];
-            _pt[i] = newOrig[i] - _orig[i] - _current_cell[i] * _cell_size[i];
+            ray._current_cell[i] = (unsigned)floor((newOrig[i] - _orig[i]) / _cell_size[i]);
+            if(ray._current_cell[i] == _cells_nb[i])
+                ray._current_cell[i] = _cells_nb[i] - 1;
+            ray._pt[i] = newOrig[i] - _orig[i] - ray._current_cell[i] * _cell_size[i];
         }
 
       }else{
@@ -80,6 +80,45 @@ class LIB_GEOMETRY_EXPORT Cell
 };
 
 
+//
+// Traversal state of one ray through a Grid
+//
+///////////////////////////////////////////////////////////////////////////////
+
+/*! The state of a ray being cast through a Grid.
+ *  The grid itself is not modified by ray casting, so rays can be cast
+ *  through the same grid from several threads, as long as each thread
+ *  uses its own GridRay.
+ *  A GridRay also remembers which occluders the current ray has already
+ *  examined, so that occluders spanning several cells are reported once.
+ */
+class LIB_GEOMETRY_EXPORT GridRay
+{
+ public:
+
+  GridRay() : _timestamp(0), _t_end(0), _t(0) {}
+
+  /*! Lets the current ray examine this occluder again, in a later cell */
+  inline void unmark(Polygon3r* occ) {
+    _stamps[(unsigned long)occ->userdata2] = 0;
+  }
+
+ private:
+
+  friend class Grid;
+
+  unsigned	_timestamp;    // stamp of the current ray
+  vector<unsigned> _stamps;    // per occluder (indexed by userdata2): stamp of the last ray that examined it
+
+  Vec3r		_ray_dir;      // direction vector for the ray
+  Vec3u		_current_cell; // The current cell being processed (designated by its 3 coordinates)
+  Vec3r		_pt;           // Points corresponding to the incoming and outgoing intersections
+                               // of one cell with the ray
+  real		_t_end;        // To know when we are at the end of the ray
+  real		_t;
+};
+
+
 class GridVisitor{
 public:
     virtual void discoverCell(Cell *cell) {}
@@ -108,9 +147,9 @@ private:
  */
 class firstIntersectionGridVisitor : public GridVisitor {
 public:
-      firstIntersectionGridVisitor(const Vec3r& ray_org, const Vec3r& ray_dir, const Vec3r& cell_size) : 
-      GridVisitor(), ray_org_(ray_org), cell_size_(cell_size),ray_dir_(ray_dir),occluder_(0),
-            u_(0),v_(0),t_(DBL_MAX),current_cell_(0){}
+      firstIntersectionGridVisitor(const Vec3r& ray_org, const Vec3r& ray_dir, const Vec3r& cell_size, GridRay& ray) : 
+      GridVisitor(), u_(0),v_(0),t_(DBL_MAX),occluder_(0),ray_org_(ray_org), ray_dir_(ray_dir),
+            cell_size_(cell_size),current_cell_(0),ray_(ray){}
       virtual ~firstIntersectionGridVisitor() {}
 
     virtual void discoverCell(Cell *cell) {current_cell_=cell;}
@@ -126,6 +165,7 @@ private:
     Vec3r ray_org_, ray_dir_;
     Vec3r cell_size_;
     Cell * current_cell_;
+    GridRay& ray_;
 };
 
 //
@@ -250,10 +290,20 @@ public:
    *    convex_poly
    *      The list of 3D points constituing a convex polygon
    */
-  void insertOccluder(Polygon3r * convex_poly);
+  virtual void insertOccluder(Polygon3r * convex_poly);
+
+  /*! Called once all the occluders have been inserted,
+   *  before any ray is cast. Structures that are built
+   *  over the whole occluder set (see OccluderBVH) do so here;
+   *  the cell grids are filled as occluders are inserted.
+   */
+  virtual void finalizeOccluders() {}
 
-  /*! Adds an occluder to the list of occluders */
+  /*! Adds an occluder to the list of occluders.
+   *  Its index in the list is kept in userdata2, for the GridRay stamps.
+   */
   void addOccluder(Polygon3r* occluder) {
+    occluder->userdata2 = (void*)(unsigned long)_occluders.size();
     _occluders.push_back(occluder);
   }
 
@@ -261,32 +311,34 @@ public:
    *  Returns the list of occluders contained
    *  in the cells intersected by this ray
    *  Starts with a call to InitRay.
+   *  The traversal state is kept in ray, so concurrent
+   *  calls must pass different GridRays.
    */
-  void castRay(const Vec3r& orig,
+  virtual void castRay(const Vec3r& orig,
 	       const Vec3r& end,
 	       OccludersSet& occluders,
-	       unsigned timestamp);
+	       GridRay& ray);
 
   /*! Casts an infinite ray (still finishing at the end of the grid) from a starting point and in a given direction.
    *  Returns the list of occluders contained
    *  in the cells intersected by this ray
    *  Starts with a call to InitRay.
    */
-  void castInfiniteRay(const Vec3r& orig,
+  virtual void castInfiniteRay(const Vec3r& orig,
 		       const Vec3r& dir,
 		       OccludersSet& occluders,
-		       unsigned timestamp);
+		       GridRay& ray);
 
   /*! Casts an infinite ray (still finishing at the end of the grid) from a starting point and in a given direction.
   *  Returns the first intersection (occluder,t,u,v) or null.
   *  Starts with a call to InitRay.
   */
-  Polygon3r * castRayToFindFirstIntersection(const Vec3r& orig,
+  virtual Polygon3r * castRayToFindFirstIntersection(const Vec3r& orig,
       const Vec3r& dir,
       double& t,
       double& u,
       double& v,
-      unsigned timestamp);
+      GridRay& ray);
 
 
   /*! Init all structures and values for computing
@@ -294,7 +346,7 @@ public:
    */
   void initRay (const Vec3r &orig,
 		const Vec3r& end,
-		unsigned timestamp);
+		GridRay& ray);
 
   /*! Init all structures and values for computing
    *  the cells intersected by this infinite ray.
@@ -303,7 +355,7 @@ public:
    */
   bool initInfiniteRay (const Vec3r &orig,
 		const Vec3r& dir,
-		unsigned timestamp);
+		GridRay& ray);
 
  
   /*! Accessors */
@@ -320,7 +372,7 @@ public:
     return _cells_nb;
   }
 
-  void displayDebug() {
+  virtual void displayDebug() {
     cerr << "Cells nb     : " << _cells_nb << endl;
     cerr << "Cell size    : " << _cell_size << endl;
     cerr << "Origin       : " << _orig << endl;
@@ -364,53 +416,47 @@ public:
 
   // return all occluders in all cells that intersect the triangle (p1,p2,p3)
   // these occluders do not necessarily intersect (p1,p2,p3), but all possible intersections are included in this set
-  void triangleIntersections(Vec3r p1,Vec3r p2,Vec3r p3, set<Polygon3r*> & possibleIntersections);
+  virtual void triangleIntersections(Vec3r p1,Vec3r p2,Vec3r p3, set<Polygon3r*> & possibleIntersections);
   
  protected:
 
   /*! Core of castRay and castInfiniteRay, find occluders
    *  along the given ray
    */
-  inline void castRayInternal(GridVisitor& visitor) {
+  inline void castRayInternal(GridVisitor& visitor, GridRay& ray) {
     Cell* current_cell = NULL;
     do {
-      current_cell = getCell(_current_cell);
+      current_cell = getCell(ray._current_cell);
       if (current_cell){
           visitor.discoverCell(current_cell);
           OccludersSet& occluders = current_cell->getOccluders(); // FIXME: I had forgotten the ref &
           for (OccludersSet::iterator it = occluders.begin();
               it != occluders.end();
               it++) {
-                  if ((unsigned long)(*it)->userdata2 != _timestamp) {
-                      (*it)->userdata2 = (void*)_timestamp;
+                  unsigned & stamp = ray._stamps[(unsigned long)(*it)->userdata2];
+                  if (stamp != ray._timestamp) {
+                      stamp = ray._timestamp;
                       visitor.examineOccluder(*it);
                   }
               }
           visitor.finishCell(current_cell);
       }
-    } while ((!visitor.stop()) && (nextRayCell(_current_cell, _current_cell)));
+    } while ((!visitor.stop()) && (nextRayCell(ray)));
   }
 
+  /*! Starts a new ray: gives it a fresh stamp */
+  void beginRay(GridRay& ray);
  
-  /*! returns the  cell next to the cell
-   *  passed as argument.
+  /*! moves the ray to the cell next to
+   *  its current cell.
    */
-  bool nextRayCell(Vec3u& current_cell, Vec3u& next_cell);
-
-  unsigned long	_timestamp;
+  bool nextRayCell(GridRay& ray);
 
   Vec3u		_cells_nb;  // number of cells for x,y,z axis
   Vec3r		_cell_size; // cell x,y,z dimensions
   Vec3r		_size;      // grid x,y,x dimensions
   Vec3r		_orig;      // grid origin
 
-  Vec3r		_ray_dir;      // direction vector for the ray
-  Vec3u		_current_cell; // The current cell being processed (designated by its 3 coordinates)
-  Vec3r		_pt;           // Points corresponding to the incoming and outgoing intersections
-                               // of one cell with the ray
-  real		_t_end;        // To know when we are at the end of the ray
-  real		_t;
-
   //OccludersSet _ray_occluders; // Set storing the occluders contained in the cells traversed by a ray
   OccludersSet _occluders;     // List of all occluders inserted in the grid
 };
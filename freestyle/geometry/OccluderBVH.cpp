@@ -0,0 +1,481 @@
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OccluderBVH.h"
+#include <algorithm>
+
+namespace {
+
+  // build parameters
+  const unsigned MAX_LEAF_SIZE = 4;     // leaves never hold more occluders than this if a split helps
+  const unsigned MAX_SAH_LEAF = 16;     // ... and never more than this
+  const unsigned NUM_BINS = 16;         // SAH candidate splits per axis
+  const unsigned MAX_SAH_DEPTH = 48;    // below this depth, split at the median to bound the depth
+  const unsigned STACK_SIZE = 128;      // > MAX_SAH_DEPTH + log2(number of occluders)
+
+  inline real halfArea(const Vec3r& min, const Vec3r& max) {
+    Vec3r d(max - min);
+    return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+  }
+
+  inline void extend(Vec3r& min, Vec3r& max, const Vec3r& pmin, const Vec3r& pmax) {
+    for (unsigned i = 0; i < 3; i++) {
+      if (pmin[i] < min[i])
+	min[i] = pmin[i];
+      if (pmax[i] > max[i])
+	max[i] = pmax[i];
+    }
+  }
+
+  inline bool overlap(const Vec3r& amin, const Vec3r& amax, const Vec3r& bmin, const Vec3r& bmax) {
+    for (unsigned i = 0; i < 3; i++)
+      if (amax[i] < bmin[i] || bmax[i] < amin[i])
+	return false;
+    return true;
+  }
+
+  // A ray orig + t*dir, with what the slab test needs
+  struct BoxRay {
+    BoxRay(const Vec3r& o, const Vec3r& d) : orig(o) {
+      for (unsigned i = 0; i < 3; i++) {
+	parallel[i] = (d[i] == 0);
+	inv[i] = parallel[i] ? 0 : 1.0 / d[i];
+      }
+    }
+
+    // Does the ray cross the box for some t in [0, t_end]? t_near is where it enters.
+    inline bool hit(const Vec3r& min, const Vec3r& max, real t_end, real& t_near) const {
+      real t0 = 0, t1 = t_end;
+      for (unsigned i = 0; i < 3; i++) {
+	if (parallel[i]) {
+	  if (orig[i] < min[i] || orig[i] > max[i])
+	    return false;
+	  continue;
+	}
+	real ta = (min[i] - orig[i]) * inv[i];
+	real tb = (max[i] - orig[i]) * inv[i];
+	if (ta > tb)
+	  std::swap(ta, tb);
+	if (ta > t0)
+	  t0 = ta;
+	if (tb < t1)
+	  t1 = tb;
+	if (t0 > t1)
+	  return false;
+      }
+      t_near = t0;
+      return true;
+    }
+
+    Vec3r orig;
+    Vec3r inv;
+    bool parallel[3];
+  };
+
+  struct InBin {
+    InBin(const vector<Vec3r>& c, unsigned a, real mn, real sc, unsigned s)
+      : centroid(c), axis(a), min(mn), scale(sc), split(s) {}
+    bool operator()(unsigned prim) const {
+      unsigned b = (unsigned)((centroid[prim][axis] - min) * scale);
+      if (b >= NUM_BINS)
+	b = NUM_BINS - 1;
+      return b < split;
+    }
+    const vector<Vec3r>& centroid;
+    unsigned axis;
+    real min, scale;
+    unsigned split;
+  };
+
+  struct CentroidLess {
+    CentroidLess(const vector<Vec3r>& c, unsigned a) : centroid(c), axis(a) {}
+    bool operator()(unsigned a, unsigned b) const {
+      return centroid[a][axis] < centroid[b][axis];
+    }
+    const vector<Vec3r>& centroid;
+    unsigned axis;
+  };
+
+} // end of anonymous namespace
+
+void OccluderBVH::clear() {
+  _nodes.clear();
+  _leafOccluders.clear();
+  _built = false;
+  Grid::clear();
+}
+
+void OccluderBVH::insertOccluder(Polygon3r* occluder) {
+  if (occluder->getVertices().size() == 0)
+    return;
+  addOccluder(occluder);
+  _built = false;
+}
+
+void OccluderBVH::finalizeOccluders() {
+  if (_built)
+    return;
+
+  _nodes.clear();
+  _leafOccluders.clear();
+  _built = true;
+
+  unsigned n = _occluders.size();
+  if (n == 0)
+    return;
+
+  // The boxes are slightly enlarged, so that rays grazing an occluder
+  // (e.g. along a shared edge) still report it, as the grid cells do.
+  vector<Vec3r> boxMin(n), boxMax(n), centroid(n);
+  Vec3r sceneMin, sceneMax;
+  for (unsigned i = 0; i < n; i++) {
+    _occluders[i]->getBBox(boxMin[i], boxMax[i]);
+    if (i == 0) {
+      sceneMin = boxMin[i];
+      sceneMax = boxMax[i];
+    }
+    else
+      extend(sceneMin, sceneMax, boxMin[i], boxMax[i]);
+  }
+  real pad = 1e-6 * (sceneMax - sceneMin).norm();
+  Vec3r vpad(pad, pad, pad);
+  vector<unsigned> prims(n);
+  for (unsigned i = 0; i < n; i++) {
+    boxMin[i] -= vpad;
+    boxMax[i] += vpad;
+    centroid[i] = (boxMin[i] + boxMax[i]) / 2.0;
+    prims[i] = i;
+  }
+
+  _nodes.reserve(2 * n / MAX_LEAF_SIZE + 1);
+  _leafOccluders.reserve(n);
+  buildNode(prims, 0, n, 0, boxMin, boxMax, centroid);
+}
+
+unsigned OccluderBVH::buildNode(vector<unsigned>& prims, unsigned begin, unsigned end, unsigned depth,
+				const vector<Vec3r>& boxMin, const vector<Vec3r>& boxMax, const vector<Vec3r>& centroid) {
+  unsigned index = _nodes.size();
+  _nodes.push_back(Node());
+
+  Vec3r min(boxMin[prims[begin]]), max(boxMax[prims[begin]]);
+  Vec3r cmin(centroid[prims[begin]]), cmax(centroid[prims[begin]]);
+  for (unsigned i = begin + 1; i < end; i++) {
+    extend(min, max, boxMin[prims[i]], boxMax[prims[i]]);
+    extend(cmin, cmax, centroid[prims[i]], centroid[prims[i]]);
+  }
+  _nodes[index].min = min;
+  _nodes[index].max = max;
+
+  unsigned n = end - begin;
+  unsigned axis = 0;
+  for (unsigned i = 1; i < 3; i++)
+    if (cmax[i] - cmin[i] > cmax[axis] - cmin[axis])
+      axis = i;
+  real extent = cmax[axis] - cmin[axis];
+
+  unsigned mid = begin;
+  if (n > MAX_LEAF_SIZE && extent > 0 && depth < MAX_SAH_DEPTH) {
+    // bin the centroids along the widest axis and evaluate the SAH at each bin boundary
+    real scale = NUM_BINS / extent;
+    unsigned binCount[NUM_BINS];
+    Vec3r binMin[NUM_BINS], binMax[NUM_BINS];
+    for (unsigned b = 0; b < NUM_BINS; b++)
+      binCount[b] = 0;
+    for (unsigned i = begin; i < end; i++) {
+      unsigned p = prims[i];
+      unsigned b = (unsigned)((centroid[p][axis] - cmin[axis]) * scale);
+      if (b >= NUM_BINS)
+	b = NUM_BINS - 1;
+      if (binCount[b]++ == 0) {
+	binMin[b] = boxMin[p];
+	binMax[b] = boxMax[p];
+      }
+      else
+	extend(binMin[b], binMax[b], boxMin[p], boxMax[p]);
+    }
+
+    // sweep from the right to get the area of every right side
+    real rightArea[NUM_BINS];
+    unsigned rightCount[NUM_BINS];
+    Vec3r rmin, rmax;
+    unsigned count = 0;
+    for (int b = NUM_BINS - 1; b > 0; b--) {
+      if (binCount[b] > 0) {
+	if (count == 0) {
+	  rmin = binMin[b];
+	  rmax = binMax[b];
+	}
+	else
+	  extend(rmin, rmax, binMin[b], binMax[b]);
+	count += binCount[b];
+      }
+      rightCount[b] = count;
+      rightArea[b] = count > 0 ? halfArea(rmin, rmax) : 0;
+    }
+
+    // then from the left, keeping the cheapest split
+    real bestCost = DBL_MAX;
+    unsigned bestSplit = 0;
+    Vec3r lmin, lmax;
+    count = 0;
+    for (unsigned b = 0; b < NUM_BINS - 1; b++) {
+      if (binCount[b] > 0) {
+	if (count == 0) {
+	  lmin = binMin[b];
+	  lmax = binMax[b];
+	}
+	else
+	  extend(lmin, lmax, binMin[b], binMax[b]);
+	count += binCount[b];
+      }
+      if (count == 0 || rightCount[b + 1] == 0)
+	continue;
+      real cost = halfArea(lmin, lmax) * count + rightArea[b + 1] * rightCount[b + 1];
+      if (cost < bestCost) {
+	bestCost = cost;
+	bestSplit = b + 1;
+      }
+    }
+
+    // relative to intersecting everything in a leaf (traversal cost ~ one intersection)
+    real area = halfArea(min, max);
+    bool split = bestSplit > 0 &&
+      (n > MAX_SAH_LEAF || (area > 0 && 1 + bestCost / area < n));
+    if (split) {
+      mid = std::partition(prims.begin() + begin, prims.begin() + end,
+			   InBin(centroid, axis, cmin[axis], scale, bestSplit)) - prims.begin();
+    }
+  }
+
+  // SAH splits may produce very unbalanced trees on degenerate input; past a
+  // certain depth, or when all centroids coincide, split at the median instead.
+  if ((mid == begin || mid == end) &&
+      (n > MAX_SAH_LEAF || (depth >= MAX_SAH_DEPTH && n > MAX_LEAF_SIZE))) {
+    mid = begin + n / 2;
+    std::nth_element(prims.begin() + begin, prims.begin() + mid, prims.begin() + end,
+		     CentroidLess(centroid, axis));
+  }
+
+  if (mid == begin || mid == end) {
+    // leaf
+    _nodes[index].first = _leafOccluders.size();
+    _nodes[index].count = n;
+    _nodes[index].second = 0;
+    for (unsigned i = begin; i < end; i++)
+      _leafOccluders.push_back(_occluders[prims[i]]);
+    return index;
+  }
+
+  _nodes[index].count = 0;
+  _nodes[index].first = 0;
+  buildNode(prims, begin, mid, depth + 1, boxMin, boxMax, centroid);
+  unsigned second = buildNode(prims, mid, end, depth + 1, boxMin, boxMax, centroid);
+  _nodes[index].second = second;
+  return index;
+}
+
+void OccluderBVH::collectAlongRay(const Vec3r& orig, const Vec3r& dir, real t_end, OccludersSet& occluders) const {
+  if (_nodes.empty())
+    return;
+
+  BoxRay boxRay(orig, dir);
+  unsigned stack[STACK_SIZE];
+  unsigned top = 0;
+  stack[top++] = 0;
+  real t_near;
+  while (top > 0) {
+    unsigned index = stack[--top];
+    const Node& node = _nodes[index];
+    if (!boxRay.hit(node.min, node.max, t_end, t_near))
+      continue;
+    if (node.count > 0) {
+      for (unsigned i = node.first; i < node.first + node.count; i++)
+	occluders.push_back(_leafOccluders[i]);
+    }
+    else {
+      stack[top++] = node.second;
+      stack[top++] = index + 1;
+    }
+  }
+}
+
+void OccluderBVH::castRay(const Vec3r& orig,
+			  const Vec3r& end,
+			  OccludersSet& occluders,
+			  GridRay& ray) {
+  finalizeOccluders();
+  collectAlongRay(orig, end - orig, 1.0, occluders);
+}
+
+void OccluderBVH::castInfiniteRay(const Vec3r& orig,
+				  const Vec3r& dir,
+				  OccludersSet& occluders,
+				  GridRay& ray) {
+  finalizeOccluders();
+  collectAlongRay(orig, dir, DBL_MAX, occluders);
+}
+
+Polygon3r* OccluderBVH::castRayToFindFirstIntersection(const Vec3r& orig,
+						       const Vec3r& dir,
+						       double& t,
+						       double& u,
+						       double& v,
+						       GridRay& ray) {
+  finalizeOccluders();
+  if (_nodes.empty())
+    return 0;
+
+  // Nodes are visited front to back, and skipped once they are
+  // farther than the closest hit found so far.
+  Vec3r ray_org(orig), ray_dir(dir);
+  BoxRay boxRay(orig, dir);
+  Polygon3r *occluder = 0;
+  t = DBL_MAX;
+
+  unsigned stack[STACK_SIZE];
+  unsigned top = 0;
+  stack[top++] = 0;
+  real t_near;
+  while (top > 0) {
+    unsigned index = stack[--top];
+    const Node& node = _nodes[index];
+    if (!boxRay.hit(node.min, node.max, t, t_near))
+      continue;
+    if (node.count > 0) {
+      for (unsigned i = node.first; i < node.first + node.count; i++) {
+	Polygon3r *occ = _leafOccluders[i];
+	real tmp_t, tmp_u, tmp_v;
+	if (occ->rayIntersect(ray_org, ray_dir, tmp_t, tmp_u, tmp_v) &&
+	    fabs(ray_dir * occ->getNormal()) > 0.0001 && tmp_t < t) {
+	  occluder = occ;
+	  t = tmp_t;
+	  u = tmp_u;
+	  v = tmp_v;
+	}
+      }
+      continue;
+    }
+
+    // push the farther child first
+    unsigned first = index + 1, second = node.second;
+    real t_first, t_second;
+    bool hitFirst = boxRay.hit(_nodes[first].min, _nodes[first].max, t, t_first);
+    bool hitSecond = boxRay.hit(_nodes[second].min, _nodes[second].max, t, t_second);
+    if (hitFirst && hitSecond) {
+      if (t_first > t_second)
+	std::swap(first, second);
+      stack[top++] = second;
+      stack[top++] = first;
+    }
+    else if (hitFirst)
+      stack[top++] = first;
+    else if (hitSecond)
+      stack[top++] = second;
+  }
+
+  if (!occluder) {
+    t = DBL_MAX;
+    u = v = 0;
+  }
+  return occluder;
+}
+
+void OccluderBVH::triangleIntersections(Vec3r p0,Vec3r p1,Vec3r p2, set<Polygon3r*> & possibleIntersections) {
+  finalizeOccluders();
+  if (_nodes.empty())
+    return;
+
+  Vec3r min(p0), max(p0);
+  extend(min, max, p1, p1);
+  extend(min, max, p2, p2);
+
+  unsigned stack[STACK_SIZE];
+  unsigned top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    unsigned index = stack[--top];
+    const Node& node = _nodes[index];
+    if (!overlap(min, max, node.min, node.max))
+      continue;
+    if (node.count > 0) {
+      for (unsigned i = node.first; i < node.first + node.count; i++)
+	possibleIntersections.insert(_leafOccluders[i]);
+    }
+    else {
+      stack[top++] = node.second;
+      stack[top++] = index + 1;
+    }
+  }
+}
+
+void OccluderBVH::overlappingPairs(vector<pair<Polygon3r*,Polygon3r*> >& pairs) {
+  finalizeOccluders();
+  if (!_nodes.empty())
+    selfPairs(0, pairs);
+}
+
+void OccluderBVH::selfPairs(unsigned index, vector<pair<Polygon3r*,Polygon3r*> >& pairs) const {
+  const Node& node = _nodes[index];
+  if (node.count > 0) {
+    Vec3r amin, amax, bmin, bmax;
+    for (unsigned i = node.first; i < node.first + node.count; i++) {
+      _leafOccluders[i]->getBBox(amin, amax);
+      for (unsigned j = i + 1; j < node.first + node.count; j++) {
+	_leafOccluders[j]->getBBox(bmin, bmax);
+	if (overlap(amin, amax, bmin, bmax))
+	  pairs.push_back(make_pair(_leafOccluders[i], _leafOccluders[j]));
+      }
+    }
+    return;
+  }
+  selfPairs(index + 1, pairs);
+  selfPairs(node.second, pairs);
+  crossPairs(index + 1, node.second, pairs);
+}
+
+void OccluderBVH::crossPairs(unsigned a, unsigned b, vector<pair<Polygon3r*,Polygon3r*> >& pairs) const {
+  const Node& na = _nodes[a];
+  const Node& nb = _nodes[b];
+  if (!overlap(na.min, na.max, nb.min, nb.max))
+    return;
+
+  if (na.count > 0 && nb.count > 0) {
+    Vec3r amin, amax, bmin, bmax;
+    for (unsigned i = na.first; i < na.first + na.count; i++) {
+      _leafOccluders[i]->getBBox(amin, amax);
+      for (unsigned j = nb.first; j < nb.first + nb.count; j++) {
+	_leafOccluders[j]->getBBox(bmin, bmax);
+	if (overlap(amin, amax, bmin, bmax))
+	  pairs.push_back(make_pair(_leafOccluders[i], _leafOccluders[j]));
+      }
+    }
+    return;
+  }
+
+  // descend into the larger node (or the only interior one)
+  if (nb.count > 0 || (na.count == 0 && halfArea(na.min, na.max) >= halfArea(nb.min, nb.max))) {
+    crossPairs(a + 1, b, pairs);
+    crossPairs(na.second, b, pairs);
+  }
+  else {
+    crossPairs(a, b + 1, pairs);
+    crossPairs(a, nb.second, pairs);
+  }
+}
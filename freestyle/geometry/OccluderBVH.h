@@ -0,0 +1,129 @@
+//
+//  Filename         : OccluderBVH.h
+//  Purpose          : Bounding volume hierarchy over the scene occluders,
+//                     used in place of a cell grid for ray casting
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef  OCCLUDERBVH_H
+# define OCCLUDERBVH_H
+
+# include <utility>
+# include "Grid.h"
+
+/*! Bounding volume hierarchy over the occluders, built with
+ *  the surface area heuristic.
+ *  It answers the same queries as the cell grids, but adapts
+ *  to scenes whose density varies a lot (e.g. a large ground plane
+ *  with small detailed characters), where most cells of a uniform
+ *  grid are either empty or overloaded.
+ *  It has no cells: getCell() always returns NULL.
+ *  Occluders are only collected by insertOccluder(); the hierarchy is
+ *  built by finalizeOccluders(), which must be called before rays are
+ *  cast from several threads. Once built, it is only read by the queries.
+ */
+class LIB_GEOMETRY_EXPORT OccluderBVH : public Grid
+{
+ public:
+
+  OccluderBVH() : Grid(), _built(false) {}
+
+  virtual ~OccluderBVH() {
+    clear();
+  }
+
+  /*! clears the hierarchy and deletes the occluders */
+  virtual void clear();
+
+  /*! There are no cells */
+  virtual void fillCell(const Vec3u& coord, Cell& cell) {}
+  virtual Cell* getCell(const Vec3u& coord) {return NULL;}
+
+  /*! Adds the occluder; the hierarchy is rebuilt by the next finalizeOccluders() */
+  virtual void insertOccluder(Polygon3r * convex_poly);
+
+  /*! Builds the hierarchy over all the inserted occluders */
+  virtual void finalizeOccluders();
+
+  /*! Returns the occluders whose bounding box is crossed by the segment [orig,end] */
+  virtual void castRay(const Vec3r& orig,
+		       const Vec3r& end,
+		       OccludersSet& occluders,
+		       GridRay& ray);
+
+  /*! Returns the occluders whose bounding box is crossed by the half-line from orig along dir */
+  virtual void castInfiniteRay(const Vec3r& orig,
+			       const Vec3r& dir,
+			       OccludersSet& occluders,
+			       GridRay& ray);
+
+  /*! Returns the closest occluder hit by the half-line from orig along dir, and the (t,u,v) of the hit */
+  virtual Polygon3r * castRayToFindFirstIntersection(const Vec3r& orig,
+						     const Vec3r& dir,
+						     double& t,
+						     double& u,
+						     double& v,
+						     GridRay& ray);
+
+  /*! Returns the occluders whose bounding box overlaps the bounding box of (p1,p2,p3) */
+  virtual void triangleIntersections(Vec3r p1,Vec3r p2,Vec3r p3, set<Polygon3r*> & possibleIntersections);
+
+  /*! Returns every pair of distinct occluders whose bounding boxes overlap,
+   *  each pair once. These are the candidates for surface-surface intersections.
+   */
+  void overlappingPairs(vector<pair<Polygon3r*,Polygon3r*> >& pairs);
+
+  virtual void displayDebug() {
+    cerr << "BVH nodes    : " << _nodes.size() << endl;
+    cerr << "Occluders nb : " << _occluders.size() << endl;
+  }
+
+ protected:
+
+  /*! A node of the hierarchy. Nodes are stored depth-first: the first child
+   *  of an interior node is the next node, the second one is at index second.
+   *  Leaves refer to count occluders of _leafOccluders, starting at first.
+   */
+  struct Node {
+    Vec3r min, max;
+    unsigned first;
+    unsigned count;   // 0 for interior nodes
+    unsigned second;
+  };
+
+  /*! Collects the occluders whose bbox is crossed by orig + t*dir, t in [0,t_end] */
+  void collectAlongRay(const Vec3r& orig, const Vec3r& dir, real t_end, OccludersSet& occluders) const;
+
+  unsigned buildNode(vector<unsigned>& prims, unsigned begin, unsigned end, unsigned depth,
+		     const vector<Vec3r>& boxMin, const vector<Vec3r>& boxMax, const vector<Vec3r>& centroid);
+
+  void selfPairs(unsigned node, vector<pair<Polygon3r*,Polygon3r*> >& pairs) const;
+  void crossPairs(unsigned a, unsigned b, vector<pair<Polygon3r*,Polygon3r*> >& pairs) const;
+
+  vector<Node>		_nodes;
+  OccludersSet		_leafOccluders; // the occluders, in leaf order
+  bool			_built;
+};
+
+#endif // OCCLUDERBVH_H
@@ -156,7 +156,7 @@ class Polygon
   
   // FIXME Is it possible to get rid of userdatas ?
   void* userdata;   // this is a WFace * to the face this poly came from
-  void* userdata2; // Used during ray casting
+  void* userdata2; // Used during ray casting (index of the polygon in its Grid)
   
  protected:
   
@@ -1,9 +1,205 @@
 #include <float.h>
+#include <string>
+#include <vector>
 
 #include "NodeShape.h"
 #include "IndexedFaceSet.h"
 #include "PLYFileLoader.h"
+#include "TriangleMeshLoader.h"
 #include <locale.h>
+#include <ctype.h>
+
+#ifdef WIN32
+# include <stdio.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif
+
+namespace {
+
+// Read-only view of a whole file: memory-mapped where possible, read into a buffer otherwise
+class MappedFile
+{
+public:
+  MappedFile() : _data(NULL), _size(0), _mapped(false) {}
+  ~MappedFile() { Close(); }
+
+  bool Open(const char *iFileName)
+  {
+#ifndef WIN32
+    int fd = open(iFileName, O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void * p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+      {
+        madvise(p, st.st_size, MADV_SEQUENTIAL);
+        _data = (const char*)p;
+        _size = st.st_size;
+        _mapped = true;
+      }
+    }
+    close(fd);
+    return _mapped;
+#else
+    FILE * fp = fopen(iFileName, "rb");
+    if (fp == NULL)
+      return false;
+    fseek(fp, 0, SEEK_END);
+    _size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char * buffer = new char[_size];
+    _size = fread(buffer, 1, _size, fp);
+    fclose(fp);
+    _data = buffer;
+    return _size > 0;
+#endif
+  }
+
+  void Close()
+  {
+    if (_data == NULL)
+      return;
+#ifndef WIN32
+    if (_mapped)
+      munmap((void*)_data, _size);
+#else
+    delete [] _data;
+#endif
+    _data = NULL;
+    _size = 0;
+    _mapped = false;
+  }
+
+  const char * data() const { return _data; }
+  size_t size() const { return _size; }
+
+private:
+  const char * _data;
+  size_t _size;
+  bool _mapped;
+};
+
+enum PLYType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_UNKNOWN };
+
+PLYType ParseType(const char * name)
+{
+  static const struct { const char * name; PLYType type; } types[] = {
+    {"char", PLY_INT8}, {"int8", PLY_INT8}, {"uchar", PLY_UINT8}, {"uint8", PLY_UINT8},
+    {"short", PLY_INT16}, {"int16", PLY_INT16}, {"ushort", PLY_UINT16}, {"uint16", PLY_UINT16},
+    {"int", PLY_INT32}, {"int32", PLY_INT32}, {"uint", PLY_UINT32}, {"uint32", PLY_UINT32},
+    {"float", PLY_FLOAT32}, {"float32", PLY_FLOAT32}, {"double", PLY_FLOAT64}, {"float64", PLY_FLOAT64} };
+
+  for(unsigned i=0;i<sizeof(types)/sizeof(types[0]);i++)
+    if (strcmp(name, types[i].name) == 0)
+      return types[i].type;
+  return PLY_UNKNOWN;
+}
+
+unsigned TypeSize(PLYType type)
+{
+  static const unsigned sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+  return sizes[type];
+}
+
+// Reads one binary value of the given type at p (which need not be aligned), swapping bytes if necessary
+inline double ReadBinary(const char * p, PLYType type, bool swap)
+{
+  char bytes[8];
+  unsigned size = TypeSize(type);
+  if (swap)
+    for(unsigned i=0;i<size;i++)
+      bytes[i] = p[size-1-i];
+  else
+    memcpy(bytes, p, size);
+
+  switch(type)
+  {
+  case PLY_INT8:    { signed char v; memcpy(&v, bytes, 1); return v; }
+  case PLY_UINT8:   { unsigned char v; memcpy(&v, bytes, 1); return v; }
+  case PLY_INT16:   { short v; memcpy(&v, bytes, 2); return v; }
+  case PLY_UINT16:  { unsigned short v; memcpy(&v, bytes, 2); return v; }
+  case PLY_INT32:   { int v; memcpy(&v, bytes, 4); return v; }
+  case PLY_UINT32:  { unsigned v; memcpy(&v, bytes, 4); return v; }
+  case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return v; }
+  case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+  default: return 0;
+  }
+}
+
+struct PLYProperty
+{
+  std::string name;
+  PLYType type;
+  PLYType countType;   // PLY_UNKNOWN unless this is a list property
+};
+
+struct PLYElement
+{
+  std::string name;
+  unsigned count;
+  std::vector<PLYProperty> properties;
+
+  int FindProperty(const char * name) const
+  {
+    for(unsigned i=0;i<properties.size();i++)
+      if (properties[i].name == name)
+        return i;
+    return -1;
+  }
+};
+
+bool HostIsBigEndian()
+{
+  const unsigned one = 1;
+  return *(const unsigned char*)&one == 0;
+}
+
+// Copies the next whitespace-separated token of [cur,end) into a terminated buffer and advances cur past it, so that
+// strtod and strtol can parse a mapped file, which is not terminated. False at the end of the range, or if the token
+// is too long to be a number
+bool NextToken(const char *& cur, const char * end, char * token, unsigned tokenSize)
+{
+  while (cur < end && isspace((unsigned char)*cur))
+    cur++;
+
+  unsigned length = 0;
+  while (cur < end && !isspace((unsigned char)*cur))
+  {
+    if (length+1 >= tokenSize)
+      return false;
+    token[length++] = *cur++;
+  }
+  token[length] = '\0';
+  return length > 0;
+}
+
+bool ReadASCII(const char *& cur, const char * end, double & value)
+{
+  char token[64], * tokenEnd;
+  if (!NextToken(cur, end, token, sizeof(token)))
+    return false;
+  value = strtod(token, &tokenEnd);
+  return tokenEnd != token;
+}
+
+bool ReadASCII(const char *& cur, const char * end, long & value)
+{
+  char token[64], * tokenEnd;
+  if (!NextToken(cur, end, token, sizeof(token)))
+    return false;
+  value = strtol(token, &tokenEnd, 10);
+  return tokenEnd != token;
+}
+
+}
 
 PLYFileLoader::PLYFileLoader(const char *iFileName)
 {
@@ -40,41 +236,140 @@ NodeGroup* PLYFileLoader::Load()
 {
     printf("Loading PLY file %s\n", _FileName);
 
-    FILE * fp = fopen(_FileName, "rt");
-    if (fp == NULL)
+    MappedFile file;
+    if (!file.Open(_FileName))
     {
         printf("ERROR: CANNOT OPEN INPUT FILE %s\n", _FileName);
         exit(1);
     }
 
+    const char * cur = file.data();
+    const char * end = file.data() + file.size();
+
     // ---------- Read the headers ---------
+    // the header is parsed line by line, so properties may come in any order and unknown ones are skipped
+
+    enum { ASCII, BINARY_LITTLE_ENDIAN, BINARY_BIG_ENDIAN } format = ASCII;
+    bool haveComment = false;
+    bool meshSilhouettes = true;
+    std::vector<PLYElement> elements;
 
-    char buffer[200];
+    for(int lineNum = 0; ; lineNum++)
+    {
+        const char * eol = (const char*)memchr(cur, '\n', end - cur);
+        if (eol == NULL)
+        {
+            printf("ERROR: UNEXPECTED EOF IN PLY HEADER\n");
+            exit(1);
+        }
 
-    unsigned numVertices = 0, numFaces = 0;
-    fscanf(fp, "ply\nformat ascii 1.0\n");
+        std::string line(cur, eol);
+        cur = eol + 1;
+        if (!line.empty() && line[line.size()-1] == '\r')
+            line.erase(line.size()-1);
 
-    fgets(buffer, 200, fp);
-    bool meshSilhouettes = (strcmp(buffer, "comment mesh silhouettes\n") == 0);
-    if (!meshSilhouettes && (strcmp(buffer, "comment smooth silhouettes\n") != 0))
+        char word[3][100];
+        unsigned count = 0;
+        int numWords = sscanf(line.c_str(), "%99s %99s %99s", word[0], word[1], word[2]);
+
+        if (lineNum == 0)
+        {
+            if (line != "ply")
+            {
+                printf("ERROR: NOT A PLY FILE: %s\n", _FileName);
+                exit(1);
+            }
+        }
+        else if (line == "end_header")
+            break;
+        else if (numWords <= 0)
+            continue;
+        else if (strcmp(word[0], "format") == 0 && numWords >= 2)
+        {
+            if (strcmp(word[1], "ascii") == 0)
+                format = ASCII;
+            else if (strcmp(word[1], "binary_little_endian") == 0)
+                format = BINARY_LITTLE_ENDIAN;
+            else if (strcmp(word[1], "binary_big_endian") == 0)
+                format = BINARY_BIG_ENDIAN;
+            else
+            {
+                printf("ERROR: UNSUPPORTED PLY FORMAT: %s\n", word[1]);
+                exit(1);
+            }
+        }
+        else if (strcmp(word[0], "comment") == 0)
+        {
+            if (line == "comment mesh silhouettes")
+            {
+                meshSilhouettes = true;
+                haveComment = true;
+            }
+            else if (line == "comment smooth silhouettes")
+            {
+                meshSilhouettes = false;
+                haveComment = true;
+            }
+        }
+        else if (strcmp(word[0], "element") == 0 && numWords == 3 && sscanf(word[2], "%u", &count) == 1)
+        {
+            PLYElement element;
+            element.name = word[1];
+            element.count = count;
+            elements.push_back(element);
+        }
+        else if (strcmp(word[0], "property") == 0 && numWords == 3 && strcmp(word[1], "list") != 0 && !elements.empty())
+        {
+            PLYProperty property;
+            property.type = ParseType(word[1]);
+            property.countType = PLY_UNKNOWN;
+            property.name = word[2];
+            if (property.type == PLY_UNKNOWN)
+            {
+                printf("ERROR: UNKNOWN PLY PROPERTY TYPE. line: %s\n", line.c_str());
+                exit(1);
+            }
+            elements.back().properties.push_back(property);
+        }
+        else if (strcmp(word[0], "property") == 0 && strcmp(word[1], "list") == 0 && !elements.empty())
+        {
+            char countType[100], itemType[100], name[100];
+            if (sscanf(line.c_str(), "property list %99s %99s %99s", countType, itemType, name) != 3 ||
+                ParseType(countType) == PLY_UNKNOWN || ParseType(itemType) == PLY_UNKNOWN)
+            {
+                printf("ERROR: UNKNOWN PLY PROPERTY TYPE. line: %s\n", line.c_str());
+                exit(1);
+            }
+
+            PLYProperty property;
+            property.countType = ParseType(countType);
+            property.type = ParseType(itemType);
+            property.name = name;
+            elements.back().properties.push_back(property);
+        }
+        else
+        {
+            printf("ERROR: UNEXPECTED LINE IN PLY HEADER: %s\n", line.c_str());
+            exit(1);
+        }
+    }
+
+    if (!haveComment)
     {
-        printf("missing comment indicating smooth vs. mesh silhouettes. line: %s\n", buffer);
+        printf("missing comment indicating smooth vs. mesh silhouettes.\n");
         exit(1);
     }
 
-    fscanf(fp,"element vertex %d\n", &numVertices);
-    fscanf(fp, "property float x\nproperty float y\nproperty float z\n");
-
-    fscanf(fp, "property float nx\n");
-    fscanf(fp, "property float ny\n");
-    fscanf(fp, "property float nz\n");
-
-    fscanf(fp, "property float red\n");
-    fscanf(fp, "property float green\n");
-    fscanf(fp, "property float blue\n");
-    fscanf(fp, "property float ndotv\n");
+    if (elements.size() != 2 || elements[0].name != "vertex" || elements[1].name != "face")
+    {
+        printf("ERROR: EXPECTED A VERTEX AND A FACE ELEMENT IN PLY\n");
+        exit(1);
+    }
 
-    fscanf(fp,"element face %d\n", &numFaces);
+    const PLYElement & vertexElement = elements[0];
+    const PLYElement & faceElement = elements[1];
+    unsigned numVertices = vertexElement.count;
+    unsigned numFaces = faceElement.count;
 
     if (numVertices <= 0 || numFaces <= 0)
     {
@@ -82,181 +377,202 @@ NodeGroup* PLYFileLoader::Load()
         exit(1);
     }
 
-    fscanf(fp, "property list uchar int vertex_index\n");
-    fscanf(fp, "property uchar int\n");  // vbf
-    fscanf(fp, "end_header\n");
-
-    // ------ Initialize data structures ------
-
-    // create of the scene root node
-    _Scene = new NodeGroup;
-    NodeShape * shape = new NodeShape;
-    _Scene->AddChild(shape);
-
-    // allocate elements for the indexed face set
-    real * vertices = new real[3*numVertices];
-    unsigned * nvertPerFace = new unsigned[numFaces];
-    IndexedFaceSet::TRIANGLES_STYLE * faceStyles = new IndexedFaceSet::TRIANGLES_STYLE[numFaces];
-    unsigned * faces = new unsigned[3*numFaces];
-    _numFacesRead = numFaces;
-
-    unsigned numNormals = numVertices;
-    real * normals = new real[numNormals * 3];
-    unsigned * nindices = new unsigned[numFaces * 3];
-
-    int * faceUserData = new int[numFaces];
-    float * vertexUserData = new float[numVertices];
-
-    real minBBox[3] = { 0,0,0};
-    real maxBBox[3] = { 0,0,0};
-    //  real minBBox[3] = { DBL_MAX, DBL_MAX, DBL_MAX };
-    //  real maxBBox[3] = { DBL_MIN, DBL_MIN, DBL_MIN };
-
-    printf("Num Vertices = %d, Num Faces = %d\n", numVertices, numFaces);
-
-    // ------- Read the vertices and faces -----
-    for(unsigned i=0;i<numVertices;i++)
+    // vertex properties we care about: position, normal, and the user data (ndotv)
+    const char * vertexPropertyNames[7] = { "x", "y", "z", "nx", "ny", "nz", "ndotv" };
+    int vertexProperty[7];
+    for(int j=0;j<7;j++)
     {
-        if (feof(fp) != 0)
+        vertexProperty[j] = vertexElement.FindProperty(vertexPropertyNames[j]);
+        if ((vertexProperty[j] < 0 && j < 6) || (vertexProperty[j] >= 0 && vertexElement.properties[vertexProperty[j]].countType != PLY_UNKNOWN))
         {
-            printf("UNEXPECTED EOF IN PLY\n");
+            printf("ERROR: MISSING OR INVALID VERTEX PROPERTY %s IN PLY\n", vertexPropertyNames[j]);
             exit(1);
         }
+    }
+
+    // face properties: the vertex index list, followed by the vertex-based facing flags
+    int indexProperty = faceElement.FindProperty("vertex_index");
+    if (indexProperty < 0 || faceElement.properties[indexProperty].countType == PLY_UNKNOWN)
+    {
+        printf("ERROR: MISSING VERTEX INDEX LIST IN PLY\n");
+        exit(1);
+    }
+    int flagProperty = -1;
+    for(unsigned j=0;j<faceElement.properties.size() && flagProperty < 0;j++)
+        if (faceElement.properties[j].countType == PLY_UNKNOWN)
+            flagProperty = j;
 
-        // note: should be using strtod
+    // ------ Initialize data structures ------
 
-        char buffer[200];
-        fgets(buffer, 200, fp);
+    TriangleMeshData mesh;
+    mesh.meshSilhouettes = meshSilhouettes;
+    mesh.vertices.resize(3*numVertices);
+    mesh.normals.resize(3*numVertices);
+    mesh.vertexUserData.resize(numVertices, 0);
+    mesh.faces.resize(3*numFaces);
+    mesh.faceUserData.resize(numFaces, 0);
 
-        real x,y,z, ndotv;
-        char * nextptr;
+    // ------- Read the vertices and faces -----
 
+    if (format == ASCII)
+    {
+        // parsed in place, one token at a time
         setlocale(LC_NUMERIC,"C");
-        x = strtod(buffer, &nextptr);
-        y = strtod(nextptr, &nextptr);
-        z = strtod(nextptr, &nextptr);
 
-        vertices[3*i] = x;
-        vertices[3*i+1] = y;
-        vertices[3*i+2] = z;
-
-        for(int j=0;j<3;j++)
+        std::vector<double> values(vertexElement.properties.size());
+        for(unsigned i=0;i<numVertices;i++)
         {
-            if (vertices[3*i+j] < minBBox[j] || i == 0)
-                minBBox[j] = vertices[3*i+j];
-            if (vertices[3*i+j] > maxBBox[j] || i == 0)
-                maxBBox[j] = vertices[3*i+j];
+            for(unsigned j=0;j<values.size();j++)
+            {
+                if (vertexElement.properties[j].countType != PLY_UNKNOWN)
+                {
+                    printf("ERROR: UNEXPECTED LIST PROPERTY IN PLY VERTEX\n");
+                    exit(1);
+                }
+                if (!ReadASCII(cur, end, values[j]))
+                {
+                    printf("UNEXPECTED EOF IN PLY\n");
+                    exit(1);
+                }
+            }
+
+            for(int j=0;j<3;j++)
+            {
+                mesh.vertices[3*i+j] = values[vertexProperty[j]];
+                mesh.normals[3*i+j] = values[vertexProperty[3+j]];  // per-vertex normals
+            }
+            if (vertexProperty[6] >= 0)
+                mesh.vertexUserData[i] = values[vertexProperty[6]];  // ndotv
         }
 
-        // per-vertex normals
-        real nx, ny, nz;
-
-        nx = strtod(nextptr, &nextptr);
-        ny = strtod(nextptr, &nextptr);
-        nz = strtod(nextptr, &nextptr);
-
-        Vec3r normal(nx,ny,nz);
-        normal.normalize();
-        for(int j=0;j<3;j++)
-            normals[3*i+j]=normal[j];
-
-        // per-vertex color
-        real red, green, blue;
-
-        red = strtod(nextptr, &nextptr);
-        green = strtod(nextptr, &nextptr);
-        blue = strtod(nextptr, &nextptr);
-
-        ndotv = strtod(nextptr, &nextptr);
-        vertexUserData[i] = ndotv;
-
-        //if (i < 3 || i+4 > numVertices )
-        //printf("Vertex %d: %f %f %f (%g %g %g)\n", i, vertices[3*i], vertices[3*i+1], vertices[3*i+2],x,y,z);
+        for(unsigned i=0;i<numFaces;i++)
+        {
+            for(unsigned j=0;j<faceElement.properties.size();j++)
+            {
+                long N = 1;
+                if (faceElement.properties[j].countType != PLY_UNKNOWN && !ReadASCII(cur, end, N))
+                {
+                    printf("UNEXPECTED EOF IN PLY\n");
+                    exit(1);
+                }
+
+                if ((int)j == indexProperty && N != 3)
+                {
+                    printf("UNEXPECTED NON-TRIANGULAR FACE IN PLY %d: %ld vertices)\n", i, N);
+                    exit(1);
+                }
+
+                for(long k=0;k<N;k++)
+                {
+                    long value;
+                    if (!ReadASCII(cur, end, value))
+                    {
+                        printf("UNEXPECTED EOF IN PLY\n");
+                        exit(1);
+                    }
+
+                    if ((int)j == indexProperty)
+                        mesh.faces[3*i+k] = value;
+                    else if ((int)j == flagProperty)
+                        mesh.faceUserData[i] = value;  // vbf goes here
+                }
+            }
+        }
     }
+    else
+    {
+        bool swap = ((format == BINARY_BIG_ENDIAN) != HostIsBigEndian());
 
+        // vertex records have a fixed size, so the property offsets are computed once
+        unsigned vertexSize = 0;
+        std::vector<unsigned> offsets(vertexElement.properties.size());
+        for(unsigned j=0;j<vertexElement.properties.size();j++)
+        {
+            if (vertexElement.properties[j].countType != PLY_UNKNOWN)
+            {
+                printf("ERROR: UNEXPECTED LIST PROPERTY IN PLY VERTEX\n");
+                exit(1);
+            }
+            offsets[j] = vertexSize;
+            vertexSize += TypeSize(vertexElement.properties[j].type);
+        }
 
-    for(unsigned i=0;i<numFaces;i++)
-    {
-        if (feof(fp) != 0)
+        if ((size_t)(end - cur) < (size_t)vertexSize * numVertices)
         {
             printf("UNEXPECTED EOF IN PLY\n");
             exit(1);
         }
 
-        //      char buffer[200];
-        //      fgets(buffer, 200, fp);
-
-        int N, v[3], vfint;
-        int r = fscanf(fp, "%d %d %d %d %d\n", &N, &v[0], &v[1], &v[2], &vfint);
-        faces[3*i] = 3*v[0];  // why multiply by 3?  no idea (there's a mysterious division by 3 is in WingedEdgeBuilder::buildTriangles)
-        faces[3*i+1] = 3*v[1];
-        faces[3*i+2] = 3*v[2];
-        //      fscanf(fp, "%d %d %d %d\n", &N, &faces[3*i], &faces[3*i+1], &faces[3*i+2]);
-
-        //      if (i <5  || i +3 > numFaces -1)
-        //      	printf("Face %d: %d verts: %d %d %d (r = %d)\n", i, N, v[0], v[1], v[2], r);
-
-        if (N != 3)
+        for(unsigned i=0;i<numVertices;i++, cur += vertexSize)
         {
-            printf("UNEXPECTED NON-TRIANGULAR FACE IN PLY %d: %d vertices)\n", i, N);
-            exit(1);
+            for(int j=0;j<3;j++)
+            {
+                const PLYProperty & p = vertexElement.properties[vertexProperty[j]];
+                const PLYProperty & n = vertexElement.properties[vertexProperty[3+j]];
+                mesh.vertices[3*i+j] = ReadBinary(cur + offsets[vertexProperty[j]], p.type, swap);
+                mesh.normals[3*i+j] = ReadBinary(cur + offsets[vertexProperty[3+j]], n.type, swap);
+            }
+            if (vertexProperty[6] >= 0)
+                mesh.vertexUserData[i] = ReadBinary(cur + offsets[vertexProperty[6]], vertexElement.properties[vertexProperty[6]].type, swap);
         }
 
-        nvertPerFace[i] = N;
-        faceStyles[i] = IndexedFaceSet::TRIANGLES;
-
-        faceUserData[i] = vfint;  // vbf goes here
-
-        Vec3r vert[3];
-        for(int j=0;j<3;j++)
-            for(int k=0;k<3;k++)
-                vert[j][k] = vertices[3*v[j] + k];
-
-        for(int j=0; j<3; j++)
+        // face records hold a list, so they are walked one property at a time
+        for(unsigned i=0;i<numFaces;i++)
         {
-            real norm = sqrt((vert[j] - vert[(j+1)%3])*(vert[j] - vert[(j+1)%3]));
-            if(_minEdgeSize > norm)
-                _minEdgeSize = norm;
+            for(unsigned j=0;j<faceElement.properties.size();j++)
+            {
+                const PLYProperty & p = faceElement.properties[j];
+                unsigned N = 1;
+                if (p.countType != PLY_UNKNOWN)
+                {
+                    if (cur + TypeSize(p.countType) > end)
+                    {
+                        printf("UNEXPECTED EOF IN PLY\n");
+                        exit(1);
+                    }
+                    N = (unsigned)ReadBinary(cur, p.countType, swap);
+                    cur += TypeSize(p.countType);
+                }
+
+                if ((int)j == indexProperty && N != 3)
+                {
+                    printf("UNEXPECTED NON-TRIANGULAR FACE IN PLY %d: %d vertices)\n", i, N);
+                    exit(1);
+                }
+
+                if (cur + N*TypeSize(p.type) > end)
+                {
+                    printf("UNEXPECTED EOF IN PLY\n");
+                    exit(1);
+                }
+
+                if ((int)j == indexProperty)
+                    for(unsigned k=0;k<3;k++)
+                        mesh.faces[3*i+k] = (unsigned)ReadBinary(cur + k*TypeSize(p.type), p.type, swap);
+                else if ((int)j == flagProperty)
+                    mesh.faceUserData[i] = (int)ReadBinary(cur, p.type, swap);  // vbf goes here
+
+                cur += N*TypeSize(p.type);
+            }
         }
-
-//        if (meshSilhouettes)  // per-face normals
-//        {
-//            Vec3r normal = (vert[2] - vert[0]) ^ (vert[1] - vert[0]);
-//            normal.normalize();
-//            for(int j=0;j<3;j++) // 3 entries of the normal vector
-//                normals[3*i+j] = normal[j];
-//            for(int j=0;j<3;j++) // normal for each vertex
-//                nindices[3*i+j] = 3*i;   // mysterious factor of 3 (see WingedEdgeBuilder::buildTriangles)
-//        }
-//        else
-        for(int j=0;j<3;j++) // per-vertex normals
-            nindices[3*i+j] = 3*v[j];
     }
 
+    for(unsigned i=0;i<3*numFaces;i++)
+        if (mesh.faces[i] >= numVertices)
+        {
+            printf("ERROR: VERTEX INDEX OUT OF RANGE IN PLY FACE %d\n", i/3);
+            exit(1);
+        }
 
+    file.Close();
 
     // -------- create the indexed face set and finish up
 
-    IndexedFaceSet * rep = new IndexedFaceSet(vertices, 3*numVertices, normals, 3*numNormals, NULL, 0, 0, 0,
-                                              numFaces, nvertPerFace, faceStyles, faces, 3*numFaces, nindices, 3*numFaces, NULL, 0, NULL, 0,
-                                              faceUserData, vertexUserData, 0, meshSilhouettes); // set to zero means it will be deallocated elsewhere
-
-    rep->SetId(Id(0,0));
-
-    const BBox<Vec3r> bbox(Vec3r(minBBox[0], minBBox[1], minBBox[2]),
-                           Vec3r(maxBBox[0], maxBBox[1], maxBBox[2]));
-    rep->SetBBox(bbox);
-    shape->AddRep(rep);
-
-    //  printf("dbl_min = %f, dbl_max = %f\n", DBL_MIN, DBL_MAX);
-    //  printf("bbox: %f, %f, %f ; %f %f %f\n", minBBox[0], minBBox[1], minBBox[2],
-    //         maxBBox[0], maxBBox[1], maxBBox[2]);
-    //  printf("bbox: %f, %f, %f ; %f %f %f\n", bbox.getMin()[0], bbox.getMin()[1], bbox.getMin()[2],
-    //         bbox.getMax()[0], bbox.getMax()[1], bbox.getMax()[2]);
+    TriangleMeshLoader meshLoader(mesh);
+    _Scene = meshLoader.Load();
+    _numFacesRead = meshLoader.numFacesRead();
+    _minEdgeSize = meshLoader.minEdgeSize();
 
     //Returns the built scene.
     return _Scene;
 }
-
-
-
@@ -0,0 +1,123 @@
+#include <float.h>
+
+#include "NodeShape.h"
+#include "IndexedFaceSet.h"
+#include "TriangleMeshLoader.h"
+
+TriangleMeshLoader::TriangleMeshLoader(const TriangleMeshData& iMesh)
+    : _Mesh(iMesh)
+{
+    _Scene = NULL;
+    _numFacesRead = 0;
+    _minEdgeSize = DBL_MAX;
+}
+
+TriangleMeshLoader::~TriangleMeshLoader()
+{
+    _Scene = NULL;
+}
+
+NodeGroup* TriangleMeshLoader::Load()
+{
+    unsigned numVertices = _Mesh.numVertices();
+    unsigned numFaces = _Mesh.numFaces();
+
+    if (numVertices <= 0 || numFaces <= 0)
+    {
+        printf("ERROR:  EMPTY MESH (nv = %d, nf = %d)\n", numVertices, numFaces);
+        return NULL;
+    }
+
+    // ------ Initialize data structures ------
+
+    // create of the scene root node
+    _Scene = new NodeGroup;
+    NodeShape * shape = new NodeShape;
+    _Scene->AddChild(shape);
+
+    // allocate elements for the indexed face set; they are handed over to (and deleted by) the IndexedFaceSet
+    real * vertices = new real[3*numVertices];
+    unsigned * nvertPerFace = new unsigned[numFaces];
+    IndexedFaceSet::TRIANGLES_STYLE * faceStyles = new IndexedFaceSet::TRIANGLES_STYLE[numFaces];
+    unsigned * faces = new unsigned[3*numFaces];
+    _numFacesRead = numFaces;
+
+    unsigned numNormals = numVertices;
+    real * normals = new real[numNormals * 3];
+    unsigned * nindices = new unsigned[numFaces * 3];
+
+    int * faceUserData = new int[numFaces];
+    float * vertexUserData = new float[numVertices];
+
+    real minBBox[3] = { 0,0,0};
+    real maxBBox[3] = { 0,0,0};
+
+    printf("Num Vertices = %d, Num Faces = %d\n", numVertices, numFaces);
+
+    // ------- Copy the vertices and faces -----
+    for(unsigned i=0;i<numVertices;i++)
+    {
+        for(int j=0;j<3;j++)
+        {
+            vertices[3*i+j] = _Mesh.vertices[3*i+j];
+
+            if (vertices[3*i+j] < minBBox[j] || i == 0)
+                minBBox[j] = vertices[3*i+j];
+            if (vertices[3*i+j] > maxBBox[j] || i == 0)
+                maxBBox[j] = vertices[3*i+j];
+        }
+
+        // per-vertex normals
+        Vec3r normal(_Mesh.normals[3*i], _Mesh.normals[3*i+1], _Mesh.normals[3*i+2]);
+        normal.normalize();
+        for(int j=0;j<3;j++)
+            normals[3*i+j]=normal[j];
+
+        vertexUserData[i] = _Mesh.vertexUserData[i];
+    }
+
+    for(unsigned i=0;i<numFaces;i++)
+    {
+        const unsigned * v = &_Mesh.faces[3*i];
+
+        faces[3*i] = 3*v[0];  // indices are multiplied by 3 (there's a matching division by 3 in WingedEdgeBuilder::buildTriangles)
+        faces[3*i+1] = 3*v[1];
+        faces[3*i+2] = 3*v[2];
+
+        nvertPerFace[i] = 3;
+        faceStyles[i] = IndexedFaceSet::TRIANGLES;
+
+        faceUserData[i] = _Mesh.faceUserData[i];  // vbf goes here
+
+        Vec3r vert[3];
+        for(int j=0;j<3;j++)
+            for(int k=0;k<3;k++)
+                vert[j][k] = vertices[3*v[j] + k];
+
+        for(int j=0; j<3; j++)
+        {
+            real norm = sqrt((vert[j] - vert[(j+1)%3])*(vert[j] - vert[(j+1)%3]));
+            if(_minEdgeSize > norm)
+                _minEdgeSize = norm;
+        }
+
+        for(int j=0;j<3;j++) // per-vertex normals
+            nindices[3*i+j] = 3*v[j];
+    }
+
+    // -------- create the indexed face set and finish up
+
+    IndexedFaceSet * rep = new IndexedFaceSet(vertices, 3*numVertices, normals, 3*numNormals, NULL, 0, 0, 0,
+                                              numFaces, nvertPerFace, faceStyles, faces, 3*numFaces, nindices, 3*numFaces, NULL, 0, NULL, 0,
+                                              faceUserData, vertexUserData, 0, _Mesh.meshSilhouettes); // set to zero means it will be deallocated elsewhere
+
+    rep->SetId(Id(0,0));
+
+    const BBox<Vec3r> bbox(Vec3r(minBBox[0], minBBox[1], minBBox[2]),
+                           Vec3r(maxBBox[0], maxBBox[1], maxBBox[2]));
+    rep->SetBBox(bbox);
+    shape->AddRep(rep);
+
+    //Returns the built scene.
+    return _Scene;
+}
@@ -0,0 +1,51 @@
+#ifndef  TRIANGLE_MESH_LOADER_H
+# define TRIANGLE_MESH_LOADER_H
+
+# include <vector>
+# include "NodeGroup.h"
+
+/*! Triangle mesh with per-vertex normals and user data, as produced by the
+ *  contour tessellator (either read from its PLY output, or handed over in memory)
+ */
+struct TriangleMeshData
+{
+  std::vector<real> vertices;         // x,y,z per vertex
+  std::vector<real> normals;          // nx,ny,nz per vertex
+  std::vector<float> vertexUserData;  // one value per vertex (ndotv or radial curvature)
+  std::vector<unsigned> faces;        // three vertex indices per triangle
+  std::vector<int> faceUserData;      // one value per triangle (vertex-based facing flags)
+  bool meshSilhouettes;
+
+  TriangleMeshData() : meshSilhouettes(true) {}
+
+  unsigned numVertices() const {return vertices.size()/3;}
+  unsigned numFaces() const {return faces.size()/3;}
+};
+
+
+class LIB_SCENE_GRAPH_EXPORT TriangleMeshLoader
+{
+public:
+  /*! Builds a TriangleMeshLoader for a mesh held in memory */
+  explicit TriangleMeshLoader(const TriangleMeshData& iMesh);
+  virtual ~TriangleMeshLoader();
+
+  /*! Builds the 3D scene and returns
+   *  a pointer to the scene root node
+   */
+  NodeGroup * Load();
+
+  /*! Gets the number of read faces */
+  inline unsigned int numFacesRead() {return _numFacesRead;}
+
+  /*! Gets the smallest edge size read */
+  inline real minEdgeSize() {return _minEdgeSize;}
+
+protected:
+  const TriangleMeshData& _Mesh;
+  NodeGroup* _Scene;
+  unsigned _numFacesRead;
+  real _minEdgeSize;
+};
+
+#endif // TRIANGLE_MESH_LOADER_H
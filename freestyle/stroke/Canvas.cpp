@@ -32,6 +32,9 @@
 #include "../image/ImagePyramid.h"
 #include "../view_map/SteerableViewMap.h"
 #include "StyleModule.h"
+#include "Operators.h"
+#include "StrokeIterators.h"
+#include "../view_map/ViewMap.h"
 
 using namespace std;
 
@@ -53,6 +56,8 @@ Canvas::Canvas()
     _drawPaper = true;
     _current_sm = NULL;
     _steerableViewMap = new SteerableViewMap(NB_STEERABLE_VIEWMAP-1);
+    _checkConcurrentLayers = false;
+    _concurrentLayerMismatches = 0;
 }
 
 Canvas::Canvas(const Canvas& iBrother)
@@ -65,6 +70,8 @@ Canvas::Canvas(const Canvas& iBrother)
     _drawPaper = iBrother._drawPaper;
     _current_sm = iBrother._current_sm;
     _steerableViewMap = new SteerableViewMap(*(iBrother._steerableViewMap));
+    _checkConcurrentLayers = iBrother._checkConcurrentLayers;
+    _concurrentLayerMismatches = 0;
 
 }
 
@@ -102,17 +109,36 @@ void Canvas::Draw()
         return;
     preDraw();
     TimeStamp *timestamp = TimeStamp::instance();
+    _concurrentLayerMismatches = 0;
 
     for(unsigned i = 0; i < _StyleModules.size(); i++)
     {
         _current_sm = _StyleModules[i];
         if (!_StyleModules[i]->getModified())
         {
-            if (_StyleModules[i]->getDrawable() && _Layers[i])
-                printf("render %n",i);
+            if (_Renderer && _StyleModules[i]->getDrawable() && _Layers[i])
+            {
+                printf("render %d\n",i);
                 _Layers[i]->Render(_Renderer);
+            }
             continue;
         }
+
+        // modified layers that only read the ViewMap run together
+        unsigned end = i;
+        while (end < _StyleModules.size() && _StyleModules[end]->getModified()
+               && _StyleModules[end]->getConcurrent())
+            ++end;
+        if (end > i + 1)
+        {
+            if (_checkConcurrentLayers)
+                CheckConcurrently(i, end);
+            else
+                ExecuteConcurrently(i, end);
+            i = end - 1;
+            continue;
+        }
+
         if (i < _Layers.size() && _Layers[i])
             delete _Layers[i];
 
@@ -122,7 +148,8 @@ void Canvas::Draw()
 
         printf("----- render %d\n",i);
 
-        if (_StyleModules[i]->getDrawable() && _Layers[i])
+        // no renderer on a headless canvas (see BatchCanvas)
+        if (_Renderer && _StyleModules[i]->getDrawable() && _Layers[i])
             _Layers[i]->Render(_Renderer);
 
         timestamp->increment();
@@ -134,6 +161,126 @@ void Canvas::Draw()
     printf("----- done\n");
 }
 
+void Canvas::ExecuteConcurrently(unsigned begin, unsigned end)
+{
+    TimeStamp *timestamp = TimeStamp::instance();
+    ViewMap *vm = ViewMap::getInstance();
+    unsigned n = end - begin;
+
+    // each layer gets the working sets, time stamp and ViewEdge marks it
+    // would have had running alone, so that its strokes are the same
+    vector<OperatorsContext*> contexts(n);
+    vector<TimeStamp*> timestamps(n);
+    vector<ViewEdgeMarks*> marks(n, (ViewEdgeMarks*)0);
+    for(unsigned k = 0; k < n; k++)
+    {
+        contexts[k] = new OperatorsContext(false);
+        timestamps[k] = new TimeStamp(timestamp->getTimeStamp() + k);
+        if (vm)
+            marks[k] = new ViewEdgeMarks(vm);
+        if (_Layers[begin + k])
+            delete _Layers[begin + k];
+        _Layers[begin + k] = 0;
+    }
+
+    printf("----- execute %d to %d concurrently\n", begin, end - 1);
+
+#pragma omp parallel for schedule(dynamic)
+    for(int k = 0; k < (int)n; k++)
+    {
+        Operators::setThreadContext(contexts[k]);
+        TimeStamp::setThreadInstance(timestamps[k]);
+        ViewEdgeMarks::setThreadMarks(marks[k]);
+
+        _Layers[begin + k] = _StyleModules[begin + k]->execute();
+
+        Operators::setThreadContext(0);
+        TimeStamp::setThreadInstance(0);
+        ViewEdgeMarks::setThreadMarks(0);
+    }
+
+    // strokes are rendered in layer order, as if the layers had run one by one
+    for(unsigned k = 0; k < n; k++)
+    {
+        unsigned i = begin + k;
+        _current_sm = _StyleModules[i];
+        Operators::StrokesContainer& strokes = contexts[k]->_current_strokes_set;
+        for(Operators::StrokesContainer::iterator s = strokes.begin(); s != strokes.end(); ++s)
+            RenderStroke(*s);
+
+        printf("----- render %d\n",i);
+
+        if (_Renderer && _StyleModules[i]->getDrawable() && _Layers[i])
+            _Layers[i]->Render(_Renderer);
+
+        if (marks[k])
+            marks[k]->apply(vm);
+        timestamp->increment();
+
+        delete contexts[k];
+        delete timestamps[k];
+        delete marks[k];
+    }
+}
+
+// true if the two layers hold the same strokes, vertex by vertex
+static bool sameStrokes(StrokeLayer *a, StrokeLayer *b)
+{
+    if (!a || !b)
+        return a == b;
+    if (a->strokes_size() != b->strokes_size())
+        return false;
+    for(StrokeLayer::stroke_container::iterator sa = a->strokes_begin(), sb = b->strokes_begin();
+        sa != a->strokes_end(); ++sa, ++sb)
+    {
+        if ((*sa)->strokeVerticesSize() != (*sb)->strokeVerticesSize())
+            return false;
+        StrokeInternal::StrokeVertexIterator va = (*sa)->strokeVerticesBegin();
+        StrokeInternal::StrokeVertexIterator vb = (*sb)->strokeVerticesBegin();
+        for(; !va.isEnd(); ++va, ++vb)
+        {
+            const StrokeAttribute& attA = (*va).attribute();
+            const StrokeAttribute& attB = (*vb).attribute();
+            if ((*va).x() != (*vb).x() || (*va).y() != (*vb).y()
+                || attA.getColorRGB() != attB.getColorRGB() || attA.getAlpha() != attB.getAlpha()
+                || attA.getThicknessRL() != attB.getThicknessRL())
+                return false;
+        }
+    }
+    return true;
+}
+
+void Canvas::CheckConcurrently(unsigned begin, unsigned end)
+{
+    TimeStamp *timestamp = TimeStamp::instance();
+    unsigned n = end - begin;
+
+    // serial run, on the ViewEdges' own time stamps; its strokes go to a
+    // context of its own so that they are not rendered
+    vector<StrokeLayer*> serialLayers(n);
+    for(unsigned k = 0; k < n; k++)
+    {
+        OperatorsContext context(false);
+        Operators::setThreadContext(&context);
+        _current_sm = _StyleModules[begin + k];
+        serialLayers[k] = _StyleModules[begin + k]->execute();
+        Operators::setThreadContext(0);
+        timestamp->increment();
+    }
+
+    ExecuteConcurrently(begin, end);
+
+    for(unsigned k = 0; k < n; k++)
+    {
+        if (!sameStrokes(serialLayers[k], _Layers[begin + k]))
+        {
+            printf("Warning: layer %d gives different strokes when run concurrently\n", begin + k);
+            _concurrentLayerMismatches++;
+        }
+        delete serialLayers[k];
+    }
+}
+
 void Canvas::postDraw()
 {
     update();
@@ -82,6 +82,8 @@ protected:
   mapsMap _maps;
   static const char * _MapsPath;
   SteerableViewMap *_steerableViewMap;
+  bool _checkConcurrentLayers;
+  unsigned _concurrentLayerMismatches;
   
 public:
   /* Builds the Canvas */
@@ -100,6 +102,13 @@ public:
   /* operations that need to be done after a draw */
   virtual void postDraw();
 
+  /* Executes the layers [begin, end) at the same time, see StyleModule::getConcurrent */
+  void ExecuteConcurrently(unsigned begin, unsigned end);
+
+  /* Executes the layers [begin, end) one after the other without rendering
+   * them, then concurrently, and counts the layers whose strokes differ */
+  void CheckConcurrently(unsigned begin, unsigned end);
+
   /* Render one layer */
   void RenderLayer(const StrokeRenderer *iRenderer, int layer);
   /* Renders the created strokes */
@@ -179,9 +188,16 @@ public:
   inline StyleModule* getStyleModule(int i) { return _StyleModules.at(i); }
   inline int getNumStyleModules() { return _StyleModules.size(); }
   virtual bool getRecordFlag() const {return false;}
+  /*! number of concurrent layers whose strokes differed from a serial run
+   *  during the last Draw, see SetCheckConcurrentLayers */
+  inline unsigned concurrentLayerMismatches() const {return _concurrentLayerMismatches;}
 
   /*! modifiers */
   inline void SetSelectedFEdge(FEdge *iFEdge) {_SelectedFEdge = iFEdge;}
+  /*! if true, Draw also runs the layers it executes concurrently one after
+   *  the other, and compares their strokes. For debugging concurrent style
+   *  modules; it executes these layers twice. */
+  inline void SetCheckConcurrentLayers(bool iCheck) {_checkConcurrentLayers = iCheck;}
   /*! inserts a shader at pos index+1 */
   void InsertStyleModule(unsigned index, StyleModule *iStyleModule);
   void RemoveStyleModule(unsigned index);
@@ -0,0 +1,130 @@
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <dlfcn.h>
+#include <iostream>
+#include "CompiledStyleModule.h"
+
+LIB_STROKE_EXPORT
+map<string, CompiledStyleModuleEntry> *CompiledStyleModules::_loading = 0;
+LIB_STROKE_EXPORT
+map<string, map<string, CompiledStyleModuleEntry> > CompiledStyleModules::_libraries;
+
+// splits "<library>:<module>"; the library may not contain ':' after its last '/'
+static bool splitSpec(const string& spec, string& library, string& module)
+{
+  string::size_type slash = spec.rfind('/');
+  string::size_type colon = spec.rfind(':');
+  if (colon == string::npos || (slash != string::npos && colon < slash))
+    return false;
+  library = spec.substr(0, colon);
+  module = spec.substr(colon + 1);
+  return true;
+}
+
+static bool endsWith(const string& s, const string& suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void CompiledStyleModules::registerModule(const string& name, StyleModuleFunction f, bool concurrent)
+{
+  CompiledStyleModuleEntry entry;
+  entry.function = f;
+  entry.concurrent = concurrent;
+  // modules linked with the application rather than loaded are kept under ""
+  if (_loading)
+    (*_loading)[name] = entry;
+  else
+    _libraries[""][name] = entry;
+}
+
+int CompiledStyleModules::loadLibrary(const string& path)
+{
+  if (_libraries.find(path) != _libraries.end())
+    return 0;
+
+  map<string, CompiledStyleModuleEntry> modules;
+  _loading = &modules;
+  // the library is never closed: its modules stay registered
+  void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+  _loading = 0;
+  if (!handle) {
+    cerr << "Error: cannot load the style module library \"" << path << "\": " << dlerror() << endl;
+    return 1;
+  }
+  _libraries[path] = modules;
+  return 0;
+}
+
+const CompiledStyleModuleEntry * CompiledStyleModules::find(const string& path, const string& name)
+{
+  map<string, map<string, CompiledStyleModuleEntry> >::const_iterator lib = _libraries.find(path);
+  if (lib != _libraries.end()) {
+    map<string, CompiledStyleModuleEntry>::const_iterator m = lib->second.find(name);
+    if (m != lib->second.end())
+      return &m->second;
+  }
+  lib = _libraries.find("");
+  if (lib != _libraries.end()) {
+    map<string, CompiledStyleModuleEntry>::const_iterator m = lib->second.find(name);
+    if (m != lib->second.end())
+      return &m->second;
+  }
+  return NULL;
+}
+
+bool CompiledStyleModule::isCompiled(const string& spec)
+{
+  string library, module;
+  if (!splitSpec(spec, library, module))
+    return false;
+  return endsWith(library, ".so") || endsWith(library, ".dylib");
+}
+
+bool CompiledStyleModule::getConcurrent() const
+{
+  string library, module;
+  if (!splitSpec(getFileName(), library, module))
+    return false;
+  // loaded here, before the concurrent layers start, so that interpret()
+  // then only reads the registry
+  if (CompiledStyleModules::loadLibrary(library))
+    return false;
+  const CompiledStyleModuleEntry *entry = CompiledStyleModules::find(library, module);
+  return entry && entry->concurrent;
+}
+
+int CompiledStyleModule::interpret()
+{
+  string library, module;
+  if (!splitSpec(getFileName(), library, module)) {
+    cerr << "Error: \"" << getFileName() << "\" is not of the form <library>:<module>" << endl;
+    return 1;
+  }
+  if (CompiledStyleModules::loadLibrary(library))
+    return 1;
+  const CompiledStyleModuleEntry *entry = CompiledStyleModules::find(library, module);
+  if (!entry) {
+    cerr << "Error: no style module \"" << module << "\" in \"" << library << "\"" << endl;
+    return 1;
+  }
+  return entry->function();
+}
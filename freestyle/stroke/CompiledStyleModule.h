@@ -0,0 +1,126 @@
+//
+//  Filename         : CompiledStyleModule.h
+//  Purpose          : Style modules written in C++ and loaded from a
+//                     shared library, as an alternative to Python scripts
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef  COMPILED_STYLE_MODULE_H
+# define COMPILED_STYLE_MODULE_H
+
+# include <map>
+# include <string>
+# include "../system/FreestyleConfig.h"
+# include "StyleModule.h"
+
+using namespace std;
+
+/*! A compiled style module does what a Python style module does, by
+ *  calling Operators with the C++ predicates, chaining iterators and
+ *  shaders. It returns 0 on success.
+ */
+typedef int (*StyleModuleFunction)();
+
+/*! A registered compiled style module */
+struct CompiledStyleModuleEntry
+{
+  StyleModuleFunction function;
+  /*! see REGISTER_CONCURRENT_STYLE_MODULE */
+  bool concurrent;
+};
+
+/*! Registry of the compiled style modules, filled when the shared
+ *  libraries defining them are loaded (see REGISTER_STYLE_MODULE).
+ */
+class LIB_STROKE_EXPORT CompiledStyleModules
+{
+public:
+  /*! Called by REGISTER_STYLE_MODULE and REGISTER_CONCURRENT_STYLE_MODULE */
+  static void registerModule(const string& name, StyleModuleFunction f, bool concurrent = false);
+
+  /*! Loads a shared library once, which registers the modules it defines.
+   *  Returns 0 on success.
+   */
+  static int loadLibrary(const string& path);
+
+  /*! Returns the module registered by the library under name, or NULL */
+  static const CompiledStyleModuleEntry * find(const string& path, const string& name);
+
+private:
+  // modules of the library being loaded, then of each loaded library
+  static map<string, CompiledStyleModuleEntry> *_loading;
+  static map<string, map<string, CompiledStyleModuleEntry> > _libraries;
+};
+
+/*! Registration helper, see REGISTER_STYLE_MODULE */
+class CompiledStyleModuleRegistrar
+{
+public:
+  CompiledStyleModuleRegistrar(const char *name, StyleModuleFunction f, bool concurrent) {
+    CompiledStyleModules::registerModule(name, f, concurrent);
+  }
+};
+
+/*! To be used at file scope in the shared library:
+ *    static int plain() { Operators::select(...); ...; return 0; }
+ *    REGISTER_STYLE_MODULE(plain)
+ *  The module is then selected as "<library path>:plain".
+ */
+# define REGISTER_STYLE_MODULE(function) \
+  static CompiledStyleModuleRegistrar function##Registrar(#function, function, false);
+
+/*! Same as REGISTER_STYLE_MODULE, for a module that may run at the same
+ *  time as the other concurrent layers of the Canvas. The module must only
+ *  read the ViewMap and its own Operators sets: no shader reading the
+ *  canvas (density, steerable or image maps), drawing textures, or using
+ *  the shared random generator, no Module settings, and no global state
+ *  of its own.
+ */
+# define REGISTER_CONCURRENT_STYLE_MODULE(function) \
+  static CompiledStyleModuleRegistrar function##Registrar(#function, function, true);
+
+/*! A layer of the Canvas running a compiled style module instead of a
+ *  Python script. It produces the same strokes as a Python module doing
+ *  the same calls, without going through the interpreter.
+ */
+class LIB_STROKE_EXPORT CompiledStyleModule : public StyleModule
+{
+public:
+  /*! spec is "<library path>:<module name>" */
+  CompiledStyleModule(const string& spec) : StyleModule(spec, NULL) {}
+  virtual ~CompiledStyleModule() {}
+
+  /*! true if spec names a compiled style module rather than a script */
+  static bool isCompiled(const string& spec);
+
+  /*! true if the module was registered with REGISTER_CONCURRENT_STYLE_MODULE.
+   *  Loads its library if needed.
+   */
+  virtual bool getConcurrent() const;
+
+protected:
+  virtual int interpret();
+};
+
+#endif // COMPILED_STYLE_MODULE_H
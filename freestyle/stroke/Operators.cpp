@@ -25,23 +25,40 @@
 #include "Canvas.h"
 #include "Stroke.h"
 
-LIB_STROKE_EXPORT Operators::I1DContainer	  Operators::_current_view_edges_set;
-LIB_STROKE_EXPORT Operators::I1DContainer		Operators::_current_chains_set;
-LIB_STROKE_EXPORT Operators::I1DContainer*	Operators::_current_set = NULL;
-LIB_STROKE_EXPORT Operators::StrokesContainer	Operators::_current_strokes_set;
+LIB_STROKE_EXPORT OperatorsContext	Operators::_context;
+
+// working sets of the thread, if it has its own
+static OperatorsContext *threadContext = NULL;
+#pragma omp threadprivate(threadContext)
+
+OperatorsContext::~OperatorsContext() {
+  for (vector<Interface1D*>::iterator it = _current_chains_set.begin();
+       it != _current_chains_set.end();
+       ++it)
+    delete *it;
+}
+
+OperatorsContext& Operators::context() {
+  return threadContext ? *threadContext : _context;
+}
+
+void Operators::setThreadContext(OperatorsContext *iContext) {
+  threadContext = iContext;
+}
 
 void Operators::select(UnaryPredicate1D& pred) {
-  if (!_current_set)
+  OperatorsContext& ctx = context();
+  if (!ctx._current_set)
     return;
-  if(_current_set->empty())
+  if(ctx._current_set->empty())
     return;
   I1DContainer new_set;
   I1DContainer rejected;
   Functions1D::ChainingTimeStampF1D cts;
   Functions1D::TimeStampF1D ts;
-  I1DContainer::iterator it = _current_set->begin();
+  I1DContainer::iterator it = ctx._current_set->begin();
   I1DContainer::iterator itbegin = it;
-  while (it != _current_set->end()) {
+  while (it != ctx._current_set->end()) {
     Interface1D * i1d = *it;
     cts(*i1d); // mark everyone's chaining time stamp anyway
     if (pred(*i1d)){
@@ -59,23 +76,24 @@ void Operators::select(UnaryPredicate1D& pred) {
     delete *it;
   }
   rejected.clear();
-  _current_set->clear();
-  *_current_set = new_set;
+  ctx._current_set->clear();
+  *ctx._current_set = new_set;
 }
 
 
 void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
 		      UnaryPredicate1D& pred,
 		      UnaryFunction1D<void>& modifier) {
-  if (_current_view_edges_set.empty())
+  OperatorsContext& ctx = context();
+  if (ctx._current_view_edges_set.empty())
     return;
 
   unsigned id = 0;
   ViewEdge* edge;
   Chain* new_chain;
 
-  for (I1DContainer::iterator it_edge = _current_view_edges_set.begin();
-       it_edge != _current_view_edges_set.end();
+  for (I1DContainer::iterator it_edge = ctx._current_view_edges_set.begin();
+       it_edge != ctx._current_view_edges_set.end();
        ++it_edge) {
     if (pred(**it_edge))
       continue;
@@ -91,17 +109,18 @@ void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
       ++it;
     } while (!it.isEnd() && !pred(**it));
 
-    _current_chains_set.push_back(new_chain);
+    ctx._current_chains_set.push_back(new_chain);
   }
 
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 
 void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
 		      UnaryPredicate1D& pred) {
-  if (_current_view_edges_set.empty())
+  OperatorsContext& ctx = context();
+  if (ctx._current_view_edges_set.empty())
     return;
 
   unsigned id = 0;
@@ -111,8 +130,8 @@ void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
   ViewEdge* edge;
   Chain* new_chain;
 
-  for (I1DContainer::iterator it_edge = _current_view_edges_set.begin();
-       it_edge != _current_view_edges_set.end();
+  for (I1DContainer::iterator it_edge = ctx._current_view_edges_set.begin();
+       it_edge != ctx._current_view_edges_set.end();
        ++it_edge) {
     if (pred(**it_edge) || pred_ts(**it_edge))
       continue;
@@ -128,11 +147,11 @@ void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
       ++it;
     } while (!it.isEnd() && !pred(**it) && !pred_ts(**it));
 
-    _current_chains_set.push_back(new_chain);
+    ctx._current_chains_set.push_back(new_chain);
   }
 
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 
@@ -225,7 +244,8 @@ void Operators::chain(ViewEdgeInternal::ViewEdgeIterator& it,
           //}
 
 void Operators::bidirectionalChain(ChainingIterator& it, UnaryPredicate1D& pred) {
-  if (_current_view_edges_set.empty())
+  OperatorsContext& ctx = context();
+  if (ctx._current_view_edges_set.empty())
     return;
 
   unsigned id = 0;
@@ -235,8 +255,8 @@ void Operators::bidirectionalChain(ChainingIterator& it, UnaryPredicate1D& pred)
   ViewEdge* edge;
   Chain* new_chain;
   
-  for (I1DContainer::iterator it_edge = _current_view_edges_set.begin();
-  it_edge != _current_view_edges_set.end();
+  for (I1DContainer::iterator it_edge = ctx._current_view_edges_set.begin();
+  it_edge != ctx._current_view_edges_set.end();
   ++it_edge) {
     if (pred(**it_edge) || pred_ts(**it_edge))
       continue;
@@ -266,15 +286,16 @@ void Operators::bidirectionalChain(ChainingIterator& it, UnaryPredicate1D& pred)
       ts(**it);
       it.decrement();// FIXME
     }
-    _current_chains_set.push_back(new_chain);
+    ctx._current_chains_set.push_back(new_chain);
   }
   
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 void Operators::bidirectionalChain(ChainingIterator& it) {
-  if (_current_view_edges_set.empty())
+  OperatorsContext& ctx = context();
+  if (ctx._current_view_edges_set.empty())
     return;
 
   unsigned id = 0;
@@ -283,8 +304,8 @@ void Operators::bidirectionalChain(ChainingIterator& it) {
   
   ViewEdge* edge;
   
-  for (I1DContainer::iterator it_edge = _current_view_edges_set.begin();
-  it_edge != _current_view_edges_set.end();
+  for (I1DContainer::iterator it_edge = ctx._current_view_edges_set.begin();
+  it_edge != ctx._current_view_edges_set.end();
   ++it_edge) {
     if (pred_ts(**it_edge))
       continue;
@@ -312,17 +333,18 @@ void Operators::bidirectionalChain(ChainingIterator& it) {
       ts(**it);
       it.decrement();// FIXME
     }
-    _current_chains_set.push_back(new_chain);
+    ctx._current_chains_set.push_back(new_chain);
   }
   
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 void Operators::sequentialSplit(UnaryPredicate0D& pred, 
 				float sampling)
 {
-  if (_current_chains_set.empty()) {
+  OperatorsContext& ctx = context();
+  if (ctx._current_chains_set.empty()) {
     cerr << "Warning: current set empty" << endl;
     return;
   }
@@ -333,7 +355,7 @@ void Operators::sequentialSplit(UnaryPredicate0D& pred,
   Interface0DIterator end;
   Interface0DIterator last;
   Interface0DIterator it;
-  I1DContainer::iterator cit = _current_chains_set.begin(), citend = _current_chains_set.end();
+  I1DContainer::iterator cit = ctx._current_chains_set.begin(), citend = ctx._current_chains_set.end();
   for (;
        cit != citend;
        ++cit) {
@@ -368,24 +390,25 @@ void Operators::sequentialSplit(UnaryPredicate0D& pred,
   }
 
   // Update the current set of chains:
-  cit = _current_chains_set.begin();
+  cit = ctx._current_chains_set.begin();
   for(;
       cit != citend;
       ++cit){
     delete (*cit);
   }
-  _current_chains_set.clear();
-  _current_chains_set = splitted_chains;
+  ctx._current_chains_set.clear();
+  ctx._current_chains_set = splitted_chains;
   splitted_chains.clear();
 
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 void Operators::sequentialSplit(UnaryPredicate0D& startingPred, UnaryPredicate0D& stoppingPred, 
 				float sampling)
 {
-  if (_current_chains_set.empty()) {
+  OperatorsContext& ctx = context();
+  if (ctx._current_chains_set.empty()) {
     cerr << "Warning: current set empty" << endl;
     return;
   }
@@ -397,7 +420,7 @@ void Operators::sequentialSplit(UnaryPredicate0D& startingPred, UnaryPredicate0D
   Interface0DIterator last;
   Interface0DIterator itStart;
   Interface0DIterator itStop;
-  I1DContainer::iterator cit = _current_chains_set.begin(), citend = _current_chains_set.end();
+  I1DContainer::iterator cit = ctx._current_chains_set.begin(), citend = ctx._current_chains_set.end();
   for (;
   cit != citend;
   ++cit) {
@@ -436,18 +459,18 @@ void Operators::sequentialSplit(UnaryPredicate0D& startingPred, UnaryPredicate0D
   }
   
   // Update the current set of chains:
-  cit = _current_chains_set.begin();
+  cit = ctx._current_chains_set.begin();
   for(;
   cit != citend;
   ++cit){
     delete (*cit);
   }
-  _current_chains_set.clear();
-  _current_chains_set = splitted_chains;
+  ctx._current_chains_set.clear();
+  ctx._current_chains_set = splitted_chains;
   splitted_chains.clear();
   
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 #include "CurveIterators.h"
@@ -547,7 +570,8 @@ void __recursiveSplit(Chain *_curve, UnaryFunction0D<double>& func, UnaryPredica
 
 void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate1D& pred, float sampling)
 {
-  if (_current_chains_set.empty()) {
+  OperatorsContext& ctx = context();
+  if (ctx._current_chains_set.empty()) {
     cerr << "Warning: current set empty" << endl;
     return;
   }
@@ -555,7 +579,7 @@ void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate1D&
   Chain *currentChain = 0;
   I1DContainer splitted_chains;
   I1DContainer newChains;
-  I1DContainer::iterator cit = _current_chains_set.begin(), citend = _current_chains_set.end();
+  I1DContainer::iterator cit = ctx._current_chains_set.begin(), citend = ctx._current_chains_set.end();
   for (;
        cit != citend;
        ++cit) {
@@ -579,12 +603,12 @@ void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate1D&
   splitted_chains.clear();
   } 
   
-  _current_chains_set.clear();
-  _current_chains_set = newChains;
+  ctx._current_chains_set.clear();
+  ctx._current_chains_set = newChains;
   newChains.clear();
 
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 
 
@@ -693,7 +717,8 @@ void __recursiveSplit(Chain *_curve, UnaryFunction0D<double>& func, UnaryPredica
 
 void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate0D& pred0d,  UnaryPredicate1D& pred, float sampling)
 {
-  if (_current_chains_set.empty()) {
+  OperatorsContext& ctx = context();
+  if (ctx._current_chains_set.empty()) {
     cerr << "Warning: current set empty" << endl;
     return;
   }
@@ -701,7 +726,7 @@ void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate0D&
   Chain *currentChain = 0;
   I1DContainer splitted_chains;
   I1DContainer newChains;
-  I1DContainer::iterator cit = _current_chains_set.begin(), citend = _current_chains_set.end();
+  I1DContainer::iterator cit = ctx._current_chains_set.begin(), citend = ctx._current_chains_set.end();
   for (;
        cit != citend;
        ++cit) {
@@ -725,12 +750,12 @@ void Operators::recursiveSplit(UnaryFunction0D<double>& func, UnaryPredicate0D&
   splitted_chains.clear();
   } 
   
-  _current_chains_set.clear();
-  _current_chains_set = newChains;
+  ctx._current_chains_set.clear();
+  ctx._current_chains_set = newChains;
   newChains.clear();
 
-  if (!_current_chains_set.empty())
-    _current_set = &_current_chains_set;
+  if (!ctx._current_chains_set.empty())
+    ctx._current_set = &ctx._current_chains_set;
 }
 // Internal class
 class PredicateWrapper
@@ -751,9 +776,10 @@ private:
 };
 
 void Operators::sort(BinaryPredicate1D& pred) {
-  if (!_current_set)
+  OperatorsContext& ctx = context();
+  if (!ctx._current_set)
     return;
-  std::sort(_current_set->begin(), _current_set->end(), PredicateWrapper(pred));
+  std::sort(ctx._current_set->begin(), ctx._current_set->end(), PredicateWrapper(pred));
 }
 
 Stroke* createStroke(Interface1D& inter) {
@@ -824,14 +850,15 @@ inline void applyShading(Stroke& stroke, vector<StrokeShader*>& shaders) {
 
 
 void Operators::create(UnaryPredicate1D& pred, vector<StrokeShader*> shaders) {
+  OperatorsContext& ctx = context();
   Canvas* canvas = Canvas::getInstance();
-  if (!_current_set) {
+  if (!ctx._current_set) {
     cerr << "Warning: current set empty" << endl;
     return;
   }
 
-  for (Operators::I1DContainer::iterator it = _current_set->begin();
-       it != _current_set->end();
+  for (Operators::I1DContainer::iterator it = ctx._current_set->begin();
+       it != ctx._current_set->end();
        ++it) {
     if (!pred(**it))
       continue;
@@ -850,26 +877,28 @@ void Operators::create(UnaryPredicate1D& pred, vector<StrokeShader*> shaders) {
     Stroke* stroke = createStroke(**it);
     if (stroke) {
       applyShading(*stroke, shaders);
-      canvas->RenderStroke(stroke);
-      _current_strokes_set.push_back(stroke);
+      if (ctx._render_strokes)
+        canvas->RenderStroke(stroke);
+      ctx._current_strokes_set.push_back(stroke);
     }
   }
 }
 
 
 void Operators::reset() {
-  _current_view_edges_set.clear();
-  for (I1DContainer::iterator it = _current_chains_set.begin();
-       it != _current_chains_set.end();
+  OperatorsContext& ctx = context();
+  ctx._current_view_edges_set.clear();
+  for (I1DContainer::iterator it = ctx._current_chains_set.begin();
+       it != ctx._current_chains_set.end();
        ++it)
     delete *it;
-  _current_chains_set.clear();
-  _current_set = &_current_view_edges_set;
-  _current_strokes_set.clear();
+  ctx._current_chains_set.clear();
+  ctx._current_set = &ctx._current_view_edges_set;
+  ctx._current_strokes_set.clear();
 
   ViewMap* vm = ViewMap::getInstance();
   if (vm) {
-    _current_view_edges_set.insert(_current_view_edges_set.begin(),
+    ctx._current_view_edges_set.insert(ctx._current_view_edges_set.begin(),
 				   vm->ViewEdges().begin(),
 				   vm->ViewEdges().end());
   }
@@ -41,6 +41,32 @@
 # include "../system/TimeStamp.h"
 # include "StrokeShader.h"
 
+/*! The working sets of the operators while a style module runs: the
+ *  selected ViewEdges, the Chains and the Strokes. The threads running
+ *  style modules concurrently each have their own (see
+ *  Operators::setThreadContext), the others share a global one.
+ */
+class LIB_STROKE_EXPORT OperatorsContext {
+public:
+
+  /*! iRenderStrokes: whether Operators::create hands the strokes to the
+   *  Canvas renderer. Contexts of concurrent style modules leave it to
+   *  the Canvas, which renders their strokes afterwards in layer order.
+   */
+  OperatorsContext(bool iRenderStrokes = true) {
+    _current_set = NULL;
+    _render_strokes = iRenderStrokes;
+  }
+  /*! Deletes the chains; the strokes belong to their StrokeLayer */
+  ~OperatorsContext();
+
+  vector<Interface1D*>	_current_view_edges_set;
+  vector<Interface1D*>	_current_chains_set;
+  vector<Interface1D*>*	_current_set;
+  vector<Stroke*>	_current_strokes_set;
+  bool			_render_strokes;
+};
+
 /*! Class defining the operators used in a style module.
  *  There are 4 classes of operators: Selection, Chaining,
  * Splitting and Creating. All these operators are user controlled
@@ -264,27 +290,27 @@ public:
   ////////////////////////////////////////////////
 
   static ViewEdge* getViewEdgeFromIndex(unsigned i) {
-    return dynamic_cast<ViewEdge*>(_current_view_edges_set[i]);
+    return dynamic_cast<ViewEdge*>(context()._current_view_edges_set[i]);
   }
   
   static Chain* getChainFromIndex(unsigned i) {
-    return dynamic_cast<Chain*>(_current_chains_set[i]);
+    return dynamic_cast<Chain*>(context()._current_chains_set[i]);
   }
     
   static Stroke* getStrokeFromIndex(unsigned i) {
-    return _current_strokes_set[i];
+    return context()._current_strokes_set[i];
   }
   
   static unsigned getViewEdgesSize() {
-    return _current_view_edges_set.size();
+    return context()._current_view_edges_set.size();
   }
   
   static unsigned getChainsSize() {
-    return _current_chains_set.size();
+    return context()._current_chains_set.size();
   }
 
   static unsigned getStrokesSize() {
-    return _current_strokes_set.size();
+    return context()._current_strokes_set.size();
   }
   
   //
@@ -293,19 +319,24 @@ public:
   //////////////////////////////////////////////////
 
   static StrokesContainer* getStrokesSet() {
-    return &_current_strokes_set;
+    return &context()._current_strokes_set;
   }
 
   static void reset();
 
+  /*! The working sets of the calling thread */
+  static OperatorsContext& context();
+
+  /*! Makes iContext the working sets of the calling thread, or gives it
+   *  back the global ones if iContext is NULL.
+   */
+  static void setThreadContext(OperatorsContext *iContext);
+
 private:
 
   Operators() {}
 
-  static I1DContainer		_current_view_edges_set;
-  static I1DContainer		_current_chains_set;
-  static I1DContainer*		_current_set;
-  static StrokesContainer	_current_strokes_set;
+  static OperatorsContext	_context;
 };
 
 #endif // OPERATORS_H
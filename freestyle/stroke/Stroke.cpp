@@ -23,6 +23,7 @@
 #include "StrokeRenderer.h"
 #include "StrokeIterators.h"
 #include "StrokeAdvancedIterators.h"
+#include <string.h>
 
                   /**********************************/
                   /*                                */
@@ -32,6 +33,81 @@
                   /*                                */
                   /**********************************/
 
+// identifiers of the user defined attribute names. Names are only ever added, at the head of the list,
+// and an entry does not change once it is published, so that the lookups by name, which Python shaders
+// make at every vertex, neither lock nor allocate. Only the registration of a new name is serialized.
+enum { ATTRIBUTE_REAL, ATTRIBUTE_VEC2F, ATTRIBUTE_VEC3F };
+struct AttributeName {
+  int type;
+  char *name;
+  StrokeAttribute::AttributeId id;
+  const AttributeName *next;
+};
+static const AttributeName *attributeNames = 0;
+static unsigned nbAttributeIds = 0;
+
+static const AttributeName * lookupAttributeName(const AttributeName *iFirst, int iType, const char *iName)
+{
+  for(const AttributeName *a = iFirst; a != 0; a = a->next)
+    if(a->type == iType && strcmp(a->name, iName) == 0)
+      return a;
+  return 0;
+}
+
+// does not register iName, so that looking up unknown names does not grow the list
+static bool findAttributeId(int iType, const char *iName, StrokeAttribute::AttributeId& oId)
+{
+  const AttributeName *first;
+#pragma omp atomic read
+  first = attributeNames;
+#pragma omp flush
+
+  const AttributeName *a = lookupAttributeName(first, iType, iName);
+  if(a == 0)
+    return false;
+  oId = a->id;
+  return true;
+}
+
+static StrokeAttribute::AttributeId registerAttributeId(int iType, const char *iName)
+{
+  StrokeAttribute::AttributeId id;
+  if(findAttributeId(iType, iName, id))
+    return id;
+
+#pragma omp critical(stroke_attribute_ids)
+  {
+    // another thread may have added it in the meantime
+    const AttributeName *a = lookupAttributeName(attributeNames, iType, iName);
+    if(a == 0){
+      AttributeName *n = new AttributeName;
+      n->type = iType;
+      n->name = strdup(iName);
+      n->id = nbAttributeIds++;
+      n->next = attributeNames;
+#pragma omp flush
+#pragma omp atomic write
+      attributeNames = n;
+      a = n;
+    }
+    id = a->id;
+  }
+  return id;
+}
+
+StrokeAttribute::AttributeId StrokeAttribute::attributeIdReal(const char *iName)
+{
+  return registerAttributeId(ATTRIBUTE_REAL, iName);
+}
+StrokeAttribute::AttributeId StrokeAttribute::attributeIdVec2f(const char *iName)
+{
+  return registerAttributeId(ATTRIBUTE_VEC2F, iName);
+}
+StrokeAttribute::AttributeId StrokeAttribute::attributeIdVec3f(const char *iName)
+{
+  return registerAttributeId(ATTRIBUTE_VEC3F, iName);
+}
+
 StrokeAttribute::StrokeAttribute()
 {
   int i;
@@ -41,9 +117,8 @@ StrokeAttribute::StrokeAttribute()
   for(i=0; i<3; ++i)
     _color[i] = 0.2f;
   _color[0]=0.8;
-  _userAttributesReal = 0;
-  _userAttributesVec2f = 0;
-  _userAttributesVec3f = 0;
+  _nbUserAttributes = 0;
+  _moreUserAttributes = 0;
   _visible = true;
   _colorID[0] = 0;
   _colorID[1] = 0;
@@ -57,18 +132,8 @@ StrokeAttribute::StrokeAttribute(const StrokeAttribute& iBrother)
   for(int i=0; i<3; ++i)
     _color[i] = iBrother._color[i];
   _visible = iBrother._visible;
-  if(iBrother._userAttributesReal)
-    _userAttributesReal = new realMap(*iBrother._userAttributesReal);
-  else
-    _userAttributesReal = 0;
-  if(iBrother._userAttributesVec2f)
-    _userAttributesVec2f = new Vec2fMap(*iBrother._userAttributesVec2f);
-  else
-    _userAttributesVec2f = 0;
-  if(iBrother._userAttributesVec3f)
-    _userAttributesVec3f = new Vec3fMap(*iBrother._userAttributesVec3f);
-  else
-    _userAttributesVec3f = 0;
+  _moreUserAttributes = 0;
+  copyUserAttributes(iBrother);
   _colorID[0] = iBrother._colorID[0];
   _colorID[1] = iBrother._colorID[1];
   _colorID[2] = iBrother._colorID[2];
@@ -89,9 +154,8 @@ StrokeAttribute::StrokeAttribute( float iRColor, float iGColor, float iBColor,
   
   _visible = true;
 
-  _userAttributesReal = 0;
-  _userAttributesVec2f = 0;
-  _userAttributesVec3f = 0;
+  _nbUserAttributes = 0;
+  _moreUserAttributes = 0;
 
   _colorID[0] = iRColorID;
   _colorID[1] = iGColorID;
@@ -110,42 +174,22 @@ StrokeAttribute::StrokeAttribute(const StrokeAttribute& a1, const StrokeAttribut
 
   _visible = true;
   
-  // FIXME: a verifier (et a ameliorer)
-  if((a1._userAttributesReal) && (a2._userAttributesReal)){
-    if(a1._userAttributesReal->size() == a2._userAttributesReal->size()){
-      _userAttributesReal = new realMap;
-      realMap::iterator it1=a1._userAttributesReal->begin(), it1end=a1._userAttributesReal->end();
-      realMap::iterator it2=a2._userAttributesReal->begin(), it2end=a2._userAttributesReal->end();
-      for(; (it1!=it1end); ++it1){
-        (*_userAttributesReal)[(*it1).first] = ((1-t)*(*it1).second+t*(*it2).second);
-      }
-    }
-  }else{
-    _userAttributesReal = 0;
-  }
-  if((a1._userAttributesVec2f) && (a2._userAttributesVec2f)){
-    if(a1._userAttributesVec2f->size() == a2._userAttributesVec2f->size()){
-      _userAttributesVec2f = new Vec2fMap;
-      Vec2fMap::iterator it1=a1._userAttributesVec2f->begin(), it1end=a1._userAttributesVec2f->end();
-      Vec2fMap::iterator it2=a2._userAttributesVec2f->begin(), it2end=a2._userAttributesVec2f->end();
-      for(; (it1!=it1end); ++it1){
-        (*_userAttributesVec2f)[(*it1).first] = ((1-t)*(*it1).second+t*(*it2).second);
-      }
-    }
-  }else{
-    _userAttributesVec2f = 0;
-  }
-  if((a1._userAttributesVec3f) && (a2._userAttributesVec3f)){
-    if(a1._userAttributesVec3f->size() == a2._userAttributesVec3f->size()){
-      _userAttributesVec3f = new Vec3fMap;
-      Vec3fMap::iterator it1=a1._userAttributesVec3f->begin(), it1end=a1._userAttributesVec3f->end();
-      Vec3fMap::iterator it2=a2._userAttributesVec3f->begin(), it2end=a2._userAttributesVec3f->end();
-      for(; (it1!=it1end); ++it1){
-        (*_userAttributesVec3f)[(*it1).first] = ((1-t)*(*it1).second+t*(*it2).second);
-      }
-    }
-  }else{
-    _userAttributesVec3f = 0;
+  // the attributes defined on both vertices are interpolated; they are
+  // usually set in the same order, so that a2's is found at the same place
+  _nbUserAttributes = 0;
+  _moreUserAttributes = 0;
+  for(unsigned i=0; i<a1._nbUserAttributes; ++i){
+    const UserAttribute& u1 = a1.userAttributeAt(i);
+    const UserAttribute *u2;
+    if((i < a2._nbUserAttributes) && (a2.userAttributeAt(i).id == u1.id))
+      u2 = &a2.userAttributeAt(i);
+    else
+      u2 = a2.findUserAttribute(u1.id);
+    if(!u2)
+      continue;
+    UserAttribute& u = userAttribute(u1.id);
+    for(int j=0; j<3; ++j)
+      u.value[j] = (1-t)*u1.value[j]+t*u2->value[j];
   }
 
   _colorID[0] = a1._colorID[0];
@@ -154,18 +198,8 @@ StrokeAttribute::StrokeAttribute(const StrokeAttribute& a1, const StrokeAttribut
 }
 StrokeAttribute::~StrokeAttribute()
 {
-  if(_userAttributesReal){
-    _userAttributesReal->clear();
-    delete _userAttributesReal;
-  }
-  if(_userAttributesVec2f){
-    _userAttributesVec2f->clear();
-    delete _userAttributesVec2f;
-  }
-  if(_userAttributesVec3f){
-    _userAttributesVec3f->clear();
-    delete _userAttributesVec3f;
-  }
+  if(_moreUserAttributes)
+    delete _moreUserAttributes;
 }
 
 StrokeAttribute& StrokeAttribute::operator=(const StrokeAttribute& iBrother)
@@ -177,27 +211,8 @@ StrokeAttribute& StrokeAttribute::operator=(const StrokeAttribute& iBrother)
   for(i=0; i<3; ++i)
     _color[i] = iBrother._color[i];
   _visible = iBrother._visible;
-  if(iBrother._userAttributesReal){
-    if(!_userAttributesReal)
-      _userAttributesReal = new realMap;
-    _userAttributesReal = new realMap(*(iBrother._userAttributesReal));
-  }else{
-    _userAttributesReal = 0;
-  }
-  if(iBrother._userAttributesVec2f){
-    if(!_userAttributesVec2f)
-      _userAttributesVec2f = new Vec2fMap;
-    _userAttributesVec2f = new Vec2fMap(*(iBrother._userAttributesVec2f));
-  }else{
-    _userAttributesVec2f = 0;
-  }
-  if(iBrother._userAttributesVec3f){
-    if(!_userAttributesVec3f)
-      _userAttributesVec3f = new Vec3fMap;
-    _userAttributesVec3f = new Vec3fMap(*(iBrother._userAttributesVec3f));
-  }else{
-    _userAttributesVec3f = 0;
-  } 
+  if(this != &iBrother)
+    copyUserAttributes(iBrother);
 
   _colorID[0] = iBrother._colorID[0];
   _colorID[1] = iBrother._colorID[1];
@@ -206,86 +221,121 @@ StrokeAttribute& StrokeAttribute::operator=(const StrokeAttribute& iBrother)
   return *this;
 }
 
-float StrokeAttribute::getAttributeReal(const char *iName) const{
-  if(!_userAttributesReal){
-    cout << "StrokeAttribute warning: no real attribute was defined"<< endl;
-    return 0;
+void StrokeAttribute::copyUserAttributes(const StrokeAttribute& iBrother)
+{
+  _nbUserAttributes = iBrother._nbUserAttributes;
+  for(unsigned i=0; (i<_nbUserAttributes) && (i<NB_INLINE_USER_ATTRIBUTES); ++i)
+    _userAttributes[i] = iBrother._userAttributes[i];
+  if(iBrother._moreUserAttributes){
+    if(_moreUserAttributes)
+      *_moreUserAttributes = *iBrother._moreUserAttributes;
+    else
+      _moreUserAttributes = new vector<UserAttribute>(*iBrother._moreUserAttributes);
+  }else if(_moreUserAttributes){
+    delete _moreUserAttributes;
+    _moreUserAttributes = 0;
+  }
+}
+
+const StrokeAttribute::UserAttribute * StrokeAttribute::findUserAttribute(AttributeId iId) const
+{
+  for(unsigned i=0; i<_nbUserAttributes; ++i){
+    const UserAttribute& u = userAttributeAt(i);
+    if(u.id == iId)
+      return &u;
+  }
+  return 0;
+}
+
+StrokeAttribute::UserAttribute& StrokeAttribute::userAttribute(AttributeId iId)
+{
+  const UserAttribute *found = findUserAttribute(iId);
+  if(found)
+    return const_cast<UserAttribute&>(*found);
+  UserAttribute u;
+  u.id = iId;
+  u.value[0] = u.value[1] = u.value[2] = 0.f;
+  if(_nbUserAttributes < NB_INLINE_USER_ATTRIBUTES){
+    _userAttributes[_nbUserAttributes] = u;
+  }else{
+    if(!_moreUserAttributes)
+      _moreUserAttributes = new vector<UserAttribute>;
+    _moreUserAttributes->push_back(u);
   }
-  realMap::iterator a = _userAttributesReal->find(iName);
-  if(a ==_userAttributesReal->end()){
+  return userAttributeAt(_nbUserAttributes++);
+}
+
+float StrokeAttribute::getAttributeReal(AttributeId iId) const{
+  const UserAttribute *u = findUserAttribute(iId);
+  return u ? u->value[0] : 0;
+}
+Vec2f StrokeAttribute::getAttributeVec2f(AttributeId iId) const{
+  const UserAttribute *u = findUserAttribute(iId);
+  return u ? Vec2f(u->value[0], u->value[1]) : Vec2f(0, 0);
+}
+Vec3f StrokeAttribute::getAttributeVec3f(AttributeId iId) const{
+  const UserAttribute *u = findUserAttribute(iId);
+  return u ? Vec3f(u->value[0], u->value[1], u->value[2]) : Vec3f(0, 0, 0);
+}
+void StrokeAttribute::setAttributeReal(AttributeId iId, float att){
+  userAttribute(iId).value[0] = att;
+}
+void StrokeAttribute::setAttributeVec2f(AttributeId iId, const Vec2f& att){
+  UserAttribute& u = userAttribute(iId);
+  u.value[0] = att[0];
+  u.value[1] = att[1];
+}
+void StrokeAttribute::setAttributeVec3f(AttributeId iId, const Vec3f& att){
+  UserAttribute& u = userAttribute(iId);
+  u.value[0] = att[0];
+  u.value[1] = att[1];
+  u.value[2] = att[2];
+}
+
+float StrokeAttribute::getAttributeReal(const char *iName) const{
+  AttributeId id;
+  if(!findAttributeId(ATTRIBUTE_REAL, iName, id) || !isAttributeAvailable(id)){
     cout << "StrokeAttribute warning: no real attribute was added with the name " << iName << endl;
     return 0;
   }
-  return (*a).second;
+  return getAttributeReal(id);
 }
 Vec2f StrokeAttribute::getAttributeVec2f(const char *iName) const{
-  if(!_userAttributesVec2f){
-    cout << "StrokeAttribute warning: no Vec2f attribute was defined "<< endl;
-    return 0;
-  }
-  Vec2fMap::iterator a = _userAttributesVec2f->find(iName);
-  if(a ==_userAttributesVec2f->end()){
+  AttributeId id;
+  if(!findAttributeId(ATTRIBUTE_VEC2F, iName, id) || !isAttributeAvailable(id)){
     cout << "StrokeAttribute warning: no Vec2f attribute was added with the name " << iName << endl;
     return 0;
   }
-  return (*a).second;
+  return getAttributeVec2f(id);
 }
 Vec3f StrokeAttribute::getAttributeVec3f(const char *iName) const{
-  if(!_userAttributesVec3f){
-    cout << "StrokeAttribute warning: no Vec3f attribute was defined"<< endl;
-    return 0;
-  }
-  Vec3fMap::iterator a = _userAttributesVec3f->find(iName);
-  if(a ==_userAttributesVec3f->end()){
+  AttributeId id;
+  if(!findAttributeId(ATTRIBUTE_VEC3F, iName, id) || !isAttributeAvailable(id)){
     cout << "StrokeAttribute warning: no Vec3f attribute was added with the name " << iName << endl;
     return 0;
   }
-  return (*a).second;
+  return getAttributeVec3f(id);
 }
 bool StrokeAttribute::isAttributeAvailableReal(const char *iName) const{
-  if(!_userAttributesReal){
-    return false;
-  }
-  realMap::iterator a = _userAttributesReal->find(iName);
-  if(a ==_userAttributesReal->end()){
-    return false;
-  }
-  return true;
+  AttributeId id;
+  return findAttributeId(ATTRIBUTE_REAL, iName, id) && isAttributeAvailable(id);
 }
 bool StrokeAttribute::isAttributeAvailableVec2f(const char *iName) const{
-  if(!_userAttributesVec2f){
-    return false;
-  }
-  Vec2fMap::iterator a = _userAttributesVec2f->find(iName);
-  if(a ==_userAttributesVec2f->end()){
-    return false;
-  }
-  return true;
+  AttributeId id;
+  return findAttributeId(ATTRIBUTE_VEC2F, iName, id) && isAttributeAvailable(id);
 }
 bool StrokeAttribute::isAttributeAvailableVec3f(const char *iName) const{
-  if(!_userAttributesVec3f){
-    return false;
-  }
-  Vec3fMap::iterator a = _userAttributesVec3f->find(iName);
-  if(a ==_userAttributesVec3f->end()){
-    return false;
-  }
-  return true;
+  AttributeId id;
+  return findAttributeId(ATTRIBUTE_VEC3F, iName, id) && isAttributeAvailable(id);
 }
 void StrokeAttribute::setAttributeReal(const char *iName, float att){
-  if(!_userAttributesReal)
-    _userAttributesReal = new realMap;
-  (*_userAttributesReal)[iName] = att;
+  setAttributeReal(attributeIdReal(iName), att);
 }
 void StrokeAttribute::setAttributeVec2f(const char *iName, const Vec2f& att){
-  if(!_userAttributesVec2f)
-    _userAttributesVec2f = new Vec2fMap;
-  (*_userAttributesVec2f)[iName] = att;
+  setAttributeVec2f(attributeIdVec2f(iName), att);
 }
 void StrokeAttribute::setAttributeVec3f(const char *iName, const Vec3f& att){
-  if(!_userAttributesVec3f)
-    _userAttributesVec3f = new Vec3fMap;
-  (*_userAttributesVec3f)[iName] = att;
+  setAttributeVec3f(attributeIdVec3f(iName), att);
 }
                   /**********************************/
                   /*                                */
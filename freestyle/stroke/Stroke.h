@@ -51,6 +51,21 @@ class LIB_STROKE_EXPORT StrokeAttribute
 {
 public:
 
+  /*! Identifier of a user defined attribute, see attributeIdReal */
+  typedef unsigned short AttributeId;
+
+  /*! Returns the identifier of the user defined attribute of type real
+   *  named iName, registering the name the first time. Shaders looking
+   *  up an attribute at every vertex should get its identifier once and
+   *  use the AttributeId versions of the accessors, which neither compare
+   *  strings nor allocate.
+   */
+  static AttributeId attributeIdReal(const char *iName);
+  /*! Same as attributeIdReal, for an attribute of type Vec2f */
+  static AttributeId attributeIdVec2f(const char *iName);
+  /*! Same as attributeIdReal, for an attribute of type Vec3f */
+  static AttributeId attributeIdVec3f(const char *iName);
+
   /*! default constructor */
   StrokeAttribute();
   /*! Copy constructor */
@@ -151,6 +166,15 @@ public:
   bool isAttributeAvailableVec2f(const char *iName) const ;
   /*! Checks whether the attribute iName is availbale */
   bool isAttributeAvailableVec3f(const char *iName) const ;
+
+  /*! Returns the attribute of type real of identifier iId */
+  float getAttributeReal(AttributeId iId) const;
+  /*! Returns the attribute of type Vec2f of identifier iId */
+  Vec2f getAttributeVec2f(AttributeId iId) const;
+  /*! Returns the attribute of type Vec3f of identifier iId */
+  Vec3f getAttributeVec3f(AttributeId iId) const;
+  /*! Checks whether the attribute of identifier iId is available */
+  bool isAttributeAvailable(AttributeId iId) const { return findUserAttribute(iId) != 0; }
   
   /* modifiers */
   /*! Sets the attribute's color.
@@ -227,19 +251,41 @@ public:
    */
   void setAttributeVec3f(const char *iName, const Vec3f& att);
 
+  /*! Sets the attribute of type real of identifier iId */
+  void setAttributeReal(AttributeId iId, float att);
+  /*! Sets the attribute of type Vec2f of identifier iId */
+  void setAttributeVec2f(AttributeId iId, const Vec2f& att);
+  /*! Sets the attribute of type Vec3f of identifier iId */
+  void setAttributeVec3f(AttributeId iId, const Vec3f& att);
+
 private:
 
-  typedef std::map<const char*, float, StringUtils::ltstr> realMap ;
-  typedef std::map<const char*, Vec2f, StringUtils::ltstr> Vec2fMap ;
-  typedef std::map<const char*, Vec3f, StringUtils::ltstr> Vec3fMap ;
+  // a user defined attribute; reals and Vec2f use the first components
+  struct UserAttribute {
+    AttributeId id;
+    float value[3];
+  };
+  // the first user attributes are stored in the StrokeAttribute itself,
+  // so that copies and interpolations of most vertices do not allocate
+  static const unsigned NB_INLINE_USER_ATTRIBUTES = 3;
+
+  const UserAttribute * findUserAttribute(AttributeId iId) const;
+  UserAttribute& userAttribute(AttributeId iId);
+  void copyUserAttributes(const StrokeAttribute& iBrother);
+  UserAttribute& userAttributeAt(unsigned i) {
+    return i < NB_INLINE_USER_ATTRIBUTES ? _userAttributes[i] : (*_moreUserAttributes)[i-NB_INLINE_USER_ATTRIBUTES];
+  }
+  const UserAttribute& userAttributeAt(unsigned i) const {
+    return i < NB_INLINE_USER_ATTRIBUTES ? _userAttributes[i] : (*_moreUserAttributes)[i-NB_INLINE_USER_ATTRIBUTES];
+  }
 
   float _color[3];      //! the color 
   float _alpha;         //! alpha 
   float _thickness[2];  //! the thickness on the right and on the left of the backbone vertex (the stroke is oriented)
   bool _visible;
-  realMap *_userAttributesReal;
-  Vec2fMap *_userAttributesVec2f;
-  Vec3fMap *_userAttributesVec3f;
+  unsigned _nbUserAttributes;
+  UserAttribute _userAttributes[NB_INLINE_USER_ATTRIBUTES];
+  std::vector<UserAttribute> *_moreUserAttributes; // the ones after the inline ones, or NULL
   float _colorID[3];    // ID of the ViewEdge that this came from
 };
 
@@ -27,6 +27,13 @@
 
 using namespace std;
 
+// the user defined orientation of the strips, see shaders.py
+static StrokeAttribute::AttributeId orientationId()
+{
+  static const StrokeAttribute::AttributeId id = StrokeAttribute::attributeIdVec2f("orientation");
+  return id;
+}
+
 //
 // STROKE VERTEX REP
 /////////////////////////////////////
@@ -182,8 +189,8 @@ Strip::createStrip (const vector<StrokeVertex*>& iStrokeVertices)
   Vec2r stripDir(orthDir);
   // check whether the orientation
   // was user defined
-  if(sv->attribute().isAttributeAvailableVec2f("orientation")){
-    Vec2r userDir = sv->attribute().getAttributeVec2f("orientation");
+  if(sv->attribute().isAttributeAvailable(orientationId())){
+    Vec2r userDir = sv->attribute().getAttributeVec2f(orientationId());
     userDir.normalize();
     Vec2r t(orthDir[1], -orthDir[0]);
     real dp1 = userDir*orthDir;
@@ -275,8 +282,8 @@ Strip::createStrip (const vector<StrokeVertex*>& iStrokeVertices)
       dir.normalize();
       Vec2r orthDir(-dir[1], dir[0]);
       Vec2r stripDir = orthDir;
-      if(sv->attribute().isAttributeAvailableVec2f("orientation")){
-        Vec2r userDir = sv->attribute().getAttributeVec2f("orientation");
+      if(sv->attribute().isAttributeAvailable(orientationId())){
+        Vec2r userDir = sv->attribute().getAttributeVec2f(orientationId());
         userDir.normalize();
         real dp = userDir*orthDir;
         if(dp<0)
@@ -290,8 +297,8 @@ Strip::createStrip (const vector<StrokeVertex*>& iStrokeVertices)
       dirPrev.normalize();
       Vec2r orthDirPrev(-dirPrev[1], dirPrev[0]);
       Vec2r stripDirPrev = orthDirPrev;
-      if(svPrev->attribute().isAttributeAvailableVec2f("orientation")){
-        Vec2r userDir = svPrev->attribute().getAttributeVec2f("orientation");
+      if(svPrev->attribute().isAttributeAvailable(orientationId())){
+        Vec2r userDir = svPrev->attribute().getAttributeVec2f(orientationId());
         userDir.normalize();
         real dp = userDir*orthDir;
         if(dp<0)
@@ -385,8 +392,8 @@ Strip::createStrip (const vector<StrokeVertex*>& iStrokeVertices)
 
   // check whether the orientation
   // was user defined
-  if(sv->attribute().isAttributeAvailableVec2f("orientation")){
-    Vec2r userDir = sv->attribute().getAttributeVec2f("orientation");
+  if(sv->attribute().isAttributeAvailable(orientationId())){
+    Vec2r userDir = sv->attribute().getAttributeVec2f(orientationId());
     userDir.normalize();
     Vec2r t(orthDir[1], -orthDir[0]);
     real dp1 = userDir*orthDir;
@@ -54,16 +54,12 @@ public:
     _inter = inter;
   }
 
-  ~StyleModule() {}
+  virtual ~StyleModule() {}
 
   StrokeLayer* execute() {
-    if (!_inter) {
-      cerr << "Error: no interpreter was found to execute the script" << endl;
-      return NULL;
-    }
     Operators::reset();
 
-    if (_inter->interpretFile(_file_name))
+    if (interpret())
       return NULL;
     Operators::StrokesContainer* strokes_set = Operators::getStrokesSet();
     if (!_drawable || strokes_set->empty())
@@ -103,6 +99,14 @@ public:
     return _displayed;
   }
 
+  /*! true if the module only reads the ViewMap, so that it may run at the
+   *  same time as the other concurrent modules (see Canvas::Draw).
+   *  Python modules share the interpreter and are never concurrent.
+   */
+  virtual bool getConcurrent() const {
+    return false;
+  }
+
   // modifiers
 
   void setFileName(const string& file_name) {
@@ -131,6 +135,17 @@ public:
     _displayed = b;
   }
 
+protected:
+
+  /*! Runs the module, which fills the Operators sets. Returns 0 on success. */
+  virtual int interpret() {
+    if (!_inter) {
+      cerr << "Error: no interpreter was found to execute the script" << endl;
+      return 1;
+    }
+    return _inter->interpretFile(_file_name);
+  }
+
 private:
 
   string	_file_name;
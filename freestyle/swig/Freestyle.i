@@ -165,6 +165,9 @@
 %template(integrateDouble)	integrate<double>;
 //%template(integrateReal)	integrate<real>;
 
+// base of the view map entities, not wrapped
+%import "../system/Arena.h"
+
 %rename(getObject) FEdgeInternal::SVertexIterator::operator*;
 %rename(FEdgeSVertexIterator) FEdgeInternal::SVertexIterator;
 %include "../view_map/Silhouette.h"
@@ -188,6 +191,7 @@
 %ignore ViewEdge::vertices_begin;
 %ignore ViewEdge::vertices_last;
 %ignore ViewEdge::vertices_end;
+%ignore ViewEdgeMarks;
 %rename(directedViewEdge) ViewVertex::directedViewEdge; 
 //%template(directedViewEdge) std::pair<ViewEdge*,bool>;
 %include "../view_map/ViewMap.h"
@@ -271,6 +275,9 @@
 
 %ignore Operators::getStrokesSet;
 %ignore Operators::reset;
+%ignore Operators::context;
+%ignore Operators::setThreadContext;
+%ignore OperatorsContext;
 %include "../stroke/Operators.h"
 
 // Canvas.h
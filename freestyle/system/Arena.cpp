@@ -0,0 +1,119 @@
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <new>
+#include "Arena.h"
+
+using namespace std;
+
+// every block handed out starts 16 bytes in, keeps the alignment of operator new
+static const size_t ALIGNMENT = 16;
+
+// ArenaObject blocks are preceded by a header holding the arena they come from
+// (NULL for the heap), so that delete knows whether to free them
+static const size_t HEADER_SIZE = ALIGNMENT;
+
+// the arena of the innermost Scope of each thread
+static Arena *currentArena = 0;
+#pragma omp threadprivate(currentArena)
+
+Arena * Arena::current()
+{
+  return currentArena;
+}
+
+Arena::Arena(size_t chunkSize)
+{
+  _cursor = _end = 0;
+  _chunkSize = chunkSize;
+  _allocated = 0;
+}
+
+Arena::~Arena()
+{
+  release();
+}
+
+void * Arena::allocate(size_t size)
+{
+  size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  char *p;
+  // only contended when several threads open a Scope on the same arena
+#pragma omp critical(arena)
+  {
+    if (size > _chunkSize) {
+      // kept out of the current chunk so that its remainder is not lost
+      p = static_cast<char*>(::operator new(size));
+      _chunks.push_back(p);
+    } else {
+      if (_cursor == 0 || size_t(_end - _cursor) < size) {
+        _cursor = static_cast<char*>(::operator new(_chunkSize));
+        _end = _cursor + _chunkSize;
+        _chunks.push_back(_cursor);
+      }
+      p = _cursor;
+      _cursor += size;
+    }
+    _allocated += size;
+  }
+  return p;
+}
+
+void Arena::release()
+{
+  for(vector<char*>::iterator it = _chunks.begin(); it != _chunks.end(); ++it)
+    ::operator delete(*it);
+  _chunks.clear();
+  _cursor = _end = 0;
+  _allocated = 0;
+}
+
+Arena::Scope::Scope(Arena& iArena)
+{
+  _previous = currentArena;
+  currentArena = &iArena;
+}
+
+Arena::Scope::~Scope()
+{
+  currentArena = _previous;
+}
+
+void * ArenaObject::operator new(size_t size)
+{
+  Arena *arena = Arena::current();
+  char *block;
+  if (arena)
+    block = static_cast<char*>(arena->allocate(size + HEADER_SIZE));
+  else
+    block = static_cast<char*>(::operator new(size + HEADER_SIZE));
+  *reinterpret_cast<Arena**>(block) = arena;
+  return block + HEADER_SIZE;
+}
+
+void ArenaObject::operator delete(void *p)
+{
+  if (p == 0)
+    return;
+  char *block = static_cast<char*>(p) - HEADER_SIZE;
+  // arena memory is given back by Arena::release
+  if (*reinterpret_cast<Arena**>(block) == 0)
+    ::operator delete(block);
+}
@@ -0,0 +1,103 @@
+//
+//  Filename         : Arena.h
+//  Purpose          : Chunked allocator for objects that all die together,
+//                     and a base class routing their new/delete to it
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef  ARENA_H
+# define ARENA_H
+
+# include <cstddef>
+# include <vector>
+# include "FreestyleConfig.h"
+
+/*! Bump allocator: memory is taken from large chunks and is only given
+ *  back all at once, by release() or by the destructor.
+ *  allocate() can be called from several threads, which may share an arena.
+ */
+class LIB_SYSTEM_EXPORT Arena
+{
+ public:
+
+  /*! chunkSize: size in bytes of each chunk; larger requests get a chunk of their own */
+  explicit Arena(size_t chunkSize = 1 << 20);
+  /*! Releases all the memory */
+  ~Arena();
+
+  /*! Returns size bytes aligned on 16 bytes */
+  void * allocate(size_t size);
+
+  /*! Gives back all the chunks. Nothing allocated before may be used afterwards. */
+  void release();
+
+  /*! Number of bytes handed out since the last release */
+  inline size_t allocatedSize() const { return _allocated; }
+
+  /*! The arena used by ArenaObject::operator new in the calling thread,
+   *  or NULL for the heap
+   */
+  static Arena * current();
+
+  /*! Makes an arena the current one of the calling thread for the
+   *  lifetime of the Scope, then restores the previous one. Each thread
+   *  has its own current arena: the threads of a parallel loop started
+   *  inside a Scope allocate from the heap, unless they open a Scope of
+   *  their own.
+   */
+  class LIB_SYSTEM_EXPORT Scope
+  {
+  public:
+    explicit Scope(Arena& iArena);
+    ~Scope();
+  private:
+    Arena *_previous;
+  };
+
+ private:
+
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+
+  std::vector<char*> _chunks;
+  char *_cursor;
+  char *_end;
+  size_t _chunkSize;
+  size_t _allocated;
+};
+
+/*! Base class of the objects that may live in an Arena.
+ *  Objects created with new while an Arena::Scope is active are allocated
+ *  in its arena; delete then only runs the destructor, and the memory goes
+ *  back when the arena is released. Objects created outside of any Scope
+ *  are allocated on the heap as usual.
+ */
+class LIB_SYSTEM_EXPORT ArenaObject
+{
+ public:
+  static void * operator new(size_t size);
+  static void operator delete(void *p);
+};
+
+#endif // ARENA_H
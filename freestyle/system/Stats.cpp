@@ -0,0 +1,169 @@
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "Stats.h"
+
+LIB_SYSTEM_EXPORT
+Stats* Stats::_instance = 0;
+
+Stats* Stats::instance()
+{
+  Stats *instance;
+#pragma omp critical(statsInstance)
+  {
+    if (_instance == 0)
+      _instance = new Stats;
+    instance = _instance;
+  }
+  return instance;
+}
+
+Stats::Stage& Stats::stage(const char *name)
+{
+  for(vector<Stage>::iterator it = _stages.begin(); it != _stages.end(); ++it)
+    if (it->name == name)
+      return *it;
+
+  Stage s;
+  s.name = name;
+  s.seconds = 0;
+  s.calls = 0;
+  s.peakKB = 0;
+  _stages.push_back(s);
+  return _stages.back();
+}
+
+void Stats::addTime(const char *name, double seconds)
+{
+#pragma omp critical(stats)
+  {
+    Stage& s = stage(name);
+    s.seconds += seconds;
+    s.calls++;
+  }
+}
+
+void Stats::addCount(const char *name, const char *counter, long long value)
+{
+#pragma omp critical(stats)
+  {
+    vector<pair<string, long long> >& counters = stage(name).counters;
+    vector<pair<string, long long> >::iterator it = counters.begin();
+    while(it != counters.end() && it->first != counter)
+      ++it;
+    if (it == counters.end())
+      counters.push_back(make_pair(string(counter), value));
+    else
+      it->second += value;
+  }
+}
+
+void Stats::sampleMemory(const char *name)
+{
+  long kb = peakMemoryKB();
+
+#pragma omp critical(stats)
+  {
+    Stage& s = stage(name);
+    if (kb > s.peakKB)
+      s.peakKB = kb;
+  }
+}
+
+// stage and counter names are identifiers, so they need no escaping; the frame label might be a file name
+static void writeJSONString(FILE *fp, const char *str)
+{
+  fputc('"', fp);
+  for(; *str; str++)
+  {
+    if (*str == '"' || *str == '\\')
+      fputc('\\', fp);
+    if ((unsigned char)*str >= 0x20)
+      fputc(*str, fp);
+  }
+  fputc('"', fp);
+}
+
+bool Stats::writeReport(const char *filename, const char *frame) const
+{
+  FILE *fp = fopen(filename, "a");
+  if (fp == NULL)
+  {
+    printf("ERROR: CAN'T OPEN STATS REPORT %s\n", filename);
+    return false;
+  }
+
+  fprintf(fp, "{\"frame\": ");
+  writeJSONString(fp, frame == NULL ? "" : frame);
+  fprintf(fp, ", \"peakKB\": %ld, \"stages\": [", peakMemoryKB());
+
+  for(vector<Stage>::const_iterator it = _stages.begin(); it != _stages.end(); ++it)
+  {
+    fprintf(fp, "%s{\"name\": ", it == _stages.begin() ? "" : ", ");
+    writeJSONString(fp, it->name.c_str());
+    fprintf(fp, ", \"seconds\": %.6f, \"calls\": %lld, \"peakKB\": %ld", it->seconds, it->calls, it->peakKB);
+
+    if (!it->counters.empty())
+    {
+      fprintf(fp, ", \"counters\": {");
+      for(vector<pair<string, long long> >::const_iterator c = it->counters.begin(); c != it->counters.end(); ++c)
+      {
+        if (c != it->counters.begin())
+          fprintf(fp, ", ");
+        writeJSONString(fp, c->first.c_str());
+        fprintf(fp, ": %lld", c->second);
+      }
+      fprintf(fp, "}");
+    }
+    fprintf(fp, "}");
+  }
+
+  fprintf(fp, "]}\n");
+  fclose(fp);
+  return true;
+}
+
+void Stats::reset()
+{
+#pragma omp critical(stats)
+  _stages.clear();
+}
+
+double Stats::wallTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+long Stats::peakMemoryKB()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024; // bytes on OS X
+#else
+  return usage.ru_maxrss;
+#endif
+}
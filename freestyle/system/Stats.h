@@ -0,0 +1,122 @@
+//
+//  Filename         : Stats.h
+//  Purpose          : Per-stage timings, counters and memory samples,
+//                     written out as a per-frame report
+//
+///////////////////////////////////////////////////////////////////////////////
+
+
+//
+//  Copyright (C) : Please refer to the COPYRIGHT file distributed
+//   with this source distribution.
+//
+//  This program is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU General Public License
+//  as published by the Free Software Foundation; either version 2
+//  of the License, or (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef  STATS_H
+# define STATS_H
+
+# include <vector>
+# include <utility>
+# include "FreestyleConfig.h"
+
+/*! Singleton collecting, for each named stage of the pipeline, the wall
+ *  time spent in it, the number of times it ran, the peak memory seen at
+ *  its end, and any counters reported by it.
+ *  Stages are kept in the order they were first seen. Stages that run on
+ *  several threads at once accumulate the time of each thread.
+ *  All the methods can be called from several threads.
+ */
+class LIB_SYSTEM_EXPORT Stats
+{
+ public:
+
+  /*! Creates the singleton on first use, which may come from any thread */
+  static Stats* instance();
+
+  /*! Adds seconds to the time of the stage, and counts one more call */
+  void addTime(const char *stage, double seconds);
+
+  /*! Adds value to the counter of the stage */
+  void addCount(const char *stage, const char *counter, long long value);
+
+  /*! Records the peak resident memory of the process so far against the stage */
+  void sampleMemory(const char *stage);
+
+  /*! Appends the stages collected so far to filename, as a single line
+   *  holding one JSON object, so that a file collects one line per frame.
+   *  Returns false if the file can't be opened.
+   */
+  bool writeReport(const char *filename, const char *frame) const;
+
+  /*! Forgets all the stages, for the next frame */
+  void reset();
+
+  /*! Seconds since an arbitrary origin, for measuring wall time */
+  static double wallTime();
+
+  /*! Peak resident memory of the process so far, in kilobytes */
+  static long peakMemoryKB();
+
+ protected:
+
+  Stats() {}
+  Stats(const Stats&) {}
+
+  struct Stage {
+    string name;
+    double seconds;
+    long long calls;
+    long peakKB;
+    vector<pair<string, long long> > counters;
+  };
+
+  Stage& stage(const char *name);
+
+ private:
+
+  static Stats* _instance;
+  vector<Stage> _stages;
+};
+
+/*! Adds the wall time between its construction and its destruction
+ *  (or the call to stop(), if that comes first) to a stage
+ */
+class StatsTimer
+{
+ public:
+
+  inline StatsTimer(const char *stage) : _stage(stage), _start(Stats::wallTime()) {}
+
+  inline ~StatsTimer() {
+    stop();
+  }
+
+  inline void stop() {
+    if (_stage == 0)
+      return;
+    Stats::instance()->addTime(_stage, Stats::wallTime() - _start);
+    Stats::instance()->sampleMemory(_stage);
+    _stage = 0;
+  }
+
+ private:
+
+  const char *_stage;
+  double _start;
+};
+
+#endif // STATS_H
@@ -23,3 +23,19 @@
 
 LIB_SYSTEM_EXPORT 
 TimeStamp* TimeStamp::_instance = 0;
+
+// time stamp of the thread, if it has one of its own
+static TimeStamp *threadInstance = 0;
+#pragma omp threadprivate(threadInstance)
+
+TimeStamp* TimeStamp::instance() {
+  if (threadInstance)
+    return threadInstance;
+  if (_instance == 0)
+    _instance = new TimeStamp;
+  return _instance;
+}
+
+void TimeStamp::setThreadInstance(TimeStamp *iTimeStamp) {
+  threadInstance = iTimeStamp;
+}
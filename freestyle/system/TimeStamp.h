@@ -36,10 +36,20 @@ class LIB_SYSTEM_EXPORT TimeStamp
 {
  public:
 
-  static inline TimeStamp* instance() {
-    if (_instance == 0)
-      _instance = new TimeStamp;
-    return _instance;
+  /*! The time stamp of the calling thread if it was given one with
+   *  setThreadInstance, the global one otherwise.
+   */
+  static TimeStamp* instance();
+
+  /*! Makes iTimeStamp the time stamp of the calling thread, or gives it
+   *  back the global one if iTimeStamp is NULL. Used to run style modules
+   *  concurrently, see Canvas::Draw.
+   */
+  static void setThreadInstance(TimeStamp *iTimeStamp);
+
+  /*! A time stamp other than the global one, see setThreadInstance */
+  explicit TimeStamp(unsigned iTimeStamp) {
+    _time_stamp = iTimeStamp;
   }
 
   inline unsigned getTimeStamp() const {
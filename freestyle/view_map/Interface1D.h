@@ -206,7 +206,7 @@ public:
   }
   
   /*! Sets the time stamp for the 1D element. */
-  inline void setTimeStamp(unsigned iTimeStamp){
+  virtual void setTimeStamp(unsigned iTimeStamp){
     _timeStamp = iTimeStamp;
   }
 
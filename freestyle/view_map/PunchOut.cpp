@@ -1,6 +1,9 @@
 #include <assert.h>
 
 #include <map>
+#ifdef _OPENMP
+# include <omp.h>
+#endif
 
 #include "ViewMapBuilder.h"
 #include "PunchOut.h"
@@ -54,12 +57,14 @@ void ViewMapBuilder::ComputePunchOutRegions(WingedEdge & we, Grid * iGrid)
 
   vector<WFace*> startFaces;
 
+  for(vector<WShape*>::iterator wit = we.getWShapes().begin(); wit != we.getWShapes().end(); wit ++)
+    _ViewMap->allocateFacePOData(*wit);
+
   // =========== mark all inconsistent vertices/faces ================================
   for(vector<WShape*>::iterator wit = we.getWShapes().begin(); wit != we.getWShapes().end(); wit ++)
     for(vector<WFace*>::iterator fit = (*wit)->GetFaceList().begin(); fit != (*wit)->GetFaceList().end(); ++fit)
       {
-	FacePOData * fd = new FacePOData;
-	_ViewMap->setFacePOData(*fit,fd);
+	FacePOData * fd = _ViewMap->facePOData(*fit);
 
 	// find all faces containing inconsistent regions
 	for(int i=0;i<3;i++)
@@ -106,35 +111,67 @@ void ViewMapBuilder::ComputePunchOutRegions(WingedEdge & we, Grid * iGrid)
   // =============================== main loop of algorithm =================================
   //
 
-  // iterate over each inconsistent region
+  // The regions are found one after the other, so that each inconsistent region and punch-out
+  // region pair keeps a unique integer ID that does not depend on the number of threads: the
+  // order of the start faces. The punch-out flood fills, which do the cone/triangle
+  // intersections, are independent: they run in parallel, and their results are merged in
+  // region order afterwards.
+
+  vector<PunchOutRegion> regions;
+
+  {
+    // has this face been traversed for the punch-out region with the given index?
+    vector<int> POvisitIndex(_ViewMap->facePOData().size(), -1);
+
+    for(vector<WFace*>::iterator fit = startFaces.begin(); fit != startFaces.end(); ++fit)
+      {
+	if (_ViewMap->facePOData(*fit)->visitedForInconsistent)
+	  continue;
+
+	// flood fill the inconsistent region:
+	// visit all faces inside, determine the boundary, and add inconsistent faces to punchOutFaces
+	regions.push_back(PunchOutRegion());
+	FloodFillInconsistent(*fit, regions.back(), inconsistentNodes, regions.size()-1, POvisitIndex);
+      }
+  }
+
+  int regionIndex = regions.size();
+
+#pragma omp parallel
+  {
+    // same as above, for the regions filled by this thread
+    vector<int> POvisitIndex(_ViewMap->facePOData().size(), -1);
 
+#pragma omp for schedule(dynamic)
+    for(int r = 0; r < regionIndex; r++)
+      {
+	// flood fill the PunchOut side, to visit the rest of the punched-out faces
+	FloodFillPunchOut(regions[r], r, POvisitIndex, punchOutNodes);
+      }
+  }
 
-  int regionIndex = 0;   // each inconsistent region and punch-out region pair has a unique integer ID
-  for(vector<WFace*>::iterator fit = startFaces.begin(); fit != startFaces.end(); ++fit)
+  for(int r = 0; r < regionIndex; r++)
     {
-      if (_ViewMap->facePOData(*fit)->visitedForInconsistent)
-	continue;
-      
-      vector<InconsistentTri> inconsistentCones; // faces overlapping this inconsistent region
-      deque<WFace*> punchOutFaces;    // queue of faces to be visited for punchout
+      PunchOutRegion & region = regions[r];
 
-      // flood fill the inconsistent region:
-      // visit all faces inside, determine the boundary, and add inconsistent faces to punchOutFaces
-      bool smoothSilhouette = 
-	FloodFillInconsistent(*fit,inconsistentCones, punchOutFaces, inconsistentNodes, regionIndex);
+      for(vector<pair<WFace*,POBoundaryEdge*> >::iterator bit = region.POboundary.begin();
+	  bit != region.POboundary.end(); ++bit)
+	_ViewMap->facePOData(bit->first)->POboundary.push_back(bit->second);
 
-      // flood fill the PunchOut side, to visit the rest of the punched-out faces
-      FloodFillPunchOut(punchOutFaces, inconsistentCones, regionIndex, punchOutNodes);
+      // add the inconsistent triangle to the list of punch-out triangles, and vice versa
+      for(vector<pair<WFace*,WFace*> >::iterator sit = region.sources.begin(); sit != region.sources.end(); ++sit)
+	{
+	  _ViewMap->facePOData(sit->first)->sourceFaces.insert(sit->second);
+	  _ViewMap->facePOData(sit->second)->targetFaces.insert(sit->first);
+	}
 
       // make a visualization
-      //      if (regionIndex == debugRegionToShow || debugRegionToShow == -1 )
-      //	MakePunchOutRegionVisualization(inconsistentCones, inconsistentNodes, punchOutNodes, regionIndex);
+      //      if (r == debugRegionToShow || debugRegionToShow == -1 )
+      //	MakePunchOutRegionVisualization(region.inconsistentCones, inconsistentNodes, punchOutNodes, r);
 
-      for(vector<InconsistentTri>::iterator trit = inconsistentCones.begin(); 
-	  trit != inconsistentCones.end(); ++trit)
-	_ViewMap->addInconsistentTri(new InconsistentTri(*trit), regionIndex);
-
-      ++regionIndex;
+      for(vector<InconsistentTri>::iterator trit = region.inconsistentCones.begin(); 
+	  trit != region.inconsistentCones.end(); ++trit)
+	_ViewMap->addInconsistentTri(new InconsistentTri(*trit), r);
     }
 
   //  MakePunchOutFullVisualization(inconsistentNodes, punchOutNodes);
@@ -161,11 +198,12 @@ void ViewMapBuilder::ComputePunchOutRegions(WingedEdge & we, Grid * iGrid)
 
 
 
-bool ViewMapBuilder::FloodFillInconsistent(WFace * startFace,
-					   vector<InconsistentTri> & inconsistentCones,
-					   deque<WFace*> & punchOutFaces,
-					   NodeShape * debugPunchOutNodes, int regionIndex)
+bool ViewMapBuilder::FloodFillInconsistent(WFace * startFace, PunchOutRegion & region,
+					   NodeShape * debugPunchOutNodes, int regionIndex,
+					   vector<int> & POvisitIndex)
 {
+  vector<InconsistentTri> & inconsistentCones = region.inconsistentCones;
+  deque<WFace*> & punchOutFaces = region.punchOutFaces;
   deque<WFace*> activeSet;
 
   activeSet.push_back(startFace);
@@ -372,11 +410,11 @@ bool ViewMapBuilder::FloodFillInconsistent(WFace * startFace,
 	  // check if the opposing face may have punch-outs, add it to the punch-out flood fill
 	  if ( (Ainconsistent && !Aopp_inconsistent) || (Binconsistent && !Bopp_inconsistent) )
 	    {
-	      if (_ViewMap->facePOData(oppFace)->POvisitIndex != regionIndex)
+	      int & visitIndex = POvisitIndex[_ViewMap->facePODataIndex(oppFace)];
+	      if (visitIndex != regionIndex)
 		{		  
 		  punchOutFaces.push_back(oppFace);
-		  _ViewMap->facePOData(oppFace)->POvisitIndex = regionIndex;
-		  _ViewMap->facePOData(oppFace)->debugAge = 0;
+		  visitIndex = regionIndex;
 		}
 	    }
 	}
@@ -389,10 +427,16 @@ bool ViewMapBuilder::FloodFillInconsistent(WFace * startFace,
 
 
 
-void ViewMapBuilder::FloodFillPunchOut(deque<WFace*> & punchOutFaces, 
-				       vector<InconsistentTri> & inconsistentCones,
-				       int regionIndex, NodeShape * debugPunchOutNodes)
+// Only reads the FacePOData: the boundary edges and the source faces found are recorded in region.
+void ViewMapBuilder::FloodFillPunchOut(PunchOutRegion & region, int regionIndex,
+				       vector<int> & POvisitIndex, NodeShape * debugPunchOutNodes)
 {
+  vector<InconsistentTri> & inconsistentCones = region.inconsistentCones;
+  deque<WFace*> & punchOutFaces = region.punchOutFaces;
+
+  for(deque<WFace*>::iterator fit = punchOutFaces.begin(); fit != punchOutFaces.end(); ++fit)
+    POvisitIndex[_ViewMap->facePODataIndex(*fit)] = regionIndex;
+
   int nFaces =0;
   while(!punchOutFaces.empty())
     {
@@ -400,9 +444,7 @@ void ViewMapBuilder::FloodFillPunchOut(deque<WFace*> & punchOutFaces,
       WFace * face = punchOutFaces.front();
       punchOutFaces.pop_front();
 
-      FacePOData * fd = _ViewMap->facePOData(face);
-
-      assert(fd->POvisitIndex == regionIndex);
+      assert(POvisitIndex[_ViewMap->facePODataIndex(face)] == regionIndex);
       nFaces ++;
 
 
@@ -489,7 +531,7 @@ void ViewMapBuilder::FloodFillPunchOut(deque<WFace*> & punchOutFaces,
 	    {
 	      //	      assert( ((*eit).A - (*eit).B).norm() > 0.0001);
 	      (*eit)->POregionIndex = regionIndex;
-	      fd->POboundary.push_back(*eit);
+	      region.POboundary.push_back(pair<WFace*,POBoundaryEdge*>(face, *eit));
 	    }
 
 	  for(int e=0;e<3;e++)
@@ -497,8 +539,7 @@ void ViewMapBuilder::FloodFillPunchOut(deque<WFace*> & punchOutFaces,
 	      edgeIntersectsPO[e] = true;
 
 	  // add the inconsistent triangle to the list of punch-out triangles, and vice versa
-	  fd->sourceFaces.insert(sourceFace);
-	  _ViewMap->facePOData(sourceFace)->targetFaces.insert(face);
+	  region.sources.push_back(pair<WFace*,WFace*>(face, sourceFace));
 
 	  //	  fd->POregions.insert(regionIndex);
 
@@ -521,14 +562,11 @@ void ViewMapBuilder::FloodFillPunchOut(deque<WFace*> & punchOutFaces,
 	  // find neighboring face
 	  WFace * oppFace = face->GetBordingFace(e);
 	  
-	  if (oppFace == NULL || _ViewMap->facePOData(oppFace)->POvisitIndex == regionIndex)
+	  if (oppFace == NULL || POvisitIndex[_ViewMap->facePODataIndex(oppFace)] == regionIndex)
 	    continue;
 
 	  punchOutFaces.push_back(oppFace);
-	  _ViewMap->facePOData(oppFace)->POvisitIndex = regionIndex;
-	  int newAge = fd->debugAge + 1;
-	  if (_ViewMap->facePOData(oppFace)->debugAge >= newAge)
-	    _ViewMap->facePOData(oppFace)->debugAge = newAge;
+	  POvisitIndex[_ViewMap->facePODataIndex(oppFace)] = regionIndex;
 	}
     }
 
@@ -2273,10 +2311,10 @@ ViewMapBuilder::GenerateCuspRegionGeometry()
   typedef pair<WFace*,WFace*> FFPair;
   typedef pair<WVertex*,WFace*> VFPair;
 
-  for(map<WFace*,FacePOData*>::iterator fit = _ViewMap->facePOData().begin(); fit != 
+  for(vector<FacePOData>::iterator fit = _ViewMap->facePOData().begin(); fit != 
 	_ViewMap->facePOData().end(); ++fit)
-    for(vector<POBoundaryEdge*>::iterator bit = (*fit).second->POboundary.begin(); 
-	bit != (*fit).second->POboundary.end(); ++bit)
+    for(vector<POBoundaryEdge*>::iterator bit = fit->POboundary.begin(); 
+	bit != fit->POboundary.end(); ++bit)
       if ( (*bit)->sourceType == POBoundaryEdge::MESH_SIL)   // keep track of mesh-source edges only
 	{
 	  if (! (*bit)->isRealBoundary )
@@ -2580,8 +2618,7 @@ ViewMapBuilder::GenerateCuspRegionGeometry()
   // compute mean edge size:
   poGeom->ComputeMeanEdgeSize();
 
-  for(vector<WFace*>::iterator it = poGeom->GetFaceList().begin(); it != poGeom->GetFaceList().end(); ++it)
-    _ViewMap->setFacePOData(*it,new FacePOData());
+  _ViewMap->allocateFacePOData(poGeom);
 
   if (foundBoundaryCusp)
     printf("WARNING: PO BOUNDARY CUSPS FOUND.  IS THAT POSSIBLE?\n");
@@ -2776,7 +2813,7 @@ NonTVertex * findMatchingPOEndpoint(ViewMap * ioViewMap, Vec3r pt, WFace * incon
 
   ViewVertex * result = Aside ? ve2->A() : ve2->B();
 
-  assert(dynamic_cast<NonTVertex*>(result) != NULL);
+  assert(asNonTVertex(result) != NULL);
 
   return (NonTVertex*)result;
 }
@@ -3085,7 +3122,7 @@ void ViewMapBuilder::ComputePunchOutIntersections(ViewMap * ioViewMap)
 
   for(vector<ViewVertex*>::iterator vit = vvlist2.begin(); vit != vvlist2.end(); ++vit)
     {
-      NonTVertex * vv= dynamic_cast<NonTVertex*>(*vit);
+      NonTVertex * vv= asNonTVertex(*vit);
 
       if (vv == NULL)
 	continue;
@@ -3231,11 +3268,3 @@ void ViewMapBuilder::ComputePunchOutIntersections(ViewMap * ioViewMap)
 
   printf("Done computing punch-out intersection points\n");
 }
-
-
-
-FacePOData::~FacePOData()
-{
-  for(vector<POBoundaryEdge*>::iterator it = POboundary.begin(); it!=POboundary.end(); ++it)
-    delete *it;
-}
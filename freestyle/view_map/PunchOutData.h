@@ -0,0 +1,96 @@
+#ifndef __PUNCHOUTDATA_H__
+#define __PUNCHOUTDATA_H__
+
+// The punch-out records kept by the ViewMap, apart from the geometric predicates of PunchOut.h
+// so that ViewMap.h can hold them by value
+
+#include <vector>
+#include <set>
+
+using namespace std;
+
+#include "../winged_edge/WXEdge.h"
+
+struct POBoundaryEdge
+{
+  Vec3r A,B; // endpoints of the boundary segment
+
+  WFace * myFace;  // face on which this edge lies
+  WFace * sourceFace; // face on which the source "inconsistent" boundary lies
+
+  typedef enum { MESH_SIL, SMOOTH_SIL, DEPTH_CLIPPING } SourceType;
+
+  SourceType sourceType;
+
+  bool isRealBoundary; // is this edge a boundary separating PO region from valid region?
+  // the fake ones are only kept around for debugging/visualization
+  
+  // ---- the following variables are used only for PO surface generation ----
+  //      only for MESH_SIL sources that are real boundaries
+  //      could have two versions of this class to save memory
+
+  int POregionIndex;   // index of the region that this edge came from
+
+  Vec3r Asrc, Bsrc; // source locations (3D points on "sourceFace" that project to A and B)
+
+  // topological information:
+  // each of the endpoints A and B may "come from" exactly one of the following sources:
+  //    (a) Vertex of "sourceFace"
+  //    (b) edge on "myFace"
+  //    (c) clipping
+  //    (d) point on edge of "sourceFace"
+  // The following variables store topological information about the sources of A and B
+
+  WVertex * AsrcVert, * BsrcVert;  // source vertices, or NULL if none
+  int srcFaceEdge; // index of edge (Asrc,Bsrc) on source face, or -1
+  int Aedge, Bedge; // index of edges that A and B lie on in myFace, or -1;
+  bool isAdegen,isBdegen;   // true if this is a mesh sil, and srcVert is a vertex on BOTH faces
+  // degeneracy should only correspond to cusps, I think.
+  // I don't think B can be degenerate, but not sure. (this comment might be old)
+  bool isAclipPoint, isBclipPoint; // is this endpoint due to clipping?
+  // don't know yet if I'll use this variable, but it's helpful for debugging, at the very least
+
+  POBoundaryEdge(Vec3r a, Vec3r b, WFace * myf, WFace * src, SourceType st, bool rb,
+		 WVertex * Asv, WVertex * Bsv, Vec3r viewpoint, int e, int Ae, int Be,
+		 bool Aclip,bool Bclip);
+
+  bool projectPoint(Vec3r srcPoint, Vec3r viewpoint, Vec3r & projection);
+
+  void print();
+};
+
+struct FacePOData
+{
+  int inconsistentRegion; //if this face contains inconsistency, index of that region, or -1
+  bool inconsistentVertex[3]; // which vertices are inconsistent
+  bool visitedForInconsistent;  // has this face been traversed as an inconsistent face yet?
+
+  set<WFace*> sourceFaces;  // faces containing silhouettes that generated punchoutedges on this face
+  set<WFace*> targetFaces;  // faces that contain punch-out boundary due to silhouettes in this face
+  //  set<int> POregions; // PO regions overlapping this triangle. for visualization only.
+
+  vector<POBoundaryEdge*> POboundary;  // ONLY for boundary pieces that are the projection of mesh silhouettes. this comment might be wrong...
+                                       // (deleted by the ViewMap, which stores the FacePOData by value)
+
+  // these variables are added as precomputation just to make IsInconsistent more efficient
+  bool hasSilhouette;
+  Vec3r silPt1, silPt2;  // two points on the smooth silhouette
+
+  // ----------------------- methods --------------------------
+
+  FacePOData()
+  { 
+    //  debugLastCrossOverRegion = -1; 
+    inconsistentRegion = -1;
+    visitedForInconsistent = false;
+    inconsistentVertex[0] = inconsistentVertex[1] = inconsistentVertex[2] = false;
+    hasSilhouette = false;
+    //    debugAge = -1;
+    //    regionIndex[0] = regionIndex[1] = regionIndex[2] = -1;
+  }; 
+
+  bool hasSourceFace(WFace *src)  {  return sourceFaces.find(src) != sourceFaces.end(); };
+  bool hasTargetFace(WFace *tgt)  {  return targetFaces.find(tgt) != targetFaces.end(); };
+};
+
+#endif
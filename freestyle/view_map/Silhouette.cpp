@@ -48,11 +48,11 @@ ViewVertex * SVertex::castToViewVertex(){
 }
 
 NonTVertex * SVertex::castToNonTVertex(){
-  return dynamic_cast<NonTVertex*>(_pViewVertex);
+  return asNonTVertex(_pViewVertex);
 }
 
 TVertex * SVertex::castToTVertex(){
-  return dynamic_cast<TVertex*>(_pViewVertex);
+  return asTVertex(_pViewVertex);
 }
 
 float SVertex::shape_importance() const 
@@ -153,7 +153,7 @@ FEdge* SVertex::getFEdge(Interface0D& inter)
   {
     SVertex *brother;
     ViewVertex *vvertex = viewvertex();
-    TVertex * tvertex = dynamic_cast<TVertex*>(vvertex);
+    TVertex * tvertex = asTVertex(vvertex);
     if(tvertex)
     {
       brother = tvertex->frontSVertex();
@@ -174,7 +174,7 @@ FEdge* SVertex::getFEdge(Interface0D& inter)
   {
     SVertex *brother;
     ViewVertex *vvertex = iVertexB->viewvertex();
-    TVertex * tvertex = dynamic_cast<TVertex*>(vvertex);
+    TVertex * tvertex = asTVertex(vvertex);
     if(tvertex)
     {
       brother = tvertex->frontSVertex();
@@ -598,8 +598,8 @@ void SShape::SplitEdge(FEdge *fe, const vector<Vec2r>& iParameters, vector<FEdge
       if (fe->getNature() & Nature::ALL_INTERSECTION)
 	{
 	  newEdge = new FEdgeIntersection((*sv), svB);
-	  FEdgeIntersection * se = dynamic_cast<FEdgeIntersection*>(newEdge);
-	  FEdgeIntersection * fes = dynamic_cast<FEdgeIntersection*>(fe);
+	  FEdgeIntersection * se = asFEdgeIntersection(newEdge);
+	  FEdgeIntersection * fes = asFEdgeIntersection(fe);
 	  se->SetMaterialIndex(fes->materialIndex());
 	  se->SetFaces(fes->getFace1(), fes->getFace2());
 
@@ -617,13 +617,13 @@ void SShape::SplitEdge(FEdge *fe, const vector<Vec2r>& iParameters, vector<FEdge
       else
       if(fe->isSmooth()){
         newEdge = new FEdgeSmooth((*sv), svB);
-        FEdgeSmooth * se = dynamic_cast<FEdgeSmooth*>(newEdge);
-        FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(fe);
+        FEdgeSmooth * se = asFEdgeSmooth(newEdge);
+        FEdgeSmooth * fes = asFEdgeSmooth(fe);
         se->SetMaterialIndex(fes->materialIndex());
       }else{
         newEdge = new FEdgeSharp((*sv), svB);
-        FEdgeSharp * se = dynamic_cast<FEdgeSharp*>(newEdge);
-        FEdgeSharp * fes = dynamic_cast<FEdgeSharp*>(fe);
+        FEdgeSharp * se = asFEdgeSharp(newEdge);
+        FEdgeSharp * fes = asFEdgeSharp(fe);
         se->SetaMaterialIndex(fes->aMaterialIndex());
         se->SetbMaterialIndex(fes->bMaterialIndex());
 	se->SetEdge(fes->edge());
@@ -684,8 +684,8 @@ FEdge* SShape::SplitEdgeIn2(FEdge* ioEdge, SVertex * ioNewVertex)
       if (ioEdge->getNature() & Nature::ALL_INTERSECTION)
 	{
 	  newEdge = new FEdgeIntersection(ioNewVertex, B);
-	  FEdgeIntersection * se = dynamic_cast<FEdgeIntersection*>(newEdge);
-	  FEdgeIntersection * fes = dynamic_cast<FEdgeIntersection*>(ioEdge);
+	  FEdgeIntersection * se = asFEdgeIntersection(newEdge);
+	  FEdgeIntersection * fes = asFEdgeIntersection(ioEdge);
 	  se->SetMaterialIndex(fes->materialIndex());
 	  se->SetFaces(fes->getFace1(), fes->getFace2());
 
@@ -699,14 +699,14 @@ FEdge* SShape::SplitEdgeIn2(FEdge* ioEdge, SVertex * ioNewVertex)
 	}else
       if(ioEdge->isSmooth()){
         newEdge = new FEdgeSmooth(ioNewVertex, B);
-        FEdgeSmooth * se = dynamic_cast<FEdgeSmooth*>(newEdge);
-        FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(ioEdge);
+        FEdgeSmooth * se = asFEdgeSmooth(newEdge);
+        FEdgeSmooth * fes = asFEdgeSmooth(ioEdge);
         se->SetMaterialIndex(fes->materialIndex());
 	se->SetFace(fes->face());
       }else{
         newEdge = new FEdgeSharp(ioNewVertex, B);
-        FEdgeSharp * se = dynamic_cast<FEdgeSharp*>(newEdge);
-        FEdgeSharp * fes = dynamic_cast<FEdgeSharp*>(ioEdge);
+        FEdgeSharp * se = asFEdgeSharp(newEdge);
+        FEdgeSharp * fes = asFEdgeSharp(ioEdge);
         se->SetaMaterialIndex(fes->aMaterialIndex());
         se->SetbMaterialIndex(fes->bMaterialIndex());
 	se->SetEdge(fes->edge());
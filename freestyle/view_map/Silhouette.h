@@ -42,6 +42,7 @@
 # include "../scene_graph/Material.h"
 # include "../geometry/Polygon.h"
 # include "../system/Exception.h"
+# include "../system/Arena.h"
 # include "Interface0D.h"
 # include "Interface1D.h"
 # include "../winged_edge/Curvature.h"
@@ -68,7 +69,7 @@ class ViewVertex;
 class SShape;
 
 /*! Class to define a vertex of the embedding. */
-class LIB_VIEW_MAP_EXPORT SVertex : public Interface0D
+class LIB_VIEW_MAP_EXPORT SVertex : public Interface0D, public ArenaObject
 {
 public: // Implementation of Interface0D
 
@@ -382,7 +383,7 @@ class ViewEdge;
  *  version since their properties slightly vary from
  *  one to the other.
  */
-class LIB_VIEW_MAP_EXPORT FEdge : public Interface1D
+class LIB_VIEW_MAP_EXPORT FEdge : public Interface1D, public ArenaObject
 {
 public: // Implementation of Interface0D
 
@@ -407,6 +408,9 @@ public: // Implementation of Interface0D
 
 public:
 
+  /*! Exact class of an FEdge, see edgeType() */
+  typedef enum { FEDGE, SHARP, SMOOTH, INTERSECTION } EdgeType;
+
   // An edge can only be of one kind (SILHOUETTE or BORDER, etc...)
   // For an multi-nature edge there must be several different FEdge.
    // DEBUG:
@@ -435,6 +439,7 @@ protected:
   bool _occludeeEmpty;
 
   bool _isSmooth;
+  EdgeType _Type; // set by the constructor of each class
 
   WVertex * _visSource; // for debugging region-based visibility: the vertex that this fedge got it's
   // visibility vote from.
@@ -454,6 +459,7 @@ public:
     //_hasVisibilityPoint=false;
     _occludeeEmpty = true;
     _isSmooth = false;
+    _Type = FEDGE;
     _visSource = NULL;
   }
   /*! Builds an FEdge going from vA to vB. */  
@@ -468,6 +474,7 @@ public:
     //_hasVisibilityPoint=false;
     _occludeeEmpty = true;
     _isSmooth = false;
+    _Type = FEDGE;
     _visSource = NULL;
   }
   /*! Copy constructor */
@@ -486,6 +493,7 @@ public:
     _aFace = iBrother._aFace;
     _occludeeEmpty = iBrother._occludeeEmpty;
     _isSmooth = iBrother._isSmooth;
+    _Type = iBrother._Type;
     iBrother.userdata = this;
     userdata = 0;
     _visSource = iBrother._visSource;
@@ -534,6 +542,8 @@ public:
   inline bool getOccludeeEmpty() { return _occludeeEmpty; }
   /*! Returns true if this FEdge is a smooth FEdge. */
   inline bool isSmooth() const {return _isSmooth;}
+  /*! Returns the class of the FEdge, without RTTI. See also asFEdgeSharp, asFEdgeSmooth and asFEdgeIntersection. */
+  inline EdgeType edgeType() const {return _Type;}
   inline WVertex * visSource() const { return _visSource; }
 
   /* modifiers */
@@ -838,12 +848,14 @@ protected:
 public:
   /*! Default constructor. */
   inline FEdgeSharp() : FEdge(){
+    _Type = SHARP;
     _aMaterialIndex = _bMaterialIndex = 0;
     _edge = NULL;
     //    _faceA =_faceB = NULL;
   }
   /*! Builds an FEdgeSharp going from vA to vB. */ 
   inline FEdgeSharp(SVertex *vA, SVertex *vB) : FEdge(vA, vB){
+    _Type = SHARP;
     _aMaterialIndex = _bMaterialIndex = 0;
     _edge = NULL;
     //    _faceA = _faceB = NULL;
@@ -936,12 +948,14 @@ public:
     _Face=0;
     _MaterialIndex = 0;
     _isSmooth = true;
+    _Type = SMOOTH;
   }
   /*! Builds an FEdgeSmooth going from vA to vB. */  
   inline FEdgeSmooth(SVertex *vA, SVertex *vB) : FEdge(vA, vB){
     _Face=0;
     _MaterialIndex = 0;
     _isSmooth = true;
+    _Type = SMOOTH;
 
   }
   /*! Copy constructor. */
@@ -987,9 +1001,9 @@ protected:
   WFace * _face2; 
 
 public:
-  inline FEdgeIntersection() : FEdgeSmooth() { _face1 = _face2 = NULL; };
+  inline FEdgeIntersection() : FEdgeSmooth() { _face1 = _face2 = NULL; _Type = INTERSECTION; };
   inline FEdgeIntersection(SVertex *vA, SVertex *vB) : FEdgeSmooth(vA, vB)
-  { _face1 = _face2 = NULL; }
+  { _face1 = _face2 = NULL; _Type = INTERSECTION; }
   inline FEdgeIntersection(FEdgeIntersection & fei) : FEdgeSmooth(fei) 
   { _face1 = fei._face1; _face2 = fei._face2; _isSmooth = false; };
   virtual ~FEdgeIntersection() { };
@@ -999,6 +1013,20 @@ public:
   inline void SetFaces(WFace * f1, WFace * f2) { _face1 = f1; _face2 = f2; }
 };
 
+/*! Replacements of dynamic_cast on FEdges, based on FEdge::edgeType():
+ *  they return NULL when fe is not of the class, or of one of its subclasses.
+ */
+inline FEdgeSharp * asFEdgeSharp(FEdge *fe) {
+  return (fe && fe->edgeType() == FEdge::SHARP) ? static_cast<FEdgeSharp*>(fe) : NULL;
+}
+inline FEdgeSmooth * asFEdgeSmooth(FEdge *fe) {
+  return (fe && (fe->edgeType() == FEdge::SMOOTH || fe->edgeType() == FEdge::INTERSECTION))
+    ? static_cast<FEdgeSmooth*>(fe) : NULL;
+}
+inline FEdgeIntersection * asFEdgeIntersection(FEdge *fe) {
+  return (fe && fe->edgeType() == FEdge::INTERSECTION) ? static_cast<FEdgeIntersection*>(fe) : NULL;
+}
+
 
 class POBoundaryEdge;
 
@@ -1034,7 +1062,7 @@ public:
 /*! Class to define a feature shape. It is the gathering 
  *  of feature elements from an identified input shape
  */
-class LIB_VIEW_MAP_EXPORT SShape
+class LIB_VIEW_MAP_EXPORT SShape : public ArenaObject
 {
 private:
   vector<FEdge*> _chains;          // list of fedges that are chains starting points.
@@ -97,11 +97,13 @@ ViewMap::~ViewMap()
     for(vector<DebugPoint*>::iterator dp=_debugPoints.begin(); dp != _debugPoints.end(); ++dp)
         delete *dp;
 
-    // deallocate facedata
-    for(map<WFace*,FacePOData*>::iterator mfit = _facePOData.begin(); mfit != _facePOData.end(); mfit++)
-        delete (*mfit).second;
-    
+    // deallocate facedata (the boundary edges are owned by the face that they punch out)
+    for(vector<FacePOData>::iterator fdit = _facePOData.begin(); fdit != _facePOData.end(); fdit++)
+        for(vector<POBoundaryEdge*>::iterator it = fdit->POboundary.begin(); it != fdit->POboundary.end(); ++it)
+            delete *it;
+
     _facePOData.clear();
+    _facePOOffset.clear();
 
     for(multimap<int,InconsistentTri*>::iterator trit = _inconsistentTris.begin(); trit != _inconsistentTris.end(); ++trit)
         delete (*trit).second;
@@ -113,6 +115,8 @@ ViewMap::~ViewMap()
     _VEdges.clear();
 
     _pInstance = NULL;
+
+    // the memory of the entities allocated in _arena is released with it, after this
 }
 
 ViewShape * ViewMap::viewShape(unsigned id) 
@@ -120,6 +124,53 @@ ViewShape * ViewMap::viewShape(unsigned id)
     int index = _shapeIdToIndex[id];
     return _VShapes[ index ];
 }
+// marks of the thread, see ViewEdgeMarks::setThreadMarks
+static ViewEdgeMarks *threadViewEdgeMarks = NULL;
+#pragma omp threadprivate(threadViewEdgeMarks)
+
+unsigned ViewEdgeMarks::_count = 0;
+
+ViewEdgeMarks::ViewEdgeMarks(ViewMap *vm)
+{
+    ++_count;
+    ViewMap::viewedges_container& edges = vm->ViewEdges();
+    timeStamps.resize(edges.size());
+    chainingTimeStamps.resize(edges.size());
+    for(unsigned i=0; i<edges.size(); i++)
+    {
+        edges[i]->_marksIndex = i;
+        timeStamps[i] = edges[i]->_timeStamp;
+        chainingTimeStamps[i] = edges[i]->_ChainingTimeStamp;
+    }
+}
+
+ViewEdgeMarks::~ViewEdgeMarks()
+{
+    --_count;
+}
+
+void ViewEdgeMarks::apply(ViewMap *vm) const
+{
+    ViewMap::viewedges_container& edges = vm->ViewEdges();
+    for(unsigned i=0; i<edges.size(); i++)
+    {
+        if (timeStamps[i] > edges[i]->_timeStamp)
+            edges[i]->_timeStamp = timeStamps[i];
+        if (chainingTimeStamps[i] > edges[i]->_ChainingTimeStamp)
+            edges[i]->_ChainingTimeStamp = chainingTimeStamps[i];
+    }
+}
+
+ViewEdgeMarks * ViewEdgeMarks::threadMarks()
+{
+    return threadViewEdgeMarks;
+}
+
+void ViewEdgeMarks::setThreadMarks(ViewEdgeMarks *iMarks)
+{
+    threadViewEdgeMarks = iMarks;
+}
+
 void  ViewMap::AddViewShape(ViewShape *iVShape) {
     _shapeIdToIndex[iVShape->getId().getFirst()] = _VShapes.size();
     _VShapes.push_back(iVShape);
@@ -1140,8 +1191,8 @@ void ViewMap::MergeNonTVertices(NonTVertex * ntv1, NonTVertex * ntv2)
 
 void ViewMap::MergeVertices(ViewVertex * v1, ViewVertex * v2)
 {
-    NonTVertex * ntv1 = dynamic_cast<NonTVertex*>(v1);
-    NonTVertex * ntv2 = dynamic_cast<NonTVertex*>(v2);
+    NonTVertex * ntv1 = asNonTVertex(v1);
+    NonTVertex * ntv2 = asNonTVertex(v2);
 
     // save time by using the functions I've already written
     if (ntv1 != NULL && ntv2 != NULL)
@@ -1152,8 +1203,8 @@ void ViewMap::MergeVertices(ViewVertex * v1, ViewVertex * v2)
         return;
     }
 
-    TVertex * tv1 = dynamic_cast<TVertex*>(v1);
-    TVertex * tv2 = dynamic_cast<TVertex*>(v2);
+    TVertex * tv1 = asTVertex(v1);
+    TVertex * tv2 = asTVertex(v2);
 
     if (tv1 != NULL && tv2 != NULL)
     {
@@ -1307,7 +1358,7 @@ TVertex * ViewMap::MergeSNonTVertices(SVertex *silSV, NonTVertex * ntv)
     {
         //      TVertex * debugNTV = dynamic_cast<TVertex*>(oldSilNTV);
 
-        assert(dynamic_cast<NonTVertex*>(silSV->viewvertex())!=NULL);
+        assert(asNonTVertex(silSV->viewvertex())!=NULL);
         oldSilNTV = (NonTVertex*)silSV->viewvertex();
     }
 
@@ -1801,8 +1852,8 @@ void ViewShape::SplitEdge(ViewVertex * newVertex, ViewEdge * vEdge, ViewEdge * &
                           bool isFront) // for TVertices only: is this edge in front?
 // this is based on the above SplitEdge procedures, but it's much simpler since we're splitting at an existing vertex, and no new FEdges are being created.
 {
-    TVertex * tvert = dynamic_cast<TVertex*>(newVertex);
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(newVertex);
+    TVertex * tvert = asTVertex(newVertex);
+    NonTVertex * ntv = asNonTVertex(newVertex);
 
     SVertex * sv;
 
@@ -2054,12 +2105,12 @@ bool has_key(const vector<T> & vec,T key)
 
 bool hasVertex(ViewVertex * vv, SVertex *sv)
 {
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(vv);
+    NonTVertex * ntv = asNonTVertex(vv);
 
     if (ntv != NULL)
         return ntv->svertex() == sv;
 
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     assert(tv != NULL);
     return sv == tv->frontSVertex() || sv == tv->backSVertex();
 }
@@ -2067,7 +2118,7 @@ bool hasVertex(ViewVertex * vv, SVertex *sv)
 bool hasEdge(ViewVertex *vv, ViewEdge *ve)
 {
     assert( vv != NULL && ve != NULL );
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(vv);
+    NonTVertex * ntv = asNonTVertex(vv);
     if (ntv != NULL)
     {
         for(NonTVertex::edges_container::iterator it = ntv->viewedges().begin(); it != ntv->viewedges().end(); ++it)
@@ -2075,7 +2126,7 @@ bool hasEdge(ViewVertex *vv, ViewEdge *ve)
                 return true;
         return false;
     }
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     assert(tv != NULL);
     return tv->frontEdgeA().first == ve || tv->frontEdgeB().first == ve ||
             tv->backEdgeA().first == ve || tv->backEdgeB().first == ve;
@@ -2084,7 +2135,7 @@ bool hasEdge(ViewVertex *vv, ViewEdge *ve)
 bool hasEdgeTwice(ViewVertex *vv, ViewEdge *ve)
 {
     assert( vv != NULL && ve != NULL );
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(vv);
+    NonTVertex * ntv = asNonTVertex(vv);
     if (ntv != NULL)
     {
         int n = 0;
@@ -2093,7 +2144,7 @@ bool hasEdgeTwice(ViewVertex *vv, ViewEdge *ve)
                 n++;
         return n == 2;
     }
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     assert(tv != NULL);
     int n = 0;
     if (tv->frontEdgeA().first == ve)
@@ -2149,7 +2200,7 @@ bool hasFEdge(ViewEdge* ve, FEdge *fe)
 
 void checkVertex(ViewVertex * vv)
 {
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     if (tv != NULL)
     {
         assert(tv->numEdges() >= 1);
@@ -2221,7 +2272,7 @@ void checkVertex(ViewVertex * vv)
     }
 
 
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(vv);
+    NonTVertex * ntv = asNonTVertex(vv);
     assert(ntv != NULL);
     if (ntv->svertex()->viewvertex() != ntv)
         printf("ntv: %08X\n",ntv);
@@ -2311,13 +2362,13 @@ void ViewMap::checkPointers(const char * stepName,bool forceCheck)
       // make sure we're not missing an fedges we should have
       if (sv->viewvertex() != NULL)
     {
-      TVertex * tv = dynamic_cast<TVertex*>(sv->viewvertex());
+      TVertex * tv = asTVertex(sv->viewvertex());
       if (tv != NULL)
         {
 
 
         }
-      NonTVertex * nvt = dynamic_cast<NonTVertex*>(sv->viewvertex());
+      NonTVertex * nvt = asNonTVertex(sv->viewvertex());
       if (ntv != NULL)
         {
 
@@ -2392,6 +2443,7 @@ DebugPoint * ViewMap::addDebugPoint(DebugPoint::PointType ptType, Vec3r point3D,
     dp->RIFpoint = false;
     dp->debugString = NULL;
 
+#pragma omp critical(debugPoints)
     _debugPoints.push_back(dp);
 
     return dp;
@@ -2413,6 +2465,7 @@ DebugPoint * ViewMap::addDebugPoint(DebugPoint::PointType ptType, Vec3r point3D,
     dp->RIFpoint = false;
     dp->debugString = NULL;
 
+#pragma omp critical(debugPoints)
     _debugPoints.push_back(dp);
 
     return dp;
@@ -2431,9 +2484,23 @@ void ViewMap::addRIFDebugPoint(DebugPoint::PointType ptType, Vec3r point3D, char
     dp->debugString = debugString;
     dp->radialCurvature = radialCurvature;
 
+#pragma omp critical(debugPoints)
     _debugPoints.push_back(dp);
 }
 
+void ViewMap::allocateFacePOData(WShape * iShape)
+{
+    vector<WFace*> & faces = iShape->GetFaceList();
+
+    assert(_facePOOffset.find(iShape) == _facePOOffset.end());
+    _facePOOffset[iShape] = _facePOData.size();
+
+    for(unsigned i = 0; i < faces.size(); i++)
+        assert(faces[i]->GetId() == i);
+
+    _facePOData.resize(_facePOData.size() + faces.size());
+}
+
 
 
 void ViewMap::render3D(bool selectionMode, DebugVisOptions options)
@@ -2487,7 +2554,7 @@ void ViewMap::render3D(bool selectionMode, DebugVisOptions options)
                            ve->inconsistentVisibility() ? "true" : "false",
                            ve->visVotes, ve->invisVotes,
                            arcLength);
-                    FEdgeSharp* feAs = dynamic_cast<FEdgeSharp*>(feA);
+                    FEdgeSharp* feAs = asFEdgeSharp(feA);
                     if(feAs && feAs->edge()->nearerFace)
                         printf("Nearer face: %08X\n",feAs->edge()->nearerFace);
 
@@ -2564,7 +2631,7 @@ void ViewMap::render3D(bool selectionMode, DebugVisOptions options)
       for(int i=0;i<2;i++)
         {
           ViewVertex * vv = (i == 0 ? ve->A() : ve->B());
-          TVertex * tv = dynamic_cast<TVertex*>(vv);
+          TVertex * tv = asTVertex(vv);
 
           if (tv == NULL)
         continue;
@@ -2730,8 +2797,8 @@ void ViewMap::render3D(bool selectionMode, DebugVisOptions options)
 
         for(vector<ViewVertex*>::iterator it = _VVertices.begin(); it != _VVertices.end(); ++it)
         {
-            TVertex * tv = dynamic_cast<TVertex*>(*it);
-            NonTVertex * ntv = dynamic_cast<NonTVertex*>(*it);
+            TVertex * tv = asTVertex(*it);
+            NonTVertex * ntv = asNonTVertex(*it);
 
             int name = getName(*it);
 
@@ -2845,10 +2912,9 @@ void ViewMap::render3D(bool selectionMode, DebugVisOptions options)
         }
 
         // draw the boundaries
-        for(map<WFace*,FacePOData*>::iterator poit=_facePOData.begin(); poit!=_facePOData.end();++poit)
+        for(vector<FacePOData>::iterator poit=_facePOData.begin(); poit!=_facePOData.end();++poit)
         {
-            WFace * face = (*poit).first;
-            FacePOData * data = (*poit).second;
+            FacePOData * data = &(*poit);
 
             for(vector<POBoundaryEdge*>::iterator pobit=data->POboundary.begin();
                 pobit != data->POboundary.end(); ++pobit)
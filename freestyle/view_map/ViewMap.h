@@ -32,10 +32,12 @@
 
 # include "../system/BaseIterator.h"
 # include "../system/FreestyleConfig.h"
+# include "../system/Arena.h"
 # include "../geometry/GeomUtils.h"
 # include "Interface0D.h"
 # include "Interface1D.h"
 # include "Silhouette.h" // defines the embedding
+# include "PunchOutData.h"
 # include <map>
 # include <assert.h>
 
@@ -59,8 +61,8 @@ class ViewVertex;
 class ViewEdge;
 class ViewShape;
 class TVertex;
+class NonTVertex;
 struct DebugVisOptions;
-struct FacePOData;
 struct InconsistentTri;
 
 struct DebugPoint
@@ -111,9 +113,11 @@ private:
   id_to_index_map _shapeIdToIndex; // Mapping between the WShape or VShape id to the VShape index in the 
                                 // _VShapes vector. Used in the method viewShape(int id) to access a shape from its id.
   vector<DebugPoint*> _debugPoints;
-  map<WFace*,FacePOData*> _facePOData;  // maybe this should just be pointed to from the faces?
+  vector<FacePOData> _facePOData;  // punch-out data of all faces, see allocateFacePOData
+  map<WShape*,unsigned> _facePOOffset;  // index in _facePOData of the first face of each shape
   multimap<int,InconsistentTri*> _inconsistentTris;
   vector<pair<WFace*,Vec3r> > _poCuspFaces;
+  Arena _arena; // memory of the entities created under an Arena::Scope on it, released after ~ViewMap
 
   //  visregion_container _visRegions;
 
@@ -168,6 +172,17 @@ public:
   /*! Returns the scene 3D bounding box. */
   inline BBox<Vec3r> getScene3dBBox() const {return _scene3DBBox;}
 
+  /*! The arena holding the shapes, edges and vertices of this view map
+   *  that were created under an Arena::Scope on it (see ViewMapBuilder::BuildViewMap).
+   *  They are still deleted one by one, but their memory is only given back
+   *  once the ViewMap is destroyed.
+   *  There is no index-based copy of the topology: ViewMapIO already
+   *  writes indices through userdata, and chaining and the cleanup passes
+   *  need the front/back order of the TVertex edges, which such a copy
+   *  would have to duplicate and keep in step with the pointers.
+   */
+  inline Arena& arena() {return _arena;}
+
   /* modifiers */
   void AddViewShape(ViewShape *iVShape);
   inline void AddViewEdge(ViewEdge *iVEdge) {_VEdges.push_back(iVEdge);}
@@ -242,9 +257,18 @@ public:
 
   void addCuspFace(WFace * f, Vec3r color) { _poCuspFaces.push_back(pair<WFace*,Vec3r>(f,color)); }
 
-  FacePOData * facePOData(WFace * f) { assert(_facePOData.find(f) != _facePOData.end()); return _facePOData[f]; }
-  void setFacePOData(WFace *f, FacePOData * data) { _facePOData[f] = data; }
-  map<WFace*,FacePOData*> & facePOData() { return _facePOData; }
+  /*! Adds default punch-out data for each face of iShape. The data of the faces of a shape
+   *  are contiguous, in the order of its face list (the face ids). Adding a shape may move
+   *  the data of the other shapes. */
+  void allocateFacePOData(WShape * iShape);
+  FacePOData * facePOData(WFace * f) {
+    map<WShape*,unsigned>::const_iterator it = _facePOOffset.find(f->getShape());
+    assert(it != _facePOOffset.end() && it->second + f->GetId() < _facePOData.size());
+    return &_facePOData[it->second + f->GetId()];
+  }
+  /*! index of the data of f in facePOData() */
+  unsigned facePODataIndex(WFace * f) { return facePOData(f) - &_facePOData[0]; }
+  vector<FacePOData> & facePOData() { return _facePOData; }
 
   void addInconsistentTri(InconsistentTri * tri, int regionIndex) 
   { _inconsistentTris.insert(pair<int,InconsistentTri*>(regionIndex, tri)); }
@@ -287,7 +311,7 @@ namespace ViewVertexInternal {
  *  Thus, this class can be specialized into two classes,
  *  the TVertex class and the NonTVertex class.
  */
-class LIB_VIEW_MAP_EXPORT ViewVertex : public Interface0D
+class LIB_VIEW_MAP_EXPORT ViewVertex : public Interface0D, public ArenaObject
 {
 public: // Implementation of Interface0D
 
@@ -308,6 +332,7 @@ public:
 private:
 
   Nature::VertexNature _Nature;
+  bool _isTVertex; // class tag, unlike the nature it is never modified
 
 public:
   /*! A field that can be used by the user to store any data.
@@ -315,10 +340,11 @@ public:
    */
   void * userdata;
   /*! Default constructor.*/
-  inline ViewVertex() {userdata = 0;_Nature = Nature::VIEW_VERTEX; }
+  inline ViewVertex() {userdata = 0;_Nature = Nature::VIEW_VERTEX; _isTVertex = false; }
   inline ViewVertex(Nature::VertexNature nature) {
     userdata = 0;
     _Nature = Nature::VIEW_VERTEX | nature;
+    _isTVertex = (nature & Nature::T_VERTEX) != 0;
   }
 
 protected:
@@ -326,6 +352,7 @@ protected:
   inline ViewVertex(ViewVertex& iBrother)
   {
     _Nature = iBrother._Nature;
+    _isTVertex = iBrother._isTVertex;
     iBrother.userdata = this;
     userdata = 0;
   }
@@ -341,6 +368,9 @@ public:
   virtual Nature::VertexNature getNature() const {
     return _Nature;
   }
+  /*! Returns true for a TVertex, false for a NonTVertex, without RTTI.
+   *  See also asTVertex and asNonTVertex. */
+  inline bool isTVertex() const {return _isTVertex;}
 
   /* modifiers */
   /*! Sets the nature of the vertex. */
@@ -835,11 +865,48 @@ namespace ViewEdgeInternal {
   template<class Traits> class vertex_iterator_base ;
 } // end of namespace ViewEdgeInternal
 
+/*! Selection and chaining time stamps of all the ViewEdges of a ViewMap,
+ *  private to a thread. While a thread has marks (see setThreadMarks), the
+ *  time stamps it reads and writes on the ViewEdges go to its marks instead
+ *  of the edges, so that several style modules can select and chain the
+ *  same ViewMap at once (see Canvas::Draw).
+ */
+class LIB_VIEW_MAP_EXPORT ViewEdgeMarks
+{
+public:
+  /*! Copies the time stamps of the ViewEdges of vm. Numbers the
+   *  ViewEdges, so it must not be called while other marks are in use. */
+  ViewEdgeMarks(ViewMap *vm);
+  ~ViewEdgeMarks();
+
+  /*! Copies back to the ViewEdges of vm the time stamps more recent than
+   *  theirs, so that applying the marks of several layers in any order
+   *  leaves the edges as if the layers had run one after the other. */
+  void apply(ViewMap *vm) const;
+
+  /*! The marks of the calling thread, or NULL if it uses the ViewEdges' own time stamps */
+  static ViewEdgeMarks * threadMarks();
+  static void setThreadMarks(ViewEdgeMarks *iMarks);
+
+  /*! Same as threadMarks(), but does not look the thread up while no
+   *  marks exist, as when the layers run one after the other. Marks are
+   *  only created and deleted outside of parallel regions. */
+  static inline ViewEdgeMarks * current() {
+    return _count ? threadMarks() : 0;
+  }
+
+  vector<unsigned> timeStamps;
+  vector<unsigned> chainingTimeStamps;
+
+private:
+  static unsigned _count; // number of ViewEdgeMarks alive
+};
+
 /*! Class defining a ViewEdge. A ViewEdge in an edge
  *  of the image graph. it connnects two ViewVertex.
  *  It is made by connecting a set of FEdges.
  */
-class LIB_VIEW_MAP_EXPORT ViewEdge : public Interface1D
+class LIB_VIEW_MAP_EXPORT ViewEdge : public Interface1D, public ArenaObject
 {
 public: // Implementation of Interface0D
 
@@ -859,10 +926,26 @@ public: // Implementation of Interface0D
     return _Nature;
   }
 
+  /*! Returns the time stamp of the ViewEdge, or the one of the thread's ViewEdgeMarks */
+  virtual unsigned getTimeStamp() const {
+    ViewEdgeMarks *marks = ViewEdgeMarks::current();
+    return marks ? marks->timeStamps[_marksIndex] : _timeStamp;
+  }
+
+  /*! Sets the time stamp of the ViewEdge, or the one of the thread's ViewEdgeMarks */
+  virtual void setTimeStamp(unsigned iTimeStamp) {
+    ViewEdgeMarks *marks = ViewEdgeMarks::current();
+    if (marks)
+      marks->timeStamps[_marksIndex] = iTimeStamp;
+    else
+      _timeStamp = iTimeStamp;
+  }
+
 public:
   
   typedef SVertex vertex_type;
   friend class ViewShape;
+  friend class ViewEdgeMarks;
   // for ViewEdge iterator
   typedef ViewEdgeInternal::edge_iterator_base<Nonconst_traits<ViewEdge*> > edge_iterator;
   typedef ViewEdgeInternal::edge_iterator_base<Const_traits<ViewEdge*> > const_edge_iterator;
@@ -882,6 +965,7 @@ private:
   FEdge * _FEdgeB; // last edge of the embedded fedges chain
   Id _Id;
   unsigned _ChainingTimeStamp;
+  unsigned _marksIndex; // index in the ViewEdgeMarks, set by their constructor
   ViewShape *_aShape; // The silhouette view edge separates 2 2D spaces. The one on the left is 
   // necessarly the Shape _Shape (the one to which this edge belongs to)
   // and _aShape is the one on its right // NON GERE PAR LE COPY CONSTRUCTEUR
@@ -908,6 +992,7 @@ public:
     _FEdgeA = 0;
     _FEdgeB = 0;
     _ChainingTimeStamp = 0;
+    _marksIndex = 0;
     _qi = -1;
     _aShape=0;
     userdata = 0;
@@ -925,6 +1010,7 @@ public:
     _FEdgeB = 0;
     _Shape = 0;
     _ChainingTimeStamp = 0;
+    _marksIndex = 0;
     _aShape = 0;
     _qi = -1;
     userdata = 0;
@@ -942,6 +1028,7 @@ public:
     _FEdgeB = 0;
     _Shape = 0;
     _ChainingTimeStamp = 0;
+    _marksIndex = 0;
     _aShape = 0;
     _qi = -1;
     userdata = 0;
@@ -959,6 +1046,7 @@ public:
     _FEdgeB = iFEdgeB;
     _Shape = iShape;
     _ChainingTimeStamp = 0;
+    _marksIndex = 0;
     _aShape = 0;
     _qi = -1;
     userdata = 0;
@@ -981,6 +1069,7 @@ protected:
     _Shape = 0;
     _Id = iBrother._Id;
     _ChainingTimeStamp = iBrother._ChainingTimeStamp;
+    _marksIndex = 0;
     _aShape = iBrother._aShape;
     _qi = iBrother._qi;
     _splittingId = 0;
@@ -1045,7 +1134,10 @@ public:
     return false;
   }
   /*! Returns the time stamp of this ViewEdge. */
-  inline unsigned getChainingTimeStamp() {return _ChainingTimeStamp;}
+  inline unsigned getChainingTimeStamp() {
+    ViewEdgeMarks *marks = ViewEdgeMarks::current();
+    return marks ? marks->chainingTimeStamps[_marksIndex] : _ChainingTimeStamp;
+  }
   inline const ViewShape * aShape() const {return _aShape;}
   inline const ViewShape * bShape() const {return _Shape;}
   inline vector<ViewShape*>& occluders() {return _Occluders;}
@@ -1076,7 +1168,13 @@ public:
   /*! Sets the quantitative invisibility value. */
   inline void SetQI(int qi) {_qi = qi;}
   /*! Sets the time stamp value. */
-  inline void setChainingTimeStamp(unsigned ts) {_ChainingTimeStamp = ts;}
+  inline void setChainingTimeStamp(unsigned ts) {
+    ViewEdgeMarks *marks = ViewEdgeMarks::current();
+    if (marks)
+      marks->chainingTimeStamps[_marksIndex] = ts;
+    else
+      _ChainingTimeStamp = ts;
+  }
   inline void AddOccluder(ViewShape *iShape) {_Occluders.push_back(iShape);}
   inline void setSplittingId(Id * id) {_splittingId = id;}
 
@@ -1210,7 +1308,7 @@ public:
 /*! Class gathering the elements of the ViewMap (ViewVertex, ViewEdge)
  *  that are issued from the same input shape.
  */
-class LIB_VIEW_MAP_EXPORT ViewShape
+class LIB_VIEW_MAP_EXPORT ViewShape : public ArenaObject
 {
 private:
   vector<ViewVertex*> _Vertices;
@@ -1428,6 +1526,16 @@ public:
 };
 
 
+/*! Replacements of dynamic_cast on ViewVertices, based on ViewVertex::isTVertex():
+ *  they return NULL when vv is not of the class.
+ */
+inline TVertex * asTVertex(ViewVertex *vv) {
+  return (vv && vv->isTVertex()) ? static_cast<TVertex*>(vv) : NULL;
+}
+inline NonTVertex * asNonTVertex(ViewVertex *vv) {
+  return (vv && !vv->isTVertex()) ? static_cast<NonTVertex*>(vv) : NULL;
+}
+
 
 struct DebugVisOptions
 {
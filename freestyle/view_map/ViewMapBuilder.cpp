@@ -20,12 +20,17 @@
 
 
 #include <algorithm>
+#ifdef _OPENMP
+# include <omp.h>
+#endif
 #include "ViewMapBuilder.h"
 #include "../geometry/FastGrid.h"  // included as a workaround
+#include "../geometry/OccluderBVH.h"
 #include "../scene_graph/NodeGroup.h"
 #include "../scene_graph/NodeShape.h"
 #include "../scene_graph/VertexRep.h"
 #include "../scene_graph/LineRep.h"
+#include "../system/Stats.h"
 
 using namespace std;
 
@@ -114,6 +119,8 @@ real ArcLength2D(ViewEdge * ve, real maxLength)
 
 ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, real epsilon) {
     _ViewMap = new ViewMap;
+    // everything built below is allocated in the arena of the view map
+    Arena::Scope arenaScope(_ViewMap->arena());
     _currentId = 1;
     _currentFId = 0;
     _currentSVertexId = 0;
@@ -123,23 +130,39 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
 
     _ViewMap->checkPointers("init");
 
+    _Grid->finalizeOccluders();
+
     // Compute Punch-Out Regions
     if (iAlgo == punch_out)
-        ComputePunchOutRegions(we, _Grid);
+    {
+        {
+            StatsTimer timer("ComputePunchOutRegions");
+            ComputePunchOutRegions(we, _Grid);
+        }
+
+        // the cusp region geometry has been added to the occluders
+        _Grid->finalizeOccluders();
+    }
 
     _ViewMap->checkPointers("after ComputePunchOutRegions");
 
     // -------- computing intersections -------
 
     // compute surface intersection edges
-    computeSelfIntersections(we);
+    {
+        StatsTimer timer("computeSelfIntersections");
+        computeSelfIntersections(we);
+    }
 
     _ViewMap->checkPointers("after computeSelfIntersections");
 
     // ---------- building view edges ----------
 
     // Builds initial view edges (except for self-intersections)
-    computeInitialViewEdges(we);
+    {
+        StatsTimer timer("computeInitialViewEdges");
+        computeInitialViewEdges(we);
+    }
 
     _ViewMap->checkPointers("after computeInitialViewEdges");
 
@@ -156,27 +179,36 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
     // ---------- edge splitting --------------
 
     // Detects cusps
-    computeCusps(_ViewMap);
+    {
+        StatsTimer timer("computeCusps");
+        computeCusps(_ViewMap);
+    }
 
     _ViewMap->checkPointers("after computeCusps");
 
     // Compute remaining image-space curve intersections
-    ComputeCurveIntersections(_ViewMap, iAlgo, epsilon);
+    {
+        StatsTimer timer("ComputeCurveIntersections");
+        ComputeCurveIntersections(_ViewMap, iAlgo, epsilon);
+    }
 
     _ViewMap->checkPointers("after ComputeIntersections");
 
     // ---------- visibility -------------------
 
     // Compute visibility
-    ComputeEdgesVisibility(_ViewMap, we, iAlgo, _Grid, epsilon);
+    {
+        StatsTimer timer("ComputeEdgesVisibility");
+        ComputeEdgesVisibility(_ViewMap, we, iAlgo, _Grid, epsilon);
 
-    PropagateVisibilty(_ViewMap);
+        PropagateVisibilty(_ViewMap);
+    }
 
     printf("Check coherence of visibility\n");
     for(vector<ViewVertex*>::iterator vit = _ViewMap->ViewVertices().begin(); vit != _ViewMap->ViewVertices().end(); ++vit)
     {
         ViewVertex * vVertex = *vit;
-        TVertex* tVertex = dynamic_cast<TVertex*>(vVertex);
+        TVertex* tVertex = asTVertex(vVertex);
         if(tVertex!=NULL && tVertex->backEdgeA().first && tVertex->backEdgeB().first &&
                 tVertex->frontEdgeA().first && tVertex->frontEdgeB().first)
         {
@@ -204,7 +236,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                 if(visibleFont==1){
                     edge = tVertex->backEdgeB().first;
                     if(edge->B()->getNature() & Nature::CUSP){
-                        ntVertex = dynamic_cast<NonTVertex*>(edge->B());
+                        ntVertex = asNonTVertex(edge->B());
                         assert(ntVertex->viewedges().size() == 2);
                         mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                         if(mate->qi() == 0){
@@ -213,7 +245,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                             ntVertex = NULL;
                         }
                     }else if(edge->B()->getNature() & Nature::T_VERTEX){
-                        TVertex* tv = dynamic_cast<TVertex*>(edge->B());
+                        TVertex* tv = asTVertex(edge->B());
                         if(tv->numEdges()<4)
                             continue;
                         if(tv->backEdgeA().first == edge){
@@ -230,7 +262,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                             nextV = nextE->B();
                         }
                         if(nextV->getNature() & Nature::CUSP){
-                            ntVertex = dynamic_cast<NonTVertex*>(nextV);
+                            ntVertex = asNonTVertex(nextV);
                             assert(ntVertex->viewedges().size() == 2);
                             mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                             if(mate->qi() == 0){
@@ -244,7 +276,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                     if(!ntVertex){
                         edge = tVertex->frontEdgeA().first;
                         if(edge->A()->getNature() & Nature::CUSP){
-                            ntVertex = dynamic_cast<NonTVertex*>(edge->A());
+                            ntVertex = asNonTVertex(edge->A());
                             assert(ntVertex->viewedges().size() == 2);
                             mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                             if(mate->qi() == 0){
@@ -253,7 +285,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                                 ntVertex = NULL;
                             }
                         }else if(edge->A()->getNature() & Nature::T_VERTEX){
-                            TVertex* tv = dynamic_cast<TVertex*>(edge->A());
+                            TVertex* tv = asTVertex(edge->A());
                             if(tv->numEdges()<4)
                                 continue;
                             if(tv->backEdgeA().first == edge){
@@ -270,7 +302,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                                 nextV = nextE->B();
                             }
                             if(nextV->getNature() & Nature::CUSP){
-                                ntVertex = dynamic_cast<NonTVertex*>(nextV);
+                                ntVertex = asNonTVertex(nextV);
                                 assert(ntVertex->viewedges().size() == 2);
                                 mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                                 if(mate->qi() == 0){
@@ -285,7 +317,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                 }else if(visibleBack==1){
                     edge = tVertex->frontEdgeB().first;
                     if(edge->B()->getNature() & Nature::CUSP){
-                        ntVertex = dynamic_cast<NonTVertex*>(edge->B());
+                        ntVertex = asNonTVertex(edge->B());
                         assert(ntVertex->viewedges().size() == 2);
                         mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                         if(mate->qi() == 0){
@@ -294,7 +326,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                             ntVertex = NULL;
                         }
                     }else if(edge->B()->getNature() & Nature::T_VERTEX){
-                        TVertex* tv = dynamic_cast<TVertex*>(edge->B());
+                        TVertex* tv = asTVertex(edge->B());
                         if(tv->numEdges()<4)
                             continue;
                         if(tv->backEdgeA().first == edge){
@@ -311,7 +343,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                             nextV = nextE->B();
                         }
                         if(nextV->getNature() & Nature::CUSP){
-                            ntVertex = dynamic_cast<NonTVertex*>(nextV);
+                            ntVertex = asNonTVertex(nextV);
                             assert(ntVertex->viewedges().size() == 2);
                             mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                             if(mate->qi() == 0){
@@ -325,7 +357,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                     if(!ntVertex){
                         edge = tVertex->frontEdgeA().first;
                         if(edge->A()->getNature() & Nature::CUSP){
-                            ntVertex = dynamic_cast<NonTVertex*>(edge->A());
+                            ntVertex = asNonTVertex(edge->A());
                             assert(ntVertex->viewedges().size() == 2);
                             mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                             if(mate->qi() == 0){
@@ -334,7 +366,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                                 ntVertex = NULL;
                             }
                         }else if(edge->A()->getNature() & Nature::T_VERTEX){
-                            TVertex* tv = dynamic_cast<TVertex*>(edge->A());
+                            TVertex* tv = asTVertex(edge->A());
                             if(tv->numEdges()<4)
                                 continue;
                             if(tv->backEdgeA().first == edge){
@@ -351,7 +383,7 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
                                 nextV = nextE->B();
                             }
                             if(nextV->getNature() & Nature::CUSP){
-                                ntVertex = dynamic_cast<NonTVertex*>(nextV);
+                                ntVertex = asNonTVertex(nextV);
                                 assert(ntVertex->viewedges().size() == 2);
                                 mate = (ntVertex->viewedges()[0].first != edge ? ntVertex->viewedges()[0].first : ntVertex->viewedges()[1].first);
                                 if(mate->qi() == 0){
@@ -381,13 +413,13 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
             }
         }else{
             // If 2 CUSPs are directly (no image space intersection) connected by an invisible edge with arclength<=1px, change it to visible
-            NonTVertex* ntVertex = dynamic_cast<NonTVertex*>(vVertex);
+            NonTVertex* ntVertex = asNonTVertex(vVertex);
             if(ntVertex && ntVertex->getNature() & Nature::CUSP){
                 assert(ntVertex->viewedges().size()==2);
                 for(int i=0; i<2; i++){
                     ViewEdge* edge = ntVertex->viewedges()[i].first;
                     ViewVertex* otherVVertex = (edge->A() != vVertex) ? edge->A() : edge->B();
-                    NonTVertex* otherNTVertex = dynamic_cast<NonTVertex*>(otherVVertex);
+                    NonTVertex* otherNTVertex = asNonTVertex(otherVVertex);
                     if(otherNTVertex != NULL && otherNTVertex->getNature() & Nature::CUSP){
                         assert(otherNTVertex->viewedges().size()==2);
 
@@ -447,6 +479,10 @@ ViewMap* ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
 
     _ViewMap->checkPointers("after ComputeEdgesVisibility",true);
 
+    Stats::instance()->addCount("BuildViewMap", "viewEdges", _ViewMap->ViewEdges().size());
+    Stats::instance()->addCount("BuildViewMap", "viewVertices", _ViewMap->ViewVertices().size());
+    Stats::instance()->addCount("BuildViewMap", "fedges", _ViewMap->FEdges().size());
+
     return _ViewMap;
 }
 
@@ -538,8 +574,8 @@ SVertex * TriPair::getPOendpoint(ViewMap*vm,bool fromA)
       !(fe2->getNature() & Nature::SILHOUETTE))
     continue;
 
-      FEdgeSmooth * fes1=dynamic_cast<FEdgeSmooth*>(fe1);
-      FEdgeSmooth * fes2=dynamic_cast<FEdgeSmooth*>(fe2);
+      FEdgeSmooth * fes1=asFEdgeSmooth(fe1);
+      FEdgeSmooth * fes2=asFEdgeSmooth(fe2);
 
       assert(fes1 != NULL && fes2 != NULL);
 
@@ -709,10 +745,11 @@ bool adjacent(const TriPair & tp)
 }
 
 
-bool intersectFaces(TriPair & tp, Vec3r * lastpt = NULL, bool A = true)
+bool intersectFaces(TriPair & tp, Vec3r * lastpt = NULL, bool A = true, const FaceSegmentMap * segments = NULL)
 // given the faces in "tp", compute the rest of the data structure, as described above
 // If "lastpt" isn't NULL, then sort it so that the point A is the same as "lastpt"
 //                         unless "A" is false, in which case point B becomes same as "lastpt"
+// If "segments" holds the pair (in either order), its segment is used rather than testing the faces again
 {
     // ------------------- check for intersection -------------------------
 
@@ -737,23 +774,37 @@ bool intersectFaces(TriPair & tp, Vec3r * lastpt = NULL, bool A = true)
             t2[m][n] = tp.face2->GetVertex(m)->GetVertex()[n];
         }
 
-
-    int result = tri_tri_intersection_test_3d(t1[0], t1[1], t1[2],
-            t2[0], t2[1], t2[2],
-            &coplanar, source, target);
-
-    if (result == 0)
+    FaceSegmentMap::const_iterator segment;
+    if (segments != NULL &&
+            ((segment = segments->find(pair<const WFace*,const WFace*>(tp.face1,tp.face2))) != segments->end() ||
+             (segment = segments->find(pair<const WFace*,const WFace*>(tp.face2,tp.face1))) != segments->end()))
     {
-        //      printf("No intersection: [%08X, %08X]\n", tp.face1, tp.face2);
-        return false;
+        // already known to intersect, and not to be coplanar
+        for(int n=0;n<3;n++)
+        {
+            source[n] = segment->second.first[n];
+            target[n] = segment->second.second[n];
+        }
     }
-
-    // it appears that the intersection_test code never returns 1 (with probability 1), so I hacked it
-    // the other code returned NaNs when I tried it, but that might have been an earlier bug
-    if (coplanar == 1)
+    else
     {
-        printf("WARNING: Ignoring coplanar triangles\n");
-        return false;
+        int result = tri_tri_intersection_test_3d(t1[0], t1[1], t1[2],
+                t2[0], t2[1], t2[2],
+                &coplanar, source, target);
+
+        if (result == 0)
+        {
+            //      printf("No intersection: [%08X, %08X]\n", tp.face1, tp.face2);
+            return false;
+        }
+
+        // it appears that the intersection_test code never returns 1 (with probability 1), so I hacked it
+        // the other code returned NaNs when I tried it, but that might have been an earlier bug
+        if (coplanar == 1)
+        {
+            printf("WARNING: Ignoring coplanar triangles\n");
+            return false;
+        }
     }
 
     if (isinf(source[0]) || isinf(source[1]) || isinf(source[2]) ||
@@ -992,6 +1043,67 @@ bool alreadyVisited(const WFace *f1, const WFace*f2, const set<pair<const WFace*
 
 
 
+// Exact test for a candidate pair of faces: same as the first part of intersectFaces,
+// without its side effects, so that it can be run concurrently. Gives the intersection segment.
+bool facesIntersect(const WFace * face1, const WFace * face2, Vec3r & source, Vec3r & target)
+{
+    if (face1 == face2 || adjacent(face1, face2))
+        return false;
+
+    int coplanar = 0;
+    real s[3], t[3];
+    real t1[3][3], t2[3][3];
+    for(int m=0;m<3;m++)
+        for(int n=0;n<3;n++)
+        {
+            t1[m][n] = face1->GetVertex(m)->GetVertex()[n];
+            t2[m][n] = face2->GetVertex(m)->GetVertex()[n];
+        }
+
+    int result = tri_tri_intersection_test_3d(t1[0], t1[1], t1[2],
+            t2[0], t2[1], t2[2],
+            &coplanar, s, t);
+
+    source = Vec3r(s[0], s[1], s[2]);
+    target = Vec3r(t[0], t[1], t[2]);
+
+    return result != 0 && coplanar != 1;
+}
+
+// A pair of intersecting faces, ordered by occluder index, and the segment along which they intersect
+struct IntersectingPair
+{
+    Polygon3r * first, * second;
+    Vec3r source, target;
+};
+
+// Keeps the pair, ordered by occluder index (the insertion order in the grid), if the faces intersect
+inline
+void testFacePair(Polygon3r * p1, Polygon3r * p2, vector<IntersectingPair> & found)
+{
+    if ((unsigned long)p1->userdata2 > (unsigned long)p2->userdata2)
+        swap(p1, p2);
+    IntersectingPair ip;
+    if (facesIntersect((const WFace*)p1->userdata, (const WFace*)p2->userdata, ip.source, ip.target))
+    {
+        ip.first = p1;
+        ip.second = p2;
+        found.push_back(ip);
+    }
+}
+
+bool occluderPairLess(const IntersectingPair & a, const IntersectingPair & b)
+{
+    if (a.first->userdata2 != b.first->userdata2)
+        return (unsigned long)a.first->userdata2 < (unsigned long)b.first->userdata2;
+    return (unsigned long)a.second->userdata2 < (unsigned long)b.second->userdata2;
+}
+
+bool occluderPairEqual(const IntersectingPair & a, const IntersectingPair & b)
+{
+    return a.first == b.first && a.second == b.second;
+}
+
 void ViewMapBuilder::computeSelfIntersections(WingedEdge & we)
 {
     printf("Computing self intersections:\n");
@@ -1000,16 +1112,27 @@ void ViewMapBuilder::computeSelfIntersections(WingedEdge & we)
     badIntersection = false;
 
     FastGrid * fg = dynamic_cast<FastGrid*>(_Grid);
-
+    OccluderBVH * bvh = dynamic_cast<OccluderBVH*>(_Grid);
+
+    // With the BVH, the candidates are the pairs of faces whose bounding boxes overlap.
+    // With the grid, they are all the pairs of faces sharing a cell.
+    vector<pair<Polygon3r*,Polygon3r*> > candidates;
+    vector<Cell*> cells;
+    if (bvh != NULL)
+        bvh->overlappingPairs(candidates);
+    else
+        for(FastGrid::FGiterator it = fg->beginFG() ; it != fg->endFG(); ++it)
+            cells.push_back(_Grid->getCell(*it));
+    unsigned numSteps = (bvh != NULL) ? candidates.size() : cells.size();
 
     bool progressBarDisplay = false;
     unsigned progressBarStep = 0;
 
-    if(_pProgressBar != NULL && fg->numNonempty() > gProgressBarMinSize) {
-        unsigned progressBarSteps = fg->numNonempty();
+    if(_pProgressBar != NULL && numSteps > gProgressBarMinSize) {
+        unsigned progressBarSteps = numSteps;
         if (progressBarSteps > 100)
             progressBarSteps = 100;
-        progressBarStep = fg->numNonempty() / progressBarSteps;
+        progressBarStep = numSteps / progressBarSteps;
         _pProgressBar->reset();
         _pProgressBar->setLabelText("Computing Self-Intersections");
         _pProgressBar->setTotalSteps(progressBarSteps);
@@ -1017,7 +1140,6 @@ void ViewMapBuilder::computeSelfIntersections(WingedEdge & we)
         progressBarDisplay = true;
     }
 
-    unsigned counter = progressBarStep;
 
 
     /*
@@ -1054,393 +1176,437 @@ void ViewMapBuilder::computeSelfIntersections(WingedEdge & we)
     _ViewMap->AddViewShape(vshape);
     psShape->SetViewShape(vshape);
 
+    // ------ find the intersecting face pairs ------
+    // The exact triangle tests are independent, so they run in parallel, each thread
+    // collecting the pairs it finds. A pair may be found in several cells: the pairs are
+    // sorted and made unique afterwards, which also makes the order in which the curves
+    // are traced (and thus the ids of their ViewEdges) independent of the thread count.
+
+#ifdef _OPENMP
+    vector<vector<IntersectingPair> > threadPairs(omp_get_max_threads());
+#else
+    vector<vector<IntersectingPair> > threadPairs(1);
+#endif
+
+    int numTasks = numSteps;
+    int blockSize = progressBarDisplay ? max(progressBarStep, 1u) : max(numTasks, 1);
+    for(int blockStart = 0; blockStart < numTasks; blockStart += blockSize)
+    {
+        int blockEnd = min(blockStart + blockSize, numTasks);
+
+#pragma omp parallel for schedule(dynamic)
+        for(int t = blockStart; t < blockEnd; t++)
+        {
+#ifdef _OPENMP
+            vector<IntersectingPair> & found = threadPairs[omp_get_thread_num()];
+#else
+            vector<IntersectingPair> & found = threadPairs[0];
+#endif
+            if (bvh != NULL)
+                testFacePair(candidates[t].first, candidates[t].second, found);
+            else
+            {
+                vector<Polygon3r*> & tris = cells[t]->getOccluders();
+                for(int i=0;i<tris.size();i++)
+                    for(int j=i+1;j<tris.size();j++)
+                        testFacePair(tris[i], tris[j], found);
+            }
+        }
+
+        if(progressBarDisplay)
+            _pProgressBar->setProgress(_pProgressBar->getProgress() + 1);
+    }
+
+    vector<IntersectingPair> intersecting;
+    for(int i=0;i<threadPairs.size();i++)
+        intersecting.insert(intersecting.end(), threadPairs[i].begin(), threadPairs[i].end());
+    threadPairs.clear();
+    sort(intersecting.begin(), intersecting.end(), occluderPairLess);
+    intersecting.erase(unique(intersecting.begin(), intersecting.end(), occluderPairEqual), intersecting.end());
+
+    printf("%d intersecting face pairs\n", (int)intersecting.size());
+
+    // the segments found here are reused while tracing, rather than testing the faces again
+    FaceSegmentMap segments;
+    for(int k=0;k<intersecting.size();k++)
+        segments[pair<const WFace*,const WFace*>((const WFace*)intersecting[k].first->userdata,
+                                                 (const WFace*)intersecting[k].second->userdata)] =
+                pair<Vec3r,Vec3r>(intersecting[k].source, intersecting[k].target);
+
+    // ------ trace the intersection curves through them ------
+    // Tracing follows each curve across neighboring faces and creates the view map elements,
+    // so it is done serially. Pairs on curves that are already traced are skipped.
+
     set<pair<const WFace*,const WFace*> > processed;
 
-    list<TriPair> chain;
+    for(int k=0;k<intersecting.size();k++)
+        traceSelfIntersection((WFace*)intersecting[k].first->userdata, (WFace*)intersecting[k].second->userdata,
+                              processed, segments, vshape, psShape);
+
+    // ----- make visualization ----
 
-    //  FILE * histFile = fopen("hist.txt","wt");
+#ifdef DEBUG_INTERSECTION
+    NodeShape * triangles = new NodeShape;
+    visDebugNode->AddChild(triangles);
 
-    int n = 0, firstId = _currentId, firstFId = _currentFId;
-    // iterate over all non-empty grid cells
-    for(FastGrid::FGiterator it = fg->beginFG() ; it != fg->endFG(); ++it)
-        //  for(Grid::iterator it = _Grid->begin(); it!= _Grid->end(); ++it)
+    for(vector<TriangleRep*>::iterator it = debugTriangles.begin(); it != debugTriangles.end(); ++it)
     {
-        printf("Visiting cell # %d / %d. Created so far: %d ViewEdges, %d FEdges   \r",
-               n++, fg->numNonempty()-1, _currentId-firstId, _currentFId - firstFId);
-        //      printf("sizeof: ViewEdge: %d, ViewVertex: %d, FEdgeSmooth: %d, SVertex: %d\n",
-        //	     (int)sizeof(ViewEdge), (int)sizeof(ViewVertex), (int)sizeof(FEdgeSmooth),
-        //	     (int)sizeof(SVertex));
+        TriangleRep * t = *it;
+
+        t->ComputeBBox();
+        t->SetStyle(TriangleRep::FILL);
+        triangles->AddRep(t);
+    }
+    debugTriangles.clear();
+#endif
 
-        vector<Polygon3r*> & tris = _Grid->getCell(*it)->getOccluders();
+    if (badIntersection)
+        printf("WARNING: DEGENERATE INTERSECTIONS DETECTED\n");
 
-        //      fprintf(histFile, "%d ", tris.size());
+    printf("\nDone computing self-intersections\n");
+    //  fclose(histFile);
+}
 
-        for(int i=0;i<tris.size();i++)
-            for(int j=i+1;j<tris.size();j++)
-            {
-                TriPair start_tp;
 
-                start_tp.face1 = (WFace*)tris[i]->userdata;
-                start_tp.face2 = (WFace*)tris[j]->userdata;
+// Starting from a pair of faces, traces the whole curve along which the two surfaces intersect,
+// and builds its FEdges and ViewEdge. Does nothing if the faces don't intersect, or if
+// their intersection has already been traced from another pair.
+void ViewMapBuilder::traceSelfIntersection(WFace * face1, WFace * face2,
+                                           set<pair<const WFace*,const WFace*> > & processed,
+                                           const FaceSegmentMap & segments,
+                                           ViewShape * vshape, SShape * psShape)
+{
+    TriPair start_tp;
 
-                // ------- check if we've already done this pair of triangles ---------
+    start_tp.face1 = face1;
+    start_tp.face2 = face2;
 
-                if (alreadyVisited(start_tp,processed))
-                    continue;
+    list<TriPair> chain;
 
-                // -------------- check if the polys share any vertices ---------------
+    // ------- check if we've already done this pair of triangles ---------
 
-                if (adjacent(start_tp))
-                {
-                    //		printf("Skipping adjacent: [%08X, %08X]\n", start_tp.face1, start_tp.face2);
-                    continue;
-                }
+    if (alreadyVisited(start_tp,processed))
+        return;
 
-                // ------------------------ check for intersection ------------------------
+    // -------------- check if the polys share any vertices ---------------
 
-                bool result = intersectFaces(start_tp);
-                if (result == false)
-                    continue;
+    if (adjacent(start_tp))
+    {
+        //		printf("Skipping adjacent: [%08X, %08X]\n", start_tp.face1, start_tp.face2);
+        return;
+    }
 
-                processed.insert(pair<const WFace*,const WFace*>(start_tp.face1,start_tp.face2));
+    // ------------------------ check for intersection ------------------------
 
-                // ------------------------ create the chain ------------------------------
+    bool result = intersectFaces(start_tp, NULL, true, &segments);
+    if (result == false)
+        return;
 
-                bool closed = false;
+    processed.insert(pair<const WFace*,const WFace*>(start_tp.face1,start_tp.face2));
 
-                chain.clear();
-                chain.push_back(start_tp);
+    // ------------------------ create the chain ------------------------------
 
-                // ------------------------ forward chaining pass -------------------------
+    bool closed = false;
 
-                TriPair lasttp = start_tp;
+    chain.clear();
+    chain.push_back(start_tp);
 
-                while(true)
-                {
-                    TriPair tp = lasttp;
+    // ------------------------ forward chaining pass -------------------------
+
+    TriPair lasttp = start_tp;
+
+    while(true)
+    {
+        TriPair tp = lasttp;
 
-                    // advance to the next pair of faces
+        // advance to the next pair of faces
 #ifdef DEBUG_INTERSECTION
-                    printf("forward\n");
+        printf("forward\n");
 #endif
-                    tp.forward();
+        tp.forward();
 
-                    // check if we've reached an object boundary
-                    if (tp.face1 == NULL || tp.face2 == NULL)
-                    {
+        // check if we've reached an object boundary
+        if (tp.face1 == NULL || tp.face2 == NULL)
+        {
 #ifdef DEBUG_INTERSECTION
-                        printf("reached object boundary\n");
+            printf("reached object boundary\n");
 #endif
-                        break;
-                    }
+            break;
+        }
 
-                    // check if we're back where we started
-                    if ( (tp.face1 == start_tp.face1 && tp.face2 == start_tp.face2) ||
-                         (tp.face1 == start_tp.face2 && tp.face2 == start_tp.face1))
-                    {
+        // check if we're back where we started
+        if ( (tp.face1 == start_tp.face1 && tp.face2 == start_tp.face2) ||
+             (tp.face1 == start_tp.face2 && tp.face2 == start_tp.face1))
+        {
 #ifdef DEBUG_INTERSECTION
-                        printf("Closed the loop\n");
+            printf("Closed the loop\n");
 #endif
-                        closed = true;
-                        break;
-                    }
+            closed = true;
+            break;
+        }
 
-                    // check if this pair has already been processed
-                    if (alreadyVisited(tp, processed))
-                    {
+        // check if this pair has already been processed
+        if (alreadyVisited(tp, processed))
+        {
 #ifdef DEBUG_INTERSECTION
-                        printf("WARNING: found already-processed pair without loop closure\n");
-                        printf("Face1: %08X [%08X, %08X, %08X]\n", tp.face1,
-                               tp.face1->GetVertex(0),tp.face1->GetVertex(1),tp.face1->GetVertex(2));
-                        printf("Face2: %08X [%08X, %08X, %08X]\n", tp.face2,
-                               tp.face2->GetVertex(0),tp.face2->GetVertex(1),tp.face2->GetVertex(2));
-
-                        real t1[3][3], t2[3][3];
-                        for(int m=0;m<3;m++)
-                            for(int n=0;n<3;n++)
-                            {
-                                t1[m][n] = tp.face1->GetVertex(m)->GetVertex()[n];
-                                t2[m][n] = tp.face2->GetVertex(m)->GetVertex()[n];
-                            }
+            printf("WARNING: found already-processed pair without loop closure\n");
+            printf("Face1: %08X [%08X, %08X, %08X]\n", tp.face1,
+                   tp.face1->GetVertex(0),tp.face1->GetVertex(1),tp.face1->GetVertex(2));
+            printf("Face2: %08X [%08X, %08X, %08X]\n", tp.face2,
+                   tp.face2->GetVertex(0),tp.face2->GetVertex(1),tp.face2->GetVertex(2));
+
+            real t1[3][3], t2[3][3];
+            for(int m=0;m<3;m++)
+                for(int n=0;n<3;n++)
+                {
+                    t1[m][n] = tp.face1->GetVertex(m)->GetVertex()[n];
+                    t2[m][n] = tp.face2->GetVertex(m)->GetVertex()[n];
+                }
 
-                        printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f]); hold on;\n",
-                               t1[0][0],t1[1][0],t1[2][0],t1[0][0],
-                                t1[0][1],t1[1][1],t1[2][1],t1[0][1],
-                                t1[0][2],t1[1][2],t1[2][2],t1[0][2]);
-                        printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f])\n",
-                               t2[0][0],t2[1][0],t2[2][0],t2[0][0],
-                                t2[0][1],t2[1][1],t2[2][1],t2[0][1],
-                                t2[0][2],t2[1][2],t2[2][2],t2[0][2]);
+            printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f]); hold on;\n",
+                   t1[0][0],t1[1][0],t1[2][0],t1[0][0],
+                    t1[0][1],t1[1][1],t1[2][1],t1[0][1],
+                    t1[0][2],t1[1][2],t1[2][2],t1[0][2]);
+            printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f])\n",
+                   t2[0][0],t2[1][0],t2[2][0],t2[0][0],
+                    t2[0][1],t2[1][1],t2[2][1],t2[0][1],
+                    t2[0][2],t2[1][2],t2[2][2],t2[0][2]);
 
 
-                        bool result = intersectFaces(tp);
-                        printf("  test: %s\n", result ? "INTERSECTION" : "NO INTERSECTION");
+            bool result = intersectFaces(tp);
+            printf("  test: %s\n", result ? "INTERSECTION" : "NO INTERSECTION");
 #endif
-                        break;
-                    }
+            break;
+        }
 
-                    processed.insert(pair<const WFace*,const WFace*>(tp.face1,tp.face2));
+        processed.insert(pair<const WFace*,const WFace*>(tp.face1,tp.face2));
 
-                    // compute the intersection between these two faces
-                    // if things are working properly, these faces must intersect
-                    // (unless they are adjacent on the surface, not sure if this case is important)
-                    result = intersectFaces(tp, &lasttp.ptB,true);
-                    if (!result)
-                    {
+        // compute the intersection between these two faces
+        // if things are working properly, these faces must intersect
+        // (unless they are adjacent on the surface, not sure if this case is important)
+        result = intersectFaces(tp, &lasttp.ptB, true, &segments);
+        if (!result)
+        {
 #ifdef DEBUG_INTERSECTION
-                        printf("WARNING: didn't find expected intersection\n");
+            printf("WARNING: didn't find expected intersection\n");
 
 
-                        real t1[3][3], t2[3][3];
-                        for(int m=0;m<3;m++)
-                            for(int n=0;n<3;n++)
-                            {
-                                t1[m][n] = tp.face1->GetVertex(m)->GetVertex()[n];
-                                t2[m][n] = tp.face2->GetVertex(m)->GetVertex()[n];
-                            }
+            real t1[3][3], t2[3][3];
+            for(int m=0;m<3;m++)
+                for(int n=0;n<3;n++)
+                {
+                    t1[m][n] = tp.face1->GetVertex(m)->GetVertex()[n];
+                    t2[m][n] = tp.face2->GetVertex(m)->GetVertex()[n];
+                }
 
-                        printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f]); hold on;\n",
-                               t1[0][0],t1[1][0],t1[2][0],t1[0][0],
-                                t1[0][1],t1[1][1],t1[2][1],t1[0][1],
-                                t1[0][2],t1[1][2],t1[2][2],t1[0][2]);
-                        printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f])\n",
-                               t2[0][0],t2[1][0],t2[2][0],t2[0][0],
-                                t2[0][1],t2[1][1],t2[2][1],t2[0][1],
-                                t2[0][2],t2[1][2],t2[2][2],t2[0][2]);
+            printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f]); hold on;\n",
+                   t1[0][0],t1[1][0],t1[2][0],t1[0][0],
+                    t1[0][1],t1[1][1],t1[2][1],t1[0][1],
+                    t1[0][2],t1[1][2],t1[2][2],t1[0][2]);
+            printf("\tplot3([%f %f %f %f],[%f %f %f %f],[%f %f %f %f])\n",
+                   t2[0][0],t2[1][0],t2[2][0],t2[0][0],
+                    t2[0][1],t2[1][1],t2[2][1],t2[0][1],
+                    t2[0][2],t2[1][2],t2[2][2],t2[0][2]);
 
-                        //		    makeDebugTriangles(tp.face1, tp.face2);
+            //		    makeDebugTriangles(tp.face1, tp.face2);
 #endif
-                        break;
-                    }
-                    //		  FATAL_ERROR("didn't find expected intersection");
+            break;
+        }
+        //		  FATAL_ERROR("didn't find expected intersection");
 
-                    chain.push_back(tp);
-                    lasttp = tp;
-                }
+        chain.push_back(tp);
+        lasttp = tp;
+    }
 
-                // ------------------------ backward chaining -----------------------------
+    // ------------------------ backward chaining -----------------------------
 
-                if (!closed)
-                {
+    if (!closed)
+    {
 #ifdef DEBUG_INTERSECTION
-                    printf("doing bidirectional chaining\n");
+        printf("doing bidirectional chaining\n");
 #endif
 
-                    lasttp = start_tp;
+        lasttp = start_tp;
 
-                    while(true)
-                    {
-                        TriPair tp = lasttp;
+        while(true)
+        {
+            TriPair tp = lasttp;
 
-                        Vec3r last_ptA = lasttp.ptA;
+            Vec3r last_ptA = lasttp.ptA;
 
-                        // advance to the next pair of faces
-                        tp.backward();
-                        if (tp.face1 == NULL || tp.face2 == NULL)   // should only happens at object boundaries
-                            break;
+            // advance to the next pair of faces
+            tp.backward();
+            if (tp.face1 == NULL || tp.face2 == NULL)   // should only happens at object boundaries
+                break;
 
-                        if (alreadyVisited(tp, processed))
-                        {
+            if (alreadyVisited(tp, processed))
+            {
 #ifdef DEBUG_INTERSECTION
-                            printf("warning: found already-processed pair without loop closure\n");
+                printf("warning: found already-processed pair without loop closure\n");
 #endif
-                            break;
-                        }
+                break;
+            }
 
-                        processed.insert(pair<const WFace*,const WFace*>(tp.face1,tp.face2));
+            processed.insert(pair<const WFace*,const WFace*>(tp.face1,tp.face2));
 
-                        // compute the intersection between these two faces
-                        result = intersectFaces(tp,&lasttp.ptA,false);
-                        if (result == false)
-                            break;
-                        //		      FATAL_ERROR("didn't find expected intersection");
+            // compute the intersection between these two faces
+            result = intersectFaces(tp, &lasttp.ptA, false, &segments);
+            if (result == false)
+                break;
+            //		      FATAL_ERROR("didn't find expected intersection");
 
-                        chain.push_front(tp);
-                        lasttp = tp;
-                    }
+            chain.push_front(tp);
+            lasttp = tp;
+        }
 
-                }
+    }
 
-                // ------- we now have a chain of face pairs, with ordered pts (A,B) -------
-                // ------- now we generate the corresponding chain of FEdges, and the ViewEdge and ViewVertices
+    // ------- we now have a chain of face pairs, with ordered pts (A,B) -------
+    // ------- now we generate the corresponding chain of FEdges, and the ViewEdge and ViewVertices
 
-                //	    printf("i = %d, j= %d\n", i,j);
+    //	    printf("i = %d, j= %d\n", i,j);
 
-                //	    PRINTMEM
+    //	    PRINTMEM
 
-                //	    _ViewMap->AddViewEdge(newVEdge);
-                ///	    vector<ViewEdge*> & ves = _ViewMap->ViewEdges();
-                //	    printf("ves.size() = %d\n", ves.size());
-                //	    ves.push_back(newVEdge);
+    //	    _ViewMap->AddViewEdge(newVEdge);
+    ///	    vector<ViewEdge*> & ves = _ViewMap->ViewEdges();
+    //	    printf("ves.size() = %d\n", ves.size());
+    //	    ves.push_back(newVEdge);
 
 
-                bool isPORegion = ((WXFace*)start_tp.face1)->sourcePOB() != NULL ||
-                        ((WXFace*)start_tp.face2)->sourcePOB() != NULL;
+    bool isPORegion = ((WXFace*)start_tp.face1)->sourcePOB() != NULL ||
+            ((WXFace*)start_tp.face2)->sourcePOB() != NULL;
 
 
-                ViewEdge * newVEdge = new ViewEdge;
-                assert(newVEdge != NULL);
+    ViewEdge * newVEdge = new ViewEdge;
+    assert(newVEdge != NULL);
 
-                newVEdge->SetNature(isPORegion ? Nature::PO_SURFACE_INTERSECTION : Nature::SURFACE_INTERSECTION);
-                newVEdge->SetId(_currentId);
-                _currentId++;
+    newVEdge->SetNature(isPORegion ? Nature::PO_SURFACE_INTERSECTION : Nature::SURFACE_INTERSECTION);
+    newVEdge->SetId(_currentId);
+    _currentId++;
 
-                _ViewMap->AddViewEdge(newVEdge);
-                vshape->AddEdge(newVEdge);
+    _ViewMap->AddViewEdge(newVEdge);
+    vshape->AddEdge(newVEdge);
 
 
 #ifdef DEBUG_INTERSECTION
-                Id id = newVEdge->getId();
-                printf("NEW VIEWEDGE, ID: %d %d\n", id.getFirst(), id.getSecond());
+    Id id = newVEdge->getId();
+    printf("NEW VIEWEDGE, ID: %d %d\n", id.getFirst(), id.getSecond());
 #endif
-                fflush(stdout);
+    fflush(stdout);
 
-                FEdgeIntersection * fe;
-                FEdgeIntersection * fefirst = NULL;
-                FEdgeIntersection * feprevious = NULL;
-                SVertex * vA = NULL;
-                SVertex * vB = NULL;
-                SVertex * vFirst = NULL;
+    FEdgeIntersection * fe;
+    FEdgeIntersection * fefirst = NULL;
+    FEdgeIntersection * feprevious = NULL;
+    SVertex * vA = NULL;
+    SVertex * vB = NULL;
+    SVertex * vFirst = NULL;
 
-                vA = new SVertex( chain.front().ptA, _currentSVertexId);
-                vA->SetSourceEdge(chain.front().getEdge(true));
-                vFirst = vA;
+    vA = new SVertex( chain.front().ptA, _currentSVertexId);
+    vA->SetSourceEdge(chain.front().getEdge(true));
+    vFirst = vA;
 
-                _currentSVertexId++;
-                SilhouetteGeomEngine::ProjectSilhouette(vA);
+    _currentSVertexId++;
+    SilhouetteGeomEngine::ProjectSilhouette(vA);
 
-                _ViewMap->AddSVertex(vA);
-                psShape->AddNewVertex(vA);
+    _ViewMap->AddSVertex(vA);
+    psShape->AddNewVertex(vA);
 
-                int k;
-                list<TriPair>::iterator it;
-                for(it = chain.begin(), k=0;it!= chain.end();++it, ++k)
-                {
-                    // check if we're at the end of a loop
-                    if (closed && (k+1 == chain.size()) && (chain.size() > 1))
-                    {
-                        vB = vFirst;
+    int k;
+    list<TriPair>::iterator it;
+    for(it = chain.begin(), k=0;it!= chain.end();++it, ++k)
+    {
+        // check if we're at the end of a loop
+        if (closed && (k+1 == chain.size()) && (chain.size() > 1))
+        {
+            vB = vFirst;
 
 #ifdef DEBUG_INTERSECTION
-                        // make sure vFirst is on these faces
-                        //		    printf("DEBUGGING LOOP CLOSURE\n");
-                        //		    ComputeBarycentricCoords((*it).face1, vB->getPoint3D());
-                        //		    ComputeBarycentricCoords((*it).face2, vB->getPoint3D());
+            // make sure vFirst is on these faces
+            //		    printf("DEBUGGING LOOP CLOSURE\n");
+            //		    ComputeBarycentricCoords((*it).face1, vB->getPoint3D());
+            //		    ComputeBarycentricCoords((*it).face2, vB->getPoint3D());
 #endif
-                    }
-                    else
-                    {
-                        vB = new SVertex( (*it).ptB, _currentSVertexId);
-                        vB->SetSourceEdge((*it).getEdge(false));
-                        _currentSVertexId++;
+        }
+        else
+        {
+            vB = new SVertex( (*it).ptB, _currentSVertexId);
+            vB->SetSourceEdge((*it).getEdge(false));
+            _currentSVertexId++;
 
-                        SilhouetteGeomEngine::ProjectSilhouette(vB);
-                        _ViewMap->AddSVertex(vB);
-                        psShape->AddNewVertex(vB);
-                    }
+            SilhouetteGeomEngine::ProjectSilhouette(vB);
+            _ViewMap->AddSVertex(vB);
+            psShape->AddNewVertex(vB);
+        }
 
-                    fe = new FEdgeIntersection(vA, vB);
-                    fe->SetViewEdge(newVEdge);
-                    fe->SetNature(isPORegion ? Nature::PO_SURFACE_INTERSECTION : Nature::SURFACE_INTERSECTION);//Nature::SURFACE_INTERSECTION);
-                    fe->SetId(_currentFId);
-                    _currentFId++;
-                    fe->SetPreviousEdge(feprevious);
-                    fe->SetFaces( (*it).face1 , (*it).face2 );
-                    assert((*it).face1 != NULL && (*it).face2 != NULL);
+        fe = new FEdgeIntersection(vA, vB);
+        fe->SetViewEdge(newVEdge);
+        fe->SetNature(isPORegion ? Nature::PO_SURFACE_INTERSECTION : Nature::SURFACE_INTERSECTION);//Nature::SURFACE_INTERSECTION);
+        fe->SetId(_currentFId);
+        _currentFId++;
+        fe->SetPreviousEdge(feprevious);
+        fe->SetFaces( (*it).face1 , (*it).face2 );
+        assert((*it).face1 != NULL && (*it).face2 != NULL);
 
-                    if (feprevious != NULL)
-                        feprevious->SetNextEdge(fe);
-                    //		(*it).face1->getIntersections().push_back(fe);
-                    //		(*it).face2->getIntersections().push_back(fe);
+        if (feprevious != NULL)
+            feprevious->SetNextEdge(fe);
+        //		(*it).face1->getIntersections().push_back(fe);
+        //		(*it).face2->getIntersections().push_back(fe);
 
-                    vA->AddFEdge(fe);
-                    vB->AddFEdge(fe);
-                    _ViewMap->AddFEdge(fe);
+        vA->AddFEdge(fe);
+        vB->AddFEdge(fe);
+        _ViewMap->AddFEdge(fe);
 
 #ifdef DEBUG_INTERSECTION
-                    printf("\t NEW FE: [%f %f %f], [%f %f %f], ID: %d %d\n", vA->getX(),vA->getY(),vA->getZ(),
-                           vB->getX(),vB->getY(),vB->getZ(), fe->getId().getFirst(), fe->getId().getSecond());
+        printf("\t NEW FE: [%f %f %f], [%f %f %f], ID: %d %d\n", vA->getX(),vA->getY(),vA->getZ(),
+               vB->getX(),vB->getY(),vB->getZ(), fe->getId().getFirst(), fe->getId().getSecond());
 
-                    //		debugFES(fe);
+        //		debugFES(fe);
 #endif
 
-                    if (fefirst == NULL)
-                        fefirst = fe;
-
-                    // increment pointers along the chain
-                    feprevious = fe;
-                    vA = vB;
-                }
-
-                psShape->AddChain(fefirst);
+        if (fefirst == NULL)
+            fefirst = fe;
 
-                newVEdge->SetFEdgeA(fefirst);
-                newVEdge->SetFEdgeB(fe);
-
-                if (closed)
-                {
-                    newVEdge->SetA(NULL);
-                    newVEdge->SetB(NULL);
-                    fe->SetNextEdge(fefirst);
-                    fefirst->SetPreviousEdge(fe);
-                }
-                else
-                {
-                    // create view vertecies for the endpoints.
-                    // Usually a NonTVertex, but a TVertex for one special case (end of PO cusp region connecting to silhouette)
-
-                    //		if (!isPORegion || chain.front().getPOendpoint(_ViewMap,true) == NULL)
-                    //		  {
-                    // just create a plain new vertex here
-                    NonTVertex * vva = new NonTVertex(fefirst->vertexA());
-                    newVEdge->SetA(vva);
-                    vva->AddOutgoingViewEdge(newVEdge);
-                    _ViewMap->AddViewVertex(vva);
-
-                    //		if (!isPORegion || chain.back().getPOendpoint(_ViewMap,false) == NULL)
-                    //		  {
-                    NonTVertex * vvb = new NonTVertex(fe->vertexB());
-                    newVEdge->SetB(vvb);
-                    vvb->AddIncomingViewEdge(newVEdge);
-
-                    _ViewMap->AddViewVertex(vvb);
-                }
-            }
-
-        if(progressBarDisplay) {
-            counter--;
-            if (counter <= 0) {
-                counter = progressBarStep;
-                _pProgressBar->setProgress(_pProgressBar->getProgress() + 1);
-            }
-        }
+        // increment pointers along the chain
+        feprevious = fe;
+        vA = vB;
     }
 
-    // ----- make visualization ----
+    psShape->AddChain(fefirst);
 
-#ifdef DEBUG_INTERSECTION
-    NodeShape * triangles = new NodeShape;
-    visDebugNode->AddChild(triangles);
+    newVEdge->SetFEdgeA(fefirst);
+    newVEdge->SetFEdgeB(fe);
 
-    for(vector<TriangleRep*>::iterator it = debugTriangles.begin(); it != debugTriangles.end(); ++it)
+    if (closed)
     {
-        TriangleRep * t = *it;
-
-        t->ComputeBBox();
-        t->SetStyle(TriangleRep::FILL);
-        triangles->AddRep(t);
+        newVEdge->SetA(NULL);
+        newVEdge->SetB(NULL);
+        fe->SetNextEdge(fefirst);
+        fefirst->SetPreviousEdge(fe);
+    }
+    else
+    {
+        // create view vertecies for the endpoints.
+        // Usually a NonTVertex, but a TVertex for one special case (end of PO cusp region connecting to silhouette)
+
+        //		if (!isPORegion || chain.front().getPOendpoint(_ViewMap,true) == NULL)
+        //		  {
+        // just create a plain new vertex here
+        NonTVertex * vva = new NonTVertex(fefirst->vertexA());
+        newVEdge->SetA(vva);
+        vva->AddOutgoingViewEdge(newVEdge);
+        _ViewMap->AddViewVertex(vva);
+
+        //		if (!isPORegion || chain.back().getPOendpoint(_ViewMap,false) == NULL)
+        //		  {
+        NonTVertex * vvb = new NonTVertex(fe->vertexB());
+        newVEdge->SetB(vvb);
+        vvb->AddIncomingViewEdge(newVEdge);
+
+        _ViewMap->AddViewVertex(vvb);
     }
-    debugTriangles.clear();
-#endif
-
-    if (badIntersection)
-        printf("WARNING: DEGENERATE INTERSECTIONS DETECTED\n");
-
-    printf("\nDone computing self-intersections\n");
-    //  fclose(histFile);
 }
 
-
 void ViewMapBuilder::computeInitialViewEdges(WingedEdge& we)
 {
     vector<WShape*> wshapes = we.getWShapes();
@@ -1801,7 +1967,7 @@ void ViewMapBuilder::computeCusps(ViewMap *ioViewMap){
     bool first = true;
     bool positive = true;
     do{
-      FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(fe);
+      FEdgeSmooth * fes = asFEdgeSmooth(fe);
       Vec3r A((fes)->vertexA()->point3d());
       Vec3r B((fes)->vertexB()->point3d());
       Vec3r AB(B-A);
@@ -1895,7 +2061,7 @@ void ViewMapBuilder::computeCusps(ViewMap *ioViewMap){
 
         assert(fes[0]->getNature() & fes[1]->getNature() & (Nature::SILHOUETTE | Nature::BORDER));
 
-        FEdgeSmooth * fesh[2] = { dynamic_cast<FEdgeSmooth*>(fes[0]), dynamic_cast<FEdgeSmooth*>(fes[1]) };
+        FEdgeSmooth * fesh[2] = { asFEdgeSmooth(fes[0]), asFEdgeSmooth(fes[1]) };
         assert(fesh[0] != NULL && fesh[1] != NULL);
 
         // sign (viewvec * (AB ^ normal))
@@ -1979,7 +2145,7 @@ void ViewMapBuilder::computeCusps(ViewMap *ioViewMap){
 
         assert(fes[0]->getNature() & fes[1]->getNature() & (Nature::SILHOUETTE | Nature::BORDER));
 
-        FEdgeSharp * fesh[2] = { dynamic_cast<FEdgeSharp*>(fes[0]), dynamic_cast<FEdgeSharp*>(fes[1]) };
+        FEdgeSharp * fesh[2] = { asFEdgeSharp(fes[0]), asFEdgeSharp(fes[1]) };
         assert(fesh[0] != NULL && fesh[1] != NULL);
 
         // find the WVertex shared by both edges
@@ -2154,7 +2320,40 @@ void ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, Grid* iGrid
         progressBarDisplay = true;
     }
 
-    unsigned counter = progressBarStep;
+    // ViewEdges are independent, so they are processed in parallel, each thread casting its rays
+    // with its own GridRay. They go in blocks of progressBarStep so that the progress bar is only
+    // updated from this thread.
+#ifdef _OPENMP
+    vector<GridRay> rays(omp_get_max_threads());
+#else
+    vector<GridRay> rays(1);
+#endif
+
+    int numEdges = vedges.size();
+    int blockSize = progressBarDisplay ? max(progressBarStep, 1u) : max(numEdges, 1);
+    for(int blockStart = 0; blockStart < numEdges; blockStart += blockSize)
+    {
+        int blockEnd = min(blockStart + blockSize, numEdges);
+
+#pragma omp parallel for schedule(dynamic)
+        for(int i = blockStart; i < blockEnd; i++)
+        {
+#ifdef _OPENMP
+            GridRay & ray = rays[omp_get_thread_num()];
+#else
+            GridRay & ray = rays[0];
+#endif
+            ComputeViewEdgeRayCastingVisibility(ioViewMap, vedges[i], iGrid, epsilon, iAlgo, ray);
+        }
+
+        if(progressBarDisplay)
+            _pProgressBar->setProgress(_pProgressBar->getProgress() + 1);
+    }
+}
+
+void ViewMapBuilder::ComputeViewEdgeRayCastingVisibility(ViewMap *ioViewMap, ViewEdge *ve, Grid* iGrid, real epsilon,
+                                                         visibility_algo iAlgo, GridRay& ray)
+{
     FEdge * fe, *festart;
     int nSamples = 0;
     vector<Polygon3r*> aFaces;
@@ -2163,145 +2362,129 @@ void ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, Grid* iGrid
     unsigned qiClasses[256];
     unsigned maxIndex, maxCard;
     unsigned qiMajority;
-    static unsigned timestamp = 1;
-    for(vector<ViewEdge*>::iterator ve=vedges.begin(), veend=vedges.end();
-        ve!=veend;
-        ve++)
-    {
-        festart = (*ve)->fedgeA();
-        fe = (*ve)->fedgeA();
-        qiMajority = 1;
-        do {
-            qiMajority++;
-            fe = fe->nextEdge();
-        } while (fe && fe != festart);
-        //    qiMajority >>= 1;   // halve the number of possible votes. If N/2 votes agree, no point in getting more votes.
 
-        // freestyle used to keep track of QI, but I'm disabling/not supporting
-        // those features -Aaron
+    festart = ve->fedgeA();
+    fe = ve->fedgeA();
+    qiMajority = 1;
+    do {
+        qiMajority++;
+        fe = fe->nextEdge();
+    } while (fe && fe != festart);
+    //    qiMajority >>= 1;   // halve the number of possible votes. If N/2 votes agree, no point in getting more votes.
 
-        tmpQI = 0;
-        maxIndex = 0;
-        maxCard = 0;
-        nSamples = 0;
-        fe = (*ve)->fedgeA();
-        memset(qiClasses, 0, 256 * sizeof(*qiClasses));
+    // freestyle used to keep track of QI, but I'm disabling/not supporting
+    // those features -Aaron
 
-        int visVotes = 0;
-        int invisVotes = 0;
+    tmpQI = 0;
+    maxIndex = 0;
+    maxCard = 0;
+    nSamples = 0;
+    fe = ve->fedgeA();
+    memset(qiClasses, 0, 256 * sizeof(*qiClasses));
 
-        set<ViewShape*> occluders;
-        do
-        {
-            if((maxCard < qiMajority)) {
+    int visVotes = 0;
+    int invisVotes = 0;
 
-                if (iAlgo == punch_out)
-                    tmpQI = ComputeRayCastingVisibilityPunchOut(fe, iGrid,
-                                                                epsilon, occluders, &aFace, timestamp++);
-                else
-                    tmpQI = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon,
-                                                        occluders, &aFace, timestamp++);
+    set<ViewShape*> occluders;
+    do
+    {
+        if((maxCard < qiMajority)) {
 
-                if (tmpQI != -1)
-                {
-                    if(tmpQI >= 256)
-                        cerr << "Warning: too many occluding levels" << endl;
+            if (iAlgo == punch_out)
+                tmpQI = ComputeRayCastingVisibilityPunchOut(fe, iGrid,
+                                                            epsilon, occluders, &aFace, ray);
+            else
+                tmpQI = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon,
+                                                    occluders, &aFace, ray);
 
-                    if (++qiClasses[tmpQI] > maxCard)
-                    {
-                        maxCard = qiClasses[tmpQI];
-                        maxIndex = tmpQI;
-                    }
+            if (tmpQI != -1)
+            {
+                if(tmpQI >= 256)
+                    cerr << "Warning: too many occluding levels" << endl;
 
-                    if (tmpQI == 0)
-                        visVotes ++;
-                    else
-                        invisVotes ++;
+                if (++qiClasses[tmpQI] > maxCard)
+                {
+                    maxCard = qiClasses[tmpQI];
+                    maxIndex = tmpQI;
+                }
 
-                    switch (tmpQI)
-                    {
-                    case 0:
-                        ioViewMap->addDebugPoint(DebugPoint::RAY_TRACE_VISIBLE,fe->center3d());
-                        break;
+                if (tmpQI == 0)
+                    visVotes ++;
+                else
+                    invisVotes ++;
 
-                    case 101:
-                        ioViewMap->addDebugPoint(DebugPoint::INVISIBLE_BACK_FACE, fe->center3d(), true);
-                        break;
+                switch (tmpQI)
+                {
+                case 0:
+                    ioViewMap->addDebugPoint(DebugPoint::RAY_TRACE_VISIBLE,fe->center3d());
+                    break;
 
-                    case 123:
-                        ioViewMap->addDebugPoint(DebugPoint::INVISIBLE_ONE_RING_OVERLAP, fe->center3d(), true);
-                        break;
+                case 101:
+                    ioViewMap->addDebugPoint(DebugPoint::INVISIBLE_BACK_FACE, fe->center3d(), true);
+                    break;
 
-                    default:
-                    case 100:
-                        ioViewMap->addDebugPoint(DebugPoint::RAY_TRACE_INVISIBLE,fe->center3d(),true);
-                        break;
-                    }
+                case 123:
+                    ioViewMap->addDebugPoint(DebugPoint::INVISIBLE_ONE_RING_OVERLAP, fe->center3d(), true);
+                    break;
+
+                default:
+                case 100:
+                    ioViewMap->addDebugPoint(DebugPoint::RAY_TRACE_INVISIBLE,fe->center3d(),true);
+                    break;
                 }
-                else
-                    FindOccludee(fe, iGrid, epsilon, &aFace, timestamp++);
             }
+            else
+                FindOccludee(fe, iGrid, epsilon, &aFace, ray);
+        }
 
-            if(aFace) {
-                fe->SetaFace(*aFace); aFaces.push_back(aFace);
-                fe->SetOccludeeEmpty(false);
-            } else
-                fe->SetOccludeeEmpty(true);
+        if(aFace) {
+            fe->SetaFace(*aFace); aFaces.push_back(aFace);
+            fe->SetOccludeeEmpty(false);
+        } else
+            fe->SetOccludeeEmpty(true);
 
-            ++nSamples; fe = fe->nextEdge();
-        } while((maxCard < qiMajority) && (0!=fe) && (fe!=festart));
+        ++nSamples; fe = fe->nextEdge();
+    } while((maxCard < qiMajority) && (0!=fe) && (fe!=festart));
 
-        // ViewEdge qi -- (*ve)->SetQI(maxIndex);
+    // ViewEdge qi -- ve->SetQI(maxIndex);
 
-        // I don't care about estimating QI.
-        if (visVotes > invisVotes)
-            (*ve)->SetQI(0);
-        else
-            (*ve)->SetQI(100);
+    // I don't care about estimating QI.
+    if (visVotes > invisVotes)
+        ve->SetQI(0);
+    else
+        ve->SetQI(100);
 
-        if (invisVotes > 0 && visVotes > 0)
-            (*ve)->MarkInconsistent();
+    if (invisVotes > 0 && visVotes > 0)
+        ve->MarkInconsistent();
 
-        if (invisVotes == 0 && visVotes == 0){
-            (*ve)->MarkAmbiguous();
-        }
+    if (invisVotes == 0 && visVotes == 0){
+        ve->MarkAmbiguous();
+    }
 
-        (*ve)->visVotes = visVotes;
-        (*ve)->invisVotes = invisVotes;
+    ve->visVotes = visVotes;
+    ve->invisVotes = invisVotes;
 
-        //    assert(invisVotes + visVotes > 0);
+    //    assert(invisVotes + visVotes > 0);
 
-        // occluders --
-        for(set<ViewShape*>::iterator o=occluders.begin(),    oend=occluders.end(); o!=oend; ++o)
-            (*ve)->AddOccluder((*o));
+    // occluders --
+    for(set<ViewShape*>::iterator o=occluders.begin(),    oend=occluders.end(); o!=oend; ++o)
+        ve->AddOccluder((*o));
 
-        // occludee --
-        if(!aFaces.empty())
+    // occludee --
+    if(!aFaces.empty())
+    {
+        if(aFaces.size() <= (float)nSamples/2.f)
         {
-            if(aFaces.size() <= (float)nSamples/2.f)
-            {
-                (*ve)->SetaShape(0);
-            }
-            else
-            {
-                vector<Polygon3r*>::iterator p = aFaces.begin();
-                WFace * wface = (WFace*)((*p)->userdata);
-                ViewShape *vshape = ioViewMap->viewShape(wface->GetVertex(0)->shape()->GetId());
-                ++p;
-                (*ve)->SetaShape(vshape);
-            }
+            ve->SetaShape(0);
         }
-
-        if(progressBarDisplay)
+        else
         {
-            counter--;
-            if (counter <= 0)
-            {
-                counter = progressBarStep;
-                _pProgressBar->setProgress(_pProgressBar->getProgress() + 1);
-            }
+            vector<Polygon3r*>::iterator p = aFaces.begin();
+            WFace * wface = (WFace*)((*p)->userdata);
+            ViewShape *vshape = ioViewMap->viewShape(wface->GetVertex(0)->shape()->GetId());
+            ++p;
+            ve->SetaShape(vshape);
         }
-        aFaces.clear();
     }
 }
 
@@ -2332,7 +2515,7 @@ void ViewMapBuilder::ComputeFastRayCastingVisibility(ViewMap *ioViewMap, Grid* i
     unsigned qiClasses[256];
     unsigned maxIndex, maxCard;
     unsigned qiMajority;
-    static unsigned timestamp = 1;
+    GridRay ray;
     bool even_test;
     for(vector<ViewEdge*>::iterator ve=vedges.begin(), veend=vedges.end();
         ve!=veend;
@@ -2363,7 +2546,7 @@ void ViewMapBuilder::ComputeFastRayCastingVisibility(ViewMap *ioViewMap, Grid* i
             if (even_test)
             {
                 if((maxCard < qiMajority)) {
-                    tmpQI = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon, occluders, &aFace, timestamp++);
+                    tmpQI = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon, occluders, &aFace, ray);
 
                     if(tmpQI >= 256)
                         cerr << "Warning: too many occluding levels" << endl;
@@ -2374,7 +2557,7 @@ void ViewMapBuilder::ComputeFastRayCastingVisibility(ViewMap *ioViewMap, Grid* i
                     }
                 }
                 else
-                    FindOccludee(fe, iGrid, epsilon, &aFace, timestamp++);
+                    FindOccludee(fe, iGrid, epsilon, &aFace, ray);
 
                 if(aFace)
                 {
@@ -2455,7 +2638,7 @@ void ViewMapBuilder::ComputeVeryFastRayCastingVisibility(ViewMap *ioViewMap, Gri
     FEdge* fe;
     unsigned qi = 0;
     Polygon3r *aFace = 0;
-    static unsigned timestamp = 1;
+    GridRay ray;
     for(vector<ViewEdge*>::iterator ve=vedges.begin(), veend=vedges.end();
         ve!=veend;
         ve++)
@@ -2463,7 +2646,7 @@ void ViewMapBuilder::ComputeVeryFastRayCastingVisibility(ViewMap *ioViewMap, Gri
         set<ViewShape*> occluders;
 
         fe = (*ve)->fedgeA();
-        qi = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon, occluders, &aFace, timestamp++);
+        qi = ComputeRayCastingVisibility(ioViewMap, fe, iGrid, epsilon, occluders, &aFace, ray);
         if(aFace)
         {
             fe->SetaFace(*aFace);
@@ -2489,14 +2672,14 @@ void ViewMapBuilder::ComputeVeryFastRayCastingVisibility(ViewMap *ioViewMap, Gri
 }
 
 
-void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, unsigned timestamp, 
+void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, GridRay& ray, 
                                   Vec3r& u, Vec3r& A, Vec3r& origin, Vec3r& edge, vector<WVertex*>& faceVertices)
 {
     WFace *face = 0;
 
     if(fe->isSmooth())
     {
-        FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(fe);
+        FEdgeSmooth * fes = asFEdgeSmooth(fe);
         face = (WFace*)fes->face();
     }
 
@@ -2517,7 +2700,7 @@ void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3
         occluders.clear();
         // we cast a ray from A in the same direction but looking behind
         Vec3r v(-u[0],-u[1],-u[2]);
-        iGrid->castInfiniteRay(A, v, occluders, timestamp);
+        iGrid->castInfiniteRay(A, v, occluders, ray);
 
         bool noIntersection = true;
         real mint=FLT_MAX;
@@ -2598,7 +2781,7 @@ void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3
     }
 }
 
-void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, unsigned timestamp)
+void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, GridRay& ray)
 {
     OccludersSet occluders;
 
@@ -2618,13 +2801,13 @@ void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3
 
     WFace *face = 0;
     if(fe->isSmooth()){
-        FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(fe);
+        FEdgeSmooth * fes = asFEdgeSmooth(fe);
         face = (WFace*)fes->face();
     }
     if(0 != face)
         face->RetrieveVertexList(faceVertices);
 
-    return FindOccludee(fe,iGrid, epsilon, oaPolygon, timestamp,
+    return FindOccludee(fe,iGrid, epsilon, oaPolygon, ray,
                         u, A, origin, edge, faceVertices);
 }
 
@@ -2632,7 +2815,7 @@ void ViewMapBuilder::FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3
 
 
 int ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, Grid* iGrid, real epsilon, set<ViewShape*>& oOccluders,
-                                                Polygon3r** oaPolygon, unsigned timestamp)
+                                                Polygon3r** oaPolygon, GridRay& ray)
 {
     // return -1 for "can't tell"
 
@@ -2679,7 +2862,7 @@ int ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, G
         //        if (_useConsistency && edge->GetbFace() != NULL && !((WXFace*)edge->GetbFace())->consistent())
         //            return -1;
 
-        assert(dynamic_cast<FEdgeSharp*>(fe) != NULL);
+        assert(asFEdgeSharp(fe) != NULL);
 
 
         // don't do visibility on any fedge adjacent to a cusp.  they can be unreliable.
@@ -2783,11 +2966,11 @@ int ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, G
 
     if (fe->isSmooth() && (fe->getNature() & Nature::SILHOUETTE))
     {
-        face = (WXFace*)(dynamic_cast<FEdgeSmooth*>(fe)->face());
+        face = (WXFace*)(asFEdgeSmooth(fe)->face());
         assert(face != NULL);
     }
 
-    iGrid->castRay(center, Vec3r(_viewpoint), occluders, timestamp);
+    iGrid->castRay(center, Vec3r(_viewpoint), occluders, ray);
 
     vector<WVertex*> faceVertices;
     WVertex::incoming_edge_iterator ie;
@@ -2889,7 +3072,7 @@ int ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, G
     }
 
     // Find occludee
-    FindOccludee(fe,iGrid, epsilon, oaPolygon, timestamp,
+    FindOccludee(fe,iGrid, epsilon, oaPolygon, ray,
                  u, center, edge, origin, faceVertices);
 
     return qi;
@@ -2900,7 +3083,7 @@ int ViewMapBuilder::ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, G
 
 
 int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid, real epsilon, set<ViewShape*>& oOccluders,
-                                                        Polygon3r** oaPolygon, unsigned timestamp)
+                                                        Polygon3r** oaPolygon, GridRay& ray)
 {
     OccludersSet occluders;
     int qi = 0;
@@ -2930,6 +3113,7 @@ int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid,
     //  visDebugNode->AddChild(debugNode);
 
     NodeShape * igdg = new NodeShape();
+#pragma omp critical(visDebugNode)
     visDebugNode->AddChild(igdg);
 
     // Aaron: check against clipping planes
@@ -2979,7 +3163,7 @@ int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid,
 
     //  printf("_viewpoint = %f %f %f\n", _viewpoint[0], _viewpoint[1], _viewpoint[2]);
 
-    iGrid->castRay(center, Vec3r(_viewpoint), occluders, timestamp);
+    iGrid->castRay(center, Vec3r(_viewpoint), occluders, ray);
 
     // the faces this intersection came from
     WXFace * face1 = (WXFace*)fe->getFace1();
@@ -2988,7 +3172,7 @@ int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid,
     // for smooth edges: the face the edge came from
     WXFace *face = 0;
 
-    FEdgeIntersection * fei = dynamic_cast<FEdgeIntersection*>(fe);
+    FEdgeIntersection * fei = asFEdgeIntersection(fe);
     if (fei != NULL)
     {
         face1 = (WXFace*)fei->getFace1();
@@ -2998,7 +3182,7 @@ int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid,
     {
         if(fe->isSmooth())
         {
-            FEdgeSmooth * fes = dynamic_cast<FEdgeSmooth*>(fe);
+            FEdgeSmooth * fes = asFEdgeSmooth(fe);
             face = (WXFace*)fes->face();
         }
     }
@@ -3105,7 +3289,7 @@ int ViewMapBuilder::ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid,
     }
 
     // Find occludee
-    FindOccludee(fe,iGrid, epsilon, oaPolygon, timestamp,
+    FindOccludee(fe,iGrid, epsilon, oaPolygon, ray,
                  u, center, edge, origin, faceVertices);
 
 
@@ -3307,6 +3491,166 @@ struct silhouette_binary_rule_no_same_face : public binary_rule<segment,segment>
 */
 
 
+// Choice of all-pairs 2D intersection algorithm in ComputeCurveIntersections:
+// the tiled sweep (below) when 1, otherwise the single sweep line (or the brute force test in the #else branch)
+#define TILED_CURVE_INTERSECTIONS 1
+
+// an intersection found in one tile, before it is turned into an Intersection object
+struct tile_intersection
+{
+    segment * S;         // the segment that the sweep line would add second
+    segment * currentS;  // the segment that would already be in the active set
+    real t,u;
+};
+
+// 2D endpoints of a segment, in the order of its FEdge (as SweepLine::add passes them)
+static inline void segmentEndpoints(segment & S, Vec2r & v0, Vec2r & v1)
+{
+    Vec3r a = S[0];
+    Vec3r b = S[1];
+    if (!S.order())
+        swap(a,b);
+    v0 = Vec2r(a[0],a[1]);
+    v1 = Vec2r(b[0],b[1]);
+}
+
+// Tiled version of the sweep line. Segments are binned by their 2D bounding boxes into the
+// cells of a Grid2D, and each cell is swept independently (in parallel when OpenMP is available).
+// A pair is only tested in the cell that holds the lower corner of the overlap of the two
+// bounding boxes, so an intersection that straddles a tile border is found exactly once.
+// The per-pair tests are the ones from SweepLine::add, with the segments in the same roles.
+// Pairs whose bounding boxes are disjoint are never tested, since they cannot intersect.
+
+static void ComputeTiledIntersections(vector<segment> & segments, set<segment*> & iedges,
+                                      vector<intersection*> & intersections)
+{
+    int numSegments = segments.size();
+    if (numSegments == 0)
+        return;
+
+    // ------- bounding boxes and the grid -------
+
+    vector<Vec2r> bbmin(numSegments), bbmax(numSegments);
+    Vec2r minLoc, maxLoc;
+    for(int i=0;i<numSegments;i++)
+    {
+        Vec3r a = segments[i][0];
+        Vec3r b = segments[i][1];
+        bbmin[i] = Vec2r(min(a[0],b[0]), min(a[1],b[1]));
+        bbmax[i] = Vec2r(max(a[0],b[0]), max(a[1],b[1]));
+        for(int j=0;j<2;j++)
+        {
+            if (i == 0 || bbmin[i][j] < minLoc[j])
+                minLoc[j] = bbmin[i][j];
+            if (i == 0 || bbmax[i][j] > maxLoc[j])
+                maxLoc[j] = bbmax[i][j];
+        }
+    }
+    if (maxLoc[0] <= minLoc[0] && maxLoc[1] <= minLoc[1])
+        maxLoc += Vec2r(1,1);
+
+    // aim for a few dozen segments per cell
+    int dim = max(1, min(256, int(sqrt(numSegments / 32.0))));
+    Grid2D grid(dim, minLoc, maxLoc);
+
+    // cell index ranges of each segment's bounding box; the mapping is monotonic, so the cell of
+    // the overlap corner of two boxes is the componentwise max of their lower cells
+    vector<Vec2i> cellMin(numSegments), cellMax(numSegments);
+    for(int i=0;i<numSegments;i++)
+    {
+        Vec2r lo = grid.pt2grid(bbmin[i]);
+        Vec2r hi = grid.pt2grid(bbmax[i]);
+        for(int j=0;j<2;j++)
+        {
+            cellMin[i][j] = min(max(int(floor(lo[j])),0),dim-1);
+            cellMax[i][j] = min(max(int(floor(hi[j])),0),dim-1);
+        }
+
+        for(int x=cellMin[i][0];x<=cellMax[i][0];x++)
+            for(int y=cellMin[i][1];y<=cellMax[i][1];y++)
+                grid.cell(x,y).edges.push_back(segments[i].edge());
+    }
+
+    // ------- sweep each cell -------
+
+    vector<vector<tile_intersection> > found(dim*dim);
+
+#pragma omp parallel for schedule(dynamic)
+    for(int c=0;c<dim*dim;c++)
+    {
+        int cx = c / dim;
+        int cy = c % dim;
+        vector<FEdge*> & edges = grid.cell(cx,cy).edges;
+        if (edges.size() < 2)
+            continue;
+
+        // segments of this cell, by increasing left end
+        vector<pair<real,int> > order(edges.size());
+        for(unsigned k=0;k<edges.size();k++)
+        {
+            int i = (segment*)edges[k]->userdata - &segments[0];
+            order[k] = make_pair(bbmin[i][0], i);
+        }
+        sort(order.begin(), order.end());
+
+        silhouette_binary_rule_no_same_face sbr;
+
+        for(unsigned k=0;k<order.size();k++)
+        {
+            int i = order[k].second;
+            for(unsigned l=k+1;l<order.size() && order[l].first <= bbmax[i][0];l++)
+            {
+                int j = order[l].second;
+
+                if (bbmin[j][1] > bbmax[i][1] || bbmin[i][1] > bbmax[j][1])
+                    continue;
+
+                if (max(cellMin[i][0],cellMin[j][0]) != cx || max(cellMin[i][1],cellMin[j][1]) != cy)
+                    continue;  // this pair is tested in another cell
+
+                // the sweep line adds segments in the order of their first (lowest) endpoint
+                segment * currentS = &segments[i];
+                segment * S = &segments[j];
+                if ((*S)[0] < (*currentS)[0])
+                    swap(S, currentS);
+
+                if(true != sbr(*S, *currentS))
+                    continue;
+
+                Vec3r CP;
+                if(S->CommonVertex(*currentS, CP))
+                    continue; // the two edges have a common vertex->no need to check
+
+                Vec2r v0, v1, v2, v3;
+                segmentEndpoints(*S, v0, v1);
+                segmentEndpoints(*currentS, v2, v3);
+
+                tile_intersection ti;
+                if(GeomUtils::intersect2dSeg2dSegParametric(v0, v1, v2, v3, ti.t, ti.u) == GeomUtils::DO_INTERSECT)
+                {
+                    ti.S = S;
+                    ti.currentS = currentS;
+                    found[c].push_back(ti);
+                }
+            }
+        }
+    }
+
+    // ------- gather the intersections, in cell order -------
+
+    for(unsigned c=0;c<found.size();c++)
+        for(vector<tile_intersection>::iterator it = found[c].begin(); it != found[c].end(); ++it)
+        {
+            intersection * inter = new intersection(it->S, it->t, it->currentS, it->u);
+            intersections.push_back(inter);
+            it->S->AddIntersection(inter);
+            it->currentS->AddIntersection(inter);
+            iedges.insert(it->S);
+            iedges.insert(it->currentS);
+        }
+}
+
+
 void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_algo iAlgo, real epsilon)
 {
     printf("Computing image-space intersections\n");
@@ -3360,25 +3704,37 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
 
     unsigned counter = progressBarStep;
 
-#if 1
-
-    // ------------------------ compute sweep line (all-pairs 2D intersections) ---------
-    printf("\t sweep line\n");
-
     sort(svertices.begin(), svertices.end(), less_SVertex2D(0));//epsilon));
 
-    SweepLine<FEdge*,Vec3r> SL;
-
-    vector<segment* > segments;
+    // one segment per FEdge, stored contiguously and reached through the FEdge userdata
+    vector<segment> segments;
+    segments.reserve(fEdgesSize);
 
     vector<FEdge*>::iterator fe,fend;
 
     for(fe=ioViewMap->FEdges().begin(), fend=ioViewMap->FEdges().end(); fe!=fend; fe++)
-    {
-        segment * s = new segment((*fe), (*fe)->vertexA()->point2D(), (*fe)->vertexB()->point2D());
-        (*fe)->userdata = s;
-        segments.push_back(s);
-    }
+        segments.push_back(segment((*fe), (*fe)->vertexA()->point2D(), (*fe)->vertexB()->point2D()));
+    for(unsigned i=0;i<segments.size();i++)
+        segments[i].edge()->userdata = &segments[i];
+
+#if TILED_CURVE_INTERSECTIONS
+
+    // ------------------------ compute tiled sweep (all-pairs 2D intersections) ---------
+    printf("\t tiled sweep line\n");
+
+    // the intersected edges:
+    set<segment*> iedges;
+    // the intersections (deleted at the end):
+    vector<intersection*> intersections;
+
+    ComputeTiledIntersections(segments, iedges, intersections);
+
+#elif 1
+
+    // ------------------------ compute sweep line (all-pairs 2D intersections) ---------
+    printf("\t sweep line\n");
+
+    SweepLine<FEdge*,Vec3r> SL;
 
     const real SLepsilon =0.0;
 
@@ -3421,17 +3777,6 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
     // ----------------- Brute force intersection test O(n^2) ----------------------
     printf("\t brute force\n");
 
-    vector<segment* > segments;
-
-    vector<FEdge*>::iterator fe,fend;
-
-    for(fe=ioViewMap->FEdges().begin(), fend=ioViewMap->FEdges().end(); fe!=fend; fe++)
-    {
-        segment * s = new segment((*fe), (*fe)->vertexA()->point2D(), (*fe)->vertexB()->point2D());
-        (*fe)->userdata = s;
-        segments.push_back(s);
-    }
-
     // the intersected edges:
     set<segment*> iedges;
     // the intersections:
@@ -3440,9 +3785,9 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
     // use a binary rule that only detects certain intersections (see comments for it above)
     silhouette_binary_rule_no_same_face sbr;
 
-    for(vector<segment*>::iterator s1_it=segments.begin(); s1_it!=segments.end(); s1_it++)
+    for(vector<segment>::iterator s1_it=segments.begin(); s1_it!=segments.end(); s1_it++)
     {
-        segment* S = (*s1_it);
+        segment* S = &(*s1_it);
 
         real t,u;
         Vec3r CP;
@@ -3461,9 +3806,9 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
             v0[0] = ((*S)[1])[0];
             v0[1] = ((*S)[1])[1];
         }
-        for(vector<segment*>::iterator s2_it=(s1_it+1); s2_it!=segments.end(); s2_it++)
+        for(vector<segment>::iterator s2_it=(s1_it+1); s2_it!=segments.end(); s2_it++)
         {
-            segment* currentS = (*s2_it);
+            segment* currentS = &(*s2_it);
             if(true != sbr(*S, *currentS))
                 continue;
 
@@ -3578,7 +3923,7 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
         feit != ioViewMap->FEdges().end(); ++feit)
         if (! (*feit)->isSmooth())
         {
-            assert(dynamic_cast<FEdgeSharp*>(*feit) != NULL);
+            assert(asFEdgeSharp(*feit) != NULL);
             FEdgeSharp * fes = (FEdgeSharp*)*feit;
 
             assert(edgemap.find(fes->edge()) == edgemap.end());
@@ -3607,7 +3952,7 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
         if (it == edgemap.end())
             continue;
 
-        assert(svSmooth->viewvertex() == NULL || dynamic_cast<NonTVertex*>(svSmooth->viewvertex())!=NULL);
+        assert(svSmooth->viewvertex() == NULL || asNonTVertex(svSmooth->viewvertex())!=NULL);
 
         FEdgeSharp * feSharp = (*it).second;
 
@@ -3649,7 +3994,7 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
         if (oldVV != NULL)
         {
             // if we're at a boundary, replace the viewvertex
-            assert(dynamic_cast<NonTVertex*>(oldVV) != NULL);
+            assert(asNonTVertex(oldVV) != NULL);
             NonTVertex * ntv = (NonTVertex*)oldVV;
             assert(ntv->viewedges().size() == 1);
             assert(ntv->viewedges()[0].first == feSmooth->viewedge());
@@ -3836,10 +4181,15 @@ void ViewMapBuilder::ComputeCurveIntersections(ViewMap *ioViewMap, visibility_al
 
 
     // delete segments
-    for(vector<segment*>::iterator s=segments.begin(); s!= segments.end(); s++)
-        delete *s;
     segments.clear();
 
+#if TILED_CURVE_INTERSECTIONS
+    // delete intersections (the sweep line owns them otherwise)
+    for(vector<intersection*>::iterator i=intersections.begin(); i!=intersections.end(); i++)
+        delete *i;
+    intersections.clear();
+#endif
+
     ViewMap::viewvertices_container& vvertices = ioViewMap->ViewVertices();
     for(ViewMap::viewvertices_container::iterator vv=vvertices.begin(), vvend=vvertices.end();
         vv!=vvend;
@@ -3894,8 +4244,8 @@ void ViewMapBuilder::PropagateVisibilty(ViewMap *ioViewMap)
                 (*vit)->MarkAmbiguous();
 
         // Spurious cusps heuristic
-        NonTVertex * vertA = dynamic_cast<NonTVertex*>((*vit)->A());
-        NonTVertex * vertB = dynamic_cast<NonTVertex*>((*vit)->B());
+        NonTVertex * vertA = asNonTVertex((*vit)->A());
+        NonTVertex * vertB = asNonTVertex((*vit)->B());
         if (vertA != NULL && vertB != NULL)
             if((vertA->getNature() & Nature::CUSP) && (vertB->getNature() & Nature::CUSP)
                     && ((*vit)->fedgeA()->nextEdge() == NULL)){
@@ -3927,8 +4277,8 @@ void ViewMapBuilder::PropagateVisibilty(ViewMap *ioViewMap)
                 continue;
 
             // Spurious cusps heuristic
-            NonTVertex * vertA = dynamic_cast<NonTVertex*>(edge->A());
-            NonTVertex * vertB = dynamic_cast<NonTVertex*>(edge->B());
+            NonTVertex * vertA = asNonTVertex(edge->A());
+            NonTVertex * vertB = asNonTVertex(edge->B());
             if (vertA != NULL && vertB != NULL)
                 if(vertA->getNature() & Nature::CUSP && vertB->getNature() & Nature::CUSP){
                     ViewEdge * mateA = NULL;
@@ -3950,8 +4300,8 @@ void ViewMapBuilder::PropagateVisibilty(ViewMap *ioViewMap)
             // Fix visibility of tiny bits
             real arcLength = ArcLength2D(edge,FLT_MAX);
             if(arcLength<=0.01){
-                TVertex * vertA = dynamic_cast<TVertex*>(edge->A());
-                TVertex * vertB = dynamic_cast<TVertex*>(edge->B());
+                TVertex * vertA = asTVertex(edge->A());
+                TVertex * vertB = asTVertex(edge->B());
                 if (vertA != NULL && vertB != NULL){
                     ViewEdge * mateA = vertA->mate(edge);
                     ViewEdge * mateB = vertB->mate(edge);
@@ -3974,7 +4324,7 @@ void ViewMapBuilder::PropagateVisibilty(ViewMap *ioViewMap)
                 if (v[i] == NULL)
                     continue;
 
-                TVertex * tvert = dynamic_cast<TVertex*>(v[i]);
+                TVertex * tvert = asTVertex(v[i]);
                 if (tvert != NULL)
                 {
                     if (tvert->frontEdgeA().first == edge || tvert->frontEdgeB().first == edge)
@@ -4037,13 +4387,13 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
       if (ve->A()->getNature() & Nature::CUSP)
     {
-      assert(dynamic_cast<NonTVertex*>(ve->A()) != NULL);
+      assert(asNonTVertex(ve->A()) != NULL);
       cuspVertex = (NonTVertex*)ve->A();
     }
       else
     if (ve->A()->getNature() & Nature::T_VERTEX)
       {
-        assert(dynamic_cast<TVertex*>(ve->A()) != NULL);
+        assert(asTVertex(ve->A()) != NULL);
         tvert = (TVertex*)ve->A();
       }
     else
@@ -4051,13 +4401,13 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
       if (ve->B()->getNature() & Nature::CUSP)
     {
-      assert(dynamic_cast<NonTVertex*>(ve->B()) != NULL);
+      assert(asNonTVertex(ve->B()) != NULL);
       cuspVertex = (NonTVertex*)ve->B();
     }
       else
     if (ve->B()->getNature() & Nature::T_VERTEX)
       {
-        assert(dynamic_cast<TVertex*>(ve->B()) != NULL);
+        assert(asTVertex(ve->B()) != NULL);
         tvert = (TVertex*)ve->B();
       }
     else
@@ -4114,7 +4464,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
       if (!( (*vit)->getNature() & Nature::CUSP))
     continue;
 
-      assert(dynamic_cast<NonTVertex*>(*vit) != NULL);
+      assert(asNonTVertex(*vit) != NULL);
       NonTVertex * cuspVertex = (NonTVertex*)*vit;
 
       assert(cuspVertex->viewedges().size() == 2);
@@ -4161,7 +4511,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
       assert(nextVertex != NULL);
 
-      TVertex * tvert = dynamic_cast<TVertex*>(nextVertex);
+      TVertex * tvert = asTVertex(nextVertex);
       if (tvert != NULL)
         {
           ViewEdge * mate = tvert->mate(currentEdge);
@@ -4179,7 +4529,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
         }
       else
         {
-          assert(dynamic_cast<NonTVertex*>(nextVertex) != NULL);
+          assert(asNonTVertex(nextVertex) != NULL);
           NonTVertex * ntv = (NonTVertex*)(nextVertex);
 
           if (ntv->viewedges().size() != 2)
@@ -4221,7 +4571,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
       for(vector<ViewVertex*>::iterator vit = ioViewMap->ViewVertices().begin(); vit != ioViewMap->ViewVertices().end(); ++vit)
     {
-      TVertex * tv = dynamic_cast<TVertex*>(*vit);
+      TVertex * tv = asTVertex(*vit);
       if (tv == NULL)// || tv->sameFace())
         continue;
 
@@ -4265,7 +4615,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
             }
 
           // continue along the next viewedge
-          TVertex * tvert = dynamic_cast<TVertex*>(nextVertex);
+          TVertex * tvert = asTVertex(nextVertex);
           if (tvert != NULL)
             {
               if (!tvert->sameFace())
@@ -4294,7 +4644,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
             }
           else
             {
-              assert(dynamic_cast<NonTVertex*>(nextVertex) != NULL);
+              assert(asNonTVertex(nextVertex) != NULL);
               NonTVertex * ntv = (NonTVertex*)(nextVertex);
 
               if (ntv->viewedges().size() != 2) // not sure if there's something sensible to do here. the purpose of this iteration is silhouettes, which shoudn't have these bifurcations
@@ -4348,7 +4698,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
   for(vector<ViewVertex*>::iterator vit = ioViewMap->ViewVertices().begin(); vit != ioViewMap->ViewVertices().end(); ++vit)
     {
-      TVertex * tv = dynamic_cast<TVertex*>(*vit);
+      TVertex * tv = asTVertex(*vit);
       if (tv == NULL || visited.find(tv) != visited.end())
     continue;
 
@@ -4404,7 +4754,7 @@ void ViewMapBuilder::TrimCuspCurves(ViewMap * ioViewMap)
 
 ViewEdge * AdvanceAlongVertex(ViewVertex * nextVertex, ViewEdge * lastEdge)
 {
-    TVertex * tvert = dynamic_cast<TVertex*>(nextVertex);
+    TVertex * tvert = asTVertex(nextVertex);
 
     if (tvert != NULL)
     {
@@ -4428,7 +4778,7 @@ ViewEdge * AdvanceAlongVertex(ViewVertex * nextVertex, ViewEdge * lastEdge)
         return NULL;
     }
 
-    assert(dynamic_cast<NonTVertex*>(nextVertex) != NULL);
+    assert(asNonTVertex(nextVertex) != NULL);
     NonTVertex * ntv = (NonTVertex*)(nextVertex);
 
     if (ntv->viewedges().size() != 2) // not sure if there's something sensible to do here. the purpose of this iteration is silhouettes, which shoudn't have these bifurcations
@@ -4446,7 +4796,7 @@ ViewEdge * AdvanceAlongVertex(ViewVertex * nextVertex, ViewEdge * lastEdge)
 
 inline int NumEdges(ViewVertex * vv)
 {
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     if (tv != NULL)
         return tv->numEdges();
     return  ((NonTVertex*)vv)->viewedges().size();
@@ -4454,7 +4804,7 @@ inline int NumEdges(ViewVertex * vv)
 
 inline ViewEdge * GetEdge(ViewVertex * vv, int i)
 {
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
     if (tv != NULL)
         return tv->getEdge(i)->first;
     return ((NonTVertex*)vv)->viewedges()[i].first;
@@ -4485,19 +4835,19 @@ int NumVisibleEdgesNTV(NonTVertex * ntv)
 inline
 int NumVisibleEdges(ViewVertex * vv)
 {
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
 
     if (tv != NULL)
         return NumVisibleEdgesTV(tv);
 
-    assert(dynamic_cast<NonTVertex*>(vv) != NULL);
+    assert(asNonTVertex(vv) != NULL);
     return NumVisibleEdgesNTV((NonTVertex*)vv);
 }
 
 // if this vertex has a SINGLE visible outgoing edge, return it.  otherwise, return NULL
 ViewEdge * GetSoleVisibleEdge(ViewVertex * vv)
 {
-    TVertex * tv = dynamic_cast<TVertex*>(vv);
+    TVertex * tv = asTVertex(vv);
 
     if (tv != NULL)
     {
@@ -4514,7 +4864,7 @@ ViewEdge * GetSoleVisibleEdge(ViewVertex * vv)
         return ve;
     }
 
-    assert(dynamic_cast<NonTVertex*>(vv) != NULL);
+    assert(asNonTVertex(vv) != NULL);
     NonTVertex * ntv = (NonTVertex*)vv;
 
     ViewEdge * ve = NULL;
@@ -4575,7 +4925,7 @@ bool ViewMapBuilder::HideDeadEnds(ViewMap * ioViewMap)
             }
 
             /*
-      TVertex * tv = dynamic_cast<TVertex*>(nextVertex);
+      TVertex * tv = asTVertex(nextVertex);
 
       // if this is a TrueTVertex, we've succeeded in finding a dead-end curve to hide.
       if (tv != NULL && !tv->sameFace() && tv->frontEdgeA().first->qi() == 0 && tv->frontEdgeB().first->qi() == 0 &&
@@ -4625,7 +4975,7 @@ bool ViewMapBuilder::HideDeadEnds(ViewMap * ioViewMap)
 
 ViewEdge * AdvanceAlongVertex2(ViewVertex * nextVertex, ViewEdge * lastEdge)
 {
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(nextVertex);
+    NonTVertex * ntv = asNonTVertex(nextVertex);
     if (ntv != NULL)
     {
         for(int i=0;i<ntv->viewedges().size();i++)
@@ -4650,7 +5000,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
     for(vector<ViewVertex*>::iterator vit = ioViewMap->ViewVertices().begin(); vit != ioViewMap->ViewVertices().end(); ++vit)
     {
         ViewVertex * startVertex = *vit;
-        TVertex* startTVertex = dynamic_cast<TVertex*>(startVertex);
+        TVertex* startTVertex = asTVertex(startVertex);
         if(!startTVertex)
             continue;
 
@@ -4686,11 +5036,11 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
 
             real arclength = ArcLength2D(startEdge,2*_cuspTrimThreshold);
             if(arclength < _cuspTrimThreshold){
-                TVertex* endTVertex = dynamic_cast<TVertex*>(endVertex);
+                TVertex* endTVertex = asTVertex(endVertex);
 
                 if(!endTVertex){
                     // NonTVertex case
-                    NonTVertex* endNTVertex = dynamic_cast<NonTVertex*>(endVertex);
+                    NonTVertex* endNTVertex = asNonTVertex(endVertex);
                     if(endNTVertex->viewedges().size()==3){
                         bool found = false;
                         ViewEdge* thirdEdge = NULL;
@@ -4736,7 +5086,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                     }
                 }
                 if(midEdge){
-                    endTVertex = dynamic_cast<TVertex*>(endVertex);
+                    endTVertex = asTVertex(endVertex);
                     if(!endTVertex)
                         continue;
                     numVisibleEdges = NumVisibleEdges(endVertex);
@@ -4753,7 +5103,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                         valid = (endTVertex->frontEdgeA().first == otherEdges[0]) || (endTVertex->frontEdgeA().first == otherEdges[1])
                                 || (endTVertex->frontEdgeB().first == otherEdges[0]) || (endTVertex->frontEdgeB().first == otherEdges[1]);
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->frontEdgeA().first->A());
+                            TVertex* midV = asTVertex(endTVertex->frontEdgeA().first->A());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4768,7 +5118,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                             }
                         }
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->frontEdgeB().first->B());
+                            TVertex* midV = asTVertex(endTVertex->frontEdgeB().first->B());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4788,7 +5138,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                         valid = (endTVertex->backEdgeA().first == otherEdges[0]) || (endTVertex->backEdgeA().first == otherEdges[1])
                                 || (endTVertex->backEdgeB().first == otherEdges[0]) || (endTVertex->backEdgeB().first == otherEdges[1]);
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->backEdgeA().first->A());
+                            TVertex* midV = asTVertex(endTVertex->backEdgeA().first->A());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4803,7 +5153,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                             }
                         }
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->backEdgeB().first->B());
+                            TVertex* midV = asTVertex(endTVertex->backEdgeB().first->B());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4828,7 +5178,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                         else if(endTVertex->frontEdgeA().first->qi()!=0 && endTVertex->frontEdgeB().first->qi()==0)
                             valid = (endTVertex->frontEdgeB().first == otherEdges[0]) || (endTVertex->frontEdgeB().first == otherEdges[1]);
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->frontEdgeA().first->A());
+                            TVertex* midV = asTVertex(endTVertex->frontEdgeA().first->A());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4843,7 +5193,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                             }
                         }
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->frontEdgeB().first->B());
+                            TVertex* midV = asTVertex(endTVertex->frontEdgeB().first->B());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4864,7 +5214,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                         else if(endTVertex->backEdgeA().first->qi()!=0 && endTVertex->backEdgeB().first->qi()==0)
                             valid = (endTVertex->backEdgeB().first == otherEdges[0]) || (endTVertex->backEdgeB().first == otherEdges[1]);
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->backEdgeA().first->A());
+                            TVertex* midV = asTVertex(endTVertex->backEdgeA().first->A());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -4879,7 +5229,7 @@ bool ViewMapBuilder::HideSmallBits(ViewMap * ioViewMap)
                             }
                         }
                         if(!valid){
-                            TVertex* midV = dynamic_cast<TVertex*>(endTVertex->backEdgeB().first->B());
+                            TVertex* midV = asTVertex(endTVertex->backEdgeB().first->B());
                             if(midV && (midV == otherEdges[0]->A() || midV == otherEdges[1]->B())){
                                 if(midV == midVertex){
                                     valid = true;
@@ -5026,7 +5376,7 @@ bool ViewMapBuilder::HideSmallLoopsAndDeadEnds(ViewMap * ioViewMap)
 
 ViewEdge * AdvanceAlongVertex3(ViewVertex * nextVertex, ViewEdge * lastEdge)
 {
-    NonTVertex * ntv = dynamic_cast<NonTVertex*>(nextVertex);
+    NonTVertex * ntv = asNonTVertex(nextVertex);
     if (ntv != NULL)
     {
         for(int i=0;i<ntv->viewedges().size();i++)
@@ -33,6 +33,7 @@
 
 # include <vector>
 # include <deque>
+# include <map>
 # include "../system/FreestyleConfig.h"
 # include "../geometry/Geom.h"
 # include "../scene_graph/NodeGroup.h"
@@ -57,6 +58,10 @@ using namespace Geometry;
 typedef enum { VALID, INCONSISTENT, PUNCH_OUT, UNKNOWN } POType;
 
 
+/*! Segment along which each pair of intersecting faces found by computeSelfIntersections intersects,
+ *  keyed by the pair in the order in which it was tested */
+typedef map<pair<const WFace*,const WFace*>, pair<Vec3r,Vec3r> > FaceSegmentMap;
+
 class LIB_VIEW_MAP_EXPORT ViewMapBuilder
 {
 private:
@@ -93,6 +98,15 @@ public:
         punch_out
     } visibility_algo;
 
+    /*! Structure holding the occluders, for ray casting and surface intersections.
+   *  The grid is filled before the builder runs (see SetGrid), so this is used
+   *  by the caller to pick the Grid subclass: a FastGrid or an OccluderBVH.
+   */
+    typedef enum {
+        occluder_grid,
+        occluder_bvh
+    } occluder_structure;
+
     inline ViewMapBuilder()
     {
         _pProgressBar = 0;
@@ -205,6 +219,12 @@ public:
 
 protected:
 
+    /*! Traces the intersection curve of two surfaces, starting from two intersecting faces */
+    void traceSelfIntersection(WFace * face1, WFace * face2,
+                               set<pair<const WFace*,const WFace*> > & processed,
+                               const FaceSegmentMap & segments,
+                               ViewShape * vshape, SShape * psShape);
+
     /*! Computes the 2D scene silhouette edges visibility
    *  using a ray casting. On each edge, a ray is cast
    *  to check its quantitative invisibility. The list
@@ -218,6 +238,12 @@ protected:
    *      edge.
    */
     void ComputeRayCastingVisibility(ViewMap *ioViewMap, Grid *iGrid, real epsilon, visibility_algo iAlgo);
+    /*! Computes the visibility of one ViewEdge by voting over its FEdges.
+   *  ViewEdges are independent, so this may run concurrently for different ViewEdges,
+   *  each thread passing its own GridRay.
+   */
+    void ComputeViewEdgeRayCastingVisibility(ViewMap *ioViewMap, ViewEdge *ve, Grid *iGrid, real epsilon,
+                                             visibility_algo iAlgo, GridRay& ray);
     void ComputeFastRayCastingVisibility(ViewMap *ioViewMap, Grid *iGrid, real epsilon=1e-6);
     void ComputeVeryFastRayCastingVisibility(ViewMap *ioViewMap, Grid *iGrid, real epsilon=1e-6);
 
@@ -240,16 +266,16 @@ protected:
    *      The result is the shape id stored in oShapeId
    */
     int ComputeRayCastingVisibility(ViewMap *ioViewMap, FEdge *fe, Grid* iGrid, real epsilon, set<ViewShape*>& oOccluders,
-                                    Polygon3r** oaPolygon, unsigned timestamp);
+                                    Polygon3r** oaPolygon, GridRay& ray);
     int ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid, real epsilon, set<ViewShape*>& oOccluders,
-                                            Polygon3r** oaPolygon, unsigned timestamp);
+                                            Polygon3r** oaPolygon, GridRay& ray);
 
     //  int ComputeRayCastingVisibilityPunchOut(FEdge *fe, Grid* iGrid, real epsilon, set<ViewShape*>& oOccluders,
     //					  Polygon3r** oaPolygon, unsigned timestamp);
 
     // FIXME
-    void FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, unsigned timestamp);
-    void FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, unsigned timestamp,
+    void FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, GridRay& ray);
+    void FindOccludee(FEdge *fe, Grid* iGrid, real epsilon, Polygon3r** oaPolygon, GridRay& ray,
                       Vec3r& u, Vec3r& A, Vec3r& origin, Vec3r& edge, vector<WVertex*>& faceVertices);
 
 
@@ -269,13 +295,11 @@ protected:
 
     // our punch-out visibility algorithm
     void ComputePunchOutVisibility(ViewMap * ioViewMap, WingedEdge & we, Grid * iGrid, real epsilon);
-    bool FloodFillInconsistent(WFace * startFace,
-                               vector<InconsistentTri> & inconsistentCones,
-                               std::deque<WFace*> & punchOutFaces,
-                               NodeShape * debugPunchOutNodes, int regionIndex);
-    void FloodFillPunchOut(std::deque<WFace*> & punchOutFaces,
-                           vector<InconsistentTri> & inconsistentCones,
-                           int POindex, NodeShape *debug);
+    bool FloodFillInconsistent(WFace * startFace, PunchOutRegion & region,
+                               NodeShape * debugPunchOutNodes, int regionIndex,
+                               vector<int> & POvisitIndex);
+    void FloodFillPunchOut(PunchOutRegion & region, int POindex,
+                           vector<int> & POvisitIndex, NodeShape *debug);
     void ComputePunchOutRegions(WingedEdge & we, Grid * iGrid);
     void ComputePunchOutIntersections(ViewMap *ioViewMap);
     bool IsInconsistentPoint(WFace * face, Vec3r point, Vec3r projectionDirection = Vec3r(0,0,0));
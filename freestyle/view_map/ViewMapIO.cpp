@@ -213,9 +213,9 @@ namespace ViewMapIO {
       FEdgeSmooth *fesmooth = 0;
       FEdgeSharp * fesharp  = 0;
       if(fe->isSmooth()){
-        fesmooth = dynamic_cast<FEdgeSmooth*>(fe);
+        fesmooth = asFEdgeSmooth(fe);
       }else{
-        fesharp = dynamic_cast<FEdgeSharp*>(fe);
+        fesharp = asFEdgeSharp(fe);
       }
 
       // Id
@@ -452,7 +452,7 @@ namespace ViewMapIO {
       vv->setNature(nature);
       
       if (vv->getNature() & Nature::T_VERTEX) {
-	TVertex* tv = dynamic_cast<TVertex*>(vv);
+	TVertex* tv = asTVertex(vv);
 
 	// Id
 	Id::id_type id1, id2;
@@ -495,7 +495,7 @@ namespace ViewMapIO {
 	tv->SetBackEdgeB(beb, b);
       }
       else if (vv->getNature() & Nature::NON_T_VERTEX) {
-	NonTVertex* ntv = dynamic_cast<NonTVertex*>(vv);
+	NonTVertex* ntv = asNonTVertex(vv);
 	
 	// SVertex
 	SVertex* sv;
@@ -674,8 +674,8 @@ namespace ViewMapIO {
 	return 1;
       }
 
-      FEdgeSmooth * fesmooth = dynamic_cast<FEdgeSmooth*>(fe);
-      FEdgeSharp * fesharp =  dynamic_cast<FEdgeSharp*>(fe);
+      FEdgeSmooth * fesmooth = asFEdgeSmooth(fe);
+      FEdgeSharp * fesharp =  asFEdgeSharp(fe);
       
       // Id
       Id::id_type id = fe->getId().getFirst();
@@ -871,7 +871,7 @@ namespace ViewMapIO {
       WRITE(nature);
       
       if (vv->getNature() & Nature::T_VERTEX) {
-	TVertex* tv = dynamic_cast<TVertex*>(vv);
+	TVertex* tv = asTVertex(vv);
 	
 	// Id
 	Id::id_type id = tv->getId().getFirst();
@@ -903,7 +903,7 @@ namespace ViewMapIO {
 	
       } 
       else if (vv->getNature() & Nature::NON_T_VERTEX) {
-	NonTVertex* ntv = dynamic_cast<NonTVertex*>(vv);
+	NonTVertex* ntv = asNonTVertex(vv);
 	
 	// SVertex
 	WRITE_IF_NON_NULL(ntv->svertex());
@@ -943,6 +943,8 @@ namespace ViewMapIO {
 
     Internal::g_vm = vm;
 
+    Arena::Scope arenaScope(vm->arena());
+
     // Management of the progress bar (if present)
     if (pb) {
       pb->reset();
@@ -91,7 +91,16 @@ def runStrokes(s):  # s is the settings module/class
 
     useOrientation = False
 
-    styleFilenames = map(lambda x: freestyleDir +'/style_modules/'+x, s.styleBasenames)
+    # "<library>:<module>" names a compiled style module, in the Freestyle lib directory
+    def styleFilename(x):
+        if ':' in x:
+            return os.path.abspath('../freestyle/lib/'+x)
+        return freestyleDir +'/style_modules/'+x
+    def styleLayerName(x):
+        if ':' in x:
+            return x.split(':')[-1]
+        return x[:-3]
+    styleFilenames = map(styleFilename, s.styleBasenames)
 
     print(styleFilenames)
 
@@ -143,7 +152,7 @@ def runStrokes(s):  # s is the settings module/class
     if s.saveLayers == True:
         snapshotBasename = s.shot+'_#_'+refstr
     else:
-        snapshotBasename = s.shot+'_'+s.styleBasenames[0][:-3]+'_'+refstr
+        snapshotBasename = s.shot+'_'+styleLayerName(s.styleBasenames[0])+'_'+refstr
 
     snapshotBasename = snapshotBasename + '_ts%d'%s.cuspTrimThreshold
     
@@ -208,6 +217,7 @@ def runStrokes(s):  # s is the settings module/class
                                    '-useOrientation',str(useOrientation),
                                    '-useConsistency',str(useConsistencyLocal),
                                    '-outputImage',snapshotFilename,
+                                   '-runFreestyleHeadless',str(s.runFreestyleHeadless),
                                    '-outputEPSPolyline',EPSFilenamePolyline,
                                    '-outputEPSThick',EPSFilenameThick,
                                    '-invertNormals',str(invertNormals),
@@ -295,7 +305,15 @@ def runStrokes(s):  # s is the settings module/class
                 print('bad focal length')
                 sys.exit(1)
 
-            if numFaces > 0:
+            if numFaces > 0 and s.runFreestyleHeadless and not s.runFreestyleInteractive:
+                Freestyle.runBatch(geomFilename, EPSFilenamePolyline, EPSFilenameThick,
+                                   arrayToMatrix(cameraData['worldTransform']),
+                                   cameraData['left'], cameraData['right'], cameraData['bottom'], cameraData['top'],
+                                   cameraData['pixelaspect'], cameraData['aspect'],
+                                   cameraData['near'],cameraData['far'], cameraData['focalLength'],
+                                   cameraData['xres'], cameraData['yres'],
+                                   vas[visAlgorithm], useConsistencyLocal, s.cuspTrimThreshold, s.graftThreshold, s.wiggleFactor, "", s.saveLayers)
+            elif numFaces > 0:
                 Freestyle.run(geomFilename,snapshotFilename, EPSFilenamePolyline, EPSFilenameThick,
                               arrayToMatrix(cameraData['worldTransform']),
                               cameraData['left'], cameraData['right'], cameraData['bottom'], cameraData['top'],
@@ -320,8 +338,8 @@ def runStrokes(s):  # s is the settings module/class
         if s.renderStrokes and buildName == 'macosx':
             if s.saveLayers == True:
                 for styleName in s.styleBasenames:
-                    os.system('pstopdf %s -o %s\n'%(EPSFilenamePolyline.replace('#',styleName[:-3]), PDFFilenamePolyline.replace('#',styleName[:-3])))
-                    os.system('pstopdf %s -o %s\n'%(EPSFilenameThick.replace('#',styleName[:-3]), PDFFilenameThick.replace('#',styleName[:-3])))
+                    os.system('pstopdf %s -o %s\n'%(EPSFilenamePolyline.replace('#',styleLayerName(styleName)), PDFFilenamePolyline.replace('#',styleLayerName(styleName))))
+                    os.system('pstopdf %s -o %s\n'%(EPSFilenameThick.replace('#',styleLayerName(styleName)), PDFFilenameThick.replace('#',styleLayerName(styleName))))
             else:
                 os.system('pstopdf %s -o %s\n'%(EPSFilenamePolyline, PDFFilenamePolyline))
                 os.system('pstopdf %s -o %s\n'%(EPSFilenameThick, PDFFilenameThick))
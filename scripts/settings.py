@@ -62,9 +62,11 @@ cullBackFaces = False
 # -------------------- freestyle NPR style ---------------------------------------------
 
 saveLayers = False # if True, export each selected style as an independant layer
+runFreestyleHeadless = False # if True, run Freestyle without a display: no TIFF snapshot, and density-based styles see a blank canvas
 #styleBasenames = ['paramVis3.py','plain.py']
 
 #styleBasenames = ['plain.py']           
+#styleBasenames = ['libcompiled_styles.so:taper']   # C++ version of taper.py, see freestyle/compiled_styles
 #styleBasenames = ['bsplineTaper.py']
 #styleBasenames = ['bsplineTaperThin.py']
 #styleBasenames = ['japanese_bigbrush.py']
@@ -94,7 +94,7 @@ real CameraModel::ImageSpaceArea(const vec3 & p0, const vec3 & p1, const vec3 &
 
     vec3 n = v2 ^ v1;
 
-    return 0.5*n*n;
+    return 0.5*length(n);
 }
 
 
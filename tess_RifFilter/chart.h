@@ -2,6 +2,7 @@
 #define __CHART_H__
 
 #include "paramPoint.h"
+#include <deque>
 
 // A chart is a bijective mapping between R^2 and a local neighborhood on a base mesh.  Different kinds of charts may be defined for different kinds of neighborhoods, and need not be isometric w.r.t. each other
 
@@ -29,23 +30,60 @@ public:
     bool PointInside(const ParamPoint<T> & pt) const;
 };
 
-// general vertex-centered chart data-structure
+// general vertex-centered chart data-structure.
+// Charts are only built for regular interior vertices, so the one-ring always has 4 faces and 9 vertices
+// (counting the origin); they are kept in small flat arrays, faces sorted by address.
 template<class T>
 class Chart
 {
 private:
+    enum { MAX_FACES = 4, MAX_VERTS = 9 };
+
     HbrVertex<T> * _origin; // vertex at the center of the chart
 
-    std::map<HbrFace<T>*, FaceMapQuad<T> > _faces; // list of adjacent faces and their UV<->AB mappings
-    std::map<HbrVertex<T>*, std::pair<real, real> > _verts; // list of vertices in the one-ring and their (A,B) coordinates
+    int _numFaces;
+    HbrFace<T> * _faces[MAX_FACES];     // adjacent faces
+    FaceMapQuad<T> _faceMaps[MAX_FACES]; // and their UV<->AB mappings
+
+    int _numVerts;
+    HbrVertex<T> * _verts[MAX_VERTS];   // vertices in the one-ring
+    real _vertA[MAX_VERTS], _vertB[MAX_VERTS]; // and their (A,B) coordinates
+
+    int FindFace(const HbrFace<T> * face) const;
+    int FindVertex(const HbrVertex<T> * vert) const;
 
 public:
+    Chart() { _origin = NULL; _numFaces = 0; _numVerts = 0; } // for STL initalizers
     Chart(HbrVertex<T> * origin);
+    HbrVertex<T> * Origin() const { return _origin; }
     bool ParamToAB(const ParamPoint<T> & pt, real & a, real & b) const;
     ParamPoint<T> ABtoParam(real a, real b) const;
     bool PointInside(const ParamPoint<T> & pt) const;
 };
 
+// The charts of one source mesh, built the first time they are asked for and kept until the surface is released.
+// Refinement asks for the same few charts over and over, so this replaces building a new chart for every query.
+// Each thread has a cache of its own (see Subdiv::chartCaches), so it needs no locking.
+template<class T>
+class ChartCache : public SubdivCache
+{
+public:
+    // the calling thread's cache for the surface that owns this vertex
+    static ChartCache<T> & ForVertex(const HbrVertex<T> * vertex);
+
+    // the chart centered on a regular interior vertex. The chart is owned by the cache.
+    const Chart<T> * Get(HbrVertex<T> * origin);
+
+    // scratch space for ParamPoint<T>::FindChart, reused from one call to the next
+    std::vector<HbrVertex<T>*> pointVerts;
+    std::vector<HbrFace<T>*> faces;
+    std::vector<HbrVertex<T>*> origins;
+    std::vector<HbrHalfedge<T>*> edges;
+
+private:
+    std::vector<int> _chartIndex;   // vertex ID -> index in _charts, -1 if it hasn't been built yet
+    std::deque<Chart<T> > _charts;  // a deque, so that the charts handed out stay put as it grows
+};
 
 
 #include "chartFunctions.h"
@@ -1,4 +1,5 @@
 #include "meshFunctions.h"
+#include <algorithm>
 
 
 // ============================ (A,B) PARAMETERIZATION FUNCTIONS ==============================
@@ -127,61 +128,93 @@ Chart<T>::Chart(HbrVertex<T>* origin)
     assert(origin->GetValence() == 4 && !origin->OnBoundary());
 
     _origin = origin;
+    _numFaces = 0;
+    _numVerts = 0;
 
     // collect the faces in the one-ring
-    std::list<HbrHalfedge<T>*> edges;
+    std::vector<HbrHalfedge<T>*> edges;
     origin->GetSurroundingEdges(std::back_inserter(edges));
 
-    for(typename std::list<HbrHalfedge<T>*>::iterator it = edges.begin(); it != edges.end(); ++it)
+    for(typename std::vector<HbrHalfedge<T>*>::iterator it = edges.begin(); it != edges.end(); ++it)
     {
-        if ( (*it)->GetLeftFace() != NULL && _faces.find( (*it)->GetLeftFace()) == _faces.end())
-            _faces[(*it)->GetLeftFace()] = FaceMapQuad<T>(origin, (*it)->GetLeftFace() );
-
-        if ( (*it)->GetRightFace() != NULL && _faces.find( (*it)->GetRightFace()) == _faces.end())
-            _faces[(*it)->GetRightFace()] = FaceMapQuad<T>(origin, (*it)->GetRightFace() );
+        HbrFace<T> * sides[2] = { (*it)->GetLeftFace(), (*it)->GetRightFace() };
+        for(int i=0;i<2;i++)
+            if (sides[i] != NULL && FindFace(sides[i]) == -1)
+            {
+                assert(_numFaces < MAX_FACES);
+                _faces[_numFaces++] = sides[i];
+            }
     }
 
+    // faces are kept in address order, which is the order ABtoParam tries them in
+    std::sort(_faces, _faces + _numFaces);
+
+    for(int i=0;i<_numFaces;i++)
+        _faceMaps[i] = FaceMapQuad<T>(origin, _faces[i]);
+
     // Get the AB coordinates for each vertex in the one-ring
 
-    for(typename std::map<HbrFace<T>*, FaceMapQuad<T> >::const_iterator it = _faces.begin(); it != _faces.end(); ++it)
+    for(int f=0;f<_numFaces;f++)
     {
-        HbrFace<T> * face = (*it).first;
+        HbrFace<T> * face = _faces[f];
         for(int i=0;i<face->GetNumVertices();i++)
         {
             HbrVertex<T> * vert = face->GetVertex(i);
-            if (_verts.find(vert) == _verts.end())
+            if (FindVertex(vert) == -1)
             {
                 real a, b;
-                bool result = (*it).second.ParamToAB(ParamPoint<T>(vert), a, b);
+                bool result = _faceMaps[f].ParamToAB(ParamPoint<T>(vert), a, b);
                 assert(result);
-                _verts[vert] = std::pair<real,real>(a,b);
+                assert(_numVerts < MAX_VERTS);
+                _verts[_numVerts] = vert;
+                _vertA[_numVerts] = a;
+                _vertB[_numVerts] = b;
+                _numVerts++;
             }
         }
     }
 }
 
+template<class T>
+int Chart<T>::FindFace(const HbrFace<T> * face) const
+{
+    for(int i=0;i<_numFaces;i++)
+        if (_faces[i] == face)
+            return i;
+    return -1;
+}
+
+template<class T>
+int Chart<T>::FindVertex(const HbrVertex<T> * vert) const
+{
+    for(int i=0;i<_numVerts;i++)
+        if (_verts[i] == vert)
+            return i;
+    return -1;
+}
+
 template<class T>
 bool Chart<T>::ParamToAB(const ParamPoint<T> & pt, real & a, real & b) const
 {
     if (pt.SourceVertex() != NULL)
     {
-        typename std::map<HbrVertex<T>*,std::pair<real,real> >::const_iterator vit = _verts.find(pt.SourceVertex());
-        if (vit == _verts.end())
+        int vi = FindVertex(pt.SourceVertex());
+        if (vi == -1)
             return false;
-        a = (*vit).second.first;
-        b = (*vit).second.second;
+        a = _vertA[vi];
+        b = _vertB[vi];
         assert(a>=-1 && a<=1 && b>=-1 && b<=1);
         return true;
     }
 
     if (pt.SourceFace() != NULL)
     {
-        typename std::map<HbrFace<T>*, FaceMapQuad<T> >::const_iterator fit = _faces.find(pt.SourceFace());
+        int fi = FindFace(pt.SourceFace());
 
-        if (fit == _faces.end())
+        if (fi == -1)
             return false;
 
-        bool result = (*fit).second.ParamToAB(pt, a, b);
+        bool result = _faceMaps[fi].ParamToAB(pt, a, b);
         assert(result);
         return true;
     }
@@ -189,15 +222,14 @@ bool Chart<T>::ParamToAB(const ParamPoint<T> & pt, real & a, real & b) const
     HbrHalfedge<T> * edge = pt.SourceEdge();
     assert(edge != NULL);
 
-    if (_verts.find(edge->GetOrgVertex()) == _verts.end() || _verts.find(edge->GetDestVertex()) == _verts.end())
+    int v0 = FindVertex(edge->GetOrgVertex());
+    int v1 = FindVertex(edge->GetDestVertex());
+    if (v0 == -1 || v1 == -1)
         return false;
 
-    std::pair<real,real> AB0 = (*_verts.find(edge->GetOrgVertex())).second;
-    std::pair<real,real> AB1 = (*_verts.find(edge->GetDestVertex())).second;
-
     real t = pt.EdgeT();
-    a = (1-t)*AB0.first  + t*AB1.first;
-    b = (1-t)*AB0.second + t*AB1.second;
+    a = (1-t)*_vertA[v0] + t*_vertA[v1];
+    b = (1-t)*_vertB[v0] + t*_vertB[v1];
 
     assert(a>=-1 && a<=1 && b>=-1 && b<=1);
     return true;
@@ -212,9 +244,9 @@ ParamPoint<T> Chart<T>::ABtoParam(real a, real b) const
 
     // need special treatment to check if we're on an edge?
 
-    for(typename std::map<HbrFace<T>*, FaceMapQuad<T> >::const_iterator it = _faces.begin(); it != _faces.end(); ++it)
+    for(int i=0;i<_numFaces;i++)
     {
-        ParamPoint<T> pt = (*it).second.ABtoParam(a,b);
+        ParamPoint<T> pt = _faceMaps[i].ABtoParam(a,b);
 
         if (!pt.IsNull())
             return pt;
@@ -226,9 +258,46 @@ ParamPoint<T> Chart<T>::ABtoParam(real a, real b) const
 template<class T>
 bool Chart<T>::PointInside(const ParamPoint<T> & pt) const
 {
-    for(typename std::map<HbrFace<T>*, FaceMapQuad<T> >::iterator it = _faces.begin(); it != _faces.end(); ++it)
-        if ((*it).second.PointInside(pt))
+    for(int i=0;i<_numFaces;i++)
+        if (_faceMaps[i].PointInside(pt))
             return true;
 
     return true;
 }
+
+template<class T>
+ChartCache<T> & ChartCache<T>::ForVertex(const HbrVertex<T> * vertex)
+{
+    Subdiv & subdiv = Subdiv::ForVertex<T>(vertex);
+#ifdef _OPENMP
+    int thread = omp_get_thread_num();
+#else
+    int thread = 0;
+#endif
+    assert(thread < (int)subdiv.chartCaches.size());
+    SubdivCache *& cache = subdiv.chartCaches[thread];
+    if (cache == NULL)
+        cache = new ChartCache<T>();
+    return *static_cast<ChartCache<T>*>(cache);
+}
+
+template<class T>
+const Chart<T> * ChartCache<T>::Get(HbrVertex<T> * origin)
+{
+    int id = origin->GetID();
+    assert(id >= 0);
+
+    // vertices may be added to the mesh after the cache was created
+    if (id >= (int)_chartIndex.size())
+        _chartIndex.resize(id+1, -1);
+
+    if (_chartIndex[id] == -1)
+    {
+        _chartIndex[id] = (int)_charts.size();
+        _charts.push_back(Chart<T>(origin));
+    }
+
+    const Chart<T> * chart = &_charts[_chartIndex[id]];
+    assert(chart->Origin() == origin);
+    return chart;
+}
@@ -112,7 +112,9 @@ HbrFace<T> * NewFace(HbrMesh<T> * outputMesh, HbrVertex<T> * v1, HbrVertex<T> *
 {
     int vtx[3] = { v1->GetID(), v2->GetID(), v3->GetID() };
 
-    HbrFace<T> * result =  outputMesh->NewFace(3,vtx,0);
+    HbrFace<T> * result;
+#pragma omp critical(meshEdit)
+    result =  outputMesh->NewFace(3,vtx,0);
     assert(result != NULL);
     return result;
 }
@@ -122,11 +124,50 @@ HbrFace<T> * NewFace(HbrMesh<T> * outputMesh, HbrVertex<T> * v1, HbrVertex<T> *
 {
     int vtx[4] = { v1->GetID(), v2->GetID(), v3->GetID(), v4->GetID() };
 
-    HbrFace<T>* result =  outputMesh->NewFace(4,vtx,0);
+    HbrFace<T>* result;
+#pragma omp critical(meshEdit)
+    result =  outputMesh->NewFace(4,vtx,0);
     assert(result != NULL);
     return result;
 }
 
+// HbrMesh's vertex and face tables and its allocators are not thread-safe, and RefineContour may refine
+// separate patches of one mesh concurrently, so refinement edits the tables through these (and NewFace above).
+// The lock only orders the edits: the tables are read without it, so RefineContour also reserves them
+// beforehand and keeps the patches from growing them (see HasTableRoom).
+template<class T>
+HbrVertex<T> * NewVertex(HbrMesh<T> * mesh)
+{
+    HbrVertex<T> * result;
+#pragma omp critical(meshEdit)
+    result = mesh->NewVertex();
+    return result;
+}
+
+// can numVertices vertices and numFaces faces be added to the mesh without reallocating its tables? See RefineContour
+template<class T>
+bool HasTableRoom(HbrMesh<T> * mesh, int numVertices, int numFaces)
+{
+    bool result;
+#pragma omp critical(meshEdit)
+    result = mesh->GetVertexTableRoom() >= numVertices && mesh->GetFaceTableRoom() >= numFaces;
+    return result;
+}
+
+template<class T>
+void DeleteVertex(HbrMesh<T> * mesh, HbrVertex<T> * vertex)
+{
+#pragma omp critical(meshEdit)
+    mesh->DeleteVertex(vertex);
+}
+
+template<class T>
+void DeleteFace(HbrMesh<T> * mesh, HbrFace<T> * face)
+{
+#pragma omp critical(meshEdit)
+    mesh->DeleteFace(face);
+}
+
 
 
 template<class T>
@@ -477,7 +518,7 @@ vec3 Laplacian(HbrVertex<T> * v_center, std::set<HbrVertex<T>*> & oneRingVertice
                 e0.normalize();
                 e1.normalize();
 
-                weight += tanl( acosl(e0*e1) /2 );
+                weight += tan( acos(e0*e1) /2 );
 
                 assert(weight == weight); // check for nan
             }
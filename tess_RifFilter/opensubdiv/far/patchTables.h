@@ -194,6 +194,8 @@ public:
         template <class T> friend class FarPatchTablesFactory;
         friend class iterator;
 
+        static inline std::vector<Descriptor> buildAllValidDescriptors();
+
         unsigned int  _type:4;
         unsigned int  _pattern:3;
         unsigned int  _rotation:2;
@@ -568,40 +570,47 @@ FarPatchTables::Descriptor::iterator::getValue() const {
     return &_nonpatch;
 }
 
-inline std::vector<FarPatchTables::Descriptor> const &
-FarPatchTables::Descriptor::GetAllValidDescriptors() {
-
-    static std::vector<Descriptor> _descriptors;
+inline std::vector<FarPatchTables::Descriptor>
+FarPatchTables::Descriptor::buildAllValidDescriptors() {
 
-    if (_descriptors.empty()) {
-        _descriptors.reserve(55);
+    std::vector<Descriptor> descriptors;
+    descriptors.reserve(55);
 
-        // non-patch primitives
-        for (int i=POINTS; i<=LOOP; ++i) {
-            _descriptors.push_back( Descriptor(i, NON_TRANSITION, 0) );
-        }
+    // non-patch primitives
+    for (int i=POINTS; i<=LOOP; ++i) {
+        descriptors.push_back( Descriptor(i, NON_TRANSITION, 0) );
+    }
 
-        // non-transition patches
-        for (int i=REGULAR; i<=GREGORY_BOUNDARY; ++i) {
-            _descriptors.push_back( Descriptor(i, NON_TRANSITION, 0) );
-        }
+    // non-transition patches
+    for (int i=REGULAR; i<=GREGORY_BOUNDARY; ++i) {
+        descriptors.push_back( Descriptor(i, NON_TRANSITION, 0) );
+    }
 
-        // transition patches
-        for (int i=PATTERN0; i<=PATTERN4; ++i) {
+    // transition patches
+    for (int i=PATTERN0; i<=PATTERN4; ++i) {
 
-            _descriptors.push_back( Descriptor(REGULAR, i, 0) );
+        descriptors.push_back( Descriptor(REGULAR, i, 0) );
 
-            // 4 rotations for boundary & corner patches
-            for (int j=0; j<4; ++j) {
-                _descriptors.push_back( Descriptor(BOUNDARY, i, j) );
-            }
+        // 4 rotations for boundary & corner patches
+        for (int j=0; j<4; ++j) {
+            descriptors.push_back( Descriptor(BOUNDARY, i, j) );
+        }
 
-            for (int j=0; j<4; ++j) {
-                _descriptors.push_back( Descriptor(CORNER, i, j) );
-            }
+        for (int j=0; j<4; ++j) {
+            descriptors.push_back( Descriptor(CORNER, i, j) );
         }
     }
 
+    return descriptors;
+}
+
+inline std::vector<FarPatchTables::Descriptor> const &
+FarPatchTables::Descriptor::GetAllValidDescriptors() {
+
+    // Initialized once through the guarded local static rather than filled
+    // lazily, so that patch tables can be built for several meshes at once.
+    static std::vector<Descriptor> const _descriptors = buildAllValidDescriptors();
+
     return _descriptors;
 }
 
@@ -138,6 +138,16 @@ public:
     // Ask for face with the indicated ID
     HbrFace<T>* GetFace(int id) const;
 
+    // Grow the vertex and face tables so that the next numVertices
+    // vertices and numFaces faces can be created without reallocating
+    // them
+    void ReserveTables(int numVertices, int numFaces);
+
+    // Returns the number of vertices and faces that can still be created
+    // without reallocating the tables
+    int GetVertexTableRoom() const { return nvertices - maxVertexID; }
+    int GetFaceTableRoom() const { return nfaces - maxFaceID; }
+
     // Ask for client data associated with the face with the indicated ID
     void* GetFaceClientData(int id) const {
         if (id >= faceClientData.size()) {        
@@ -158,6 +168,12 @@ public:
         }
         faceClientData[id] = data;
     }
+
+    // Ask for client data associated with the mesh as a whole
+    void* GetClientData() const { return clientData; }
+
+    // Set client data associated with the mesh as a whole
+    void SetClientData(void *data) { clientData = data; }
     
     // Returns a collection of all vertices in the mesh. This function
     // requires an output iterator; to get the vertices into a
@@ -419,6 +435,9 @@ private:
     // deemed temporary
     bool m_transientMode;
 
+    // Client data associated with the mesh as a whole
+    void *clientData;
+
     // Vertices which are transient
     std::vector<HbrVertex<T>*> m_transientVertices;
 
@@ -486,7 +505,8 @@ HbrMesh<T>::HbrMesh(HbrSubdivision<T>* s, int _fvarcount, const int *_fvarindice
       m_numCoarseFaces(-1),
       hasVertexEdits(0),
       hasCreaseEdits(0),
-      m_transientMode(false) {
+      m_transientMode(false),
+      clientData(0) {
 }
 
 template <class T>
@@ -528,6 +548,27 @@ HbrMesh<T>::~HbrMesh() {
     }
 }
 
+template <class T>
+void
+HbrMesh<T>::ReserveTables(int numVertices, int numFaces) {
+    if (nvertices < maxVertexID + numVertices) {
+        size_t oldsize = vertices.size();
+        nvertices = maxVertexID + numVertices;
+        vertices.resize(nvertices);
+        if (s_memStatsIncrement) {
+            s_memStatsIncrement((vertices.size() - oldsize) * sizeof(HbrVertex<T>*));
+        }
+    }
+    if (nfaces < maxFaceID + numFaces) {
+        size_t oldsize = faces.size();
+        nfaces = maxFaceID + numFaces;
+        faces.resize(nfaces);
+        if (s_memStatsIncrement) {
+            s_memStatsIncrement((faces.size() - oldsize) * sizeof(HbrFace<T>*));
+        }
+    }
+}
+
 template <class T>
 HbrVertex<T>*
 HbrMesh<T>::NewVertex(int id, const T &data) {
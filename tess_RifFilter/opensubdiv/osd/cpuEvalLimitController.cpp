@@ -26,6 +26,10 @@
 #include "../osd/cpuEvalLimitKernel.h"
 #include "../far/patchTables.h"
 
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 namespace OpenSubdiv {
 namespace OPENSUBDIV_VERSION {
 
@@ -139,6 +143,178 @@ OsdCpuEvalLimitController::EvalLimitSample( OpenSubdiv::OsdEvalCoords const & co
     return 1;
 }
 
+namespace {
+
+// a sample located on its patch, in sub-patch coordinates
+struct PatchSample {
+
+    FarPatchMap::Handle const * handle;
+    real u, v;
+    int index;   // position of the sample in the caller's arrays
+
+    // order by patch, so that samples sharing control vertices are adjacent
+    bool operator < (PatchSample const & other) const {
+        if (handle->patchArrayIdx != other.handle->patchArrayIdx)
+            return handle->patchArrayIdx < other.handle->patchArrayIdx;
+        if (handle->vertexOffset != other.handle->vertexOffset)
+            return handle->vertexOffset < other.handle->vertexOffset;
+        return index < other.index;
+    }
+};
+
+}
+
+// Vertex interpolation of a batch of samples at the limit
+int
+OsdCpuEvalLimitController::EvalLimitSamples( int numSamples,
+                                             OpenSubdiv::OsdEvalCoords const * coords,
+                                             OsdCpuEvalLimitContext * context,
+                                             OsdVertexBufferDescriptor const & outDesc,
+                                             real * outQ,
+                                             real * outDQU,
+                                             real * outDQV,
+                                             real * outDQUDQU,
+                                             real * outDQVDQV,
+                                             real * outDQUDQV) const {
+
+    VertexData const & vertexData = _currentBindState.vertexData;
+
+    if (not context or not vertexData.in or numSamples <= 0)
+        return 0;
+
+    // clear the outputs : samples in holes and second derivatives of
+    // non-regular patches are left untouched by the kernels
+    real * outputs[6] = { outQ, outDQU, outDQV, outDQUDQU, outDQVDQV, outDQUDQV };
+    for (int i=0; i<6; ++i)
+        if (outputs[i])
+            memset(outputs[i], 0, numSamples*outDesc.stride*sizeof(real));
+
+    // locate every sample on its patch
+    std::vector<PatchSample> samples;
+    samples.reserve(numSamples);
+
+    for (int i=0; i<numSamples; ++i) {
+
+        PatchSample sample;
+        sample.u = coords[i].u;
+        sample.v = coords[i].v;
+        sample.index = i;
+
+        sample.handle = context->GetPatchMap().FindPatch( coords[i].face, sample.u, sample.v );
+
+        // the map may not be able to return a handle if there is a hole or the face
+        // index is incorrect
+        if (not sample.handle)
+            continue;
+
+        computeSubPatchCoords(context, sample.handle->patchIdx, sample.u, sample.v);
+
+        samples.push_back(sample);
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    OsdVertexBufferDescriptor const & inDesc = vertexData.inDesc;
+
+    // control vertices of the current regular patch, packed contiguously
+    static unsigned int const packedIndices[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11,12,13,14,15 };
+    OsdVertexBufferDescriptor packedDesc(0, inDesc.length, inDesc.length);
+    std::vector<real> packedCVs(16*inDesc.length);
+
+    int numFound = (int)samples.size();
+
+    for (int first=0; first<numFound; ) {
+
+        FarPatchMap::Handle const * handle = samples[first].handle;
+
+        // samples [first, last) lie on the same patch
+        int last = first+1;
+        while (last<numFound and samples[last].handle->patchArrayIdx == handle->patchArrayIdx
+                             and samples[last].handle->vertexOffset == handle->vertexOffset)
+            ++last;
+
+        FarPatchTables::PatchArray const & parray = context->GetPatchArrayVector()[ handle->patchArrayIdx ];
+
+        unsigned int const * cvs = &context->GetControlVertices()[ parray.GetVertIndex() + handle->vertexOffset ];
+
+        FarPatchTables::Type type = parray.GetDescriptor().GetType();
+
+        if (type == FarPatchTables::REGULAR) {
+            for (int j=0; j<16; ++j)
+                memcpy(&packedCVs[j*inDesc.length],
+                       vertexData.in + inDesc.offset + cvs[j]*inDesc.stride,
+                       inDesc.length*sizeof(real));
+        }
+
+        for (int s=first; s<last; ++s) {
+
+            real u = samples[s].u,
+                 v = samples[s].v;
+
+            int offset = outDesc.stride * samples[s].index;
+
+            real * out   = outQ ? outQ + offset : 0,
+                 * outDu = outDQU ? outDQU + offset : 0,
+                 * outDv = outDQV ? outDQV + offset : 0,
+                 * outDuDu = outDQUDQU ? outDQUDQU + offset : 0,
+                 * outDvDv = outDQVDQV ? outDQVDQV + offset : 0,
+                 * outDuDv = outDQUDQV ? outDQUDQV + offset : 0;
+
+            switch( type ) {
+
+                case FarPatchTables::REGULAR  : evalBSpline( v, u, packedIndices,
+                                                             packedDesc,
+                                                             &packedCVs[0],
+                                                             outDesc,
+                                                             out, outDu, outDv, outDuDu, outDvDv, outDuDv );
+                                                break;
+
+                case FarPatchTables::BOUNDARY : evalBoundary( v, u, cvs,
+                                                              inDesc,
+                                                              vertexData.in,
+                                                              outDesc,
+                                                              out, outDu, outDv );
+                                                break;
+
+                case FarPatchTables::CORNER   : evalCorner( v, u, cvs,
+                                                            inDesc,
+                                                            vertexData.in,
+                                                            outDesc,
+                                                            out, outDu, outDv );
+                                                break;
+
+                case FarPatchTables::GREGORY  : evalGregory( v, u, cvs,
+                                                             &context->GetVertexValenceTable()[0],
+                                                             &context->GetQuadOffsetTable()[ parray.GetQuadOffsetIndex() + handle->vertexOffset ],
+                                                             context->GetMaxValence(),
+                                                             inDesc,
+                                                             vertexData.in,
+                                                             outDesc,
+                                                             out, outDu, outDv );
+                                                break;
+
+                case FarPatchTables::GREGORY_BOUNDARY :
+                                                evalGregoryBoundary( v, u, cvs,
+                                                                     &context->GetVertexValenceTable()[0],
+                                                                     &context->GetQuadOffsetTable()[ parray.GetQuadOffsetIndex() + handle->vertexOffset ],
+                                                                     context->GetMaxValence(),
+                                                                     inDesc,
+                                                                     vertexData.in,
+                                                                     outDesc,
+                                                                     out, outDu, outDv );
+                                                break;
+
+                default:
+                    assert(0);
+            }
+        }
+
+        first = last;
+    }
+
+    return numFound;
+}
+
 // Vertex interpolation of samples at the limit
 int
 OsdCpuEvalLimitController::_EvalLimitSample( OpenSubdiv::OsdEvalCoords const & coords,
@@ -179,6 +179,48 @@ public:
                          real * outDQVDQV,
                          real * outDQUDQV) const;
 
+    /// \brief Vertex interpolation of a batch of samples at the limit
+    ///
+    /// Evaluates "vertex" interpolation of many independent samples on the
+    /// surface limit. Samples are grouped by patch, so that the control
+    /// vertices of each regular patch are gathered once and shared by all
+    /// the samples that fall on it. Results are written in the order of
+    /// the input coordinates, sample i at offset i * outDesc.stride.
+    ///
+    /// Like EvalLimitSample, this function is re-entrant and does not
+    /// require binding the output vertex buffers.
+    ///
+    /// @param numSamples  number of coordinates
+    ///
+    /// @param coords   locations on the limit surface to be evaluated
+    ///
+    /// @param context  the EvalLimitContext that the controller will evaluate
+    ///
+    /// @param outDesc  data descriptor (offset, length, stride) of one sample
+    ///
+    /// @param outQ    output vertex data
+    ///
+    /// @param outDQU  output derivative along "u" of the vertex data (optional)
+    ///
+    /// @param outDQV  output derivative along "v" of the vertex data (optional)
+    ///
+    /// @param outDQUDQU, outDQVDQV, outDQUDQV  output second derivatives
+    ///                 (optional, only computed on regular patches)
+    ///
+    /// @return the number of samples found. Outputs of samples that were not
+    ///         found, and second derivatives on non-regular patches, are zero.
+    ///
+    int EvalLimitSamples(int numSamples,
+                         OpenSubdiv::OsdEvalCoords const * coords,
+                         OsdCpuEvalLimitContext * context,
+                         OsdVertexBufferDescriptor const & outDesc,
+                         real * outQ,
+                         real * outDQU,
+                         real * outDQV,
+                         real * outDQUDQU,
+                         real * outDQVDQV,
+                         real * outDQUDQV) const;
+
     /// \brief Vertex interpolation of samples at the limit
     ///
     /// Evaluates "vertex" interpolation of a sample on the surface limit.
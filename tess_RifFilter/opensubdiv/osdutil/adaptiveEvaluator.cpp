@@ -215,6 +215,24 @@ OsdUtilAdaptiveEvaluator::EvaluateLimit(
     cpuEvalLimitController.EvalLimitSample(coords, _evalLimitContext, desc, P, dPdu, dPdv, dPdudu, dPdvdv, dPdudv);
 }
 
+int
+OsdUtilAdaptiveEvaluator::EvaluateLimit(
+    int numSamples, const OsdEvalCoords *coords,
+    real *P, real *dPdu, real *dPdv, real *dPdudu, real *dPdvdv, real *dPdudv)
+{
+    OsdCpuEvalLimitController cpuEvalLimitController;
+
+    OsdVertexBufferDescriptor desc(0,3,3);
+
+    // Setup evaluation controller. Values are offset, length, stride */
+    OsdVertexBufferDescriptor in_desc(0, 3, 3), out_desc(0, 0, 0);
+
+    cpuEvalLimitController.BindVertexBuffers<OsdCpuVertexBuffer,OsdCpuVertexBuffer>(in_desc, _vertexBuffer, out_desc, NULL);
+
+    return cpuEvalLimitController.EvalLimitSamples(numSamples, coords, _evalLimitContext, desc,
+                                                   P, dPdu, dPdv, dPdudu, dPdvdv, dPdudv);
+}
+
 
 void ccgSubSurf__mapGridToFace(int S, real grid_u, real grid_v,
                                       real *face_u, real *face_v)
@@ -94,6 +94,12 @@ class OsdUtilAdaptiveEvaluator {
     void EvaluateLimit(const OpenSubdiv::OsdEvalCoords &coords,
                        real P[3], real dPdu[3], real dPdv[3], real dPdudu[3], real dPdvdv[3], real dPdudv[3]);
 
+    // Evaluate numSamples limit points at once. Outputs are arrays of
+    // three reals per sample, in the order of coords; any of the
+    // derivative arrays may be NULL.  Returns the number of samples found.
+    int EvaluateLimit(int numSamples, const OpenSubdiv::OsdEvalCoords *coords,
+                      real *P, real *dPdu, real *dPdv, real *dPdudu, real *dPdvdv, real *dPdudv);
+
     bool GetRefinedTopology(
             OsdUtilSubdivTopology *t,
             //positions will have three floats * t->numVertices
@@ -33,7 +33,11 @@ extern "C" {
 /* Types declaration. */
 struct OpenSubdiv_EvaluatorDescr;
 struct OpenSubdiv_TopologyDescr;
+#ifdef TESS_DOUBLE_PRECISION
+typedef double real;
+#else
 typedef long double real;
+#endif
 
 /* Methods to create and delete evaluators. */
 struct OpenSubdiv_EvaluatorDescr *openSubdiv_createEvaluatorDescr(int numVertices);
@@ -27,6 +27,17 @@
 
 #define OPENSUBDIV_VERSION v2_5_1
 
+// Scalar type of the whole tessellator.  long double by default; configure
+// with -DDOUBLE_PRECISION=ON (which defines TESS_DOUBLE_PRECISION) to trade
+// robustness for speed and vectorizable arithmetic.
+#ifdef TESS_DOUBLE_PRECISION
+typedef double real;
+#else
 typedef long double real;
+#endif
+
+// Extended precision, whatever the build precision.  Reserved for the few
+// computations that are sensitive to cancellation (root-finding end-game).
+typedef long double real_ext;
 
 #endif /* OPENSUBDIV_VERSION_H */
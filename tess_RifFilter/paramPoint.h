@@ -33,6 +33,15 @@ private:
 
     real _normalOffset;
 
+    // principal curvatures and directions (in the (u,v) of the face) from the fundamental forms
+    static void Curvatures(mat2 I, mat2 II, real & k1, real & k2, vec2 & pdir1, vec2 & pdir2);
+    // radial curvature along a (normalized) view vector from the curvatures and directions
+    static real RadialCurvature(const vec3 & viewVec, const vec3 & limitNormal, real k1, real k2,
+                                const vec3 & pdir1, const vec3 & pdir2);
+
+    // the source vertex this point lies on, if any
+    HbrVertex<T> * CornerVertex() const;
+
 public:
     // -- constructors --
     ParamPoint() { clear(); }
@@ -59,9 +68,12 @@ public:
 
     // -- evaluation --
     void Evaluate(vec3 & limitPosition, vec3 & limitNormal, real * k1=NULL, real * k2=NULL, vec3 * d1=NULL, vec3 * d2=NULL) const;
+    static void Evaluate(int numPoints, const ParamPoint<T> * points, vec3 * limitPositions, vec3 * limitNormals,
+                         real * k1=NULL, real * k2=NULL, vec3 * d1=NULL, vec3 * d2=NULL);
     bool IsEvaluable() const;  // can we compute a limit position and normal for this point?
     bool IsExactlyEvaluable() const;
     bool RadialCurvature(const vec3 & cameraCenter, real & k_r) const;
+    static void RadialCurvature(int numPoints, const ParamPoint<T> * points, const vec3 & cameraCenter, real * k_r);
     real IsophoteDistance(const CameraModel & camera, real isovalue, int maxDistance) const;
     void EvaluateByInterpolation(vec3 & limitPosition, vec3 & limitNormal, real* k1=NULL, real* k2=NULL, vec3 * d1=NULL, vec3 * d2=NULL) const;
     //  bool IsValid() const; // debugging
@@ -79,8 +91,8 @@ public:
     // are P and Q on the same side of the line containing points (E0, E1)?
     static bool SameSide(const ParamPoint<T> & P, const ParamPoint<T> & Q, const ParamPoint<T> & E0, const ParamPoint<T> & E1);
 
-    static Chart<T> * FindChart(const std::vector<ParamPoint<T> > & pts, std::vector<vec2> & abs);
-    static Chart<T> * FindChart(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1, real & a0, real & b0, real & a1, real & b1);
+    static const Chart<T> * FindChart(const std::vector<ParamPoint<T> > & pts, std::vector<vec2> & abs);
+    static const Chart<T> * FindChart(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1, real & a0, real & b0, real & a1, real & b1);
     static bool HasCommonChart(const ParamPoint<T> & p1, const ParamPoint<T> & p2);
     static bool ConvexInChart(const ParamPoint<T> & p0, const ParamPoint<T> & p1,const ParamPoint<T> & p2, const ParamPoint<T> & p3);
 
@@ -121,77 +121,88 @@ void ParamPoint<T>::Print() const
 }
 
 
+// The chart returned is owned by the surface's ChartCache: callers must not delete it.
 template<class T>
-Chart<T> * ParamPoint<T>::FindChart(const std::vector<ParamPoint<T> > & pts, std::vector<vec2> & abs)
+const Chart<T> * ParamPoint<T>::FindChart(const std::vector<ParamPoint<T> > & pts, std::vector<vec2> & abs)
 {
+    assert(!pts.empty() && !pts[0].IsNull());
+
+    ChartCache<T> & cache = ChartCache<T>::ForVertex(pts[0].SourceVertex() != NULL ? pts[0].SourceVertex() :
+                                                     pts[0].SourceEdge() != NULL ? pts[0].SourceEdge()->GetOrgVertex() :
+                                                     pts[0].SourceFace()->GetVertex(0));
+
     // collect all adjacent vertices
-    std::set<HbrVertex<T>*> verts1;
+    std::vector<HbrVertex<T>*> & verts1 = cache.pointVerts;
+    verts1.clear();
 
     // probably would be sufficient just to find the neighborhood for a single vertex.
 
     for(typename std::vector<ParamPoint<T> >::const_iterator pit = pts.begin(); pit != pts.end(); ++pit)
     {
-        ParamPoint<T>  pt = *pit;
+        const ParamPoint<T> & pt = *pit;
 
         assert(!pt.IsNull());
 
         if (pt.SourceVertex() != NULL)
-            verts1.insert(pt.SourceVertex() );
+            verts1.push_back(pt.SourceVertex() );
         else
             if (pt.SourceEdge() != NULL)
             {
-                verts1.insert(pt.SourceEdge()->GetOrgVertex());
-                verts1.insert(pt.SourceEdge()->GetDestVertex());
+                verts1.push_back(pt.SourceEdge()->GetOrgVertex());
+                verts1.push_back(pt.SourceEdge()->GetDestVertex());
             }
             else
             {
                 for(int i=0;i<4;i++)
-                    verts1.insert(pt.SourceFace()->GetVertex(i));
+                    verts1.push_back(pt.SourceFace()->GetVertex(i));
             }
     }
+    std::sort(verts1.begin(), verts1.end());
+    verts1.erase(std::unique(verts1.begin(), verts1.end()), verts1.end());
 
-    std::set<HbrFace<T> *> faces;  // all faces to draw candidate vertices from
+    std::vector<HbrFace<T> *> & faces = cache.faces;  // all faces to draw candidate vertices from
+    faces.clear();
 
-    for(typename std::set<HbrVertex<T>*>::iterator vit = verts1.begin(); vit != verts1.end(); ++vit)
+    for(typename std::vector<HbrVertex<T>*>::iterator vit = verts1.begin(); vit != verts1.end(); ++vit)
     {
         // insert the one-ring
-        std::list<HbrHalfedge<T> *> edges;
+        std::vector<HbrHalfedge<T> *> & edges = cache.edges;
+        edges.clear();
         (*vit)->GetSurroundingEdges(std::back_inserter(edges));
-        for(typename std::list<HbrHalfedge<T> *>::iterator it = edges.begin(); it != edges.end(); ++it)
+        for(typename std::vector<HbrHalfedge<T> *>::iterator it = edges.begin(); it != edges.end(); ++it)
         {
             if ( (*it)->GetLeftFace() != NULL)
-                faces.insert( (*it)->GetLeftFace());
+                faces.push_back( (*it)->GetLeftFace());
             if ( (*it)->GetRightFace() != NULL)
-                faces.insert( (*it)->GetRightFace());
+                faces.push_back( (*it)->GetRightFace());
         }
     }
+    std::sort(faces.begin(), faces.end());
+    faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
 
 
     // collect all vertices from all neighboring faces
-    std::set<HbrVertex<T>*> verts2;
-    for(typename std::set<HbrFace<T> *>::iterator it=faces.begin(); it!=faces.end();++it)
+    std::vector<HbrVertex<T>*> & verts2 = cache.origins;
+    verts2.clear();
+    for(typename std::vector<HbrFace<T> *>::iterator it=faces.begin(); it!=faces.end();++it)
     {
         assert( (*it)->GetNumVertices() == 4);
         for(int i=0;i<4;i++)
         {
             HbrVertex<T> * v = (*it)->GetVertex(i);
             if (v->GetValence() == 4 && !v->OnBoundary())
-                verts2.insert(v);
+                verts2.push_back(v);
         }
     }
+    // address order, as before, so that the same chart is picked when several fit
+    std::sort(verts2.begin(), verts2.end());
+    verts2.erase(std::unique(verts2.begin(), verts2.end()), verts2.end());
 
     // try all vertices as possible origins
 
-    //  HbrVertex<T> * origin = NULL;
-
-    Chart<T> * chart = NULL;
-
-    for(typename std::set<HbrVertex<T>*>::iterator it=verts2.begin();it != verts2.end();++it)
+    for(typename std::vector<HbrVertex<T>*>::iterator it=verts2.begin();it != verts2.end();++it)
     {
-        if ( (*it)->GetValence() != 4 || (*it)->OnBoundary())
-            continue;
-
-        chart = new Chart<T>(*it);
+        const Chart<T> * chart = cache.Get(*it);
         abs.clear();
 
         for(typename std::vector<ParamPoint<T> >::const_iterator pit = pts.begin();pit != pts.end();++pit)
@@ -204,8 +215,6 @@ Chart<T> * ParamPoint<T>::FindChart(const std::vector<ParamPoint<T> > & pts, std
         }
         if (abs.size() == pts.size())
             return chart;
-
-        delete chart;
     }
 
     abs.clear();
@@ -214,7 +223,7 @@ Chart<T> * ParamPoint<T>::FindChart(const std::vector<ParamPoint<T> > & pts, std
 
 
 template<class T>
-Chart<T> * ParamPoint<T>::FindChart(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1, real & a0, real & b0, real & a1, real & b1)
+const Chart<T> * ParamPoint<T>::FindChart(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1, real & a0, real & b0, real & a1, real & b1)
 {
     assert(!p0.IsNull() && !p1.IsNull());
 
@@ -225,7 +234,7 @@ Chart<T> * ParamPoint<T>::FindChart(const ParamPoint<T>  & p0, const ParamPoint<
 
     std::vector<vec2> abs;
 
-    Chart<T> * chart = FindChart(pts, abs);
+    const Chart<T> * chart = FindChart(pts, abs);
 
     if (chart == NULL)
         return NULL;
@@ -247,13 +256,9 @@ bool ParamPoint<T>::HasCommonChart(const ParamPoint<T>  & p1, const ParamPoint<T
     real a0,b0,a1,b1;
 
     // this could be made a lot more efficient
-    Chart<T> * chart = FindChart(p1,p2,a0,b0,a1,b1);
+    const Chart<T> * chart = FindChart(p1,p2,a0,b0,a1,b1);
 
-    if (chart == NULL)
-        return false;
-
-    delete chart;
-    return true;
+    return chart != NULL;
 }
 
 
@@ -269,7 +274,7 @@ bool ParamPoint<T>::ConvexInChart(const ParamPoint<T> & p0, const ParamPoint<T>
 
     std::vector<vec2> abs;
 
-    Chart<T> * chart = FindChart(ps,abs);
+    const Chart<T> * chart = FindChart(ps,abs);
 
     if (chart == NULL){ // can't tell
         //printf("\nNULL CHART\n");
@@ -393,7 +398,7 @@ ParamPoint<T>::Interpolate(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1,
     real a0,b0,a1,b1;
 
     //  HbrVertex<T> * origin = FindABOrigin(p0,p1,a0,b0,a1,b1);
-    Chart<T> * chart = FindChart(p0,p1,a0,b0,a1,b1);
+    const Chart<T> * chart = FindChart(p0,p1,a0,b0,a1,b1);
 
     if( chart == NULL)
         return ParamPoint<T>();
@@ -408,8 +413,6 @@ ParamPoint<T>::Interpolate(const ParamPoint<T>  & p0, const ParamPoint<T>  & p1,
 
     result._normalOffset = newOffset;
 
-    delete chart;
-
     return result;
 }
 
@@ -521,7 +524,7 @@ ParamPoint<T>::MakeExtraordinarySeparator(const ParamPoint<T> & extPoint, const
 
     real a0,b0,a1,b1;
 
-    Chart<T> * chart = FindChart(extPoint,p1,a0,b0,a1,b1);
+    const Chart<T> * chart = FindChart(extPoint,p1,a0,b0,a1,b1);
     //  HbrVertex<T> * origin = FindABOrigin(extPoint,p1,a0,b0,a1,b1);
 
     assert( chart != NULL);
@@ -542,7 +545,7 @@ ParamPoint<T>::MakeExtraordinarySeparator(const ParamPoint<T> & extPoint, const
     }
 
     assert(a >= -1 && a <=1 && b>= -1 && b<=1);
-    assert(fabsl(a0 - a) >= t_threshold-1e-10 || fabsl(b0 - b) >= t_threshold - 1e-10);
+    assert(fabs(a0 - a) >= t_threshold-1e-10 || fabs(b0 - b) >= t_threshold - 1e-10);
 
     result = chart->ABtoParam(a,b);
     result._normalOffset = newOffset;
@@ -589,7 +592,7 @@ bool ParamPoint<T>::IsExactlyEvaluable() const
         if (vert->GetValence() == 4 && !vert->OnBoundary())
             return true;
 
-        if (fabsl(uvert - _u) >= t_threshold || fabsl(vvert - _v) >= t_threshold)
+        if (fabs(uvert - _u) >= t_threshold || fabs(vvert - _v) >= t_threshold)
             return true;
 
         return false;
@@ -611,6 +614,50 @@ bool ParamPoint<T>::IsExactlyEvaluable() const
 
 // ================= EVALUATION =====================
 
+template<class T>
+void ParamPoint<T>::Curvatures(mat2 I, mat2 II, real & k1, real & k2, vec2 & pdir1, vec2 & pdir2)
+{
+    mat2 S;
+
+    real detI = determinant(I);
+    if(fabs(detI) < 1e-20){
+        //printf("DET I NULL [%f,%f,%f,%f]\n",double(I[0][0]),double(I[0][1]),double(I[1][0]),double(I[1][1]));
+        detI = 1e-20;
+    }
+
+    S[0][0] = (II[0][1]*I[0][1] - II[0][0]*I[1][1]) / detI;
+    S[0][1] = (II[1][1]*I[0][1] - II[0][1]*I[1][1]) / detI;
+    S[1][0] = (II[0][0]*I[0][1] - II[0][1]*I[0][0]) / detI;
+    S[1][1] = (II[0][1]*I[0][1] - II[1][1]*I[0][0]) / detI;
+
+    real traceS = S[0][0] + S[1][1];
+    real detS = determinant(S);
+    real diff = traceS*traceS - 4.0 * detS;
+    if(diff>=0){
+        real sqrtDiff = sqrt(diff);
+        k1 = 0.5 * (traceS + sqrtDiff);
+        k2 = 0.5 * (traceS - sqrtDiff);
+        if(fabs(k1)<fabs(k2)){
+            real swap = k1;
+            k1 = k2;
+            k2 = swap;
+        }
+        if(fabs(S[1][0])>1e-20){
+            pdir1 = vec2(k1 - S[1][1], S[1][0]);
+            pdir2 = vec2(k2 - S[1][1], S[1][0]);
+        }else if (fabs(S[0][1])>1e-20){
+            pdir1 = vec2(S[0][1], k1 - S[0][0]);
+            pdir2 = vec2(S[0][1], k2 - S[0][0]);
+        }
+        pdir1.normalize();
+        pdir2.normalize();
+    }else{
+        // the directions keep the (u,v) axes
+        k1 = 0.0;
+        k2 = 0.0;
+    }
+}
+
 template<class T>
 void ParamPoint<T>::Evaluate(vec3 & limitPosition, vec3 & limitNormal, real * k1, real * k2, vec3 * d1, vec3 * d2) const
 {
@@ -658,64 +705,13 @@ void ParamPoint<T>::Evaluate(vec3 & limitPosition, vec3 & limitNormal, real * k1
         //	     face->GetVertex(0),	 face->GetVertex(1),	 face->GetVertex(2),	 face->GetVertex(3));
 
         if(k1 && k2){
-            mat2 I, II, S;
-
-            Subdiv::getInstance().Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,&I,&II);
+            mat2 I, II;
 
-            real detI = determinant(I);
-            if(fabsl(detI) < 1e-20){
-                //printf("DET I NULL [%f,%f,%f,%f]\n",double(I[0][0]),double(I[0][1]),double(I[1][0]),double(I[1][1]));
-                detI = 1e-20;
-            }
+            Subdiv::ForFace(face).Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,&I,&II);
 
-            S[0][0] = (II[0][1]*I[0][1] - II[0][0]*I[1][1]) / detI;
-            S[0][1] = (II[1][1]*I[0][1] - II[0][1]*I[1][1]) / detI;
-            S[1][0] = (II[0][0]*I[0][1] - II[0][1]*I[0][0]) / detI;
-            S[1][1] = (II[0][1]*I[0][1] - II[1][1]*I[0][0]) / detI;
-
-//            printf("detI: %.16f / %.16f / %.16f / %.16f\n",double(detI),double(II[1][1]*I[0][1]), double(II[0][1]*I[1][1]), double((II[1][1]*I[0][1] - II[0][1]*I[1][1]) / detI));
-//            printf(" I: %.16f %.16f %.16f %.16f\n",double(I[0][0]),double(I[0][1]),double(I[1][0]),double(I[1][1]));
-//            printf("II: %.16f %.16f %.16f %.16f\n",double(II[0][0]),double(II[0][1]),double(II[1][0]),double(II[1][1]));
-//            printf(" S: %.16f %.16f %.16f %.16f\n",double(S[0][0]),double(S[0][1]),double(S[1][0]),double(S[1][1]));
-
-            real traceS = S[0][0] + S[1][1];
-            real detS = determinant(S);
-            real diff = traceS*traceS - 4.0 * detS;
-            if(diff>=0){
-                real sqrtDiff = sqrtl(diff);
-                (*k1) = 0.5 * (traceS + sqrtDiff);
-                (*k2) = 0.5 * (traceS - sqrtDiff);
-                if(fabsl(*k1)<fabsl(*k2)){
-                    real swap = (*k1);
-                    (*k1) = (*k2);
-                    (*k2) = swap;
-                }
-                if(fabsl(S[1][0])>1e-20){
-                    pdir1 = vec2((*k1) - S[1][1], S[1][0]);
-                    pdir2 = vec2((*k2) - S[1][1], S[1][0]);
-                }else if (fabsl(S[0][1])>1e-20){
-                    pdir1 = vec2(S[0][1], (*k1) - S[0][0]);
-                    pdir2 = vec2(S[0][1], (*k2) - S[0][0]);
-                }
-                pdir1.normalize();
-                pdir2.normalize();
-                //printf("trace: %.16f detS: %.16f diff: %.16f k1*k2: %.16f / %.16f\n",double(traceS),double(detS),double(diff),double((*k1)*(*k2)),double((II[0][0]*II[1][1] - II[0][1]*II[0][1])/detI));
-            }else{
-                //#if LINK_FREESTYLE
-                //    char str[200];
-                //    sprintf(str, "DIFF NULL");
-                //    addRIFDebugPoint(-1, double(limitPosition[0]), double(limitPosition[1]), double(limitPosition[2]), str, NULL);
-                //#endif
-                //                printf("DIFF NULL\n");
-                (*k1) = 0.0;
-                (*k2) = 0.0;
-                if(d1 && d2){
-                    (*d1) = tanU;
-                    (*d2) = tanV;
-                }
-            }
+            Curvatures(I, II, *k1, *k2, pdir1, pdir2);
         }else{
-            Subdiv::getInstance().Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
+            Subdiv::ForFace(face).Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
         }
 
         limitNormal = tanU ^ tanV;
@@ -757,6 +753,110 @@ void ParamPoint<T>::Evaluate(vec3 & limitPosition, vec3 & limitNormal, real * k1
 }
 
 
+template<class T>
+void ParamPoint<T>::Evaluate(int numPoints, const ParamPoint<T> * points, vec3 * limitPositions, vec3 * limitNormals,
+                             real * k1, real * k2, vec3 * d1, vec3 * d2)
+// positions and normals (and, like the single-point version, curvatures) of many points on the same surface, with a
+// single batched call to the evaluator. points that are not exactly evaluable go through the single-point path.
+{
+    bool curvatures = k1 && k2;
+    bool directions = d1 && d2;
+
+    std::vector<OsdEvalCoords> coords;
+    std::vector<int> batched;
+    coords.reserve(numPoints);
+    batched.reserve(numPoints);
+
+    Subdiv * subdiv = NULL;
+
+    for(int i=0;i<numPoints;i++)
+    {
+        const ParamPoint<T> & p = points[i];
+
+        if (!p.IsExactlyEvaluable())
+        {
+            p.Evaluate(limitPositions[i], limitNormals[i], curvatures ? &k1[i] : NULL, curvatures ? &k2[i] : NULL,
+                       directions ? &d1[i] : NULL, directions ? &d2[i] : NULL);
+            continue;
+        }
+
+        HbrFace<T> * face;
+        real u,v;
+
+        if (p._sourceFace != NULL)
+        {
+            face = p._sourceFace;
+            u = p._u;
+            v = p._v;
+        }
+        else
+        {
+            HbrHalfedge<T> * edge = p._sourceEdge != NULL ? p._sourceEdge : p._sourceVertex->GetIncidentEdge();
+            face = edge->GetLeftFace() == NULL ? edge->GetRightFace() : edge->GetLeftFace();
+            GetFaceUV<T>(face,p,u,v);
+        }
+
+        assert(face != NULL && u>=0 && u<=1 && v>=0 && v<=1);
+
+        if (subdiv == NULL)
+            subdiv = &Subdiv::ForFace(face);
+        assert(subdiv == &Subdiv::ForFace(face));
+
+        coords.push_back(OsdEvalCoords(face->GetID(),u,v));
+        batched.push_back(i);
+    }
+
+    if (batched.empty())
+        return;
+
+    int numBatched = (int)batched.size();
+    std::vector<vec3> positions(numBatched), tanU(numBatched), tanV(numBatched);
+    std::vector<mat2> I, II;
+
+    if (curvatures)
+    {
+        I.resize(numBatched);
+        II.resize(numBatched);
+    }
+
+    subdiv->Evaluate(numBatched, &coords[0], &positions[0], &tanU[0], &tanV[0],
+                     curvatures ? &I[0] : NULL, curvatures ? &II[0] : NULL);
+
+    for(int j=0;j<numBatched;j++)
+    {
+        const ParamPoint<T> & p = points[batched[j]];
+        vec3 & limitPosition = limitPositions[batched[j]];
+        vec3 & limitNormal = limitNormals[batched[j]];
+
+        vec2 pdir1 = vec2(1,0);
+        vec2 pdir2 = vec2(0,1);
+
+        if (curvatures)
+            Curvatures(I[j], II[j], k1[batched[j]], k2[batched[j]], pdir1, pdir2);
+
+        limitPosition = positions[j];
+        limitNormal = tanU[j] ^ tanV[j];
+
+        if (limitNormal * limitNormal < 1e-12 && p._sourceVertex != NULL) // same fallback as the single-point path
+            limitNormal = FaceAveragedVertexNormal(p._sourceVertex);
+        limitNormal.normalize();
+
+        if (directions)
+        {
+            d1[batched[j]] = pdir1[0] * tanU[j] + pdir1[1] * tanV[j];
+            d1[batched[j]].normalize();
+            d2[batched[j]] = d1[batched[j]] ^ limitNormal;
+        }
+
+        assert(limitPosition * limitPosition > 0);
+        assert(limitNormal * limitNormal > 0);
+
+        if (p._normalOffset != 0)
+            limitPosition += p._normalOffset * limitNormal;
+    }
+}
+
+
 template<class T>
 void ParamPoint<T>::EvaluateByInterpolation(vec3 & limitPosition, vec3 & limitNormal, real* k1, real* k2, vec3 * d1, vec3 * d2) const
 {
@@ -923,7 +1023,7 @@ ParamPoint<T>::VectorToParamRay(const vec3 & worldVec) const
         u = _u;
         v = _v;
 
-        Subdiv::getInstance().Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
+        Subdiv::ForFace(face).Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
         //_evaluator->Eval(face,u,v,REF_LEVEL,&limitPosition,&tanU,&tanV,NULL,NULL,NULL,0,NULL,0,NULL,0);
 
         ProjectVector<T>(tanU, tanV, worldVec, du, dv);
@@ -953,7 +1053,7 @@ ParamPoint<T>::VectorToParamRay(const vec3 & worldVec) const
             face = *it;
             GetFaceUV(face,*this,u,v);
 
-            Subdiv::getInstance().Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
+            Subdiv::ForFace(face).Evaluate(OsdEvalCoords(face->GetID(),u,v),&limitPosition,&tanU,&tanV,NULL,NULL);
             //_evaluator->Eval(face,u,v,REF_LEVEL,&limitPosition,&tanU,&tanV,NULL,NULL,NULL,0,NULL,0,NULL,0);
 
             ProjectVector<T>(tanU, tanV, worldVec, du, dv);
@@ -1082,7 +1182,7 @@ ParamPoint<T>::SameSide(const ParamPoint<T>  & P, const ParamPoint<T>  & Q, cons
 
     std::vector<vec2> abs;
 
-    Chart<T> * chart = FindChart(pts,abs);
+    const Chart<T> * chart = FindChart(pts,abs);
     //  HbrVertex<T> * origin = FindABOrigin(pts,abs);
 
     if (chart == NULL)
@@ -1185,31 +1285,80 @@ ParamPoint<T>::IsophoteDistance(const CameraModel & camera, real isovalue, int m
     return maxDistance;
 }
 
+template<class T>
+HbrVertex<T> * ParamPoint<T>::CornerVertex() const
+{
+    if(_sourceVertex != NULL)
+        return _sourceVertex;
+    if(_sourceEdge != NULL && (_t == 0 || _t == 1))
+        return _t==0 ? _sourceEdge->GetOrgVertex() : _sourceEdge->GetDestVertex();
+    if(_sourceFace != NULL && (_u==0 || _u==1) && (_v==0 || _v==1)){
+        if(_u==0)
+            return _v==0 ? _sourceFace->GetVertex(0) : _sourceFace->GetVertex(3);
+        else
+            return _v==0 ? _sourceFace->GetVertex(1) : _sourceFace->GetVertex(2);
+    }
+    return NULL;
+}
+
+template<class T>
+real ParamPoint<T>::RadialCurvature(const vec3 & viewVec, const vec3 & limitNormal,
+                                    real k1, real k2, const vec3 & pdir1, const vec3 & pdir2)
+{
+    real ndotv = limitNormal * viewVec;
+    real sintheta = 1.0 - ndotv*ndotv;
+    real u = (viewVec * pdir1), u2 = u*u;
+    real v = (viewVec * pdir2), v2 = v*v;
+    return (k1 * u2 + k2 * v2) / sintheta;
+}
+
+template<class T>
+void ParamPoint<T>::RadialCurvature(int numPoints, const ParamPoint<T> * points, const vec3 & cameraCenter, real * k_r)
+// radial curvatures of many points on the same surface; the points that average over the one-ring of an
+// extraordinary vertex go through the single-point path, the others are evaluated in one batch.
+{
+    std::vector<ParamPoint<T> > batchedPoints;
+    std::vector<int> batched;
+    batchedPoints.reserve(numPoints);
+    batched.reserve(numPoints);
+
+    for(int i=0;i<numPoints;i++)
+    {
+        HbrVertex<T> * vertex = points[i].CornerVertex();
+        if (vertex != NULL && (vertex->GetValence() != 4 || vertex->OnBoundary()))
+        {
+            points[i].RadialCurvature(cameraCenter, k_r[i]);
+            continue;
+        }
+        batchedPoints.push_back(points[i]);
+        batched.push_back(i);
+    }
+
+    if (batched.empty())
+        return;
+
+    int numBatched = (int)batched.size();
+    std::vector<vec3> positions(numBatched), normals(numBatched), pdir1(numBatched), pdir2(numBatched);
+    std::vector<real> k1(numBatched), k2(numBatched);
+
+    Evaluate(numBatched, &batchedPoints[0], &positions[0], &normals[0], &k1[0], &k2[0], &pdir1[0], &pdir2[0]);
+
+    for(int j=0;j<numBatched;j++)
+    {
+        vec3 viewVec = positions[j] - cameraCenter;
+        viewVec.normalize();
+
+        k_r[batched[j]] = RadialCurvature(viewVec, normals[j], k1[j], k2[j], pdir1[j], pdir2[j]);
+    }
+}
+
 template<class T>
 bool ParamPoint<T>::RadialCurvature(const vec3 & cameraCenter,real & k_r) const
 // finite differences using the "(D_w n) dot w / (w dot w)"
 {
     k_r = 0.0;
-    if(_sourceVertex != NULL || (_sourceEdge !=NULL && (_t == 0 || _t == 1)) ||
-            (_sourceFace !=NULL && (_u==0 || _u==1) && (_v==0 || _v==1) )){
-        HbrVertex<T> * vertex = NULL;
-        if(_sourceVertex != NULL){
-            vertex = _sourceVertex;
-        }else if(_sourceEdge!=NULL){
-            vertex = _t==0 ? _sourceEdge->GetOrgVertex() : _sourceEdge->GetDestVertex();
-        }else{
-            if(_u==0)
-                if(_v==0)
-                    vertex = _sourceFace->GetVertex(0);
-                else
-                    vertex = _sourceFace->GetVertex(3);
-            else
-                if(_v==0)
-                    vertex = _sourceFace->GetVertex(1);
-                else
-                    vertex = _sourceFace->GetVertex(2);
-        }
-        assert(vertex);
+    HbrVertex<T> * vertex = CornerVertex();
+    if(vertex != NULL){
         const real t_threshold = pow(.5,REF_LEVEL) + EXTRAORDINARY_REGION_OFFSET+1e-10;
         if(vertex->GetValence() != 4 || vertex->OnBoundary()){
             std::set<HbrFace<T>*> oneRingFaces;
@@ -1246,11 +1395,7 @@ bool ParamPoint<T>::RadialCurvature(const vec3 & cameraCenter,real & k_r) const
     vec3 viewVec = limitPosition - cameraCenter;
     viewVec.normalize();
 
-    real ndotv = limitNormal * viewVec;
-    real sintheta = 1.0 - ndotv*ndotv;
-    real u = (viewVec * pdir1), u2 = u*u;
-    real v = (viewVec * pdir2), v2 = v*v;
-    k_r = (k1 * u2 + k2 * v2) / sintheta;
+    k_r = RadialCurvature(viewVec, limitNormal, k1, k2, pdir1, pdir2);
 
     return true;
 
@@ -1575,7 +1720,7 @@ ParamRay<T>::IntersectSegment(const ParamPoint<T> & p1, const ParamPoint<T> & p2
     pts.push_back(p1);
     pts.push_back(p2);
     std::vector<vec2> abs;
-    Chart<T> * chart = ParamPoint<T>::FindChart(pts,abs);
+    const Chart<T> * chart = ParamPoint<T>::FindChart(pts,abs);
 
     if(chart == NULL){
         printf("Chart not found\n");
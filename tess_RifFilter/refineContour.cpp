@@ -6,8 +6,14 @@
 #include <sstream>
 #include <math.h>
 #include <cfloat>
+#include <limits>
 
 #include "refineContour.h"
+#include "stats.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 void SavePLYFile(HbrMesh<VertexDataCatmark> * outputMesh, const char *prefix, int index, bool meshSilhouettes)
 {
@@ -109,7 +115,8 @@ void SavePLYFile(HbrMesh<VertexDataCatmark> * outputMesh, const char *prefix, in
 }
 
 
-int numVerts = 0;
+int numVerts = 0;  // only used to stamp the debugging "age" of new vertices
+#pragma omp threadprivate(numVerts)
 
 bool IsRadialFace(MeshVertex* v0, MeshVertex* v1, MeshVertex* v2)
 {
@@ -156,14 +163,9 @@ bool IsStandardRadialFace(MeshFace* face)
     return IsStandardRadialFace(face->GetVertex(0),face->GetVertex(1),face->GetVertex(2));
 }
 
-void SetupVertex(VertexDataCatmark & vd, const ParamPointCC & p, const vec3 & cameraCenter)
+void SetupVertex(VertexDataCatmark & vd, const ParamPointCC & p, const vec3 & cameraCenter,
+                 const vec3 & limitPosition, const vec3 & limitNormal, real k1, real k2)
 {
-    vec3 limitPosition, limitNormal;
-    real k1, k2;
-    vec3 pdir1, pdir2;
-
-    p.Evaluate(limitPosition, limitNormal, &k1, &k2, &pdir1, &pdir2);
-
     real ndotv;
 
     vec3 viewVec = limitPosition - cameraCenter;
@@ -242,6 +244,41 @@ void SetupVertex(VertexDataCatmark & vd, const ParamPointCC & p, const vec3 & ca
 //    vd.radialCurvature = k_r;
 }
 
+void SetupVertex(VertexDataCatmark & vd, const ParamPointCC & p, const vec3 & cameraCenter)
+{
+    vec3 limitPosition, limitNormal;
+    real k1, k2;
+    vec3 pdir1, pdir2;
+
+    p.Evaluate(limitPosition, limitNormal, &k1, &k2, &pdir1, &pdir2);
+
+    SetupVertex(vd, p, cameraCenter, limitPosition, limitNormal, k1, k2);
+}
+
+// SetupVertex for all the vertices of a mesh, at their sourceLoc, evaluating the surface in one batch
+void SetupVertices(Mesh * mesh, const vec3 & cameraCenter)
+{
+    std::vector<MeshVertex*> verts;
+    verts.reserve(mesh->GetNumVertices());
+    mesh->GetVertices(std::back_inserter(verts));
+
+    const int numVertices = (int)verts.size();
+    if (numVertices == 0)
+        return;
+
+    std::vector<ParamPointCC> locs(numVertices);
+    std::vector<vec3> limitPositions(numVertices), limitNormals(numVertices);
+    std::vector<real> k1(numVertices), k2(numVertices);
+
+    for(int i=0;i<numVertices;i++)
+        locs[i] = verts[i]->GetData().sourceLoc;
+
+    ParamPointCC::Evaluate(numVertices, &locs[0], &limitPositions[0], &limitNormals[0], &k1[0], &k2[0]);
+
+    for(int i=0;i<numVertices;i++)
+        SetupVertex(verts[i]->GetData(), locs[i], cameraCenter, limitPositions[i], limitNormals[i], k1[i], k2[i]);
+}
+
 real FindZeroCrossingBySampling(const ParamPointCC & p0, const ParamPointCC & p1, FacingType facing, vec3 cameraCenter)
 // given an edge where the vertices/face are all consistent (e.g., all front- or back-facing),
 // sample the edge to see if there are any points on the edge with opposite facing.
@@ -250,6 +287,12 @@ real FindZeroCrossingBySampling(const ParamPointCC & p0, const ParamPointCC & p1
     real maxNdotVmag = 0;
     real result = -1;
 
+    // gather the samples first, so that they can be evaluated in one batch
+    std::vector<ParamPointCC> samples;
+    std::vector<real> sampleT;
+    samples.reserve(NUM_INCONSISTENT_SAMPLES);
+    sampleT.reserve(NUM_INCONSISTENT_SAMPLES);
+
     for(int j=0;j<NUM_INCONSISTENT_SAMPLES;j++)
     {
         real t = (j+1.0)/(NUM_INCONSISTENT_SAMPLES + 1);
@@ -262,13 +305,25 @@ real FindZeroCrossingBySampling(const ParamPointCC & p0, const ParamPointCC & p1
 
         pt.SetNormalOffset(0);
 
+        samples.push_back(pt);
+        sampleT.push_back(t);
+    }
+
+    if (samples.empty())
+        return result;
+
+    std::vector<vec3> limitPositions(samples.size()), limitNormals(samples.size());
+    ParamPointCC::Evaluate((int)samples.size(), &samples[0], &limitPositions[0], &limitNormals[0]);
+
+    for(size_t j=0;j<samples.size();j++)
+    {
         real ndotv;
-        FacingType ft = Facing(pt, cameraCenter, CONTOUR_THRESHOLD, &ndotv);
+        FacingType ft = Facing(limitPositions[j] - cameraCenter, limitNormals[j], CONTOUR_THRESHOLD, &ndotv);
 
-        if (ft != CONTOUR && ft != facing && fabsl(ndotv) > maxNdotVmag)
+        if (ft != CONTOUR && ft != facing && fabs(ndotv) > maxNdotVmag)
         {
-            maxNdotVmag = fabsl(ndotv);
-            result = t;
+            maxNdotVmag = fabs(ndotv);
+            result = sampleT[j];
         }
     }
 
@@ -279,15 +334,17 @@ real FindZeroCrossingBySampling(const ParamPointCC & p0, const ParamPointCC & p1
 
 //////////////////////////////// SURFACE TO MESH: INITIAL SAMPLING ROUTINES //////////////////////
 
+// the vertices of the output mesh only get their sourceLoc here; SurfaceToMesh sets them up in one batch (SetupVertices)
+// once all the faces are converted
 MeshVertex * ConvertVertex(Mesh * outputMesh, CatmarkVertex * sourceVertex,
-                           const vec3 & cameraCenter, std::map<CatmarkVertex*, MeshVertex *> & vertexMap)
+                           std::map<CatmarkVertex*, MeshVertex *> & vertexMap)
 {
     if (vertexMap.find(sourceVertex) != vertexMap.end())
         return vertexMap[sourceVertex];
 
     MeshVertex * newVertex = outputMesh->NewVertex();
 
-    SetupVertex(newVertex->GetData(), ParamPointCC(sourceVertex), cameraCenter);
+    newVertex->GetData().sourceLoc = ParamPointCC(sourceVertex);
 
     newVertex->GetData().age = numVerts ++;
 
@@ -313,9 +370,9 @@ void ConvertFaceToTriangle(Mesh * outputMesh, CatmarkFace * face, int v0, int v1
         return;
     }
 
-    ConvertVertex(outputMesh, vertex[0], cameraModel.CameraCenter(), vertexMap);
-    ConvertVertex(outputMesh, vertex[1], cameraModel.CameraCenter(), vertexMap);
-    ConvertVertex(outputMesh, vertex[2], cameraModel.CameraCenter(), vertexMap);
+    ConvertVertex(outputMesh, vertex[0], vertexMap);
+    ConvertVertex(outputMesh, vertex[1], vertexMap);
+    ConvertVertex(outputMesh, vertex[2], vertexMap);
 
     NewFace(outputMesh, vertexMap[vertex[0]],vertexMap[vertex[1]],vertexMap[vertex[2]]);
 }
@@ -344,13 +401,13 @@ void ConvertFaceToTriangles(Mesh * outputMesh, CatmarkFace * face,
         if(!cameraModel.TriangleInside(v0->GetData().GetPos(),v1->GetData().GetPos(),centerPos))
             continue;
 
-        ConvertVertex(outputMesh, v0, cameraModel.CameraCenter(), vertexMap);
-        ConvertVertex(outputMesh, v1, cameraModel.CameraCenter(), vertexMap);
+        ConvertVertex(outputMesh, v0, vertexMap);
+        ConvertVertex(outputMesh, v1, vertexMap);
 
         if (centerVertex == NULL)
         {
             centerVertex = outputMesh->NewVertex();
-            SetupVertex( centerVertex->GetData(), centerLoc, cameraModel.CameraCenter() );
+            centerVertex->GetData().sourceLoc = centerLoc;
             centerVertex->GetData().age = numVerts ++;
         }
 
@@ -371,12 +428,282 @@ void ConvertQuadFace(Mesh * outputMesh, CatmarkFace * face,
         return;
 
     for(int i=0;i<4;i++)
-        ConvertVertex(outputMesh, face->GetVertex(i), cameraModel.CameraCenter(), vertexMap);
+        ConvertVertex(outputMesh, face->GetVertex(i), vertexMap);
 
     NewFace(outputMesh, vertexMap[face->GetVertex(0)], vertexMap[face->GetVertex(1)],
             vertexMap[face->GetVertex(2)], vertexMap[face->GetVertex(3)]);
 }
 
+// ------------------------- adaptive sampling -------------------------
+//
+// A face sampled at level l > subdivisionLevel is cut into cells x cells quads, cells = 2^(l-subdivisionLevel), in
+// the (u,v) of the face. An edge between two faces gets as many segments as the finer of them; since neighbouring
+// levels differ by at most one (see SampleLevels), the cells of the coarser face along that edge get their side
+// midpoint as an extra vertex, and are split into a fan around their center. The points are indexed on a
+// (2*cells+1) x (2*cells+1) grid of cell corners, side midpoints and cell centers.
+
+typedef std::pair<std::pair<int,int>,int> EdgeVertexKey;
+typedef std::map<EdgeVertexKey, MeshVertex*> EdgeVertexMap;
+
+// the face across edge e of a face, NULL on the boundary
+CatmarkFace * AdjacentFace(CatmarkFace * face, int e)
+{
+    CatmarkHalfedge * edge = face->GetEdge(e);
+    return edge->GetLeftFace() != face ? edge->GetLeftFace() : edge->GetRightFace();
+}
+
+// number of segments along each edge of a sampled face, given the levels of the sampled faces
+void EdgeSegments(CatmarkFace * face, int subdivisionLevel, const std::map<CatmarkFace*,int> & faceLevel, int segments[4])
+{
+    std::map<CatmarkFace*,int>::const_iterator it = faceLevel.find(face);
+    int level = it != faceLevel.end() ? it->second : subdivisionLevel;
+
+    for(int e=0;e<4;e++)
+    {
+        int edgeLevel = level;
+
+        CatmarkFace * other = AdjacentFace(face, e);
+        if (other != NULL && (it = faceLevel.find(other)) != faceLevel.end())
+            edgeLevel = std::max(edgeLevel, it->second);
+
+        segments[e] = 1 << (edgeLevel - subdivisionLevel);
+    }
+}
+
+// triangulate the cells of a face; three grid indices per triangle, counter-clockwise in (u,v) like the face
+void AdaptiveTriangles(CatmarkFace * face, int cells, const int segments[4], std::vector<int> & triangles)
+{
+    int res = 2*cells;
+
+    triangles.clear();
+
+    bool extraord[4];
+    for(int j=0;j<4;j++)
+        extraord[j] = (face->GetVertex(j)->GetValence() != 4 || face->GetVertex(j)->OnBoundary());
+
+    for(int cj=0;cj<cells;cj++)
+        for(int ci=0;ci<cells;ci++)
+        {
+            int i0 = 2*ci, j0 = 2*cj;
+
+            int corner[4] = { j0*(res+1)+i0, j0*(res+1)+i0+2, (j0+2)*(res+1)+i0+2, (j0+2)*(res+1)+i0 };
+            int midpoint[4] = { j0*(res+1)+i0+1, (j0+1)*(res+1)+i0+2, (j0+2)*(res+1)+i0+1, (j0+1)*(res+1)+i0 };
+            bool finer[4] = { cj == 0 && segments[0] > cells, ci == cells-1 && segments[1] > cells,
+                              cj == cells-1 && segments[2] > cells, ci == 0 && segments[3] > cells };
+
+            if (finer[0] || finer[1] || finer[2] || finer[3] ||
+                    (cells == 1 && (extraord[1] || extraord[3]) && (extraord[0] || extraord[2])))
+            {
+                // fan around the center of the cell, as in ConvertFaceToTriangles
+                std::vector<int> boundary;
+                for(int s=0;s<4;s++)
+                {
+                    boundary.push_back(corner[s]);
+                    if (finer[s])
+                        boundary.push_back(midpoint[s]);
+                }
+
+                int center = (j0+1)*(res+1)+i0+1;
+                for(size_t b=0;b<boundary.size();b++)
+                {
+                    triangles.push_back(boundary[b]);
+                    triangles.push_back(boundary[(b+1)%boundary.size()]);
+                    triangles.push_back(center);
+                }
+                continue;
+            }
+
+            // want a diagonal emanating from an extraordinary corner of the face
+            if ((ci == cells-1 && cj == 0 && extraord[1]) || (ci == 0 && cj == cells-1 && extraord[3]))
+            {
+                int tri[6] = { corner[0], corner[1], corner[3], corner[1], corner[2], corner[3] };
+                triangles.insert(triangles.end(), tri, tri+6);
+            }
+            else
+            {
+                int tri[6] = { corner[0], corner[1], corner[2], corner[0], corner[2], corner[3] };
+                triangles.insert(triangles.end(), tri, tri+6);
+            }
+        }
+}
+
+// position of a grid point for the view-frustum tests: bilinear in the control points, like the tests of whole faces
+vec3 GridPosition(CatmarkFace * face, int res, int index)
+{
+    real u = real(index % (res+1))/res;
+    real v = real(index / (res+1))/res;
+
+    return (1-u)*(1-v)*face->GetVertex(0)->GetData().GetPos() + u*(1-v)*face->GetVertex(1)->GetData().GetPos() +
+            u*v*face->GetVertex(2)->GetData().GetPos() + (1-u)*v*face->GetVertex(3)->GetData().GetPos();
+}
+
+// generate the triangles of AdaptiveTriangles that are in the view frustum. The vertices at the corners of the face
+// are shared through vertexMap, those on its edges through edgeVertexMap, keyed by the IDs of the edge's end points
+// (lowest first) and the position along the edge in units of 1/maxSegments.
+void ConvertFaceAdaptive(Mesh * outputMesh, CatmarkFace * face, int cells, const int segments[4], int maxSegments,
+                         std::map<CatmarkVertex*, MeshVertex*> & vertexMap, EdgeVertexMap & edgeVertexMap,
+                         const CameraModel & cameraModel)
+{
+    int res = 2*cells;
+
+    std::vector<int> triangles;
+    AdaptiveTriangles(face, cells, segments, triangles);
+
+    std::vector<MeshVertex*> gridVertices((res+1)*(res+1), (MeshVertex*)NULL);
+
+    for(size_t t=0;t<triangles.size();t+=3)
+    {
+        if (!cameraModel.TriangleInside(GridPosition(face, res, triangles[t]),
+                                        GridPosition(face, res, triangles[t+1]),
+                                        GridPosition(face, res, triangles[t+2])))
+            continue;
+
+        MeshVertex * v[3];
+
+        for(int k=0;k<3;k++)
+        {
+            int index = triangles[t+k];
+            int i = index % (res+1);
+            int j = index / (res+1);
+
+            if (gridVertices[index] != NULL)
+            {
+                v[k] = gridVertices[index];
+                continue;
+            }
+
+            if ((i == 0 || i == res) && (j == 0 || j == res))
+            {
+                int corner = (j == 0) ? (i == 0 ? 0 : 1) : (i == 0 ? 3 : 2);
+                v[k] = ConvertVertex(outputMesh, face->GetVertex(corner), vertexMap);
+                gridVertices[index] = v[k];
+                continue;
+            }
+
+            ParamPointCC loc(face, real(i)/res, real(j)/res);
+
+            if (i == 0 || i == res || j == 0 || j == res)
+            {
+                // position along the edge, from its origin
+                int e, pos;
+                if (j == 0)        { e = 0; pos = i; }
+                else if (i == res) { e = 1; pos = j; }
+                else if (j == res) { e = 2; pos = res-i; }
+                else               { e = 3; pos = res-j; }
+
+                assert((pos * maxSegments) % res == 0);
+                pos = pos * maxSegments / res;
+
+                int org = face->GetEdge(e)->GetOrgVertex()->GetID();
+                int dest = face->GetEdge(e)->GetDestVertex()->GetID();
+                EdgeVertexKey key = org < dest ? EdgeVertexKey(std::make_pair(org,dest),pos) :
+                                                 EdgeVertexKey(std::make_pair(dest,org),maxSegments-pos);
+
+                EdgeVertexMap::iterator it = edgeVertexMap.find(key);
+                if (it != edgeVertexMap.end())
+                {
+                    v[k] = it->second;
+                    gridVertices[index] = v[k];
+                    continue;
+                }
+
+                v[k] = outputMesh->NewVertex();
+                edgeVertexMap[key] = v[k];
+            }
+            else
+                v[k] = outputMesh->NewVertex();
+
+            v[k]->GetData().sourceLoc = loc;
+            v[k]->GetData().age = numVerts ++;
+
+            gridVertices[index] = v[k];
+        }
+
+        NewFace(outputMesh, v[0], v[1], v[2]);
+    }
+}
+
+void SampleLevels(const std::vector<CatmarkFace*> & faces, int subdivisionLevel, int maxSubdivisionLevel,
+                  const CameraModel & cameraModel, std::vector<int> & levels)
+{
+    levels.assign(faces.size(), subdivisionLevel);
+
+    if (maxSubdivisionLevel <= subdivisionLevel)
+        return;
+
+    const int n = NUM_ADAPTIVE_SAMPLES_SQRT;
+    std::vector<ParamPointCC> samples(n*n);
+    std::vector<vec3> limitPositions(n*n), limitNormals(n*n);
+
+    std::map<CatmarkFace*,int> faceIndex;
+
+    for(size_t k=0;k<faces.size();k++)
+    {
+        CatmarkFace * face = faces[k];
+        faceIndex[face] = k;
+
+        for(int j=0;j<n;j++)
+            for(int i=0;i<n;i++)
+                samples[j*n+i] = ParamPointCC(face, real(i)/(n-1), real(j)/(n-1));
+
+        ParamPointCC::Evaluate(n*n, &samples[0], &limitPositions[0], &limitNormals[0]);
+
+        const vec3 & p0 = limitPositions[0];
+        const vec3 & p1 = limitPositions[n-1];
+        const vec3 & p2 = limitPositions[n*n-1];
+        const vec3 & p3 = limitPositions[(n-1)*n];
+
+        if (!cameraModel.TriangleInside(p0,p1,p2) && !cameraModel.TriangleInside(p0,p2,p3))
+            continue;
+
+        // the contour crosses the face: sample it as finely as allowed
+        bool front = false, back = false;
+        for(int s=0;s<n*n;s++)
+        {
+            FacingType ft = Facing(limitPositions[s] - cameraModel.CameraCenter(), limitNormals[s]);
+            front = front || ft == FRONT;
+            back = back || ft == BACK;
+        }
+
+        if (front && back)
+        {
+            levels[k] = maxSubdivisionLevel;
+            continue;
+        }
+
+        // each level divides the image-space area of the cells by four
+        real area = cameraModel.ImageSpaceArea(p0,p1,p2) + cameraModel.ImageSpaceArea(p0,p2,p3);
+
+        while (levels[k] < maxSubdivisionLevel && area > ADAPTIVE_CELL_AREA_PIXELS)
+        {
+            levels[k] ++;
+            area /= 4;
+        }
+    }
+
+    // raise the levels until neighbouring faces differ by at most one
+    std::vector<int> queue;
+    for(size_t k=0;k<faces.size();k++)
+        if (levels[k] > subdivisionLevel+1)
+            queue.push_back(k);
+
+    while (!queue.empty())
+    {
+        int k = queue.back();
+        queue.pop_back();
+
+        for(int e=0;e<4;e++)
+        {
+            std::map<CatmarkFace*,int>::iterator it = faceIndex.find(AdjacentFace(faces[k], e));
+            if (it == faceIndex.end() || levels[it->second] >= levels[k]-1)
+                continue;
+
+            levels[it->second] = levels[k]-1;
+            queue.push_back(it->second);
+        }
+    }
+}
+
 int IsNearBoundary(CatmarkFace * face, int distance)
 {
     // is this face within "distance" of the boundary?
@@ -421,9 +748,80 @@ void RefineFaceUniform(HbrFace<T>* face, int level)
     }
 }
 
+// build a Catmull-Clark control mesh from face-vertex lists (positions: 3 per vertex), reporting bad connectivity
+CatmarkMesh * NewCatmarkSurface(int numVertices, const real * positions, int numFaces, const int * faceSizes, const int * vertIndices)
+{
+    static HbrCatmarkSubdivision<Vertex> catmark;
+    CatmarkMesh * surface = new CatmarkMesh(&catmark);
+
+    Vertex vtx;
+    for(int i=0;i<numVertices; i++ ) {
+        CatmarkVertex* v = surface->NewVertex(i, vtx);
+        v->GetData().SetPosition(positions[3*i],positions[3*i+1],positions[3*i+2]);
+    }
+
+    int maxFaceSize = 0;
+    for(int i = 0; i < numFaces; ++i) {
+        maxFaceSize = std::max(faceSizes[i], maxFaceSize);
+    }
+
+    std::vector<int> fv(maxFaceSize);
+    int k = 0;
+    for (int i=0; i<numFaces; ++i) {
+        int faceSize = faceSizes[i];
+        for(int j = 0; j < faceSize; ++j) {
+            fv[j] = vertIndices[k++];
+        }
+
+        // now check the half-edges connectivity
+        for(int j=0; j<faceSize; j++) {
+            CatmarkVertex * origin      = surface->GetVertex( fv[j] );
+            CatmarkVertex * destination = surface->GetVertex( fv[(j+1)%faceSize] );
+
+            if(origin==NULL || destination==NULL) {
+                printf(" An edge was specified that connected a nonexistent vertex\n");
+                continue;
+            }
+
+            CatmarkHalfedge * opposite  = destination->GetEdge(origin);
+
+            if(origin == destination) {
+                printf(" An edge was specified that connected a vertex to itself\n");
+                continue;
+            }
+
+            if(opposite && opposite->GetOpposite() ) {
+                printf(" A non-manifold edge incident to more than 2 faces was found\n");
+                continue;
+            }
+
+            if(origin->GetEdge(destination)) {
+                printf(" An edge connecting two vertices was specified more than once."
+                       " It's likely that an incident face was flipped\n");
+                continue;
+            }
+        }
+
+        surface->NewFace(faceSize, &fv[0], i);
+    }
+
+    surface->SetInterpolateBoundaryMethod( CatmarkMesh::k_InterpolateBoundaryEdgeOnly );
+
+    surface->Finish();
+
+    if(surface->GetNumDisconnectedVertices())
+    {
+        printf("The specified subdivmesh contains disconnected surface components.\n");
+
+        // abort or iterate over the mesh to remove the offending vertices
+    }
+
+    return surface;
+}
+
 // sample an initial triangle mesh from a surface, clipping to the view frustum
 Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
-                     const CameraModel & cameraModel, bool triangles)
+                     const CameraModel & cameraModel, bool triangles, int maxSubdivisionLevel)
 {
     // subdivide the mesh up to _subdivisionLevel
     // subdividing at least once is necessary since later steps assume all faces are quads.
@@ -450,6 +848,8 @@ Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
     OsdUtilSubdivTopology topology;
     std::vector<real> pointPositions;
     std::map<int,int> indexMap;
+    Subdiv * subdiv = new Subdiv;
+    subdiv->faceIndexMap.assign(sourceMesh->GetNumFaces(), -1);
 
     for(int i=0; i<sourceMesh->GetNumVertices(); ++i){
         CatmarkVertex* vertex = sourceMesh->GetVertex(i);
@@ -474,7 +874,7 @@ Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
         CatmarkFace* f = sourceMesh->GetFace(i);
         if(f->GetDepth()!=subdivisionLevel)
             continue;
-        Subdiv::getInstance().faceIndexMap[i] = topology.nverts.size();
+        subdiv->faceIndexMap[i] = topology.nverts.size();
         topology.nverts.push_back(f->GetNumVertices());
         for (int j=0; j<f->GetNumVertices(); ++j){
             topology.indices.push_back(indexMap[f->GetVertex(j)->GetID()]);
@@ -486,10 +886,13 @@ Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
     std::string *errorMessage;
     if(!topology.IsValid(errorMessage)){
         std::cout << "Initialize failed with " << *errorMessage << std::endl;
+        delete subdiv;
         return NULL;
     }
 
-    Subdiv::getInstance().initialize(topology,pointPositions);
+    // each surface owns its evaluator; released with Subdiv::Release once the surface is done
+    subdiv->initialize(topology,pointPositions);
+    Subdiv::Attach(sourceMesh, subdiv);
 
     Mesh * outputMesh = new Mesh;
 
@@ -502,21 +905,49 @@ Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
     // ------------- transfer all of the faces ----------------------------
 
     std::map<CatmarkVertex*,MeshVertex *> vertexMap;              // Mapping from input to output vertices
+    EdgeVertexMap edgeVertexMap;                                  // vertices inside the edges of adaptive faces
+
+    printf("nb faces after refine: %d\n",sourceMesh->GetNumFaces());
+
+    // faces that are near the boundary are skipped
+    std::vector<CatmarkFace*> sampledFaces;
+    SampledFaces(sourceMesh, subdivisionLevel, sampledFaces);
+
+    // quads are always sampled at subdivisionLevel
+    std::vector<int> levels;
+    SampleLevels(sampledFaces, subdivisionLevel, triangles ? maxSubdivisionLevel : subdivisionLevel, cameraModel, levels);
+
+    std::map<CatmarkFace*,int> faceLevel;
+    int maxLevel = subdivisionLevel;
+    for(size_t i=0;i<sampledFaces.size();i++)
+        if (levels[i] > subdivisionLevel)
+        {
+            faceLevel[sampledFaces[i]] = levels[i];
+            maxLevel = std::max(maxLevel, levels[i]);
+        }
 
-    int initialNumFaces = sourceMesh->GetNumFaces();
-    printf("nb faces after refine: %d\n",initialNumFaces);
+    int numSampledFaces = sampledFaces.size();
 
     // copy all faces, creating new vertices as necessary
-    for(int i=0;i<initialNumFaces; i++)
+    for(int i=0;i<numSampledFaces; i++)
     {
-        CatmarkFace * face = sourceMesh->GetFace(i);
+        CatmarkFace * face = sampledFaces[i];
 
-        // skip faces that are near the boundary
-        if(face->GetDepth() != subdivisionLevel || IsNearBoundary(face, pow(2, subdivisionLevel))){
-            continue;
-        }
+        printf("Processing face %d / %d \r", i, numSampledFaces);
 
-        printf("Processing face %d / %d \r", i, initialNumFaces);
+        if (!faceLevel.empty())
+        {
+            int cells = 1 << (levels[i] - subdivisionLevel);
+            int segments[4];
+            EdgeSegments(face, subdivisionLevel, faceLevel, segments);
+
+            if (cells > 1 || segments[0] > 1 || segments[1] > 1 || segments[2] > 1 || segments[3] > 1)
+            {
+                ConvertFaceAdaptive(outputMesh, face, cells, segments, 1 << (maxLevel - subdivisionLevel),
+                                    vertexMap, edgeVertexMap, cameraModel);
+                continue;
+            }
+        }
 
         bool extraord[4];
         int numExtraord = 0;
@@ -565,85 +996,223 @@ Mesh * SurfaceToMesh(CatmarkMesh * sourceMesh, int subdivisionLevel,
         return NULL;
     }
 
+    SetupVertices(outputMesh, cameraModel.CameraCenter());
+
     // generate charts.  this has to be done after the geometry is complete
 
     return outputMesh;
 }
 
+void SampledFaces(CatmarkMesh * sourceMesh, int subdivisionLevel, std::vector<CatmarkFace*> & faces)
+{
+    faces.clear();
+
+    // same faces as SurfaceToMesh, in the same order
+    for(int i=0;i<sourceMesh->GetNumFaces(); i++)
+    {
+        CatmarkFace * face = sourceMesh->GetFace(i);
+
+        if(face->GetDepth() == subdivisionLevel && !IsNearBoundary(face, pow(2, subdivisionLevel)))
+            faces.push_back(face);
+    }
+}
+
+void FrustumSignature(const std::vector<CatmarkFace*> & faces, const std::vector<int> & levels, int subdivisionLevel,
+                      const CameraModel & cameraModel, std::vector<bool> & signature)
+{
+    signature.clear();
+
+    std::map<CatmarkFace*,int> faceLevel;
+    for(size_t i=0;i<faces.size();i++)
+        if (levels[i] > subdivisionLevel)
+            faceLevel[faces[i]] = levels[i];
+
+    // same triangles as the triangle case of SurfaceToMesh
+    for(size_t i=0;i<faces.size();i++)
+    {
+        CatmarkFace * face = faces[i];
+
+        if (!faceLevel.empty())
+        {
+            int cells = 1 << (levels[i] - subdivisionLevel);
+            int segments[4];
+            EdgeSegments(face, subdivisionLevel, faceLevel, segments);
+
+            if (cells > 1 || segments[0] > 1 || segments[1] > 1 || segments[2] > 1 || segments[3] > 1)
+            {
+                std::vector<int> triangles;
+                AdaptiveTriangles(face, cells, segments, triangles);
+
+                for(size_t t=0;t<triangles.size();t+=3)
+                    signature.push_back(cameraModel.TriangleInside(GridPosition(face, 2*cells, triangles[t]),
+                                                                   GridPosition(face, 2*cells, triangles[t+1]),
+                                                                   GridPosition(face, 2*cells, triangles[t+2])));
+                continue;
+            }
+        }
+
+        bool extraord[4];
+        vec3 p[4];
+        for(int j=0;j<4;j++)
+        {
+            extraord[j] = (face->GetVertex(j)->GetValence() != 4 || face->GetVertex(j)->OnBoundary());
+            p[j] = face->GetVertex(j)->GetData().GetPos();
+        }
+
+        if ((extraord[1] || extraord[3]) && (extraord[0] || extraord[2]))
+        {
+            vec3 centerPos, centerNormal;
+            ParamPointCC(face, 0.5, 0.5).Evaluate(centerPos, centerNormal);
+
+            for(int e=0;e<4;e++)
+                signature.push_back(cameraModel.TriangleInside(p[e], p[(e+1)%4], centerPos));
+        }
+        else
+            if (extraord[1] || extraord[3])
+            {
+                signature.push_back(cameraModel.TriangleInside(p[0], p[1], p[3]));
+                signature.push_back(cameraModel.TriangleInside(p[1], p[2], p[3]));
+            }
+            else
+            {
+                signature.push_back(cameraModel.TriangleInside(p[0], p[1], p[2]));
+                signature.push_back(cameraModel.TriangleInside(p[0], p[2], p[3]));
+            }
+    }
+}
+
 /////////////////////////////////////  MAIN REFINEMENT ROUTINES ////////////////////////////
 
 
 bool FindContour(const ParamPointCC & p0, const ParamPointCC & p1, vec3 cameraCenter, ParamPointCC & resultPoint)
 // use root-finding to find a contour point between p0 and p1, assuming that p0 and p1 share some face
 //
-// this is potentially very inefficient because each call to interpolate params redoes the interpolation logic
+// uses Brent's method on ndotv(t) along Interpolate(p0,p1,t): inverse quadratic / secant steps while they
+// stay inside the bracket and keep shrinking it, bisection otherwise.  each step costs a full limit
+// evaluation, so this typically needs a handful of steps where plain bisection needed dozens.
+// the solver state is kept in extended precision regardless of the build precision: the interpolation
+// formulas cancel badly near the root, and they are cheap next to the evaluations.
 {
     //  printf("\n_________________________________________\n");
 
-    ParamPointCC lower = p0;
-    ParamPointCC upper = p1;
-
-    real t_lower = 0;
-    real t_upper = 1;
-    std::map<real,real> values;
+    // b is the best estimate so far, c the opposite end of the bracket, a the previous estimate
+    ParamPointCC pa = p0, pb = p1, pc;
+    real_ext a = 0, b = 1, c;
+    real_ext fa, fb, fc;
+    real ndotv;
 
-    real ndotvL, ndotvU;
+    FacingType lowerFacing = Facing(p0, cameraCenter, CONTOUR_THRESHOLD, &ndotv);
+    fa = ndotv;
+    FacingType upperFacing = Facing(p1, cameraCenter, CONTOUR_THRESHOLD, &ndotv);
+    fb = ndotv;
 
-    FacingType lowerFacing = Facing(lower, cameraCenter, CONTOUR_THRESHOLD, &ndotvL);
-    values[t_lower] = ndotvL;
+    assert(lowerFacing != CONTOUR && upperFacing != CONTOUR && lowerFacing != upperFacing);
 
-    FacingType upperFacing = Facing(upper, cameraCenter, CONTOUR_THRESHOLD, &ndotvU);
-    values[t_upper] = ndotvU;
+    // iterates, kept only for the failure dump below
+    real valuesT[MAX_ROOT_ITERATIONS+2], valuesV[MAX_ROOT_ITERATIONS+2];
+    int numValues = 0;
+    valuesT[numValues] = a; valuesV[numValues++] = fa;
+    valuesT[numValues] = b; valuesV[numValues++] = fb;
 
-    bool lowerIsEndpoint = true, upperIsEndpoint = true;
+    pc = pa; c = a; fc = fa;
+    real_ext d = b - a, e = d;
 
-    assert(lowerFacing != CONTOUR && upperFacing != CONTOUR && lowerFacing != upperFacing);
+    // the bracket width the bisection this replaced reached after MAX_ROOT_ITERATIONS halvings
+    const real_ext xtol = ldexpl(1, -MAX_ROOT_ITERATIONS);
 
     for(int i=0;i<MAX_ROOT_ITERATIONS;i++)
     {
-        // bisection method
-        ParamPointCC nextPoint = ParamPointCC::Interpolate(lower,upper,0.5);
+        if ((fb > 0) == (fc > 0))
+        {
+            pc = pa; c = a; fc = fa;
+            d = e = b - a;
+        }
 
-        if (nextPoint.IsNull() || !nextPoint.IsEvaluable())   // rare round-off error seems to happen once in awhile. seems to relate to root-finding between an extSrc and another point.
+        if (fabsl(fc) < fabsl(fb))
         {
-            printf("UNEXPECTED NON-EVALUABLE POINT IN FIND CONTOUR at ");
-            nextPoint.Print();
-            return false;
+            pa = pb; a = b; fa = fb;
+            pb = pc; b = c; fb = fc;
+            pc = pa; c = a; fc = fa;
         }
 
-        real ndotv;
-        FacingType newFacing = Facing(nextPoint, cameraCenter, CONTOUR_THRESHOLD, &ndotv);
+        // steps below the resolution of the parameter (a real) cannot move the point; the absolute
+        // floor keeps a root near t = 0 from shrinking the bracket further than bisection used to
+        real_ext tol = 2*std::numeric_limits<real>::epsilon()*fabsl(b) + 0.5*xtol;
+        real_ext xm = (c - b)/2;
 
-        if (newFacing == CONTOUR)
+        if (fabsl(xm) <= tol)   // bracket has collapsed to round-off without reaching the threshold
+            break;
+
+        if (fabsl(e) >= tol && fabsl(fa) > fabsl(fb))
         {
-            resultPoint = nextPoint;
-            return true;
+            // attempt inverse quadratic interpolation (secant if only two distinct points)
+            real_ext s = fb/fa, p, q;
+            if (a == c)
+            {
+                p = 2*xm*s;
+                q = 1-s;
+            }
+            else
+            {
+                real_ext qa = fa/fc, r = fb/fc;
+                p = s*(2*xm*qa*(qa-r) - (b-a)*(r-1));
+                q = (qa-1)*(r-1)*(s-1);
+            }
+            if (p > 0)
+                q = -q;
+            p = fabsl(p);
+
+            if (2*p < std::min(3*xm*q - fabsl(tol*q), fabsl(e*q)))
+            {
+                e = d;
+                d = p/q;
+            }
+            else
+            {
+                d = xm;
+                e = d;
+            }
         }
+        else
+        {
+            d = xm;
+            e = d;
+        }
+
+        pa = pb; a = b; fa = fb;
+        b = real(b + (fabsl(d) > tol ? d : (xm > 0 ? tol : -tol)));
 
-        if (newFacing == lowerFacing)
+        pb = ParamPointCC::Interpolate(p0,p1,real(b));
+
+        if (pb.IsNull() || !pb.IsEvaluable())   // rare round-off error seems to happen once in awhile. seems to relate to root-finding between an extSrc and another point.
         {
-            lower = nextPoint;
-            ndotvL = ndotv;
-            lowerIsEndpoint = false;
-            t_lower = (t_lower + t_upper)/2;
-            values[t_lower] = ndotv;
+            printf("UNEXPECTED NON-EVALUABLE POINT IN FIND CONTOUR at ");
+            pb.Print();
+            return false;
         }
-        else
+
+        FacingType newFacing = Facing(pb, cameraCenter, CONTOUR_THRESHOLD, &ndotv);
+        fb = ndotv;
+        valuesT[numValues] = b; valuesV[numValues++] = fb;
+
+        if (newFacing == CONTOUR)
         {
-            upper = nextPoint;
-            ndotvU = ndotv;
-            upperIsEndpoint = false;
-            t_upper = (t_lower + t_upper)/2;
-            values[t_upper] = ndotv;
+            resultPoint = pb;
+            return true;
         }
     }
 
-    printf("WARNING: EXCEEDED MAX ITERATIONS. ndotv bounds: (%lf, %lf)\n", double(ndotvL), double(ndotvU));
+    printf("WARNING: ROOT FINDING DID NOT CONVERGE. ndotv bounds: (%lf, %lf)\n", double(fb), double(fc));
 
     static int n = 0;
 
+#pragma omp critical(rootFindingDump)
     if (n < 10)
     {
+        std::map<real,real> values;
+        for(int i=0;i<numValues;i++)
+            values[valuesT[i]] = valuesV[i];
+
         char filename[20];
         sprintf(filename, "rootfinding-%d.txt", n++);
         FILE * fp = fopen(filename, "wt");
@@ -656,16 +1225,13 @@ bool FindContour(const ParamPointCC & p0, const ParamPointCC & p1, vec3 cameraCe
 
     //  assert(0);
 
-    assert(!(upperIsEndpoint && lowerIsEndpoint));
+    bool bIsEndpoint = (b == 0 || b == 1);
+    bool cIsEndpoint = (c == 0 || c == 1);
 
-    // if one of the bounds is an endpoint, return the other point
-    if (upperIsEndpoint)
-        resultPoint = lower;
-    else
-        if (lowerIsEndpoint)
-            resultPoint = upper;
-        else
-            resultPoint = (fabsl(ndotvU) < fabsl(ndotvL) ? upper : lower);
+    assert(!(bIsEndpoint && cIsEndpoint));
+
+    // if one of the bounds is an endpoint, return the other point; otherwise b is the closer one
+    resultPoint = (bIsEndpoint ? pc : pb);
 
     return false;
 }
@@ -838,7 +1404,7 @@ bool EnsureShiftable(MeshVertex * shiftVertex, const ParamPointCC & targetLoc,
         if(edge == NULL)
             continue;
 
-        MeshVertex * vnew = mesh->NewVertex();
+        MeshVertex * vnew = NewVertex(mesh);
         VertexDataCatmark & data = vnew->GetData();
         SetupVertex(data, (*it).second.first, cameraCenter);
 
@@ -963,9 +1529,9 @@ MeshVertex * ShiftVertex(MeshVertex * vA, MeshVertex * vB, const ParamPointCC &
 
     VertexDataCatmark & data = shiftVertex->GetData();
 
-    if (data.origLoc.IsNull())
-        data.origLoc = data.sourceLoc;
-    data.isShifted = true;
+    VertexProvenance & prov = VertexProvenanceTable::Row(mesh, shiftVertex);
+    if (prov.origLoc.IsNull())
+        prov.origLoc = data.sourceLoc;
 
     real ndotv;
     FacingType ft = Facing(limitPos - cameraCenter, limitNormal, CONTOUR_THRESHOLD, &ndotv);
@@ -978,9 +1544,10 @@ MeshVertex * ShiftVertex(MeshVertex * vA, MeshVertex * vB, const ParamPointCC &
 
     // note: not touching extSrc...
 
-    if (wiggleQueue != NULL && enqueueNewFaces)
+    if (wiggleQueue != NULL)
     {
-        // add the one-ring to the list of modified faces
+        // the faces of the one-ring changed shape: reprioritize those already queued, and add the one-ring to the
+        // list of modified faces
         std::set<MeshFace*> faces;
         GetOneRing<VertexDataCatmark>(shiftVertex, faces);
 
@@ -988,6 +1555,12 @@ MeshVertex * ShiftVertex(MeshVertex * vA, MeshVertex * vB, const ParamPointCC &
         {
             MeshFace * face = *it;
 
+            wiggleQueue->Update(face);
+            splitQueue->Update(face);
+
+            if (!enqueueNewFaces)
+                continue;
+
             assert(GetArea<VertexDataCatmark>(face) > 0);
             
             if (!IsConsistent<VertexDataCatmark>(face, cameraCenter))
@@ -1039,7 +1612,7 @@ real GetMinAngle(const MeshVertex * v1, const MeshVertex * v2, const MeshVertex
         vec3 e1 = (p[(i+1)%3] - p[i]).normalize();
         vec3 e2 = (p[(i+2)%3] - p[i]).normalize();
 
-        real angle = acosl(e1 * e2);
+        real angle = acos(e1 * e2);
 
 #ifdef isnan
         if (isnan(angle) || isinf(angle))
@@ -1065,7 +1638,7 @@ real TriangleQuality(const MeshVertex * v1, const MeshVertex * v2, const MeshVer
     real area = GetArea<VertexDataCatmark>(v1,v2,v3);
     real sumLength = EdgeLengthSquare(v1,v2)+EdgeLengthSquare(v2,v3)+EdgeLengthSquare(v3,v1);
     if(sumLength > 0.0)
-        return (4.0*sqrtl(3.0)*area) / sumLength;
+        return (4.0*sqrt(3.0)*area) / sumLength;
     return 0;
 }
 
@@ -1146,7 +1719,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
     assert(edge != NULL); // might crash at boundaries in which case we must check v2->GetEdge(v1);
 
     // create a dummy vertex for the test point
-    MeshVertex * vnew = v1->GetMesh()->NewVertex();
+    MeshVertex * vnew = NewVertex(v1->GetMesh());
     VertexDataCatmark & data = vnew->GetData();
     data.extraordinary = false;
     data.extSrc = NULL;
@@ -1211,7 +1784,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
             {
                 if (SmallTriangle<VertexDataCatmark>(newFaces[f][0],newFaces[f][1],newFaces[f][2]))
                 {
-                    v1->GetMesh()->DeleteVertex(vnew);
+                    DeleteVertex(v1->GetMesh(), vnew);
                     SplitCandidate candidate;
                     candidate.numConsistent = -1;
                     return candidate;
@@ -1221,7 +1794,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
 
                 if (quality < 0)
                 {
-                    v1->GetMesh()->DeleteVertex(vnew);
+                    DeleteVertex(v1->GetMesh(), vnew);
                     SplitCandidate candidate;
                     candidate.numConsistent = -1;
                     return candidate;
@@ -1235,7 +1808,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
                     minQuality = quality;
             }
 
-            v1->GetMesh()->DeleteVertex(vnew);
+            DeleteVertex(v1->GetMesh(), vnew);
 
 
             SplitCandidate candidate;
@@ -1259,7 +1832,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
     if (!ParamPointCC::HasCommonChart(v1->GetData().sourceLoc,v2->GetData().sourceLoc))
     {
         printf("WARNING: NO COMMON ORIGIN IN FIND BEST SPLIT\n");
-        v1->GetMesh()->DeleteVertex(vnew);
+        DeleteVertex(v1->GetMesh(), vnew);
         return SplitCandidate();
     }
 
@@ -1387,7 +1960,7 @@ SplitCandidate FindBestSplitPoint(MeshVertex * v1, MeshVertex * v2,
     }
 
     // delete the dummy vertex
-    v1->GetMesh()->DeleteVertex(vnew);
+    DeleteVertex(v1->GetMesh(), vnew);
 
     if (bestNumConsistent < 0)
         return SplitCandidate();
@@ -1521,7 +2094,7 @@ bool FindBestSplitPointFace(MeshFace * face, bool allowShifts, const vec3 & came
         return false;
 
     // insert the new vertex
-    MeshVertex * newVertex = mesh->NewVertex();
+    MeshVertex * newVertex = NewVertex(mesh);
     SetupVertex(newVertex->GetData(),candidates[e].splitLoc,cameraCenter);
     newVertex->GetData().extSrc = candidates[e].extSrc;
 
@@ -1591,7 +2164,7 @@ bool FindRadialSplitPointFace(MeshFace * face, const vec3 & cameraCenter, Mesh *
     // need to try opp side too.
 
     // insert the new vertex
-    MeshVertex * newVertex = mesh->NewVertex();
+    MeshVertex * newVertex = NewVertex(mesh);
     SetupVertex(newVertex->GetData(),newPoint,cameraCenter);
 
     InsertVertex<VertexDataCatmark>(face, bestEdge, newVertex, mesh, wiggleQueue, splitQueue);
@@ -1957,6 +2530,8 @@ int WiggleVertexInParamSpace(MeshVertex* currV, const vec3 & cameraCenter)
         if(!GetFaceUV(currF,currV->GetData().sourceLoc,u,v)){
             continue;
         }
+        // gather the samples of the face and evaluate them in one batch
+        std::vector<ParamPointCC> samples;
         for(int du=-h; du<=h; du++){
             for(int dv=-h; dv<=h; dv++){
                 if(du==0 && dv == 0)
@@ -1970,43 +2545,51 @@ int WiggleVertexInParamSpace(MeshVertex* currV, const vec3 & cameraCenter)
                 ParamPointCC newPosParam = ParamPointCC(currF,newU,newV);
                 if(newPosParam.IsNull() || !newPosParam.IsEvaluable())
                     continue;
+                samples.push_back(newPosParam);
+            }
+        }
+        if(samples.empty())
+            continue;
 
-                vec3 newPos, newNormal;
-                newPosParam.Evaluate(newPos, newNormal);
+        std::vector<vec3> newPositions(samples.size()), newNormals(samples.size());
+        ParamPointCC::Evaluate(samples.size(), &samples[0], &newPositions[0], &newNormals[0]);
 
-                if(!ValidMove(currV,newPos,adjacentFaces))
-                    continue;
+        for(size_t s=0; s<samples.size(); s++){
+            const vec3 & newPos = newPositions[s];
+            const vec3 & newNormal = newNormals[s];
 
-                currV->GetData().pos = newPos;
+            if(!ValidMove(currV,newPos,adjacentFaces))
+                continue;
 
-                int numInconsistent = 0;
-                std::vector<real> quality;
-                quality.reserve(adjacentFaces.size());
-                for(std::set<MeshFace*>::iterator it = adjacentFaces.begin(); it != adjacentFaces.end(); ++it)
-                    if (!IsConsistent(*it, cameraCenter)){
-                        if (IsContourFace(*it))
-                            numInconsistent += contourScore;
-                        else
-                            numInconsistent ++;
-                        quality.push_back(TriangleQuality(*it));
-                    }
-                real minQuality = FLT_MAX;
-                for(std::vector<real>::iterator qIt=quality.begin(); qIt!=quality.end(); qIt++){
-                    if((*qIt)<minQuality)
-                        minQuality = (*qIt);
-                }
-                if(!(minQuality>=0.0))
-                    printf("min quality = %f\n",(double) minQuality);
-                assert(minQuality>=0.0);
+            currV->GetData().pos = newPos;
 
-                if (numInconsistent < bestNumInconsistent || (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
-                    bestNumInconsistent = numInconsistent;
-                    bestMinQuality = minQuality;
-                    bestPos = newPos;
-                    bestNormal = newNormal;
+            int numInconsistent = 0;
+            std::vector<real> quality;
+            quality.reserve(adjacentFaces.size());
+            for(std::set<MeshFace*>::iterator it = adjacentFaces.begin(); it != adjacentFaces.end(); ++it)
+                if (!IsConsistent(*it, cameraCenter)){
+                    if (IsContourFace(*it))
+                        numInconsistent += contourScore;
+                    else
+                        numInconsistent ++;
+                    quality.push_back(TriangleQuality(*it));
                 }
-                currV->GetData().pos = oldPos;
+            real minQuality = FLT_MAX;
+            for(std::vector<real>::iterator qIt=quality.begin(); qIt!=quality.end(); qIt++){
+                if((*qIt)<minQuality)
+                    minQuality = (*qIt);
             }
+            if(!(minQuality>=0.0))
+                printf("min quality = %f\n",(double) minQuality);
+            assert(minQuality>=0.0);
+
+            if (numInconsistent < bestNumInconsistent || (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
+                bestNumInconsistent = numInconsistent;
+                bestMinQuality = minQuality;
+                bestPos = newPos;
+                bestNormal = newNormal;
+            }
+            currV->GetData().pos = oldPos;
         }
     }
 
@@ -2096,8 +2679,9 @@ int WiggleFaceVerticesInParamSpace(MeshFace* currF, MeshVertex* currV, const vec
         }
     }else{
         const int NUM_SAMPLES = 11;
-        // Regular case (not a contour point): search in one ring triangles
+        // Regular case (not a contour point): search in one ring triangles. The samples are evaluated in one batch
         int idx = GetVertexIndex(currF,currV);
+        std::vector<ParamPointCC> samples;
         for(int s1=0; s1<=NUM_SAMPLES; s1++){
             assert(!currF->GetVertex((idx+1)%3)->GetData().sourceLoc.IsNull() && !currF->GetVertex((idx+2)%3)->GetData().sourceLoc.IsNull());
             ParamPointCC onEdgeParam = ParamPointCC::Interpolate(currF->GetVertex((idx+1)%3)->GetData().sourceLoc,
@@ -2107,8 +2691,11 @@ int WiggleFaceVerticesInParamSpace(MeshFace* currF, MeshVertex* currV, const vec
 #if LINK_FREESTYLE
                 char str[200];
                 sprintf(str, "CAN'T INTERPOLATE");
+#pragma omp critical(rifDebugPoint)
+                {
                 addRIFDebugPoint(-1, double(currF->GetVertex((idx+1)%3)->GetData().pos[0]), double(currF->GetVertex((idx+1)%3)->GetData().pos[1]), double(currF->GetVertex((idx+1)%3)->GetData().pos[2]), str, 0);
                 addRIFDebugPoint(-1, double(currF->GetVertex((idx+2)%3)->GetData().pos[0]), double(currF->GetVertex((idx+2)%3)->GetData().pos[1]), double(currF->GetVertex((idx+2)%3)->GetData().pos[2]), str, 0);
+                }
 #endif
                 continue;
             }
@@ -2120,31 +2707,39 @@ int WiggleFaceVerticesInParamSpace(MeshFace* currF, MeshVertex* currV, const vec
 #if LINK_FREESTYLE
                     char str[200];
                     sprintf(str, "CAN'T INTERPOLATE");
+#pragma omp critical(rifDebugPoint)
                     addRIFDebugPoint(-1, double(currV->GetData().pos[0]), double(currV->GetData().pos[1]), double(currV->GetData().pos[2]), str, 0);
 #endif
                     continue;
                 }
+                samples.push_back(newPosParam);
+            }
+        }
 
-                vec3 newPos, newNormal;
-                newPosParam.Evaluate(newPos, newNormal);
+        std::vector<vec3> newPositions(samples.size()), newNormals(samples.size());
+        if(!samples.empty())
+            ParamPointCC::Evaluate(samples.size(), &samples[0], &newPositions[0], &newNormals[0]);
 
-                if(!ValidMove(currV,newPos,oneRing))
-                    continue;
+        for(size_t s=0; s<samples.size(); s++){
+            const vec3 & newPos = newPositions[s];
+            const vec3 & newNormal = newNormals[s];
 
-                currV->GetData().pos = newPos;
+            if(!ValidMove(currV,newPos,oneRing))
+                continue;
 
-                real minQuality = FLT_MAX;
-                int numInconsistent = NumInconsistent(oneRing,minQuality,cameraCenter);
+            currV->GetData().pos = newPos;
 
-                if ((numInconsistent < bestNumInconsistent && minQuality > 0.25*bestMinQuality) ||
-                        (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
-                    bestNumInconsistent = numInconsistent;
-                    bestMinQuality = minQuality;
-                    bestPos = newPos;
-                    bestNormal = newNormal;
-                }
-                currV->GetData().pos = oldPos;
+            real minQuality = FLT_MAX;
+            int numInconsistent = NumInconsistent(oneRing,minQuality,cameraCenter);
+
+            if ((numInconsistent < bestNumInconsistent && minQuality > 0.25*bestMinQuality) ||
+                    (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
+                bestNumInconsistent = numInconsistent;
+                bestMinQuality = minQuality;
+                bestPos = newPos;
+                bestNormal = newNormal;
             }
+            currV->GetData().pos = oldPos;
         }
     }
 
@@ -2185,7 +2780,7 @@ int WiggleFaceVerticesInABSpace(MeshFace* face, const vec3 & cameraCenter)
     for(int i=0; i<3; i++)
         pts.push_back(currentFace->GetVertex(i)->GetData().sourceLoc);
     std::vector<vec2> abs;
-    ChartCC* chart = ParamPointCC::FindChart(pts,abs);
+    const ChartCC* chart = ParamPointCC::FindChart(pts,abs);
 
     if(!chart){
         for(int i=0; i<3; i++){
@@ -2215,13 +2810,14 @@ int WiggleFaceVerticesInABSpace(MeshFace* face, const vec3 & cameraCenter)
             currV->GetData().pos = oldPos;
         }
     }else{
-        // Regular sampling
+        // Regular sampling, the samples being evaluated in one batch
         const int NUM_SAMPLES = 11;
+        std::vector<ParamPointCC> samples;
         for(int s1=1; s1<NUM_SAMPLES; s1++){
             real r1 = real(s1)/real(NUM_SAMPLES);
             for(int s2=1; s2<NUM_SAMPLES; s2++){
                 real r2 = real(s2)/real(NUM_SAMPLES);
-                real sr2 = sqrtl(1.0-r2);
+                real sr2 = sqrt(1.0-r2);
                 real beta = r1 * sr2;
                 real gamma = 1.0 - sr2;
                 vec2 newAB = (1.0-beta-gamma) * abs[0] + beta * abs[1] + gamma * abs[2];
@@ -2231,43 +2827,51 @@ int WiggleFaceVerticesInABSpace(MeshFace* face, const vec3 & cameraCenter)
                 if(newPosParam.IsNull())// || !newPosParam.IsEvaluable())
                     continue;
 
-                vec3 newPos, newNormal;
-                newPosParam.Evaluate(newPos, newNormal);
+                samples.push_back(newPosParam);
+            }
+        }
 
-                // Try moving one of the 3 vertices at a time and keep the best displacement
-                for(int i=0; i<3; i++){
-                    MeshVertex* currV = currentFace->GetVertex(i);
-                    if(skip[i])
-                        continue;
+        std::vector<vec3> newPositions(samples.size()), newNormals(samples.size());
+        if(!samples.empty())
+            ParamPointCC::Evaluate(samples.size(), &samples[0], &newPositions[0], &newNormals[0]);
 
-                    vec3 oldPos = currV->GetData().pos;
-
-                    if(currV->GetData().facing == CONTOUR){
-                        newPos = oldPos;
-                        WiggleFaceVerticesInParamSpace(currentFace,currV,cameraCenter,newPos,newNormal);
-                        if(oldPos == newPos)
-                            continue;
-                    }else{
-                        //check if moving currV would produce fold
-                        if(!ValidMove(currV,newPos,adjacentFaces))
-                            continue;
-                    }
+        for(size_t s=0; s<samples.size(); s++){
+            vec3 newPos = newPositions[s];
+            vec3 newNormal = newNormals[s];
+
+            // Try moving one of the 3 vertices at a time and keep the best displacement
+            for(int i=0; i<3; i++){
+                MeshVertex* currV = currentFace->GetVertex(i);
+                if(skip[i])
+                    continue;
+
+                vec3 oldPos = currV->GetData().pos;
+
+                if(currV->GetData().facing == CONTOUR){
+                    newPos = oldPos;
+                    WiggleFaceVerticesInParamSpace(currentFace,currV,cameraCenter,newPos,newNormal);
+                    if(oldPos == newPos)
+                        continue;
+                }else{
+                    //check if moving currV would produce fold
+                    if(!ValidMove(currV,newPos,adjacentFaces))
+                        continue;
+                }
 
-                    currV->GetData().pos = newPos;
+                currV->GetData().pos = newPos;
 
-                    real minQuality = FLT_MAX;
-                    int numInconsistent = NumInconsistent(adjacentFaces,minQuality,cameraCenter);
+                real minQuality = FLT_MAX;
+                int numInconsistent = NumInconsistent(adjacentFaces,minQuality,cameraCenter);
 
-                    if ((numInconsistent < bestNumInconsistent && minQuality > 0.25*bestMinQuality) ||
-                            (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
-                        bestNumInconsistent = numInconsistent;
-                        bestMinQuality = minQuality;
-                        bestIndex = GetVertexIndex(face,currV);
-                        bestPos = newPos;
-                        bestNormal = newNormal;
-                    }
-                    currV->GetData().pos = oldPos;
+                if ((numInconsistent < bestNumInconsistent && minQuality > 0.25*bestMinQuality) ||
+                        (numInconsistent == bestNumInconsistent && minQuality > bestMinQuality)){
+                    bestNumInconsistent = numInconsistent;
+                    bestMinQuality = minQuality;
+                    bestIndex = GetVertexIndex(face,currV);
+                    bestPos = newPos;
+                    bestNormal = newNormal;
                 }
+                currV->GetData().pos = oldPos;
             }
         }
     }
@@ -2438,8 +3042,8 @@ int FlipEdge(MeshFace * face, int oppVertex, Mesh * mesh, const vec3 & cameraCen
         splitQueue->Remove(face);
         splitQueue->Remove(oppFace);
 
-        mesh->DeleteFace(face);
-        mesh->DeleteFace(oppFace);
+        DeleteFace(mesh, face);
+        DeleteFace(mesh, oppFace);
 
         MeshFace * f1 = NewFaceDebug(mesh, v0, v1, v3);
         MeshFace * f2 = NewFaceDebug(mesh, v0, v3, v2);
@@ -2572,7 +3176,7 @@ void SplitZeroCrossingEdge(MeshFace * face, int oppVertex, Mesh * mesh,
 
     // ----------- create the new vertex --------------------
 
-    MeshVertex * newVertex = mesh->NewVertex();
+    MeshVertex * newVertex = NewVertex(mesh);
 
     // set up data for the new vertex
 
@@ -2596,7 +3200,7 @@ void SplitZeroCrossingEdge(MeshFace * face, int oppVertex, Mesh * mesh,
                     (oppFace != NULL && (GetArea<VertexDataCatmark>(newVertex, v1, v3) < MIN_TRIANGLE_AREA &&
                                          GetArea<VertexDataCatmark>(v2, newVertex, v3) < MIN_TRIANGLE_AREA))))
     {
-        mesh->DeleteVertex(newVertex);
+        DeleteVertex(mesh, newVertex);
         badEdge = std::pair<MeshVertex*,MeshVertex*>(vA,vB);
         return;
     }
@@ -2634,51 +3238,241 @@ bool SplitZeroCrossingFace(MeshFace * face, Mesh * mesh,const vec3 & cameraCente
 }
 
 
-void RefineContour(Mesh * mesh, const vec3 & cameraCenter, const RefinementType refinement, const bool allowShifts,
-                   const int maxInconsistentSplits)
+// How far (in vertex rings around a face) the work on that face can reach: a split or a flip changes the face and
+// its neighbor; a shift moves a vertex of either one and may split the edges around it.
+const int PATCH_REACH = 3;
+// how far each patch extends beyond its inconsistent faces
+const int PATCH_GUARD = PATCH_REACH + 1;
+// Contours are long connected curves, so the guard rings of their inconsistent faces merge into a few large groups.
+// Groups are cut into patches of at most this many faces, so that there are enough patches to keep the threads busy.
+const int PATCH_MAX_FACES = 2048;
+
+// The vertex and face tables of the mesh must not be reallocated while patches are refined, since the other threads
+// read them (an HbrHalfedge finds its vertex by ID). One iteration of the main loop has been seen to create at most
+// one vertex and five faces on the bench scenes; a patch stops, leaving its faces to the serial pass, once the room
+// left in the tables is below this margin for each thread.
+const int PATCH_TABLE_MARGIN = 64;
+
+// the queue sizes are printed once every this many iterations; printing them every time costs more than some iterations
+const int PROGRESS_INTERVAL = 1000;
+
+// vertices or faces handed to a thread at a time by the per-vertex and per-face passes over a refined mesh
+const int PARALLEL_CHUNK_SIZE = 64;
+
+// Can the patch with this label refine the face on its own, i.e. do all faces within PATCH_REACH vertex rings
+// of it belong to the patch?  Faces created during refinement have IDs past the labels. They always belong to the
+// patch that created them, since the work on a patch never goes past its guard ring.
+bool PatchOwnsNeighborhood(MeshFace * face, const std::vector<int> & faceLabels, int label)
 {
-    PriorityQueueCatmark wiggleQueue;  // faces to be tested for shifting, wiggling, flipping improvements
-    PriorityQueueCatmark splitQueue;   // faces to be split
+    std::set<MeshFace*> visited;
+    std::set<MeshVertex*> seen;
+    std::vector<MeshVertex*> ring, next;
 
-    assert(refinement != RF_NONE);
+    for(int i=0;i<3;i++)
+    {
+        ring.push_back(face->GetVertex(i));
+        seen.insert(face->GetVertex(i));
+    }
 
-    bool localAllowShifts = allowShifts; // && (refinement == RF_CONTOUR_INCONSISTENT || refinement == RF_FULL);
+    for(int r=0;r<PATCH_REACH;r++)
+    {
+        next.clear();
+        for(std::vector<MeshVertex*>::iterator vit = ring.begin(); vit != ring.end(); ++vit)
+        {
+            std::set<MeshFace*> oneRing;
+            GetOneRing<VertexDataCatmark>(*vit, oneRing);
+
+            for(std::set<MeshFace*>::iterator fit = oneRing.begin(); fit != oneRing.end(); ++fit)
+            {
+                if (!visited.insert(*fit).second)
+                    continue;
+
+                int id = (*fit)->GetID();
+                if (id < (int)faceLabels.size() && faceLabels[id] != label)
+                    return false;
+
+                for(int i=0;i<3;i++)
+                    if (seen.insert((*fit)->GetVertex(i)).second)
+                        next.push_back((*fit)->GetVertex(i));
+            }
+        }
+        ring.swap(next);
+    }
+
+    return true;
+}
+
+// Group the inconsistent faces into patches that can be refined independently: each face within PATCH_GUARD
+// vertex rings of an inconsistent face is labeled, and the labeled faces connected through shared vertices form a patch,
+// or several patches of at most PATCH_MAX_FACES faces. The faces around the vertices shared by two patches belong to
+// neither, so that no vertex belongs to two patches.
+// faceLabels maps face IDs to patch indices (-1 outside every patch). Returns the number of patches.
+int LabelPatches(Mesh * mesh, const std::vector<MeshFace*> & inconsistent, std::vector<int> & faceLabels)
+{
+    const int UNASSIGNED = -2;
 
-    // find all inconsistent faces and put them in the queue
     std::list<MeshFace*> faces;
+    std::list<MeshVertex*> verts;
     mesh->GetFaces(std::back_inserter(faces));
+    mesh->GetVertices(std::back_inserter(verts));
 
+    int maxFaceID = 0, maxVertexID = 0;
     for(std::list<MeshFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
-        if (!IsConsistent<VertexDataCatmark>(*it,cameraCenter))
-            wiggleQueue.Insert(*it);
+        maxFaceID = std::max(maxFaceID, (*it)->GetID());
+    for(std::list<MeshVertex*>::iterator it = verts.begin(); it != verts.end(); ++it)
+        maxVertexID = std::max(maxVertexID, (*it)->GetID());
 
-    printf("Num faces: %d\n", mesh->GetNumFaces());
-    printf("Initial queue: %d\n", (int)wiggleQueue.Size());
+    faceLabels.assign(maxFaceID+1, -1);
+    std::vector<char> seen(maxVertexID+1, 0);
 
-    std::set<std::pair<MeshVertex*,MeshVertex*> > badEdges;
+    // grow the guard rings around the inconsistent faces
+    std::vector<MeshVertex*> ring, next;
+    for(std::vector<MeshFace*>::const_iterator it = inconsistent.begin(); it != inconsistent.end(); ++it)
+    {
+        faceLabels[(*it)->GetID()] = UNASSIGNED;
+        for(int i=0;i<3;i++)
+            if (!seen[(*it)->GetVertex(i)->GetID()])
+            {
+                seen[(*it)->GetVertex(i)->GetID()] = 1;
+                ring.push_back((*it)->GetVertex(i));
+            }
+    }
 
-    int numZCs = 0;
-    int numFlips = 0;
-    int numSplits = 0;
-    int numWiggles = 0;
-    int minInc = mesh->GetNumFaces()*256;
+    for(int r=0;r<PATCH_GUARD;r++)
+    {
+        next.clear();
+        for(std::vector<MeshVertex*>::iterator vit = ring.begin(); vit != ring.end(); ++vit)
+        {
+            std::set<MeshFace*> oneRing;
+            GetOneRing<VertexDataCatmark>(*vit, oneRing);
 
-    //---------------- MAIN LOOP: iterate over the faces until everything is consistent --------
+            for(std::set<MeshFace*>::iterator fit = oneRing.begin(); fit != oneRing.end(); ++fit)
+            {
+                if (faceLabels[(*fit)->GetID()] != -1)
+                    continue;
+                faceLabels[(*fit)->GetID()] = UNASSIGNED;
 
-    printf("Refining contour\n");
+                for(int i=0;i<3;i++)
+                    if (!seen[(*fit)->GetVertex(i)->GetID()])
+                    {
+                        seen[(*fit)->GetVertex(i)->GetID()] = 1;
+                        next.push_back((*fit)->GetVertex(i));
+                    }
+            }
+        }
+        ring.swap(next);
+    }
 
-    assert(splitQueue.Size() == 0);
-    std::set<std::pair<MeshVertex*,MeshVertex*> > cuspEdges;
+    // flood-fill the connected groups of labeled faces, breadth-first so that the patches cut from a group are compact
+    int numPatches = 0;
+    std::vector<MeshFace*> front;
+
+    for(std::list<MeshFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
+    {
+        if (faceLabels[(*it)->GetID()] != UNASSIGNED)
+            continue;
+
+        faceLabels[(*it)->GetID()] = numPatches;
+        front.clear();
+        front.push_back(*it);
+
+        for(size_t head = 0; head < front.size(); head++)
+        {
+            MeshFace * face = front[head];
+
+            for(int i=0;i<3;i++)
+            {
+                std::set<MeshFace*> oneRing;
+                GetOneRing<VertexDataCatmark>(face->GetVertex(i), oneRing);
+
+                for(std::set<MeshFace*>::iterator fit = oneRing.begin(); fit != oneRing.end(); ++fit)
+                    if (faceLabels[(*fit)->GetID()] == UNASSIGNED && front.size() < PATCH_MAX_FACES)
+                    {
+                        faceLabels[(*fit)->GetID()] = numPatches;
+                        front.push_back(*fit);
+                    }
+            }
+        }
+
+        numPatches++;
+    }
+
+    // the patches cut from the same group touch: take the faces around the vertices they share out of both
+    std::vector<MeshVertex*> shared;
+    for(std::list<MeshVertex*>::iterator it = verts.begin(); it != verts.end(); ++it)
+    {
+        std::set<MeshFace*> oneRing;
+        GetOneRing<VertexDataCatmark>(*it, oneRing);
+
+        int label = -1;
+        for(std::set<MeshFace*>::iterator fit = oneRing.begin(); fit != oneRing.end(); ++fit)
+        {
+            int faceLabel = faceLabels[(*fit)->GetID()];
+            if (faceLabel < 0)
+                continue;
+            if (label >= 0 && faceLabel != label)
+            {
+                shared.push_back(*it);
+                break;
+            }
+            label = faceLabel;
+        }
+    }
+
+    for(std::vector<MeshVertex*>::iterator it = shared.begin(); it != shared.end(); ++it)
+    {
+        std::set<MeshFace*> oneRing;
+        GetOneRing<VertexDataCatmark>(*it, oneRing);
+
+        for(std::set<MeshFace*>::iterator fit = oneRing.begin(); fit != oneRing.end(); ++fit)
+            faceLabels[(*fit)->GetID()] = -1;
+    }
+
+    return numPatches;
+}
+
+// MAIN LOOP: iterate over the queued faces until everything is consistent.
+// When faceLabels is given, the loop refines one patch of the mesh, concurrently with the other patches:
+// faces whose neighborhood leaves the patch are not touched but listed in deferredFaces (by ID, since they
+// may be deleted in the meantime), and there is no progress output. All the faces left are deferred once the mesh
+// tables, reserved by RefineContour, could have to grow.
+void RefineQueuedFaces(Mesh * mesh, const vec3 & cameraCenter, const RefinementType refinement, const bool localAllowShifts,
+                       const int maxInconsistentSplits, PriorityQueueCatmark & wiggleQueue, PriorityQueueCatmark & splitQueue,
+                       std::set<std::pair<MeshVertex*,MeshVertex*> > & badEdges, std::set<std::pair<MeshVertex*,MeshVertex*> > & cuspEdges,
+                       RefineCounters & counters, int & minInc,
+                       const std::vector<int> * faceLabels = NULL, int label = -1, std::vector<int> * deferredFaces = NULL)
+{
+    int & numZCs = counters.numZCs;
+    int & numFlips = counters.numFlips;
+    int & numSplits = counters.numSplits;
+    int & numWiggles = counters.numWiggles;
+
+    int tableMargin = PATCH_TABLE_MARGIN;
+#ifdef _OPENMP
+    tableMargin *= omp_get_num_threads();
+#endif
 
-    while (wiggleQueue.Size() != 0 || splitQueue.Size() != 0)
+    for(int iteration = 0; wiggleQueue.Size() != 0 || splitQueue.Size() != 0; iteration++)
     {
         if (wiggleQueue.Size() + splitQueue.Size() < minInc && (numSplits < maxInconsistentSplits || maxInconsistentSplits < 0))
             minInc = wiggleQueue.Size()+splitQueue.Size();
 
-        fflush(stdout);
+        if (faceLabels == NULL && iteration % PROGRESS_INTERVAL == 0)
+        {
+            printf("queue size: %d+%d / %d. ZC: %d. flips: %d. splits: %d. wiggles: %d   \r",
+                   wiggleQueue.Size(), splitQueue.Size(), mesh->GetNumFaces(),numZCs, numFlips, numSplits, numWiggles);
+
+            fflush(stdout);
+        }
 
-        printf("queue size: %d+%d / %d. ZC: %d. flips: %d. splits: %d. wiggles: %d   \r",
-               wiggleQueue.Size(), splitQueue.Size(), mesh->GetNumFaces(),numZCs, numFlips, numSplits, numWiggles);
+        if (faceLabels != NULL && !HasTableRoom(mesh, tableMargin, tableMargin))
+        {
+            while (wiggleQueue.Size() != 0)
+                deferredFaces->push_back(wiggleQueue.PopFront()->GetID());
+            while (splitQueue.Size() != 0)
+                deferredFaces->push_back(splitQueue.PopFront()->GetID());
+            break;
+        }
 
         if (wiggleQueue.Size() != 0)
         {
@@ -2687,6 +3481,12 @@ void RefineContour(Mesh * mesh, const vec3 & cameraCenter, const RefinementType
             if (IsConsistent<VertexDataCatmark>(face,cameraCenter))
                 continue;
 
+            if (faceLabels != NULL && !PatchOwnsNeighborhood(face, *faceLabels, label))
+            {
+                deferredFaces->push_back(face->GetID());
+                continue;
+            }
+
 #ifdef VERBOSE
             printf("\n-------------------------------------------------\n");
 
@@ -2745,6 +3545,12 @@ void RefineContour(Mesh * mesh, const vec3 & cameraCenter, const RefinementType
         if (IsConsistent<VertexDataCatmark>(face,cameraCenter))  // might have changed since it was added to the queue
             continue;
 
+        if (faceLabels != NULL && !PatchOwnsNeighborhood(face, *faceLabels, label))
+        {
+            deferredFaces->push_back(face->GetID());
+            continue;
+        }
+
         bool didSplit = FindBestSplitPointFace(face, localAllowShifts, cameraCenter, mesh, badEdges, wiggleQueue, splitQueue);
 
         //bool didSplit = FindRadialSplitPointFace(face, cameraCenter, mesh, badEdges, wiggleQueue, splitQueue);
@@ -2752,16 +3558,269 @@ void RefineContour(Mesh * mesh, const vec3 & cameraCenter, const RefinementType
         if (didSplit)
             numSplits++;
     }
+}
+
+// a group of inconsistent faces, with its guard ring, that one thread refines on its own
+struct RefinePatch
+{
+    std::vector<MeshFace*> seeds;      // its initially inconsistent faces
+    std::vector<int> deferredFaces;    // IDs of the faces left for the serial pass
+    std::set<std::pair<MeshVertex*,MeshVertex*> > badEdges;
+    std::set<std::pair<MeshVertex*,MeshVertex*> > cuspEdges;
+    RefineCounters counters;
+};
+
+void RefineContour(Mesh * mesh, const vec3 & cameraCenter, const RefinementType refinement, const bool allowShifts,
+                   const int maxInconsistentSplits, const bool concurrentPatches, RefineCounters * countersOut)
+{
+    PriorityQueueCatmark wiggleQueue;  // faces to be tested for shifting, wiggling, flipping improvements
+    PriorityQueueCatmark splitQueue;   // faces to be split
+
+    assert(refinement != RF_NONE);
+
+    bool localAllowShifts = allowShifts; // && (refinement == RF_CONTOUR_INCONSISTENT || refinement == RF_FULL);
+
+    // find all inconsistent faces and put them in the queue
+    std::list<MeshFace*> faces;
+    mesh->GetFaces(std::back_inserter(faces));
+
+    std::vector<MeshFace*> inconsistent;
+    for(std::list<MeshFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
+        if (!IsConsistent<VertexDataCatmark>(*it,cameraCenter))
+            inconsistent.push_back(*it);
+
+    printf("Num faces: %d\n", mesh->GetNumFaces());
+    printf("Initial queue: %d\n", (int)inconsistent.size());
+
+    std::set<std::pair<MeshVertex*,MeshVertex*> > badEdges;
+    std::set<std::pair<MeshVertex*,MeshVertex*> > cuspEdges;
+
+    RefineCounters counters;
+    int minInc = mesh->GetNumFaces()*256;
+
+    // Patches only pay off when they can run concurrently: not on a single thread, nor inside the parallel loop
+    // over the surfaces, where a nested parallel region gets a single thread.
+    bool concurrent = false;
+    int numThreads = 1;
+#ifdef _OPENMP
+    numThreads = omp_get_max_threads();
+    concurrent = concurrentPatches && numThreads > 1 && !omp_in_parallel();
+#endif
+
+    std::vector<int> faceLabels;
+    int numPatches = 0;
+
+    // A cap on the number of splits depends on the order in which the faces are processed, so it is
+    // only honored by the serial loop.
+    if (concurrent && maxInconsistentSplits < 0 && !inconsistent.empty())
+        numPatches = LabelPatches(mesh, inconsistent, faceLabels);
+
+    if (numPatches > 1)
+    {
+        std::vector<RefinePatch> patches(numPatches);
+        for(std::vector<MeshFace*>::iterator it = inconsistent.begin(); it != inconsistent.end(); ++it)
+            if (faceLabels[(*it)->GetID()] >= 0)
+                patches[faceLabels[(*it)->GetID()]].seeds.push_back(*it);
+            else
+                wiggleQueue.Insert(*it);  // between two patches, left for the serial pass
+
+        // reserve the tables, which then can't be reallocated while the patches are refined (see PATCH_TABLE_MARGIN)
+        mesh->ReserveTables(std::max(mesh->GetNumVertices(), PATCH_TABLE_MARGIN*numThreads),
+                            std::max(mesh->GetNumFaces(), PATCH_TABLE_MARGIN*numThreads));
+
+        printf("Refining %d patches concurrently\n", numPatches);
+
+        StageTimer patchTimer("RefineContour.patches");
+        StageCount("RefineContour.patches", "patches", numPatches);
+
+#pragma omp parallel
+        {
+            // queues are reused from one patch to the next; they are empty when a patch is done
+            PriorityQueueCatmark patchWiggleQueue, patchSplitQueue;
+
+#pragma omp for schedule(dynamic,1)
+            for(int p=0;p<numPatches;p++)
+            {
+                RefinePatch & patch = patches[p];
+                int patchMinInc = 0;
+
+                for(std::vector<MeshFace*>::iterator it = patch.seeds.begin(); it != patch.seeds.end(); ++it)
+                    patchWiggleQueue.Insert(*it);
+
+                RefineQueuedFaces(mesh, cameraCenter, refinement, localAllowShifts, maxInconsistentSplits,
+                                  patchWiggleQueue, patchSplitQueue, patch.badEdges, patch.cuspEdges, patch.counters, patchMinInc,
+                                  &faceLabels, p, &patch.deferredFaces);
+            }
+        }
+
+        // the serial pass picks up the faces next to the patch borders
+        int numDeferred = 0;
+        for(std::vector<RefinePatch>::iterator it = patches.begin(); it != patches.end(); ++it)
+        {
+            counters.Add(it->counters);
+            badEdges.insert(it->badEdges.begin(), it->badEdges.end());
+            cuspEdges.insert(it->cuspEdges.begin(), it->cuspEdges.end());
+
+            for(std::vector<int>::iterator fit = it->deferredFaces.begin(); fit != it->deferredFaces.end(); ++fit)
+            {
+                MeshFace * face = mesh->GetFace(*fit);
+                if (face != NULL)
+                {
+                    wiggleQueue.Insert(face);
+                    numDeferred++;
+                }
+            }
+        }
+
+        printf("Patches done. ZC: %d. flips: %d. splits: %d. wiggles: %d. Border faces: %d\n",
+               counters.numZCs, counters.numFlips, counters.numSplits, counters.numWiggles, numDeferred);
+
+        StageCount("RefineContour.patches", "borderFaces", numDeferred);
+    }
+    else
+        for(std::vector<MeshFace*>::iterator it = inconsistent.begin(); it != inconsistent.end(); ++it)
+            wiggleQueue.Insert(*it);
+
+    //---------------- MAIN LOOP: iterate over the faces until everything is consistent --------
+
+    printf("Refining contour\n");
+
+    StageTimer serialTimer("RefineContour.serial");
 
-    if (wiggleQueue.Size() + splitQueue.Size() < minInc && (numSplits < maxInconsistentSplits || maxInconsistentSplits < 0))
+    RefineQueuedFaces(mesh, cameraCenter, refinement, localAllowShifts, maxInconsistentSplits,
+                      wiggleQueue, splitQueue, badEdges, cuspEdges, counters, minInc);
+
+    serialTimer.Stop();
+
+    if (wiggleQueue.Size() + splitQueue.Size() < minInc && (counters.numSplits < maxInconsistentSplits || maxInconsistentSplits < 0))
         minInc = wiggleQueue.Size() + splitQueue.Size();
 
-    printf("queue size: %d+%d / %d. ZCsplits = %d. flips = %d. splits = %d. wiggles = %d                    \n", (int)wiggleQueue.Size(),splitQueue.Size(),(int)mesh->GetNumFaces(),numZCs, numFlips, numSplits, numWiggles);
+    printf("queue size: %d+%d / %d. ZCsplits = %d. flips = %d. splits = %d. wiggles = %d                    \n", (int)wiggleQueue.Size(),splitQueue.Size(),(int)mesh->GetNumFaces(),
+           counters.numZCs, counters.numFlips, counters.numSplits, counters.numWiggles);
 
     printf("minInc = %d\n", minInc);
     if (minInc == 0)
         printf("NO INCONSISTENT TRIANGLES!\n");
 
+    StageCount("RefineContour", "initialInconsistent", inconsistent.size());
+    StageCount("RefineContour", "zeroCrossingSplits", counters.numZCs);
+    StageCount("RefineContour", "flips", counters.numFlips);
+    StageCount("RefineContour", "splits", counters.numSplits);
+    StageCount("RefineContour", "wiggles", counters.numWiggles);
+    StageCount("RefineContour", "remaining", wiggleQueue.Size() + splitQueue.Size());
+
+    if (countersOut != NULL)
+        *countersOut = counters;
+}
+
+real OPT_LAMBDA = 1;//1e-16;
+real OPT_EPSILON = 0.000001;//1e-10;
+
+void RefineMesh(Mesh * mesh, const vec3 & cameraCenter, const RefinementType refinement, const bool allowShifts,
+                const int maxInconsistentSplits, const bool concurrentPatches, const RefineRadialStep lastStep,
+                RefineCounters * counters)
+{
+    if (refinement == RF_CONTOUR_ONLY || refinement == RF_FULL || refinement == RF_CONTOUR_INCONSISTENT)
+    {
+        printf("Refining contour\n");
+
+        StageTimer timer("RefineContour");
+        RefineContour(mesh, cameraCenter, refinement, allowShifts, maxInconsistentSplits, concurrentPatches, counters);
+    }
+    else if (refinement == RF_OPTIMIZE)
+    {
+        StageTimer timer("RefineContour");
+        RefineContour(mesh, cameraCenter, RF_CONTOUR_ONLY, allowShifts, maxInconsistentSplits, concurrentPatches, counters);
+        timer.Stop();
+
+        StageTimer optimizeTimer("OptimizeConsistency");
+        OptimizeConsistency<VertexDataCatmark>(mesh, cameraCenter, OPT_LAMBDA, OPT_EPSILON);
+
+        WiggleAllVertices<VertexDataCatmark>(mesh, cameraCenter);
+    }
+    else if (refinement == RF_RADIAL)
+    {
+        StageTimer timer("RefineContourRadial");
+        RefineContourRadial(mesh, cameraCenter, allowShifts, lastStep);
+    }
+}
+
+//////////////////////////////// TEMPORALLY COHERENT SAMPLING ////////////////////////////
+
+// re-evaluate the facing of every vertex for a new camera center. The limit positions and normals don't depend
+// on the camera, so nothing is evaluated on the surface. Returns the number of vertices whose facing changed.
+int UpdateFacing(Mesh * mesh, const vec3 & cameraCenter)
+{
+    std::vector<MeshVertex*> vertices;
+    mesh->GetVertices(std::back_inserter(vertices));
+
+    int numChanged = 0;
+    for(std::vector<MeshVertex*>::iterator it = vertices.begin(); it != vertices.end(); ++it)
+    {
+        VertexDataCatmark & data = (*it)->GetData();
+
+        FacingType ft = Facing(data.pos - cameraCenter, data.normal, CONTOUR_THRESHOLD, &data.ndotv);
+        if (ft != data.facing)
+            numChanged ++;
+
+        data.facing = ft;
+    }
+
+    return numChanged;
+}
+
+void CoherentMesh::Release()
+{
+    if (baseMesh == NULL)
+        return;
+
+    delete baseMesh;
+    baseMesh = NULL;
+}
+
+Mesh * SampleCoherent(CoherentMesh & coherent, CatmarkMesh * surface, int subdivisionLevel, int maxSubdivisionLevel,
+                      const CameraModel & camera, bool & reused)
+{
+    reused = false;
+
+    std::vector<int> levels;
+
+    if (coherent.baseMesh != NULL)
+    {
+        SampleLevels(coherent.sampledFaces, subdivisionLevel, maxSubdivisionLevel, camera, levels);
+
+        if (levels == coherent.sampleLevels)
+        {
+            std::vector<bool> signature;
+            FrustumSignature(coherent.sampledFaces, levels, subdivisionLevel, camera, signature);
+            reused = (signature == coherent.frustumSignature);
+        }
+    }
+
+    if (!reused)
+    {
+        coherent.Release();
+
+        coherent.baseMesh = SurfaceToMesh(surface, subdivisionLevel, camera, true, maxSubdivisionLevel);
+        if (coherent.baseMesh == NULL)
+            return NULL;
+
+        // after SurfaceToMesh, which subdivides the surface
+        if (coherent.sampledFaces.empty())
+            SampledFaces(surface, subdivisionLevel, coherent.sampledFaces);
+        // not computed above if the previous frame was entirely culled
+        if (levels.size() != coherent.sampledFaces.size())
+            SampleLevels(coherent.sampledFaces, subdivisionLevel, maxSubdivisionLevel, camera, levels);
+        coherent.sampleLevels.swap(levels);
+        FrustumSignature(coherent.sampledFaces, coherent.sampleLevels, subdivisionLevel, camera, coherent.frustumSignature);
+    }
+
+    int numChanged = UpdateFacing(coherent.baseMesh, camera.CameraCenter());
+    if (reused)
+        printf("Reusing the previous sample: %d vertices changed facing\n", numChanged);
+
+    // the vertices and faces of the copy get the same IDs, in the same order
+    return DuplicateMesh(coherent.baseMesh);
 }
 
 
@@ -2771,33 +3830,36 @@ Mesh * DuplicateMesh(Mesh * sourceMesh)
 
     assert(outputMesh != NULL);
 
-    std::map<MeshVertex*, MeshVertex*> vertexMap;
-
-    std::list<MeshVertex*> verts;
-    std::list<MeshFace*> faces;
+    std::vector<MeshVertex*> verts;
+    std::vector<MeshFace*> faces;
 
     sourceMesh->GetVertices(std::back_inserter(verts));
     sourceMesh->GetFaces(std::back_inserter(faces));
 
-    for(std::list<MeshVertex*>::iterator it = verts.begin(); it != verts.end(); ++it)
+    // source vertex ID -> copy
+    std::vector<MeshVertex*> vertexMap(verts.empty() ? 0 : verts.back()->GetID()+1, (MeshVertex*)NULL);
+
+    for(std::vector<MeshVertex*>::iterator it = verts.begin(); it != verts.end(); ++it)
     {
         MeshVertex * vertex = *it;
 
-        if (vertexMap.find(vertex) == vertexMap.end())
+        MeshVertex * newv = outputMesh->NewVertex();
+        newv->GetData() = vertex->GetData();
+        if (vertex->GetData().provenance != NULL)  // give the copy a row of its own
         {
-            MeshVertex * newv = outputMesh->NewVertex();
-            newv->GetData() = vertex->GetData();
-            vertexMap[vertex] = newv;
+            newv->GetData().provenance = NULL;
+            VertexProvenanceTable::Row(outputMesh, newv) = *vertex->GetData().provenance;
         }
+        vertexMap[vertex->GetID()] = newv;
     }
 
-    for(std::list<MeshFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
+    for(std::vector<MeshFace*>::iterator it = faces.begin(); it != faces.end(); ++it)
     {
         MeshFace * face = *it;
 
-        int vtx[3] = { vertexMap[face->GetVertex(0)]->GetID(),
-                       vertexMap[face->GetVertex(1)]->GetID(),
-                       vertexMap[face->GetVertex(2)]->GetID()};
+        int vtx[3] = { vertexMap[face->GetVertex(0)->GetID()]->GetID(),
+                       vertexMap[face->GetVertex(1)->GetID()]->GetID(),
+                       vertexMap[face->GetVertex(2)->GetID()]->GetID()};
 
         outputMesh->NewFace(3,vtx,0);
     }
@@ -2850,7 +3912,7 @@ int VertexDataCatmark::DebugString(char * str) const
             srcStr,
             extraordinary ? "true" : "false",
             extSrc,
-            isShifted ? "true" : "false",
+            IsShifted() ? "true" : "false",
             shiftSplit ? "true" : "false",
             rootFindingFailed ? "true":"false",
             degenerate ? "true":"false",
@@ -2868,63 +3930,84 @@ void ComputeRadialCurvatures(Mesh * mesh, const CameraModel & camera, real isova
 {
     printf("Computing radial curvatures and isophote distance.\n");
 
-    std::list<MeshVertex*> verts;
+    std::vector<MeshVertex*> verts;
+    verts.reserve(mesh->GetNumVertices());
     mesh->GetVertices(std::back_inserter(verts));
 
-    for(std::list<MeshVertex*>::iterator it = verts.begin(); it != verts.end(); ++it)
+    const int numVertices = (int)verts.size();
+    const int numBlocks = (numVertices + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+
+    // each vertex only writes its own data; evaluations only read the surface (charts are cached per thread).
+    // the radial curvatures of a block of vertices are evaluated in one batch
+#pragma omp parallel for schedule(dynamic)
+    for(int b=0;b<numBlocks;b++)
     {
+        int begin = b*PARALLEL_CHUNK_SIZE;
+        int count = std::min(PARALLEL_CHUNK_SIZE, numVertices - begin);
+
+        std::vector<ParamPointCC> locs(count);
+        std::vector<real> k_r(count);
+        for(int i=0;i<count;i++)
+            locs[i] = verts[begin+i]->GetData().sourceLoc;
+
         // radial curvature
+        ParamPointCC::RadialCurvature(count, &locs[0], camera.CameraCenter(), &k_r[0]);
 
-        real k_r;
-        VertexDataCatmark & data = (*it)->GetData();
-        bool result = data.sourceLoc.RadialCurvature(camera.CameraCenter(), k_r);
-        if (!result)
-            k_r = -123456;
-        (*it)->GetData().radialCurvature = k_r;
+        for(int i=0;i<count;i++)
+        {
+            VertexDataCatmark & data = verts[begin+i]->GetData();
+            data.radialCurvature = k_r[i];
 
-        // isophote distance
-        data.isophoteDistance = data.sourceLoc.IsophoteDistance(camera, isovalue, maxIsophoteDistance);
+            // isophote distance
+            data.isophoteDistance = data.sourceLoc.IsophoteDistance(camera, isovalue, maxIsophoteDistance);
+        }
     }
 }
 
 void ComputeConsistencyStats(HbrMesh<VertexDataCatmark> * outputMesh, const vec3 & cameraCenter, int & numInconsistent, int & numStrongInconsistent,
                              int &numNonRadial, int &numInconsistentContour, int &numInconsistentRadial)
 {
+    StageTimer timer("ComputeConsistencyStats");
 
     printf("Checking consistency\n");
 
-    std::list<HbrFace<VertexDataCatmark>*> faces;
+    std::vector<HbrFace<VertexDataCatmark>*> faces;
+    faces.reserve(outputMesh->GetNumFaces());
     outputMesh->GetFaces(std::back_inserter(faces));
+    const int numFaces = (int)faces.size();
 
-    int i = 0;
+    // the counts of this mesh, added to the running totals at the end. Integer sums don't depend on
+    // how the faces are split among threads.
+    int inconsistent = 0, strongInconsistent = 0, nonRadial = 0, inconsistentContour = 0, inconsistentRadial = 0;
 
-    for(std::list<HbrFace<VertexDataCatmark>*>::iterator it = faces.begin(); it != faces.end(); ++it)
+#pragma omp parallel for schedule(dynamic,PARALLEL_CHUNK_SIZE) \
+    reduction(+:inconsistent,strongInconsistent,nonRadial,inconsistentContour,inconsistentRadial)
+    for(int i=0;i<numFaces;i++)
     {
-        if(i%40==0)
-            printf("Face: %d / %ld.   Count: %d, %d      \r", i, faces.size(), numInconsistent, numStrongInconsistent);
-        i++;
-
-        HbrFace<VertexDataCatmark> * face = *it;
+        HbrFace<VertexDataCatmark> * face = faces[i];
 
         if(!IsStandardRadialFace(face))
         {
-            numNonRadial++;
+            nonRadial++;
         }
 
         if (!IsConsistent(face, cameraCenter))
         {
-            numInconsistent ++;
+            inconsistent ++;
             for(int e=0;e<3;e++) {
                 if(face->GetVertex(e)->GetData().facing == CONTOUR){
-                    numInconsistentContour++;
+                    inconsistentContour++;
                     if(IsStandardRadialFace(face)){
-                        numInconsistentRadial++;
+                        inconsistentRadial++;
 #if LINK_FREESTYLE
+#pragma omp critical(rifDebugPoint)
+                        {
                         char str[200];
                         sprintf(str, "INCONSISTENT RADIAL");
                         addRIFDebugPoint(-1,double(face->GetVertex(0)->GetData().pos[0]),double(face->GetVertex(0)->GetData().pos[1]),double(face->GetVertex(0)->GetData().pos[2]),str,0);
                         addRIFDebugPoint(-1,double(face->GetVertex(1)->GetData().pos[0]),double(face->GetVertex(1)->GetData().pos[1]),double(face->GetVertex(1)->GetData().pos[2]),str,0);
                         addRIFDebugPoint(-1,double(face->GetVertex(2)->GetData().pos[0]),double(face->GetVertex(2)->GetData().pos[1]),double(face->GetVertex(2)->GetData().pos[2]),str,0);
+                        }
 #endif
                     }
                     break;
@@ -2935,7 +4018,7 @@ void ComputeConsistencyStats(HbrMesh<VertexDataCatmark> * outputMesh, const vec3
         if (true ||NUM_INCONSISTENT_SAMPLES == 0)
             continue;
 
-        bool strongInconsistent = false;
+        bool strong = false;
 
         for(int e=0;e<3;e++)
         {
@@ -2970,7 +4053,7 @@ void ComputeConsistencyStats(HbrMesh<VertexDataCatmark> * outputMesh, const vec3
 
             if (t != -1)
             {
-                strongInconsistent = true;
+                strong = true;
 
 #ifdef LINK_FREESTYLE
                 ParamPointCC zeroCrossingPoint = ParamPointCC::Interpolate(p0, p1, t);
@@ -2990,14 +4073,23 @@ void ComputeConsistencyStats(HbrMesh<VertexDataCatmark> * outputMesh, const vec3
                 sprintf(str2, "STRONG INCONSISTENCY.\nft0 = %s, ft1 = %s, myFacing = %s, ndotv = %f, t= %f, %s",
                         FacingToString(ft0), FacingToString(ft1), FacingToString(myFacing), double(ndotv), double(t), str);
 
+#pragma omp critical(rifDebugPoint)
                 addRIFDebugPoint(-1, pos[0], pos[1], pos[2], str2, 0);
 #endif
             }
         }
 
-        if (strongInconsistent)
-            numStrongInconsistent ++;
+        if (strong)
+            strongInconsistent ++;
     }
+
+    printf("Faces: %d.   Count: %d, %d\n", numFaces, inconsistent, strongInconsistent);
+
+    numInconsistent += inconsistent;
+    numStrongInconsistent += strongInconsistent;
+    numNonRadial += nonRadial;
+    numInconsistentContour += inconsistentContour;
+    numInconsistentRadial += inconsistentRadial;
 }
 
 bool IsSplittable(MeshVertex * v0, MeshVertex * v1)
@@ -76,44 +76,107 @@ typedef ParamPoint<Vertex> ParamPointCC;  // sourceLoc for a Catmull-Clark surfa
 typedef ParamRay<Vertex> ParamRayCC;
 typedef Chart<Vertex> ChartCC;
 
+struct VertexDataCatmark;
+
+// how a refined vertex came to be where it is. The refinement loops never look at this, so it is kept
+// out of VertexDataCatmark, in a table owned by the mesh (see VertexProvenanceTable); only the few vertices
+// that were shifted or inserted radially get a row.
+struct VertexProvenance
+{
+  ParamPointCC origLoc;   // if this vertex got "shifted," where did it begin?
+  HbrVertex<VertexDataCatmark> * radialOrg[2];
+
+  VertexProvenance() { radialOrg[0] = radialOrg[1] = NULL; }
+};
+
+// per-vertex data of the refined mesh. The fields read by the consistency and quality tests come first,
+// so that they share cache lines; every real is a long double, so the record is kept as small as it can be.
 struct VertexDataCatmark
 {
   vec3 pos;                // limit position
   vec3 normal;             // limit normal
+  real ndotv;
   FacingType facing;       // facing direction, as a function of limit normal
+  int id;
+  int age;
+  bool extraordinary;     // source point is an extraordinary point
+  bool cusp; //smooth cusp
+  bool shiftSplit;        // created during shifting to make sure parameterizations exist.
+  bool rootFindingFailed;
+  bool degenerate;
+
   ParamPointCC sourceLoc;  // parametric location on the source mesh
-  real ndotv;
 
   // information on how this vertex was created
-  bool extraordinary;     // source point is an extraordinary point
   HbrVertex<VertexDataCatmark> * extSrc; // if this is an extraordinary region endpoint, the source extr. point
-  bool isShifted;         // variable is redundant, could just check if origLoc is null...
-  ParamPointCC origLoc;   // if this vertex got "shifted," where did it begin?
-  bool shiftSplit;        // created during shifting to make sure parameterizations exist.
+  VertexProvenance * provenance;         // NULL until the vertex gets shifted or a radial origin (see VertexProvenanceTable::Row)
 
   real radialCurvature;   // only computed at the end
   real isophoteDistance;
   real k1;
   real k2;
 
-  bool cusp; //smooth cusp
-  HbrVertex<VertexDataCatmark> * radialOrg[2];
-
-  bool rootFindingFailed;
-  bool degenerate;
-  int id;
-  int age;
   VertexDataCatmark() { Clear(); }
   VertexDataCatmark(int i) { Clear(); id = i; }
-  void Clear() { id = -1; age = -1; rootFindingFailed = degenerate = extraordinary = isShifted = cusp = false; extSrc = NULL; shiftSplit = false; isophoteDistance = 6; radialOrg[0] = radialOrg[1] = NULL;}
+  void Clear() { id = -1; age = -1; rootFindingFailed = degenerate = extraordinary = cusp = false; extSrc = NULL; provenance = NULL; shiftSplit = false; isophoteDistance = 6; }
   int DebugString(char *) const;
   vec3 GetPos() { return pos; }
-  bool Radial() const { return radialOrg[0]!=NULL; }
-  void AddRadialOrg(HbrVertex<VertexDataCatmark> *v) { if(Radial()){ assert(!radialOrg[1]); radialOrg[1] = v; }else{ radialOrg[0] = v;  }}
-  bool HasRadialOrg(HbrVertex<VertexDataCatmark> *v) { return radialOrg[0] == v || radialOrg[1] == v; }
-  int NumRadialOrg() const { if (radialOrg[0] == NULL) return 0; else if (radialOrg[1] == NULL) return 1; else return 2; }
+  bool IsShifted() const { return provenance != NULL && !provenance->origLoc.IsNull(); }
+  ParamPointCC OrigLoc() const { return provenance != NULL ? provenance->origLoc : ParamPointCC(); }
+  HbrVertex<VertexDataCatmark> * RadialOrg(int i) const { return provenance != NULL ? provenance->radialOrg[i] : NULL; }
+  bool Radial() const { return RadialOrg(0)!=NULL; }
+  bool HasRadialOrg(HbrVertex<VertexDataCatmark> *v) { return provenance != NULL && (provenance->radialOrg[0] == v || provenance->radialOrg[1] == v); }
+  int NumRadialOrg() const { if (RadialOrg(0) == NULL) return 0; else if (RadialOrg(1) == NULL) return 1; else return 2; }
 };
 
+// provenance rows of the vertices of one refined mesh, attached to the mesh as its client data.
+// Rows are never moved or reused, so a vertex keeps pointing to its row until the table is released.
+class VertexProvenanceTable
+{
+public:
+  // the row of a vertex of mesh, created (together with the table) on first use.
+  // the mesh is passed in since new vertices, and vertices whose faces were just deleted, can't find it on their own
+  static VertexProvenance & Row(HbrMesh<VertexDataCatmark> * mesh, HbrVertex<VertexDataCatmark> * v)
+  {
+    // a vertex that still has faces must belong to the mesh given
+    assert(mesh != NULL && (v->GetIncidentEdge() == NULL || v->GetMesh() == mesh));
+
+    VertexDataCatmark & data = v->GetData();
+    if (data.provenance == NULL)
+    {
+      // patches of the mesh may be refined concurrently (see RefineContour)
+#pragma omp critical(vertexProvenance)
+      {
+        VertexProvenanceTable * table = static_cast<VertexProvenanceTable*>(mesh->GetClientData());
+        if (table == NULL)
+        {
+          table = new VertexProvenanceTable;
+          mesh->SetClientData(table);
+        }
+        table->_rows.push_back(VertexProvenance());
+        data.provenance = &table->_rows.back();
+      }
+    }
+    return *data.provenance;
+  }
+
+  // frees the rows of the mesh; must be called before the mesh is deleted
+  static void Release(HbrMesh<VertexDataCatmark> * mesh)
+  {
+    delete static_cast<VertexProvenanceTable*>(mesh->GetClientData());
+    mesh->SetClientData(NULL);
+  }
+
+private:
+  std::deque<VertexProvenance> _rows;
+};
+
+inline void AddRadialOrg(HbrMesh<VertexDataCatmark> * mesh, HbrVertex<VertexDataCatmark> * v, HbrVertex<VertexDataCatmark> * org)
+{
+  VertexProvenance & prov = VertexProvenanceTable::Row(mesh, v);
+  if (prov.radialOrg[0] != NULL){ assert(!prov.radialOrg[1]); prov.radialOrg[1] = org; }else{ prov.radialOrg[0] = org; }
+}
+
 typedef HbrMesh<VertexDataCatmark> Mesh;
 typedef HbrVertex<VertexDataCatmark> MeshVertex;
 typedef HbrFace<VertexDataCatmark> MeshFace;
@@ -121,24 +184,37 @@ typedef HbrHalfedge<VertexDataCatmark> MeshEdge;
 
 template<class T>
 class FacePriorityQueue
-        // a queue that supports insertion of arbitrary elements and redundant insertions
-        // implementation right now is very quick and dirty
+        // a queue that supports insertion of arbitrary elements and redundant insertions.
+        // it is a binary max-heap; each face's position in the heap is kept in a side array indexed
+        // by face ID, so that faces can really be removed or reprioritized instead of being left behind as stale entries
 {
 private:
-    std::set<HbrFace<T>*> _readySet;  // all of the faces in the queue
-    std::multimap<real,HbrFace<T>*> _queue;  // ordered list of faces
+    struct Entry
+    {
+        real priority;
+        HbrFace<T> * face;
+        int id;  // of the face
+    };
 
+    std::vector<Entry> _heap;  // heap-ordered faces, highest priority first
+    std::vector<int> _slot;    // face ID -> index in _heap, -1 for faces not in the queue
 
     real _Priority(const HbrFace<T>*) const;  // function that determines the priority of a face
 
+    int _Slot(const HbrFace<T>* f) const { int id = f->GetID(); return id < (int)_slot.size() ? _slot[id] : -1; }
+    void _Place(int i, const Entry & e) { _heap[i] = e; _slot[e.id] = i; }
+    void _SiftUp(int i);
+    void _SiftDown(int i);
+    void _Erase(int i);  // remove the entry at heap index i
 
 public:
     HbrFace<T> * PopFront(); // return the highest-priority element
-    void Insert(HbrFace<T>*); // add a face to the queue (even if it's already there)
+    void Insert(HbrFace<T>*); // add a face to the queue (does nothing if it's already there)
     void Remove(HbrFace<T>*); // remove a face from the queue
-    int Size() const { return _readySet.size(); }
-    bool HasFace(HbrFace<T>* f) const { return _readySet.find(f) != _readySet.end(); }
-    void Clear() { _readySet.clear();  _queue.clear(); }
+    void Update(HbrFace<T>*); // recompute the priority of a face already in the queue, e.g. after its vertices moved
+    int Size() const { return _heap.size(); }
+    bool HasFace(HbrFace<T>* f) const { return _Slot(f) != -1; }
+    void Clear() { for(size_t i=0;i<_heap.size();i++) _slot[_heap[i].id] = -1;  _heap.clear(); } // keeps the slot array, for reuse
 };
 
 typedef FacePriorityQueue<VertexDataCatmark> PriorityQueueCatmark;
@@ -157,19 +233,82 @@ bool FindBestSplitPointFace(MeshFace * face, bool allowShifts, const vec3 & came
                             std::set<std::pair<MeshVertex*,MeshVertex*> > & badEdges,
                             PriorityQueueCatmark & wiggleQueue, PriorityQueueCatmark & splitQueue);
 
-// sample an initial triangle mesh from a surface, clipping to the view frustum
+// build a Catmull-Clark control mesh from face-vertex lists (positions: 3 per vertex)
+CatmarkMesh * NewCatmarkSurface(int numVertices, const real * positions, int numFaces, const int * faceSizes, const int * vertIndices);
+
+// sample an initial triangle mesh from a surface, clipping to the view frustum. With triangles, faces that are large
+// in the image or crossed by the contour are sampled finer, up to maxSubdivisionLevel (see SampleLevels); the mesh
+// has no T-junctions where the levels change. maxSubdivisionLevel <= subdivisionLevel samples every face uniformly.
 HbrMesh<VertexDataCatmark> * SurfaceToMesh(CatmarkMesh * surface, int subdivisionLevel,
-                                           const CameraModel & cameraModel, bool triangles);
+                                           const CameraModel & cameraModel, bool triangles, int maxSubdivisionLevel);
+
+// operations performed by RefineContour
+struct RefineCounters
+{
+    int numZCs;
+    int numFlips;
+    int numSplits;
+    int numWiggles;
+
+    RefineCounters() : numZCs(0), numFlips(0), numSplits(0), numWiggles(0) { }
+    void Add(const RefineCounters & c) { numZCs += c.numZCs; numFlips += c.numFlips; numSplits += c.numSplits; numWiggles += c.numWiggles; }
+};
 
-// perform contour filtering on a sampled mesh, in order to have a consistent smooth mesh contour
+// perform contour filtering on a sampled mesh, in order to have a consistent smooth mesh contour.
+// concurrentPatches: refine patches of inconsistent faces concurrently, then fix up their borders serially
+// (only without a cap on the number of splits, and with several threads outside of a parallel region).
+// The counters are the totals over the patches and the serial pass. They and the resulting mesh are the
+// serial loop's as long as the order in which faces are refined doesn't change what is done to them. The faces
+// at the patch borders are refined after the patches, later than in the serial loop, so a few operations and
+// inconsistent faces can differ (see "Benchmarking the tessellation" in the README).
 void RefineContour(HbrMesh<VertexDataCatmark> * mesh, const vec3 & cameraCenter,
 		   const RefinementType refinement, const bool allowShifts,
-		   const int maxInconsistentSplits);
+		   const int maxInconsistentSplits, const bool concurrentPatches = false, RefineCounters * counters = NULL);
 
 typedef enum { PREPROCESS, DETECT_CUSP, INSERT_CONTOUR, INSERT_CUSP, INSERT_RADIAL, FLIP_RADIAL, EXTEND_RADIAL, FLIP_EDGE, WIGGLING_PARAM, SPLIT_EDGE, EVERYTHING} RefineRadialStep;
 
 void RefineContourRadial(HbrMesh<VertexDataCatmark> * mesh, const vec3 & cameraCenter, const bool allowShifts, const RefineRadialStep lastStep);
 
+// refine a mesh sampled by SurfaceToMesh with the given method (nothing for RF_NONE); lastStep only matters for RF_RADIAL.
+// counters, if given, receives RefineContour's counters (it is left alone by RF_NONE and RF_RADIAL)
+void RefineMesh(HbrMesh<VertexDataCatmark> * mesh, const vec3 & cameraCenter, const RefinementType refinement, const bool allowShifts,
+                const int maxInconsistentSplits, const bool concurrentPatches, const RefineRadialStep lastStep,
+                RefineCounters * counters = NULL);
+
+// the faces of a subdivided surface that SurfaceToMesh samples, whatever the camera
+void SampledFaces(CatmarkMesh * surface, int subdivisionLevel, std::vector<CatmarkFace*> & faces);
+
+// the level at which SurfaceToMesh (with triangles) samples each of these faces for a camera: subdivisionLevel, raised
+// by one for each four-fold of ADAPTIVE_CELL_AREA_PIXELS the face covers in the image, or to maxSubdivisionLevel if
+// its facing changes across it; then raised until the levels of neighbouring faces differ by at most one
+void SampleLevels(const std::vector<CatmarkFace*> & sampledFaces, int subdivisionLevel, int maxSubdivisionLevel,
+                  const CameraModel & cameraModel, std::vector<int> & levels);
+
+// the outcome of the view-frustum tests that SurfaceToMesh makes (with triangles) on these faces at these levels;
+// two cameras with the same levels and signature sample the same mesh, up to the facing of its vertices
+void FrustumSignature(const std::vector<CatmarkFace*> & sampledFaces, const std::vector<int> & levels, int subdivisionLevel,
+                      const CameraModel & cameraModel, std::vector<bool> & signature);
+
+// the initial sampling of one surface, kept from one frame of a camera path to the next (see SampleCoherent)
+struct CoherentMesh
+{
+  HbrMesh<VertexDataCatmark> * baseMesh;   // as sampled by SurfaceToMesh, never refined; NULL before the first frame
+  std::vector<CatmarkFace*> sampledFaces;  // see SampledFaces
+  std::vector<int> sampleLevels;           // see SampleLevels, for the camera it was sampled for
+  std::vector<bool> frustumSignature;      // of that camera
+
+  CoherentMesh() : baseMesh(NULL) { }
+  void Release();  // deletes the base mesh
+};
+
+// sample the surface for a camera, like SurfaceToMesh with triangles. The sample only depends on the camera through the
+// levels, the frustum tests and the facing of its vertices, so as long as the levels and tests don't change from one
+// frame to the next, the sample of the previous frame is copied with the facing of its vertices updated, without
+// evaluating the surface again (apart from the few samples of SampleLevels when adaptive). The surface must outlive
+// coherent. Returns a new mesh (NULL if everything was culled); reused is true if it was copied.
+HbrMesh<VertexDataCatmark> * SampleCoherent(CoherentMesh & coherent, CatmarkMesh * surface, int subdivisionLevel,
+                                            int maxSubdivisionLevel, const CameraModel & camera, bool & reused);
+
 bool EnsureShiftable(MeshVertex * shiftVertex, const ParamPointCC & targetLoc,
                      const vec3 & cameraCenter, Mesh * mesh,
                      PriorityQueueCatmark * wiggleQueue, PriorityQueueCatmark * splitQueue, bool testMode);
@@ -201,6 +340,7 @@ void SplitZeroCrossingEdge(MeshFace * face, int oppVertex, Mesh * mesh,
 bool FlipFace(MeshFace * face, Mesh * mesh, const vec3 & cameraCenter,
               PriorityQueueCatmark & wiggleQueue, PriorityQueueCatmark & splitQueue);
 
+// radial curvature and isophote distance of every vertex, computed concurrently
 void ComputeRadialCurvatures(HbrMesh<VertexDataCatmark> * mesh, const CameraModel & camera, real isovalue, int maxIsophoteDistance);
 
 // The face orientation according to the vertices of the face; CONTOUR if the face is not vertex-consistent
@@ -218,6 +358,7 @@ HbrFace<T> * NewFaceDebug(HbrMesh<T> * mesh, int numVertices, int * IDs, bool tr
 template<class T>
 void OptimizeConsistency(HbrMesh<T> * outputMesh, const vec3 & cameraCenter, real lambda, real epsilon);
 
+// add the face counts of a refined mesh to the given totals; the faces are checked concurrently
 void ComputeConsistencyStats(HbrMesh<VertexDataCatmark> * outputMesh, const vec3 & cameraCenter, int & numInconsistent, int & numStrongInconsistent,
                              int &numNonRadial, int &numInconsistentContour, int &numInconsistentRadial);
 
@@ -246,6 +387,10 @@ const real MIN_TRIANGLE_AREA = 1e-20;  //1e-10 or 1e-5?
 const bool ENFORCE_SHIFTABLE = true;
 const bool REQUIRE_SEPARATORS = false; // only active when extraordinary interpolation is on.  having this on without interpolation will fail.
 
+// adaptive initial sampling, see SampleLevels
+const real ADAPTIVE_CELL_AREA_PIXELS = 100;  // a face is sampled finer until its cells cover at most this many pixels
+const int NUM_ADAPTIVE_SAMPLES_SQRT = 5;     // limit samples per side of a face, looking for a change of facing
+
 const real CONTOUR_THRESHOLD = 1e-8; //0.01; //1e-6; //0.000001; // 0.000001;
 
 #include "refineContourFunctions.h"
@@ -242,8 +242,12 @@ HbrFace<T> * NewFaceDebug(HbrMesh<T> * mesh, int numVertices, int * IDs, bool tr
     bool bad = false;
     for(int i=0;i<numVertices;i++)
     {
-        HbrVertex<T> * v0 = mesh->GetVertex(IDs[i]);
-        HbrVertex<T> * v1 = mesh->GetVertex(IDs[(i+1)%3]);
+        HbrVertex<T> * v0, * v1;
+#pragma omp critical(meshEdit)
+        {
+            v0 = mesh->GetVertex(IDs[i]);
+            v1 = mesh->GetVertex(IDs[(i+1)%3]);
+        }
 
         assert(v0 != v1);
 
@@ -265,7 +269,9 @@ HbrFace<T> * NewFaceDebug(HbrMesh<T> * mesh, int numVertices, int * IDs, bool tr
         return NULL;
     }
 
-    HbrFace<T> * face = mesh->NewFace(numVertices, IDs, 0);
+    HbrFace<T> * face;
+#pragma omp critical(meshEdit)
+    face = mesh->NewFace(numVertices, IDs, 0);
 
     assert(!bad);
 
@@ -962,25 +968,66 @@ void WiggleAllVertices(HbrMesh<T> * outputMesh, const vec3 & cameraCenter)
 ///////////////////////////////////////////// PRIORITY QUEUE /////////////////////////////////
 
 template<class T>
-HbrFace<T> * FacePriorityQueue<T>::PopFront()
+void FacePriorityQueue<T>::_SiftUp(int i)
 {
-    assert(Size()!=0);
-
-    HbrFace<T> * face;
-    typename std::set<HbrFace<T>*>::iterator rit;
-
-    do
+    Entry e = _heap[i];
+    while (i > 0)
     {
-        typename std::multimap<real,HbrFace<T>*>::iterator it=_queue.end();
-        --it;
-        face = (*it).second;
-        _queue.erase(it);
+        int parent = (i-1)/2;
+        if (!(_heap[parent].priority < e.priority))
+            break;
+        _Place(i, _heap[parent]);
+        i = parent;
+    }
+    _Place(i, e);
+}
 
-        rit = _readySet.find(face);
+template<class T>
+void FacePriorityQueue<T>::_SiftDown(int i)
+{
+    Entry e = _heap[i];
+    int n = _heap.size();
+    for(;;)
+    {
+        int child = 2*i+1;
+        if (child >= n)
+            break;
+        if (child+1 < n && _heap[child].priority < _heap[child+1].priority)
+            child++;
+        if (!(e.priority < _heap[child].priority))
+            break;
+        _Place(i, _heap[child]);
+        i = child;
     }
-    while (rit == _readySet.end());
+    _Place(i, e);
+}
 
-    _readySet.erase(rit);
+template<class T>
+void FacePriorityQueue<T>::_Erase(int i)
+{
+    _slot[_heap[i].id] = -1;
+
+    Entry last = _heap.back();
+    _heap.pop_back();
+
+    if (i == (int)_heap.size())
+        return;
+
+    // move the last entry into the hole, then restore the heap order in whichever direction it's broken
+    _Place(i, last);
+    if (i > 0 && _heap[(i-1)/2].priority < last.priority)
+        _SiftUp(i);
+    else
+        _SiftDown(i);
+}
+
+template<class T>
+HbrFace<T> * FacePriorityQueue<T>::PopFront()
+{
+    assert(Size()!=0);
+
+    HbrFace<T> * face = _heap[0].face;
+    _Erase(0);
 
     return face;
 }
@@ -988,24 +1035,46 @@ HbrFace<T> * FacePriorityQueue<T>::PopFront()
 template<class T>
 void FacePriorityQueue<T>::Insert(HbrFace<T>* face)
 {
-    if (_readySet.find(face) != _readySet.end())
+    if (HasFace(face))
         return;
 
-    _readySet.insert(face);
-
-    _queue.insert(std::pair<real,HbrFace<T>*>(_Priority(face),face));
+    int id = face->GetID();
+    if (id >= (int)_slot.size())
+        _slot.resize(std::max<int>(id+1, 2*_slot.size()), -1);
+
+    Entry e;
+    e.priority = _Priority(face);
+    e.face = face;
+    e.id = id;
+    _heap.push_back(e);
+    _slot[id] = _heap.size()-1;
+    _SiftUp(_heap.size()-1);
 }
 
 template<class T>
 void FacePriorityQueue<T>::Remove(HbrFace<T> * face)
 {
-    if (_readySet.find(face) == _readySet.end())
+    int i = _Slot(face);
+    if (i == -1)
         return;
 
-    _readySet.erase(face);
+    _Erase(i);
+}
 
-    // could also remove from the queue and then simplify "PopFront()"
-}  
+template<class T>
+void FacePriorityQueue<T>::Update(HbrFace<T> * face)
+{
+    int i = _Slot(face);
+    if (i == -1)
+        return;
+
+    real old = _heap[i].priority;
+    _heap[i].priority = _Priority(face);
+    if (old < _heap[i].priority)
+        _SiftUp(i);
+    else
+        _SiftDown(i);
+}
 
 
 template<class T>
@@ -1099,7 +1168,7 @@ bool Inverse(real A[3][3])
             n-=A[i][j]*A[i-1][j+1]*A[i-2][j+2];
     }
 
-    if(fabsl(n)>0.0)
+    if(fabs(n)>0.0)
         x=1.0/n;
     else{
         return false;
@@ -1189,6 +1258,7 @@ bool Outside(vec3 & pos0, vec3 & pos1, vec3 & pos2, vec3 & testPos,
 #ifdef LINK_FREESTYLE
                 char str[200];
                 sprintf(str, "CAN'T INVERSE MATRIX");
+#pragma omp critical(rifDebugPoint)
                 addRIFDebugPoint(-1,double(testPos[0]),double(testPos[1]),double(testPos[2]),str,0);
 #endif
                 return false;
@@ -1241,7 +1311,7 @@ FacePriorityQueue<T> & wiggleQueue, FacePriorityQueue<T> & splitQueue, bool skip
                         return;
                     wiggleQueue.Remove(adjFace);
                     splitQueue.Remove(adjFace);
-                    mesh->DeleteFace(adjFace);
+                    DeleteFace<T>(mesh, adjFace);
                     if(v[0]->GetEdge(v[1])){
                         f.push_back(NewFace<T>(mesh, newV, v[0], oppositeV));
                         f.push_back(NewFace<T>(mesh, newV, oppositeV, v[1]));
@@ -1269,7 +1339,7 @@ FacePriorityQueue<T> & wiggleQueue, FacePriorityQueue<T> & splitQueue, bool skip
                         return;
                     wiggleQueue.Remove(adjFace);
                     splitQueue.Remove(adjFace);
-                    mesh->DeleteFace(adjFace);
+                    DeleteFace<T>(mesh, adjFace);
                     if(v[2]->GetEdge(v[0])){
                         f.push_back(NewFace<T>(mesh, newV, v[2], oppositeV));
                         f.push_back(NewFace<T>(mesh, newV, oppositeV, v[0]));
@@ -1297,7 +1367,7 @@ FacePriorityQueue<T> & wiggleQueue, FacePriorityQueue<T> & splitQueue, bool skip
                         return;
                     wiggleQueue.Remove(adjFace);
                     splitQueue.Remove(adjFace);
-                    mesh->DeleteFace(adjFace);
+                    DeleteFace<T>(mesh, adjFace);
                     if(v[1]->GetEdge(v[2])){
                         f.push_back(NewFace<T>(mesh, newV, v[1], oppositeV));
                         f.push_back(NewFace<T>(mesh, newV, oppositeV, v[2]));
@@ -1354,7 +1424,7 @@ void InsertVertex(HbrFace<T> * face, int oppVertex, HbrVertex<T> * newVertex, Hb
 
     MYTEST("b\n");
 
-    mesh->DeleteFace(face);
+    DeleteFace<T>(mesh, face);
 
     MYTEST("c\n");
 
@@ -1391,7 +1461,7 @@ void InsertVertex(HbrFace<T> * face, int oppVertex, HbrVertex<T> * newVertex, Hb
 
         MYTEST("F\n");
 
-        mesh->DeleteFace(oppFace);
+        DeleteFace<T>(mesh, oppFace);
 
         HbrFace<T> * f3 = !skip1[0] ? NewFace<T>(mesh, newVertex, v1, v3) : NULL;
         HbrFace<T> * f4 = !skip1[2] ? NewFace<T>(mesh, v2, newVertex, v3) : NULL;
@@ -1416,6 +1486,7 @@ void InsertVertex(HbrFace<T> * face, int oppVertex, HbrVertex<T> * newVertex, Hb
 #if LINK_FREESTYLE
             char str[200];
             sprintf(str, "SPLIT");
+#pragma omp critical(rifDebugPoint)
             addRIFDebugPoint(-1, double(newVertex->GetData().pos[0]), double(newVertex->GetData().pos[1]), double(newVertex->GetData().pos[2]), str, 0);
 #endif
         }
@@ -1448,7 +1519,7 @@ void InsertVertex(HbrFace<T> * face, int oppVertex, HbrVertex<T> * newVertex, Hb
     int eOpp;
     HbrFace<T> * oppFace = GetOppFace<T>(face, oppVertex, eOpp);
 
-    mesh->DeleteFace(face);
+    DeleteFace<T>(mesh, face);
     deletedFaces.push_back(face);
 
     HbrFace<T> * f1 = NewFace<T>(mesh, v0, v1, newVertex);
@@ -1460,7 +1531,7 @@ void InsertVertex(HbrFace<T> * face, int oppVertex, HbrVertex<T> * newVertex, Hb
     {
         HbrVertex<T> * v3 = oppFace->GetVertex(eOpp);
 
-        mesh->DeleteFace(oppFace);
+        DeleteFace<T>(mesh, oppFace);
         deletedFaces.push_back(oppFace);
 
         HbrFace<T> * f3 = NewFace<T>(mesh, newVertex, v1, v3);
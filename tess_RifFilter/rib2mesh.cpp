@@ -5,13 +5,15 @@
 
 #include "rib2mesh.h"
 #include "refineContour.h"
+#include "stats.h"
 
 #include <osdutil/adaptiveEvaluator.h>
 #include <osdutil/uniformEvaluator.h>
 #include <osdutil/topology.h>
 
-real OPT_LAMBDA = 1;//1e-16;
-real OPT_EPSILON = 0.000001;//1e-10;
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -37,6 +39,7 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
     bool meshSilhouettes = true;
     bool runFreestyle = false;
     const char * outputImage = "default.tiff";
+    bool runFreestyleHeadless = false;
     const char * outputEPSPolyline = "default.svg";
     const char * outputEPSThick = "default.ps";
     const char * freestyleLibPath = "";
@@ -51,6 +54,14 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
     std::vector<char*> styleModules;
     bool invertNormals = false;
     bool useConsistency = true;
+    int numThreads = 1;
+    bool savePLY = true;
+    bool binaryPLY = true;
+    bool occluderBVH = false;
+    bool checkConcurrentLayers = false;
+    bool refinePatches = false;
+    const char * statsReport = NULL;
+    int maxSubdivisionLevel = -1;
 
     if (argc > 1)
         outputFilename = argv[0];
@@ -169,6 +180,36 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
                                             maxInconsistentSplits = atoi(argv[i+1]);
                                             i+=2;
                                         }
+                                        else if (strcmp(argv[i],"-savePLY") == 0)
+                                        {
+                                            savePLY = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-binaryPLY") == 0)
+                                        {
+                                            binaryPLY = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-occluderBVH") == 0)
+                                        {
+                                            occluderBVH = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-checkConcurrentLayers") == 0)
+                                        {
+                                            checkConcurrentLayers = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-refinePatches") == 0)
+                                        {
+                                            refinePatches = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-numThreads") == 0)
+                                        {
+                                            numThreads = atoi(argv[i+1]);
+                                            i+=2;
+                                        }
                                         else if (strcmp(argv[i],"-allowShifts") == 0)
                                         {
                                             allowShifts = (strcmp(argv[i+1],"False") != 0);
@@ -214,6 +255,11 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
                                             outputImage = argv[i+1];
                                             i+=2;
                                         }
+                                        else if (strcmp(argv[i],"-runFreestyleHeadless") == 0)
+                                        {
+                                            runFreestyleHeadless = (strcmp(argv[i+1],"False") != 0);
+                                            i+=2;
+                                        }
                                         else if (strcmp(argv[i],"-outputEPSPolyline") == 0)
                                         {
                                             outputEPSPolyline = argv[i+1];
@@ -229,6 +275,16 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
                                             freestyleLibPath = argv[i+1];
                                             i+=2;
                                         }
+                                        else if (strcmp(argv[i],"-statsReport") == 0)
+                                        {
+                                            statsReport = argv[i+1];
+                                            i+=2;
+                                        }
+                                        else if (strcmp(argv[i],"-maxSubdivLevel") == 0)
+                                        {
+                                            maxSubdivisionLevel = atoi(argv[i+1]);
+                                            i+=2;
+                                        }
                                         else if (strcmp(argv[i],"-runFreestyleInteractive") == 0)
                                         {
                                             runFreestyleInteractive = (strcmp(argv[i+1],"False") != 0);
@@ -255,7 +311,7 @@ RifPlugin* RifPluginManufacture(int argc, char ** argv)
     rib2mesh * obj = new rib2mesh(targetSurfacePattern,outputFilename,exclusionPattern,subdivisionLevel,meshSmoothing,
                             refinement, maxInconsistentSplits, allowShifts, maxDisplayWidth, maxDisplayHeight, useOrientation, invertNormals,
                             cullBackFaces, meshSilhouettes, useConsistency, runFreestyle,
-                            runFreestyleInteractive, cuspTrimThreshold, graftThreshold, wiggleFactor, outputImage, outputEPSPolyline, outputEPSThick, freestyleLibPath, lastStep);
+                            runFreestyleInteractive, cuspTrimThreshold, graftThreshold, wiggleFactor, outputImage, runFreestyleHeadless, outputEPSPolyline, outputEPSThick, freestyleLibPath, lastStep, numThreads, savePLY, binaryPLY, occluderBVH, checkConcurrentLayers, refinePatches, statsReport, maxSubdivisionLevel);
 
     for(std::vector<char*>::iterator it = styleModules.begin(); it != styleModules.end(); ++it)
         obj->addStyle(*it);
@@ -274,7 +330,9 @@ rib2mesh::rib2mesh(const char * targetSurfacePattern, const char *outputFilename
              bool cullBackFaces,
              bool meshSilhouettes, bool useConsistency, bool runFreestyle, bool runFreestyleInteractive,
              double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
-             const char * outputImage, const char * outputEPSPolyline, const char * outputEPSThick, const char * freestyleLibPath, RefineRadialStep lastStep)
+             const char * outputImage, bool runFreestyleHeadless, const char * outputEPSPolyline, const char * outputEPSThick, const char * freestyleLibPath, RefineRadialStep lastStep,
+             int numThreads, bool savePLY, bool binaryPLY, bool occluderBVH, bool checkConcurrentLayers, bool refinePatches, const char * statsReport,
+             int maxSubdivisionLevel)
 { 
     printf("Using pattern: %s\n", targetSurfacePattern);
     printf("Output geom filename: %s\n", outputFilename);
@@ -322,7 +380,15 @@ rib2mesh::rib2mesh(const char * targetSurfacePattern, const char *outputFilename
     _cullBackFaces = cullBackFaces;
     _meshSilhouettes = meshSilhouettes;
     _runFreestyle = runFreestyle;
+    _savePLY = savePLY;
+    _binaryPLY = binaryPLY;
+    _occluderBVH = occluderBVH;
+    _checkConcurrentLayers = checkConcurrentLayers;
+    _refinePatches = refinePatches;
+    _statsReport = statsReport;
+    _maxSubdivisionLevel = maxSubdivisionLevel;
     _outputImage = outputImage;
+    _runFreestyleHeadless = runFreestyleHeadless;
     _outputEPSPolyline = outputEPSPolyline;
     _outputEPSThick = outputEPSThick;
     _freestyleLibPath = freestyleLibPath;
@@ -339,6 +405,16 @@ rib2mesh::rib2mesh(const char * targetSurfacePattern, const char *outputFilename
     _focalLength = 1;
     _wiggleFactor = wiggleFactor;
 
+#ifdef _OPENMP
+    _numThreads = numThreads > 0 ? numThreads : omp_get_max_threads();
+#else
+    if (numThreads != 1)
+        printf("Not compiled with OpenMP; refining surfaces serially\n");
+    _numThreads = 1;
+#endif
+    if (_numThreads > 1)
+        printf("Refining surfaces on %d threads\n", _numThreads);
+
     mat4 firstMatrix;
     firstMatrix.SetIdentity();
     _matrixStack.push_back(firstMatrix);
@@ -347,6 +423,9 @@ rib2mesh::rib2mesh(const char * targetSurfacePattern, const char *outputFilename
     _totalOutputFaces = 0;
     _totalInconsistentFaces = 0;
     _totalStrongInconsistentFaces = 0;
+    _totalContourInconsistentFaces = 0;
+    _totalRadialInconsistentFaces = 0;
+    _totalNonRadialFaces = 0;
 
     // ---------------------------- COMPILE THE REGEXPs ----------------------------------
 
@@ -478,10 +557,10 @@ double compute_feature_size(HbrMesh<VertexDataCatmark>* mesh, bool radial=false)
             continue;
         }
         if(radial){
-               samples.push_back(fabsl(mesh->GetVertex(ind)->GetData().radialCurvature));
+               samples.push_back(fabs(mesh->GetVertex(ind)->GetData().radialCurvature));
         }else{
-            samples.push_back(fabsl(mesh->GetVertex(ind)->GetData().k1));
-            samples.push_back(fabsl(mesh->GetVertex(ind)->GetData().k2));
+            samples.push_back(fabs(mesh->GetVertex(ind)->GetData().k1));
+            samples.push_back(fabs(mesh->GetVertex(ind)->GetData().k2));
         }
     }
 
@@ -494,55 +573,30 @@ double compute_feature_size(HbrMesh<VertexDataCatmark>* mesh, bool radial=false)
     return (mult / samples[which]);
 }
 
-int rib2mesh::SavePLYFile()
+void rib2mesh::CollectOutputMesh(OutputMesh & mesh) const
 {
-
     // ---- count the number of vertices and faces ----
     int numVertices = 0;
     int numFaces = 0;
-    for(std::vector<HbrMesh<VertexDataCatmark>*>::iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
+    for(std::vector<HbrMesh<VertexDataCatmark>*>::const_iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
     {
         numVertices += (*it)->GetNumVertices();
         numFaces += (*it)->GetNumFaces();
     }
 
-    // ---- output the PLY header ----
-
-    FILE * fp = fopen(_outputFilename, "wt");
-
-    if (fp == NULL)
-    {
-        printf("ERROR: CANNOT OPEN OUTPUT PLY FILE\n");
-        exit(1);
-    }
-
-    fprintf(fp,"ply\n");
-    fprintf(fp,"format ascii 1.0\n");
-    fprintf(fp,"comment %s\n", _meshSilhouettes ? "mesh silhouettes" : "smooth silhouettes");
-    fprintf(fp,"element vertex %d\n", numVertices);
-    fprintf(fp,"property float x\n");   // maybe should save as doubles?  what would this require?
-    fprintf(fp,"property float y\n");   // maybe should save as doubles?
-    fprintf(fp,"property float z\n");   // maybe should save as doubles?
-    fprintf(fp,"property float nx\n");
-    fprintf(fp,"property float ny\n");
-    fprintf(fp,"property float nz\n");
-    fprintf(fp,"property float red\n");
-    fprintf(fp,"property float green\n");
-    fprintf(fp,"property float blue\n");
-    fprintf(fp,"property float ndotv\n");
-
-    fprintf(fp,"element face %d\n", numFaces);
-    //  fprintf(fp,"property uchar vbf\n");
-    fprintf(fp,"property list uchar int vertex_index\n");
-    fprintf(fp,"property uchar int\n");  // vbf
-    fprintf(fp,"end_header\n");
+    mesh.positions.reserve(3*numVertices);
+    mesh.normals.reserve(3*numVertices);
+    mesh.colors.reserve(3*numVertices);
+    mesh.vertexData.reserve(numVertices);
+    mesh.faces.reserve(3*numFaces);
+    mesh.faceFlags.reserve(numFaces);
 
-    // ---- output all the vertices and save their IDs ----
+    // ---- collect all the vertices and save their IDs ----
 
-    int nextVertID = 0;
-    std::map<HbrVertex<VertexDataCatmark>*,int> vmapcc;
+    unsigned nextVertID = 0;
+    std::map<HbrVertex<VertexDataCatmark>*,unsigned> vmapcc;
 
-    for(std::vector<HbrMesh<VertexDataCatmark>*>::iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
+    for(std::vector<HbrMesh<VertexDataCatmark>*>::const_iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
     {
         double feature_size = compute_feature_size(*it);
         double feature_size_radial = compute_feature_size(*it,true);
@@ -553,37 +607,31 @@ int rib2mesh::SavePLYFile()
         {
             vmapcc[*vit] = nextVertID;
             nextVertID ++;
-            fprintf(fp, "%.16f %.16f %.16f", double((*vit)->GetData().pos[0]), double((*vit)->GetData().pos[1]), double((*vit)->GetData().pos[2]));
 
-            if (!_meshSilhouettes)
-            {
-                vec3 normal = FaceAveragedVertexNormal(*vit);
-                fprintf(fp, " %.16f %.16f %.16f", double(normal[0]),double(normal[1]),double(normal[2]));
-            }
-            else {
-                vec3 normal = -1.*(*vit)->GetData().normal;
-                fprintf(fp, " %.16f %.16f %.16f", double(normal[0]),double(normal[1]),double(normal[2]));
-            }
+            for(int j=0;j<3;j++)
+                mesh.positions.push_back(double((*vit)->GetData().pos[j]));
+
+            vec3 normal = _meshSilhouettes ? -1.*(*vit)->GetData().normal : FaceAveragedVertexNormal(*vit);
+            for(int j=0;j<3;j++)
+                mesh.normals.push_back(double(normal[j]));
 
             //double C = compute_gcurv_colors((*vit)->GetData().k1,(*vit)->GetData().k2,feature_size);
             double color[3];
             compute_curv_colors((*vit)->GetData().k1,(*vit)->GetData().k2,feature_size,color);
+            for(int j=0;j<3;j++)
+                mesh.colors.push_back(float(color[j]));
 
-            fprintf(fp, " %f %f %f %.16f\n",
-                    //C,C,C,
-                    color[0], color[1], color[2],
-                    //double((*vit)->GetData().ndotv));
-                    double((*vit)->GetData().radialCurvature)/(0.5*feature_size_radial));
-                    //double(0.5*((*vit)->GetData().k1+(*vit)->GetData().k2))); //double((*vit)->GetData().ndotv),
-
+            //double((*vit)->GetData().ndotv));
+            mesh.vertexData.push_back(float(double((*vit)->GetData().radialCurvature)/(0.5*feature_size_radial)));
+            //double(0.5*((*vit)->GetData().k1+(*vit)->GetData().k2))); //double((*vit)->GetData().ndotv),
         }
     }
 
-    assert(nextVertID == numVertices);
+    assert(int(nextVertID) == numVertices);
 
-    // --- output all the faces ----------
+    // --- collect all the faces ----------
 
-    for(std::vector<HbrMesh<VertexDataCatmark>*>::iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
+    for(std::vector<HbrMesh<VertexDataCatmark>*>::const_iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
     {
         std::list<HbrFace<VertexDataCatmark>*> faces;
         (*it)->GetFaces(std::back_inserter(faces));
@@ -599,14 +647,109 @@ int rib2mesh::SavePLYFile()
                 vfint+=4;
 
             assert((*fit)->GetNumVertices() == 3);
-            fprintf(fp,"3 %d %d %d %d\n", vmapcc[(*fit)->GetVertex(0)], vmapcc[(*fit)->GetVertex(1)], vmapcc[(*fit)->GetVertex(2)], vfint);
+            for(int j=0;j<3;j++)
+                mesh.faces.push_back(vmapcc[(*fit)->GetVertex(j)]);
+            mesh.faceFlags.push_back(vfint);
+        }
+    }
+}
+
+void rib2mesh::SavePLYFile(const OutputMesh & mesh) const
+{
+    StageTimer timer("SavePLYFile");
+
+    // ---- output the PLY header ----
+
+    FILE * fp = fopen(_outputFilename, _binaryPLY ? "wb" : "wt");
+
+    if (fp == NULL)
+    {
+        printf("ERROR: CANNOT OPEN OUTPUT PLY FILE\n");
+        exit(1);
+    }
+
+    // binary files are written in the host byte order, and say so in the header
+    const unsigned one = 1;
+    bool bigEndian = (*(const unsigned char*)&one == 0);
+    const char * posType = _binaryPLY ? "double" : "float";
+
+    fprintf(fp,"ply\n");
+    if (_binaryPLY)
+        fprintf(fp,"format %s 1.0\n", bigEndian ? "binary_big_endian" : "binary_little_endian");
+    else
+        fprintf(fp,"format ascii 1.0\n");
+    fprintf(fp,"comment %s\n", _meshSilhouettes ? "mesh silhouettes" : "smooth silhouettes");
+    fprintf(fp,"element vertex %d\n", mesh.NumVertices());
+    fprintf(fp,"property %s x\n", posType);
+    fprintf(fp,"property %s y\n", posType);
+    fprintf(fp,"property %s z\n", posType);
+    fprintf(fp,"property %s nx\n", posType);
+    fprintf(fp,"property %s ny\n", posType);
+    fprintf(fp,"property %s nz\n", posType);
+    fprintf(fp,"property float red\n");
+    fprintf(fp,"property float green\n");
+    fprintf(fp,"property float blue\n");
+    fprintf(fp,"property float ndotv\n");
+
+    fprintf(fp,"element face %d\n", mesh.NumFaces());
+    fprintf(fp,"property list uchar int vertex_index\n");
+    fprintf(fp,_binaryPLY ? "property int vbf\n" : "property uchar int\n");  // vbf
+    fprintf(fp,"end_header\n");
+
+    if (_binaryPLY)
+    {
+        // ---- output all the vertices: 6 doubles and 4 floats each ----
+
+        const size_t vertexSize = 6*sizeof(double) + 4*sizeof(float);
+        std::vector<char> buffer(vertexSize * mesh.NumVertices());
+        char * out = buffer.empty() ? NULL : &buffer[0];
+        for(int i=0;i<mesh.NumVertices();i++, out += vertexSize)
+        {
+            memcpy(out, &mesh.positions[3*i], 3*sizeof(double));
+            memcpy(out + 3*sizeof(double), &mesh.normals[3*i], 3*sizeof(double));
+            memcpy(out + 6*sizeof(double), &mesh.colors[3*i], 3*sizeof(float));
+            memcpy(out + 6*sizeof(double) + 3*sizeof(float), &mesh.vertexData[i], sizeof(float));
+        }
+        if (!buffer.empty())
+            fwrite(&buffer[0], 1, buffer.size(), fp);
+
+        // --- output all the faces: a uchar count, 3 indices and the flags ----------
+
+        const size_t faceSize = 1 + 4*sizeof(int);
+        buffer.resize(faceSize * mesh.NumFaces());
+        out = buffer.empty() ? NULL : &buffer[0];
+        for(int i=0;i<mesh.NumFaces();i++, out += faceSize)
+        {
+            int v[4] = { int(mesh.faces[3*i]), int(mesh.faces[3*i+1]), int(mesh.faces[3*i+2]), mesh.faceFlags[i] };
+            out[0] = 3;
+            memcpy(out + 1, v, sizeof(v));
+        }
+        if (!buffer.empty())
+            fwrite(&buffer[0], 1, buffer.size(), fp);
+    }
+    else
+    {
+        // ---- output all the vertices ----
+
+        for(int i=0;i<mesh.NumVertices();i++)
+        {
+            const double * pos = &mesh.positions[3*i];
+            const double * normal = &mesh.normals[3*i];
+            const float * color = &mesh.colors[3*i];
+
+            fprintf(fp, "%.16f %.16f %.16f", pos[0], pos[1], pos[2]);
+            fprintf(fp, " %.16f %.16f %.16f", normal[0], normal[1], normal[2]);
+            fprintf(fp, " %f %f %f %.16f\n", double(color[0]), double(color[1]), double(color[2]), double(mesh.vertexData[i]));
         }
+
+        // --- output all the faces ----------
+
+        for(int i=0;i<mesh.NumFaces();i++)
+            fprintf(fp,"3 %d %d %d %d\n", mesh.faces[3*i], mesh.faces[3*i+1], mesh.faces[3*i+2], mesh.faceFlags[i]);
     }
 
     // close output file
     fclose(fp);
-
-    return numFaces;
 }
 
 
@@ -614,15 +757,29 @@ rib2mesh::~rib2mesh()
 {
     // ----------------------------- SAVE AND CLOSE THE OUTPUT FILE ---------------------
 
-    // generate a PLY file
+    // refine any surfaces that were queued for the worker threads
+
+    RefinePendingSurfaces();
 
-    int numFaces = SavePLYFile();
+    // flatten the meshes for the PLY file and Freestyle
+
+    StageTimer collectTimer("CollectOutputMesh");
+    OutputMesh outputMesh;
+    CollectOutputMesh(outputMesh);
+    int numFaces = outputMesh.NumFaces();
+    collectTimer.Stop();
+
+    if (_savePLY)
+        SavePLYFile(outputMesh);
 
     printf("Deleting meshes\n");
 
     // delete all the meshes
     for(std::vector<HbrMesh<VertexDataCatmark>*>::iterator it = _outputMeshesCatmark.begin(); it != _outputMeshesCatmark.end(); ++it)
+    {
+        VertexProvenanceTable::Release(*it);
         delete *it;
+    }
 
     if (false && NUM_INCONSISTENT_SAMPLES > 0)
         printf("STATS: Input faces: %d, Output faces: %d, Inconsistent faces: %d, Strong Inconsistent Faces: %d\n\n",
@@ -631,6 +788,19 @@ rib2mesh::~rib2mesh()
         printf("STATS: Input faces: %d, Output faces: %d, Inconsistent faces: %d on contour: %d radial: %d, Non-Radial faces: %d\n\n",
                _totalInputFaces, _totalOutputFaces, _totalInconsistentFaces, _totalContourInconsistentFaces, _totalRadialInconsistentFaces, _totalNonRadialFaces);
 
+#ifdef TESS_DOUBLE_PRECISION
+    printf("STATS: Precision: double\n\n");
+#else
+    printf("STATS: Precision: long double\n\n");
+#endif
+
+    StageCount("Tessellation", "inputFaces", _totalInputFaces);
+    StageCount("Tessellation", "outputFaces", _totalOutputFaces);
+    StageCount("Tessellation", "inconsistentFaces", _totalInconsistentFaces);
+    StageCount("Tessellation", "inconsistentContourFaces", _totalContourInconsistentFaces);
+    StageCount("Tessellation", "inconsistentRadialFaces", _totalRadialInconsistentFaces);
+    StageCount("Tessellation", "nonRadialFaces", _totalNonRadialFaces);
+
 
     if (numFaces == 0)
         printf("Entire scene clipped\n");
@@ -639,12 +809,22 @@ rib2mesh::~rib2mesh()
     {
 #ifdef LINK_FREESTYLE
         if (numFaces > 0)
-            runFreestyle();
+            runFreestyle(outputMesh);
         else
             printf("Not running Freestyle\n");
 #else
         printf("Error: can't run Freestyle (not linked)\n");
         exit(1);
+#endif
+    }
+
+    if (_statsReport != NULL)
+    {
+#ifdef LINK_FREESTYLE
+        statsWriteReportFS(_statsReport, _outputFilename);
+        printf("Stats report: %s\n", _statsReport);
+#else
+        printf("Warning: no stats report without Freestyle\n");
 #endif
     }
 }
@@ -922,7 +1102,7 @@ vec3 rib2mesh::matrixTransform(const vec3 & pos)
 
     if (!printed)
     {
-        printf("an output point: %Lf %Lf %Lf\n", posout[0], posout[1], posout[2]);
+        printf("an output point: %f %f %f\n", double(posout[0]), double(posout[1]), double(posout[2]));
         printed = true;
     }
 
@@ -1059,7 +1239,7 @@ void rib2mesh::handleCatmark(RtInt nf, RtInt nverts[],
 
     // find out how long verts is, then use verts to find out the number of vertices
     params.numVertices = 0;
-    int i, j, k;
+    int i;
 
     int nverts_len=0;
     for(i=0;i<nf;i++)
@@ -1161,72 +1341,7 @@ void rib2mesh::handleCatmark(RtInt nf, RtInt nverts[],
 
     // ----------------- CREATE THE SUBD DATA STRUCTURE AND TESSELATE ------------------
 
-    static HbrCatmarkSubdivision<Vertex> catmark;
-    CatmarkMesh * surface = new CatmarkMesh(&catmark);
-
-    Vertex vtx;
-    for(int i=0;i<params.numVertices; i++ ) {
-        CatmarkVertex* v = surface->NewVertex(i, vtx);
-        v->GetData().SetPosition(pointPositions[3*i],pointPositions[3*i+1],pointPositions[3*i+2]);
-    }
-
-    int maxFaceSize = 0;
-    for(i = 0; i < params.numFaces; ++i) {
-        maxFaceSize = std::max(params.faceSizes[i], maxFaceSize);
-    }
-
-    int* fv = new int[maxFaceSize];
-    k = 0;
-    for (i=0; i<params.numFaces; ++i) {
-        int faceSize = params.faceSizes[i];
-        for(j = 0; j < faceSize; ++j) {
-            fv[j] = params.vertIndices[k++];
-
-//            topology.indices.push_back(params.vertIndices[k++]);//fv[j]);
-        }
-//        topology.nverts.push_back(faceSize);
-
-        // now check the half-edges connectivity
-        for(j=0; j<faceSize; j++) {
-            CatmarkVertex * origin      = surface->GetVertex( fv[j] );
-            CatmarkVertex * destination = surface->GetVertex( fv[(j+1)%faceSize] );
-            CatmarkHalfedge * opposite  = destination->GetEdge(origin);
-
-            if(origin==NULL || destination==NULL) {
-                printf(" An edge was specified that connected a nonexistent vertex\n");
-                continue;
-            }
-
-            if(origin == destination) {
-                printf(" An edge was specified that connected a vertex to itself\n");
-                continue;
-            }
-
-            if(opposite && opposite->GetOpposite() ) {
-                printf(" A non-manifold edge incident to more than 2 faces was found\n");
-                continue;
-            }
-
-            if(origin->GetEdge(destination)) {
-                printf(" An edge connecting two vertices was specified more than once."
-                       " It's likely that an incident face was flipped\n");
-                continue;
-            }
-        }
-
-        surface->NewFace(faceSize, fv, i);
-    }
-
-    surface->SetInterpolateBoundaryMethod( CatmarkMesh::k_InterpolateBoundaryEdgeOnly );
-
-    surface->Finish();
-
-    if(surface->GetNumDisconnectedVertices())
-    {
-        printf("The specified subdivmesh contains disconnected surface components.\n");
-
-        // abort or iterate over the mesh to remove the offending vertices
-    }
+    CatmarkMesh * surface = NewCatmarkSurface(params.numVertices, &pointPositions[0], params.numFaces, params.faceSizes, params.vertIndices);
 
 
 
@@ -1285,62 +1400,106 @@ void rib2mesh::handleCatmark(RtInt nf, RtInt nverts[],
 //    surface->SetInterpolateBoundaryMethod( CatmarkMesh::k_InterpolateBoundaryEdgeOnly );
 //    surface->Finish();
 
-    // ------ RESAMPLE THE SUBD INTO A MESH ------------------------------------------
-
+    // ------ RESAMPLE AND REFINE, NOW OR ON THE WORKER THREADS ---------------------
 
-    printf("Converting to mesh\n");
+    SurfaceJob job(surface, obj->_currentName, obj->cameraModel());
 
-    HbrMesh<VertexDataCatmark> * outputMesh = SurfaceToMesh(surface, obj->_subdivisionLevel, obj->cameraModel(), true);//, obj->_refinement != RF_FLOWTESS );
-
-    if (outputMesh == NULL) // entire object culled
+    if (obj->_numThreads > 1)
     {
-        printf(" *** ENTIRE OBJECT CLIPPED; IGNORING *** \n");
-        delete surface;
+        obj->_pendingSurfaces.push_back(job);
+        printf("QUEUED: %s\n\n", obj->_currentName);
         return;
     }
 
-    obj->_totalInputFaces += outputMesh->GetNumFaces();
+    obj->TessellateSurface(job);
 
-    // -------- REFINE CONTOUR, RESOLVE INCONSISTENCIES, ETC -------------------------
+    if (job.outputMesh != NULL)
+        obj->FinishSurface(job);
+}
 
-    if (obj->_refinement == RF_CONTOUR_ONLY || obj->_refinement == RF_FULL || obj->_refinement == RF_CONTOUR_INCONSISTENT)
-    {
-        printf("Refining contour\n");
 
-        RefineContour(outputMesh, obj->cameraModel().CameraCenter(), obj->_refinement, obj->_allowShifts, obj->_maxInconsistentSplits);
-    }
-    else if (obj->_refinement == RF_OPTIMIZE)
-    {
-        RefineContour(outputMesh, obj->cameraModel().CameraCenter(), RF_CONTOUR_ONLY, obj->_allowShifts, obj->_maxInconsistentSplits);
+void rib2mesh::TessellateSurface(SurfaceJob & job) const
+// resample a captured surface into a mesh and refine its contour.
+// touches no plugin state, so several surfaces can be processed concurrently.
+{
+    // ------ RESAMPLE THE SUBD INTO A MESH ------------------------------------------
 
-        OptimizeConsistency<VertexDataCatmark>(outputMesh, obj->cameraModel().CameraCenter(), OPT_LAMBDA, OPT_EPSILON);
+    printf("Converting to mesh: %s\n", job.name.c_str());
 
-        WiggleAllVertices<VertexDataCatmark>(outputMesh, obj->cameraModel().CameraCenter());
-    }
-    else if (obj->_refinement == RF_RADIAL)
+    StageTimer meshTimer("SurfaceToMesh");
+    HbrMesh<VertexDataCatmark> * outputMesh = SurfaceToMesh(job.surface, _subdivisionLevel, job.camera, true, _maxSubdivisionLevel);//, _refinement != RF_FLOWTESS );
+    meshTimer.Stop();
+
+    if (outputMesh == NULL) // entire object culled
     {
-        RefineContourRadial(outputMesh, obj->cameraModel().CameraCenter(), obj->_allowShifts, obj->_lastStep);
+        printf(" *** ENTIRE OBJECT CLIPPED; IGNORING *** \n");
+        Subdiv::Release(job.surface);
+        delete job.surface;
+        job.surface = NULL;
+        return;
     }
 
-    if (obj->_cullBackFaces)
+    job.inputFaces = outputMesh->GetNumFaces();
+
+    // -------- REFINE CONTOUR, RESOLVE INCONSISTENCIES, ETC -------------------------
+
+    RefineMesh(outputMesh, job.camera.CameraCenter(), _refinement, _allowShifts, _maxInconsistentSplits, _refinePatches, _lastStep);
+
+    if (_cullBackFaces)
     {
         printf("Culling backfaces\n");
         CullBackFaces<VertexDataCatmark>(outputMesh);
     }
 
-    obj->_totalOutputFaces += outputMesh->GetNumFaces();
-    ComputeConsistencyStats(outputMesh, obj->cameraModel().CameraCenter(), obj->_totalInconsistentFaces, obj->_totalStrongInconsistentFaces,
-                            obj->_totalNonRadialFaces, obj->_totalContourInconsistentFaces, obj->_totalRadialInconsistentFaces);
+    job.outputMesh = outputMesh;
+}
+
+
+void rib2mesh::FinishSurface(SurfaceJob & job)
+// gather the statistics of a refined surface, free its source surface, and keep it for output.  always called in stream order.
+{
+    HbrMesh<VertexDataCatmark> * outputMesh = job.outputMesh;
+
+    _totalInputFaces += job.inputFaces;
+    _totalOutputFaces += outputMesh->GetNumFaces();
+    ComputeConsistencyStats(outputMesh, job.camera.CameraCenter(), _totalInconsistentFaces, _totalStrongInconsistentFaces,
+                            _totalNonRadialFaces, _totalContourInconsistentFaces, _totalRadialInconsistentFaces);
 
 #ifdef LINK_FREESTYLE
     CreatePointDebuggingData<VertexDataCatmark>(outputMesh);
 #endif
 
-    delete surface;
+    // the refined mesh no longer needs the source surface or its evaluator
+    Subdiv::Release(job.surface);
+    delete job.surface;
+    job.surface = NULL;
 
-    obj->_outputMeshesCatmark.push_back(outputMesh);
+    _outputMeshesCatmark.push_back(outputMesh);
 
-    printf("DONE: %s\n\n",obj->_currentName);
+    printf("DONE: %s\n\n", job.name.c_str());
+}
+
+
+void rib2mesh::RefinePendingSurfaces()
+{
+    if (_pendingSurfaces.empty())
+        return;
+
+    int numSurfaces = (int)_pendingSurfaces.size();
+
+    printf("Refining %d queued surfaces on %d threads\n", numSurfaces, _numThreads);
+
+    // surfaces vary wildly in cost, so hand them out one at a time
+#pragma omp parallel for schedule(dynamic,1) num_threads(_numThreads)
+    for(int i=0;i<numSurfaces;i++)
+        TessellateSurface(_pendingSurfaces[i]);
+
+    // merge in stream order, so that the output does not depend on the thread scheduling
+    for(std::vector<SurfaceJob>::iterator it = _pendingSurfaces.begin(); it != _pendingSurfaces.end(); ++it)
+        if (it->outputMesh != NULL)
+            FinishSurface(*it);
+
+    _pendingSurfaces.clear();
 }
 
 
@@ -1357,10 +1516,35 @@ void run2(const char * meshFilename, const char * snapshotFilename,
           double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
           const char * pythonLibPath, bool saveLayers);
 
+void runBatch2(const char * meshFilename, const char * outputEPSPolyline, const char * outputEPSThick,
+               float worldTransform[16],
+               float left, float right, float bottom, float top,
+               float pixelaspect, float aspectratio,
+               float near, float far, float focalLength,
+               int outputWidthArg, int outputHeightArg,
+               int visAlgorithm, bool useConsistency,
+               double cuspTrimThreshold, double graftThreshold, double wiggleFactor,
+               const char * pythonLibPath, bool saveLayers);
+
 void addStyleFS(const char * styleFilename);
 
-void rib2mesh::runFreestyle()
+void setMeshFS(std::vector<double> & vertices, std::vector<double> & normals, std::vector<float> & vertexUserData,
+               std::vector<unsigned> & faces, std::vector<int> & faceUserData, bool meshSilhouettes);
+
+void setOccluderBVHFS(bool useBVH);
+
+void setCheckConcurrentLayersFS(bool check);
+
+void rib2mesh::runFreestyle(OutputMesh & mesh)
 {
+    StageTimer timer("Freestyle");
+
+    // hand the meshes over in memory, rather than having Freestyle parse the PLY file back. Freestyle takes the
+    // arrays over, so mesh is left empty
+    setMeshFS(mesh.positions, mesh.normals, mesh.vertexData, mesh.faces, mesh.faceFlags, _meshSilhouettes);
+    setOccluderBVHFS(_occluderBVH);
+    setCheckConcurrentLayersFS(_checkConcurrentLayers);
+
     // create a pointer to a 4x4 Matrix
     float camera[16];  // get from _cameraMatrix
 
@@ -1390,6 +1574,16 @@ void rib2mesh::runFreestyle()
         displayHeight = _yres;
     }
 
+    // headless runs need no window or OpenGL context, but density-based styles then read a blank canvas
+    if (_runFreestyleHeadless && !_runFreestyleInteractive)
+    {
+        runBatch2(_outputFilename, _outputEPSPolyline, _outputEPSThick, camera, _left, _right, _bottom, _top,
+                  _pixelaspect, _aspect, _near, _far, _focalLength, _xres, _yres, 0,
+                  _useConsistency && _refinement != RF_NONE, _cuspTrimThreshold, _graftThreshold, _wiggleFactor,
+                  _freestyleLibPath,_styleModules.size() > 1);
+        return;
+    }
+
     run2(_outputFilename, _outputImage, _outputEPSPolyline, _outputEPSThick, camera, _left, _right, _bottom, _top,
          _pixelaspect, _aspect, _near, _far, _focalLength, _xres, _yres, displayWidth, displayHeight, 0,
          _useConsistency && _refinement != RF_NONE, _runFreestyleInteractive, _cuspTrimThreshold, _graftThreshold, _wiggleFactor,
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <regex.h>
 
 #include <ri.h>
@@ -18,6 +19,33 @@ public:
     Attribute(bool orientation) { orientationOutside = orientation; }
 };
 
+// a subdivision surface captured from the RIB stream, waiting to be tessellated and refined
+struct SurfaceJob
+{
+    CatmarkMesh * surface;
+    std::string name;
+    CameraModel camera;
+    HbrMesh<VertexDataCatmark> * outputMesh; // NULL until refined, or if the surface was entirely clipped
+    int inputFaces;
+
+    SurfaceJob(CatmarkMesh * s, const char * n, const CameraModel & c) :
+        surface(s), name(n), camera(c), outputMesh(NULL), inputFaces(0) { }
+};
+
+// all the refined meshes, flattened into the arrays that go to the PLY file and to Freestyle
+struct OutputMesh
+{
+    std::vector<double> positions;   // x,y,z per vertex
+    std::vector<double> normals;     // nx,ny,nz per vertex
+    std::vector<float> colors;       // r,g,b per vertex (curvature coloring, PLY only)
+    std::vector<float> vertexData;   // per-vertex value read by Freestyle (scaled radial curvature)
+    std::vector<unsigned> faces;     // three vertex indices per triangle
+    std::vector<int> faceFlags;      // per-face vertex-based facing, +4 for radial faces on the contour
+
+    int NumVertices() const { return (int)positions.size()/3; }
+    int NumFaces() const { return (int)faces.size()/3; }
+};
+
 class rib2mesh : public RifPlugin
 { 
 public:
@@ -32,18 +60,30 @@ public:
     bool _allowShifts;
     bool _cullBackFaces;
     bool _meshSilhouettes;
+    bool _savePLY;   // write the output PLY file (Freestyle gets the meshes in memory either way)
+    bool _binaryPLY; // write it as binary PLY with double positions, rather than ASCII
+    bool _occluderBVH; // have Freestyle cast its visibility rays through a BVH rather than a grid
+    bool _checkConcurrentLayers; // have Freestyle also run its concurrent layers serially, and report the ones whose strokes differ
+    bool _refinePatches; // refine separate clusters of inconsistent faces concurrently (see RefineContour)
+    const char * _statsReport; // if not NULL, append the stage timings and counters of this frame to this file
+    int _maxSubdivisionLevel; // sample faces that are large in the image or crossed by the contour up to this level (see SampleLevels)
     int _maxInconsistentSplits;
     bool _useOrientation;
     bool _invertNormals;
     bool _useConsistency;
+    int _numThreads;  // > 1: queue the surfaces and refine them concurrently once the stream ends
 
     // meshes to save to the output file
     std::vector<HbrMesh<VertexDataCatmark>*> _outputMeshesCatmark;
 
+    // surfaces waiting to be refined, in stream order (only used when _numThreads > 1)
+    std::vector<SurfaceJob> _pendingSurfaces;
+
     // for running Freestyle from the RIF
     bool _runFreestyle;
     bool _runFreestyleInteractive;
     const char * _outputImage; // output TIFF file
+    bool _runFreestyleHeadless; // run Freestyle without a window or OpenGL context; no _outputImage, blank density canvas
     const char * _outputEPSPolyline;
     const char * _outputEPSThick;
     const char * _freestyleLibPath;
@@ -135,18 +175,24 @@ public:
     void extractCameraCenter();
 
 #ifdef LINK_FREESTYLE
-    void runFreestyle();
+    void runFreestyle(OutputMesh & mesh);  // hands the arrays of mesh over to Freestyle, leaving it empty
 #endif
 
-    int SavePLYFile();
+    void TessellateSurface(SurfaceJob & job) const;
+    void FinishSurface(SurfaceJob & job);
+    void RefinePendingSurfaces();
+
+    void CollectOutputMesh(OutputMesh & mesh) const;
+    void SavePLYFile(const OutputMesh & mesh) const;
 
     rib2mesh(const char* targetPattern, const char *outputFilename, const char * exclusionPattern,
           int subdivisionMeshV, double meshSmoothing, RefinementType refinement,
           int maxInconsistentSplits, bool allowShifts, int maxDisplayWidth, int maxDisplayHeight, bool useOrientation,
           bool invertNormals, bool cullBackFaces, bool meshSilhouettes, bool useConsistency,
           bool runFreestyle, bool runFreestyleInteractive, double cuspTrimThreshold, double graftThreshhold,  double wiggleFactor,
-          const char * outputTIFF, const char * outputEPSpolyline, const char * outputEPSthick,
-          const char * freestyleLibPath, RefineRadialStep lastStep);
+          const char * outputTIFF, bool runFreestyleHeadless, const char * outputEPSpolyline, const char * outputEPSthick,
+          const char * freestyleLibPath, RefineRadialStep lastStep, int numThreads, bool savePLY, bool binaryPLY, bool occluderBVH, bool checkConcurrentLayers, bool refinePatches, const char * statsReport,
+          int maxSubdivisionLevel);
     void addStyle(char * filename) { _styleModules.push_back(filename); }
     ~rib2mesh();
     RifFilter& GetFilter() { return _filter; }
@@ -0,0 +1,38 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+// per-stage timings and counters for the per-frame report.  they are collected by Freestyle's Stats (freestyle/system/Stats.h),
+// so that the tessellation and Freestyle stages end up in the same report; without Freestyle they are no-ops.
+
+#ifdef LINK_FREESTYLE
+double statsWallTimeFS();
+void statsAddTimeFS(const char * stage, double seconds);
+void statsAddCountFS(const char * stage, const char * counter, long long value);
+void statsWriteReportFS(const char * filename, const char * frame);
+#endif
+
+// adds the wall time between its construction and its destruction (or Stop()) to a stage
+class StageTimer
+{
+public:
+#ifdef LINK_FREESTYLE
+    StageTimer(const char * stage) : _stage(stage), _start(statsWallTimeFS()) { }
+    ~StageTimer() { Stop(); }
+    void Stop() { if (_stage != NULL) statsAddTimeFS(_stage, statsWallTimeFS() - _start); _stage = NULL; }
+private:
+    const char * _stage;
+    double _start;
+#else
+    StageTimer(const char * stage) { }
+    void Stop() { }
+#endif
+};
+
+inline void StageCount(const char * stage, const char * counter, long long value)
+{
+#ifdef LINK_FREESTYLE
+    statsAddCountFS(stage, counter, value);
+#endif
+}
+
+#endif
@@ -42,8 +42,7 @@ void Subdiv::getRefineTopology(OsdUtilSubdivTopology &refinedTopology, std::vect
 void Subdiv::Evaluate(OsdEvalCoords coord, vec3 *limitPos, vec3 *tanU, vec3 *tanV, mat2* I, mat2* II)
 {
     real P[3], dPdu[3], dPdv[3], dPdudu[3], dPdvdv[3], dPdudv[3];
-    assert(faceIndexMap.find(coord.face) != faceIndexMap.end());
-    coord.face = faceIndexMap[coord.face];
+    coord.face = EvalFaceIndex(coord.face);
     _adaptiveEvaluator.EvaluateLimit(coord, P, dPdu, dPdv, dPdudu, dPdvdv, dPdudv);
 
     limitPos->setX(P[0]);
@@ -64,15 +63,63 @@ void Subdiv::Evaluate(OsdEvalCoords coord, vec3 *limitPos, vec3 *tanU, vec3 *tan
     }
     if(I && II){
         assert(tanU!=0 && tanV!=0);
-        vec3 dudu = vec3(dPdudu[0], dPdudu[1], dPdudu[2]);
-        vec3 dvdv = vec3(dPdvdv[0], dPdvdv[1], dPdvdv[2]);
-        vec3 dudv = vec3(dPdudv[0], dPdudv[1], dPdudv[2]);
-
-        real xform[2][2] = { {(*tanU)*(*tanU), (*tanU)*(*tanV)}, {(*tanU)*(*tanV), (*tanV)*(*tanV)} };
-        I->Set(xform);
-        vec3 normal = (*tanU) ^ (*tanV);
-        normal.normalize();
-        real xform2[2][2] = { {dudu*normal, dudv*normal}, {dudv*normal, dvdv*normal} };
-        II->Set(xform2);
+        FundamentalForms(*tanU, *tanV, dPdudu, dPdvdv, dPdudv, I, II);
     }
 }
+
+void Subdiv::Evaluate(int numPoints, const OsdEvalCoords * coords, vec3 *limitPos, vec3 *tanU, vec3 *tanV, mat2* I, mat2* II)
+{
+    if (numPoints <= 0)
+        return;
+
+    bool derivs = (tanU || tanV || (I && II));
+    bool secondDerivs = (I && II);
+
+    std::vector<OsdEvalCoords> evalCoords(coords, coords + numPoints);
+    for(int i=0;i<numPoints;i++)
+        evalCoords[i].face = EvalFaceIndex(coords[i].face);
+
+    // structure-of-arrays results: three reals per point for each quantity
+    std::vector<real> P(3*numPoints);
+    std::vector<real> dPdu(derivs ? 3*numPoints : 0), dPdv(derivs ? 3*numPoints : 0);
+    std::vector<real> dPdudu(secondDerivs ? 3*numPoints : 0), dPdvdv(secondDerivs ? 3*numPoints : 0), dPdudv(secondDerivs ? 3*numPoints : 0);
+
+    _adaptiveEvaluator.EvaluateLimit(numPoints, &evalCoords[0], &P[0],
+                                     derivs ? &dPdu[0] : NULL, derivs ? &dPdv[0] : NULL,
+                                     secondDerivs ? &dPdudu[0] : NULL, secondDerivs ? &dPdvdv[0] : NULL, secondDerivs ? &dPdudv[0] : NULL);
+
+    for(int i=0;i<numPoints;i++)
+    {
+        limitPos[i] = vec3(P[3*i], P[3*i+1], P[3*i+2]);
+
+        assert(limitPos[i] * limitPos[i] > 0);
+
+        if (!derivs)
+            continue;
+
+        vec3 du(dPdu[3*i], dPdu[3*i+1], dPdu[3*i+2]);
+        vec3 dv(dPdv[3*i], dPdv[3*i+1], dPdv[3*i+2]);
+
+        if (tanU)
+            tanU[i] = du;
+        if (tanV)
+            tanV[i] = dv;
+        if (secondDerivs)
+            FundamentalForms(du, dv, &dPdudu[3*i], &dPdvdv[3*i], &dPdudv[3*i], &I[i], &II[i]);
+    }
+}
+
+void Subdiv::FundamentalForms(const vec3 & tanU, const vec3 & tanV, const real dPdudu[3], const real dPdvdv[3],
+                              const real dPdudv[3], mat2 * I, mat2 * II)
+{
+    vec3 dudu = vec3(dPdudu[0], dPdudu[1], dPdudu[2]);
+    vec3 dvdv = vec3(dPdvdv[0], dPdvdv[1], dPdvdv[2]);
+    vec3 dudv = vec3(dPdudv[0], dPdudv[1], dPdudv[2]);
+
+    real xform[2][2] = { {tanU*tanU, tanU*tanV}, {tanU*tanV, tanV*tanV} };
+    I->Set(xform);
+    vec3 normal = tanU ^ tanV;
+    normal.normalize();
+    real xform2[2][2] = { {dudu*normal, dudv*normal}, {dudv*normal, dvdv*normal} };
+    II->Set(xform2);
+}
@@ -4,18 +4,34 @@
 #include "VecMat.h"
 #include <osdutil/topology.h>
 #include <osdutil/adaptiveEvaluator.h>
+#include <hbr/mesh.h>
+#include <hbr/face.h>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+
+#ifdef _OPENMP
+# include <omp.h>
+#endif
 
 using namespace OpenSubdiv::OPENSUBDIV_VERSION;
 
 //------------------------------------------------------------------------------
 
+// data derived from the source mesh on demand and kept for the lifetime of the surface
+// (see ChartCache in chart.h). It lives with the Subdiv so that it is dropped with it.
+class SubdivCache {
+public:
+    virtual ~SubdivCache() {}
+};
+
+// limit-surface evaluator for a single subdivision surface.
+// SurfaceToMesh creates one per source mesh and attaches it as the mesh client data,
+// so that surfaces refined on different threads never share evaluator state.
 class Subdiv {
 public:
-    static Subdiv& getInstance()
-    {
-        static Subdiv instance;
-        return instance;
-    }
+    Subdiv() : chartCaches(MaxThreads(), (SubdivCache*)NULL) {}
+    ~Subdiv() { for(size_t i=0;i<chartCaches.size();i++) delete chartCaches[i]; }
 
     void initialize(const OsdUtilSubdivTopology &topology, const std::vector<real> &pointPositions);
 
@@ -23,9 +39,72 @@ public:
 
     void Evaluate(OsdEvalCoords coord, vec3 *limitPos, vec3 *tanU=NULL, vec3 *tanV=NULL, mat2* I=NULL, mat2* II=NULL);
 
-    std::map<int,int> faceIndexMap;
+    // evaluate numPoints independent points at once; coords use source-mesh face IDs, like the single-point version.
+    // the outputs are separate arrays of numPoints entries each, any of which (but limitPos) may be NULL.
+    void Evaluate(int numPoints, const OsdEvalCoords * coords, vec3 *limitPos, vec3 *tanU=NULL, vec3 *tanV=NULL,
+                  mat2* I=NULL, mat2* II=NULL);
+
+    // the evaluator of the surface that owns this face
+    template<class T>
+    static Subdiv & ForFace(const HbrFace<T> * face)
+    {
+        Subdiv * subdiv = static_cast<Subdiv*>(face->GetMesh()->GetClientData());
+        assert(subdiv != NULL);
+        return *subdiv;
+    }
+
+    template<class T>
+    static void Attach(HbrMesh<T> * mesh, Subdiv * subdiv)
+    {
+        Release(mesh);
+        mesh->SetClientData(subdiv);
+    }
+
+    template<class T>
+    static void Release(HbrMesh<T> * mesh)
+    {
+        delete static_cast<Subdiv*>(mesh->GetClientData());
+        mesh->SetClientData(NULL);
+    }
+
+    // the evaluator of the surface that owns this vertex
+    template<class T>
+    static Subdiv & ForVertex(const HbrVertex<T> * vertex)
+    {
+        Subdiv * subdiv = static_cast<Subdiv*>(vertex->GetMesh()->GetClientData());
+        assert(subdiv != NULL);
+        return *subdiv;
+    }
+
+    // source-mesh face ID -> face index in the evaluator topology, -1 for faces that are not in it
+    std::vector<int> faceIndexMap;
+
+    // vertex charts of the source mesh, one cache per thread (patches of a surface may be refined
+    // concurrently), each created by the first ChartCache<T>::ForVertex call on its thread
+    std::vector<SubdivCache*> chartCaches;
+
+    // enough for the threads of the current team (surfaces are refined concurrently by rib2mesh)
+    // and for those of a parallel region started from here
+    static int MaxThreads()
+    {
+#ifdef _OPENMP
+        return std::max(omp_get_max_threads(), omp_get_num_threads());
+#else
+        return 1;
+#endif
+    }
 private:
-    Subdiv() {}
+    int EvalFaceIndex(int sourceFace) const
+    {
+        assert(sourceFace >= 0 && sourceFace < (int)faceIndexMap.size() && faceIndexMap[sourceFace] != -1);
+        return faceIndexMap[sourceFace];
+    }
+
+    static void FundamentalForms(const vec3 & tanU, const vec3 & tanV, const real dPdudu[3], const real dPdvdv[3],
+                                 const real dPdudv[3], mat2 * I, mat2 * II);
+
+    Subdiv(const Subdiv &);
+    Subdiv & operator=(const Subdiv &);
 
     OsdUtilAdaptiveEvaluator _adaptiveEvaluator;
 };
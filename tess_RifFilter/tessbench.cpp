@@ -0,0 +1,556 @@
+// Standalone driver for the tessellator: reads a Catmull-Clark control mesh (OBJ) and a camera path, and runs
+// SurfaceToMesh and each requested refinement for every camera, reporting timings, face counts and consistency stats.
+// Needs neither RenderMan nor Freestyle, so it can be used for profiling and benchmarking on any machine.
+//
+// usage: tessbench [options] mesh.obj cameras.cam
+//
+// With -maxSubdivLevel n (above -subdivLevel), faces that are large in the image or crossed by the contour are
+// sampled finer, up to level n (see SampleLevels).
+//
+// With -coherent True, the surface is sampled once and its sample copied for the following runs, as long as the
+// levels and view-frustum tests give the same result (see SampleCoherent); the SurfaceToMesh time is then that of the copy.
+//
+// The report lists the operations of the contour refinement. Running the same scene with -refinePatches False and
+// True (and -numThreads above 1) compares the concurrent patches with the serial loop: see RefineContour for when
+// they may differ.
+//
+// The camera file holds one command per line ('#' starts a comment). Each Camera or LookAt command is one frame
+// of the path, seen with the Format, ScreenWindow, Clipping and Projection settings that precede it:
+//
+//   Format xres yres
+//   ScreenWindow left right bottom top   (default: from the Format aspect ratio, as in RenderMan)
+//   Clipping near far
+//   Projection fov                       (perspective field of view, in degrees)
+//   Camera m00 m01 ... m33               (world-to-camera matrix, in RIB Transform order)
+//   LookAt eyeX eyeY eyeZ  targetX targetY targetZ  upX upY upZ
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "refineContour.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+struct BenchCamera
+{
+    mat4 cameraMatrix;
+    float xres, yres;
+    float left, right, bottom, top;
+    float near, far;
+    float focalLength;
+
+    CameraModel Model()
+    {
+        // camera center from the camera matrix [R t; 0 1], as in rib2mesh::extractCameraCenter
+        vec3 center;
+        for(int i=0;i<3;i++)
+            center[i] = -cameraMatrix[i][0] * cameraMatrix[3][0] - cameraMatrix[i][1] * cameraMatrix[3][1] - cameraMatrix[i][2] * cameraMatrix[3][2];
+
+        return CameraModel(cameraMatrix, near, far, left, right, top, bottom, xres, yres, focalLength, center);
+    }
+};
+
+struct BenchMesh
+{
+    vector<real> positions;
+    vector<int> faceSizes;
+    vector<int> vertIndices;
+
+    int NumVertices() const { return int(positions.size()/3); }
+    int NumFaces() const { return int(faceSizes.size()); }
+};
+
+static double WallTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+static const char * RefinementName(RefinementType refinement)
+{
+    switch(refinement)
+    {
+    case RF_NONE: return "None";
+    case RF_CONTOUR_ONLY: return "ContourOnly";
+    case RF_CONTOUR_INCONSISTENT: return "ContourInconsistent";
+    case RF_FULL: return "Full";
+    case RF_OPTIMIZE: return "Optimize";
+    case RF_RADIAL: return "Radial";
+    }
+    return "?";
+}
+
+static bool ParseRefinement(const char * str, RefinementType & refinement)
+{
+    const RefinementType all[] = { RF_NONE, RF_CONTOUR_ONLY, RF_CONTOUR_INCONSISTENT, RF_FULL, RF_OPTIMIZE, RF_RADIAL };
+    for(int i=0;i<6;i++)
+        if (strcmp(str, RefinementName(all[i])) == 0)
+        {
+            refinement = all[i];
+            return true;
+        }
+    return false;
+}
+
+// reads the vertices and the faces of an OBJ file; everything else (normals, texture coordinates, groups) is ignored
+static void LoadOBJ(const char * filename, bool invertNormals, BenchMesh & mesh)
+{
+    FILE * fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        printf("ERROR: CAN'T OPEN MESH FILE %s\n", filename);
+        exit(1);
+    }
+
+    char line[4096];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNumber++;
+
+        if (line[0] == 'v' && line[1] == ' ')
+        {
+            double x, y, z;
+            if (sscanf(line+2, "%lf %lf %lf", &x, &y, &z) != 3)
+            {
+                printf("ERROR: %s:%d: bad vertex\n", filename, lineNumber);
+                exit(1);
+            }
+            mesh.positions.push_back(x);
+            mesh.positions.push_back(y);
+            mesh.positions.push_back(z);
+        }
+        else if (line[0] == 'f' && line[1] == ' ')
+        {
+            vector<int> face;
+            for(char * tok = strtok(line+2, " \t\r\n"); tok != NULL; tok = strtok(NULL, " \t\r\n"))
+            {
+                int index = atoi(tok);  // stops at the texture/normal indices of "v/vt/vn"
+                if (index < 0)
+                    index += mesh.NumVertices();
+                else
+                    index--;
+                if (index < 0 || index >= mesh.NumVertices())
+                {
+                    printf("ERROR: %s:%d: bad vertex index %s\n", filename, lineNumber, tok);
+                    exit(1);
+                }
+                face.push_back(index);
+            }
+            if (face.size() < 3)
+            {
+                printf("ERROR: %s:%d: face with less than 3 vertices\n", filename, lineNumber);
+                exit(1);
+            }
+
+            // flip the face, as the RIF does for RenderMan's "inside" orientation
+            if (invertNormals)
+                reverse(face.begin(), face.end());
+
+            mesh.faceSizes.push_back(int(face.size()));
+            mesh.vertIndices.insert(mesh.vertIndices.end(), face.begin(), face.end());
+        }
+    }
+
+    fclose(fp);
+
+    if (mesh.NumFaces() == 0)
+    {
+        printf("ERROR: NO FACES IN %s\n", filename);
+        exit(1);
+    }
+
+    // the RIF only tessellates Catmull-Clark meshes that are not pure triangle meshes
+    if (count(mesh.faceSizes.begin(), mesh.faceSizes.end(), 3) == mesh.NumFaces())
+    {
+        printf("ERROR: %s IS A TRIANGLE MESH; A CATMULL-CLARK CONTROL MESH IS NEEDED\n", filename);
+        exit(1);
+    }
+
+    printf("Mesh %s: %d vertices, %d faces\n", filename, mesh.NumVertices(), mesh.NumFaces());
+}
+
+// world-to-camera matrix for a camera at eye looking at target, in the RenderMan convention (x right, y up, z forward)
+static mat4 LookAt(const vec3 & eye, const vec3 & target, const vec3 & up)
+{
+    vec3 axes[3];
+    axes[2] = target - eye;
+    axes[2].normalize();
+    axes[0] = axes[2] ^ up;
+    axes[0].normalize();
+    axes[1] = axes[0] ^ axes[2];
+
+    mat4 m;
+    m.SetIdentity();
+    for(int j=0;j<3;j++)
+    {
+        for(int i=0;i<3;i++)
+            m[i][j] = axes[j][i];
+        m[3][j] = -(axes[j] * eye);
+    }
+    return m;
+}
+
+static void LoadCameras(const char * filename, vector<BenchCamera> & cameras)
+{
+    FILE * fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        printf("ERROR: CAN'T OPEN CAMERA FILE %s\n", filename);
+        exit(1);
+    }
+
+    BenchCamera current;
+    current.cameraMatrix.SetIdentity();
+    current.xres = 640;
+    current.yres = 480;
+    current.near = 0.1;
+    current.far = 1000;
+    current.focalLength = 1;
+    bool screenWindowSet = false;
+
+    char line[4096];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        lineNumber++;
+
+        char * comment = strchr(line, '#');
+        if (comment != NULL)
+            *comment = '\0';
+
+        char command[64];
+        int offset = 0;
+        if (sscanf(line, "%63s%n", command, &offset) != 1)
+            continue;
+        const char * args = line + offset;
+
+        double v[16];
+        bool ok = true;
+
+        if (strcmp(command, "Format") == 0)
+        {
+            ok = (sscanf(args, "%lf %lf", &v[0], &v[1]) == 2);
+            current.xres = v[0];
+            current.yres = v[1];
+        }
+        else if (strcmp(command, "ScreenWindow") == 0)
+        {
+            ok = (sscanf(args, "%lf %lf %lf %lf", &v[0], &v[1], &v[2], &v[3]) == 4);
+            current.left = v[0];
+            current.right = v[1];
+            current.bottom = v[2];
+            current.top = v[3];
+            screenWindowSet = true;
+        }
+        else if (strcmp(command, "Clipping") == 0)
+        {
+            ok = (sscanf(args, "%lf %lf", &v[0], &v[1]) == 2);
+            current.near = v[0];
+            current.far = v[1];
+        }
+        else if (strcmp(command, "Projection") == 0)
+        {
+            ok = (sscanf(args, "%lf", &v[0]) == 1);
+            current.focalLength = 1/ tan((v[0]/2)*(M_PI/180));
+        }
+        else if (strcmp(command, "Camera") == 0)
+        {
+            ok = (sscanf(args, "%lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                         &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7],
+                         &v[8], &v[9], &v[10], &v[11], &v[12], &v[13], &v[14], &v[15]) == 16);
+            for(int i=0;i<4;i++)
+                for(int j=0;j<4;j++)
+                    current.cameraMatrix[i][j] = v[4*i+j];
+        }
+        else if (strcmp(command, "LookAt") == 0)
+        {
+            ok = (sscanf(args, "%lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                         &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]) == 9);
+            current.cameraMatrix = LookAt(vec3(v[0],v[1],v[2]), vec3(v[3],v[4],v[5]), vec3(v[6],v[7],v[8]));
+        }
+        else
+        {
+            printf("ERROR: %s:%d: unknown command %s\n", filename, lineNumber, command);
+            exit(1);
+        }
+
+        if (!ok)
+        {
+            printf("ERROR: %s:%d: bad arguments for %s\n", filename, lineNumber, command);
+            exit(1);
+        }
+
+        if (strcmp(command, "Camera") == 0 || strcmp(command, "LookAt") == 0)
+        {
+            BenchCamera camera = current;
+            if (!screenWindowSet)
+            {
+                // RenderMan's default screen window
+                float aspect = current.xres / current.yres;
+                camera.left = aspect >= 1 ? -aspect : -1;
+                camera.right = aspect >= 1 ? aspect : 1;
+                camera.bottom = aspect >= 1 ? -1 : -1/aspect;
+                camera.top = aspect >= 1 ? 1 : 1/aspect;
+            }
+            cameras.push_back(camera);
+        }
+    }
+
+    fclose(fp);
+
+    if (cameras.empty())
+    {
+        printf("ERROR: NO CAMERAS IN %s\n", filename);
+        exit(1);
+    }
+}
+
+struct BenchResult
+{
+    int inputFaces;
+    int outputFaces;
+    int numInconsistent;
+    int numStrongInconsistent;
+    int numNonRadial;
+    int numInconsistentContour;
+    int numInconsistentRadial;
+    bool reused;  // the sample of an earlier run was copied (-coherent)
+    RefineCounters counters;
+    double meshSeconds;
+    double refineSeconds;
+    double statsSeconds;
+
+    BenchResult() : inputFaces(0), outputFaces(0), numInconsistent(0), numStrongInconsistent(0), numNonRadial(0),
+        numInconsistentContour(0), numInconsistentRadial(0), reused(false), meshSeconds(0), refineSeconds(0), statsSeconds(0) { }
+};
+
+static void WriteReport(FILE * fp, const char * meshFilename, const char * cameraFilename, int frame,
+                        RefinementType refinement, int subdivisionLevel, int maxSubdivisionLevel, bool refinePatches, const BenchResult & r)
+{
+    fprintf(fp, "{\"mesh\": \"%s\", \"cameras\": \"%s\", \"frame\": %d, \"refinement\": \"%s\", \"subdivLevel\": %d, "
+            "\"maxSubdivLevel\": %d, \"refinePatches\": %s, ", meshFilename, cameraFilename, frame, RefinementName(refinement), subdivisionLevel,
+            std::max(subdivisionLevel, maxSubdivisionLevel), refinePatches ? "true" : "false");
+    fprintf(fp, "\"inputFaces\": %d, \"outputFaces\": %d, \"inconsistentFaces\": %d, \"inconsistentContourFaces\": %d, "
+            "\"inconsistentRadialFaces\": %d, \"nonRadialFaces\": %d, \"reused\": %s, ",
+            r.inputFaces, r.outputFaces, r.numInconsistent, r.numInconsistentContour, r.numInconsistentRadial, r.numNonRadial,
+            r.reused ? "true" : "false");
+    fprintf(fp, "\"operations\": {\"zeroCrossingSplits\": %d, \"flips\": %d, \"splits\": %d, \"wiggles\": %d}, ",
+            r.counters.numZCs, r.counters.numFlips, r.counters.numSplits, r.counters.numWiggles);
+    fprintf(fp, "\"seconds\": {\"SurfaceToMesh\": %.6f, \"Refine\": %.6f, \"ComputeConsistencyStats\": %.6f}}\n",
+            r.meshSeconds, r.refineSeconds, r.statsSeconds);
+}
+
+int main(int argc, char ** argv)
+{
+    int subdivisionLevel = 1;
+    int maxSubdivisionLevel = -1;
+    vector<RefinementType> refinements;
+    RefineRadialStep lastStep = EVERYTHING;
+    bool allowShifts = false;
+    int maxInconsistentSplits = -1;
+    bool refinePatches = false;
+    bool invertNormals = false;
+    bool coherent = false;
+    int numThreads = 0;
+    const char * reportFilename = NULL;
+    vector<const char*> files;
+
+    int i = 1;
+    while (i<argc)
+    {
+        if (argv[i][0] != '-')
+        {
+            files.push_back(argv[i]);
+            i++;
+            continue;
+        }
+
+        if (i+1 >= argc)
+        {
+            printf("TESSBENCH: MISSING VALUE FOR %s\n", argv[i]);
+            exit(1);
+        }
+
+        if (strcmp(argv[i],"-subdivLevel") == 0)
+            subdivisionLevel = atoi(argv[i+1]);
+        else if (strcmp(argv[i],"-maxSubdivLevel") == 0)
+            maxSubdivisionLevel = atoi(argv[i+1]);
+        else if (strcmp(argv[i],"-refinement") == 0)
+        {
+            RefinementType refinement;
+            if (!ParseRefinement(argv[i+1], refinement))
+            {
+                printf("Invalid refinement type %s\n", argv[i+1]);
+                exit(1);
+            }
+            refinements.push_back(refinement);
+        }
+        else if (strcmp(argv[i],"-allowShifts") == 0)
+            allowShifts = (strcmp(argv[i+1],"False") != 0);
+        else if (strcmp(argv[i],"-maxInconsistentSplits") == 0)
+            maxInconsistentSplits = atoi(argv[i+1]);
+        else if (strcmp(argv[i],"-refinePatches") == 0)
+            refinePatches = (strcmp(argv[i+1],"False") != 0);
+        else if (strcmp(argv[i],"-invertNormals") == 0)
+            invertNormals = (strcmp(argv[i+1],"False") != 0);
+        else if (strcmp(argv[i],"-coherent") == 0)
+            coherent = (strcmp(argv[i+1],"False") != 0);
+        else if (strcmp(argv[i],"-numThreads") == 0)
+            numThreads = atoi(argv[i+1]);
+        else if (strcmp(argv[i],"-report") == 0)
+            reportFilename = argv[i+1];
+        else
+        {
+            printf("TESSBENCH: INVALID COMMAND-LINE (i=%d, argv[i] = %s)\n",i,argv[i]);
+            exit(1);
+        }
+        i+=2;
+    }
+
+    if (files.size() != 2)
+    {
+        printf("usage: %s [-subdivLevel n] [-maxSubdivLevel n] [-refinement None|ContourOnly|ContourInconsistent|Full|Optimize|Radial]...\n"
+               "       [-allowShifts True|False] [-maxInconsistentSplits n] [-refinePatches True|False]\n"
+               "       [-invertNormals True|False] [-coherent True|False] [-numThreads n] [-report file.jsonl] mesh.obj cameras.cam\n", argv[0]);
+        exit(1);
+    }
+
+    // all refinement types by default
+    if (refinements.empty())
+        for(int r=RF_NONE;r<=RF_RADIAL;r++)
+            refinements.push_back(RefinementType(r));
+
+#ifdef _OPENMP
+    if (numThreads > 0)
+        omp_set_num_threads(numThreads);
+#endif
+
+    const char * meshFilename = files[0];
+    const char * cameraFilename = files[1];
+
+    BenchMesh benchMesh;
+    LoadOBJ(meshFilename, invertNormals, benchMesh);
+
+    vector<BenchCamera> cameras;
+    LoadCameras(cameraFilename, cameras);
+
+    FILE * report = NULL;
+    if (reportFilename != NULL)
+    {
+        report = fopen(reportFilename, "a");
+        if (report == NULL)
+        {
+            printf("ERROR: CAN'T OPEN REPORT FILE %s\n", reportFilename);
+            exit(1);
+        }
+    }
+
+    vector<BenchResult> totals(refinements.size());
+
+    // with -coherent, all the runs share one surface and its sample
+    CatmarkMesh * coherentSurface = NULL;
+    CoherentMesh coherentMesh;
+
+    for(int frame=0;frame<(int)cameras.size();frame++)
+    {
+        CameraModel camera = cameras[frame].Model();
+
+        for(int r=0;r<(int)refinements.size();r++)
+        {
+            printf("\n==== frame %d, refinement %s ====\n", frame, RefinementName(refinements[r]));
+
+            BenchResult result;
+
+            // SurfaceToMesh subdivides the surface in place, so each run starts from a new one
+            CatmarkMesh * surface = coherentSurface;
+            if (surface == NULL)
+                surface = NewCatmarkSurface(benchMesh.NumVertices(), &benchMesh.positions[0], benchMesh.NumFaces(),
+                                            &benchMesh.faceSizes[0], &benchMesh.vertIndices[0]);
+
+            double start = WallTime();
+            HbrMesh<VertexDataCatmark> * mesh;
+            if (coherent)
+                mesh = SampleCoherent(coherentMesh, surface, subdivisionLevel, maxSubdivisionLevel, camera, result.reused);
+            else
+                mesh = SurfaceToMesh(surface, subdivisionLevel, camera, true, maxSubdivisionLevel);
+            result.meshSeconds = WallTime() - start;
+
+            if (mesh == NULL)
+                printf(" *** ENTIRE OBJECT CLIPPED *** \n");
+            else
+            {
+                result.inputFaces = mesh->GetNumFaces();
+
+                start = WallTime();
+                RefineMesh(mesh, camera.CameraCenter(), refinements[r], allowShifts, maxInconsistentSplits, refinePatches, lastStep,
+                           &result.counters);
+                result.refineSeconds = WallTime() - start;
+
+                result.outputFaces = mesh->GetNumFaces();
+
+                start = WallTime();
+                ComputeConsistencyStats(mesh, camera.CameraCenter(), result.numInconsistent, result.numStrongInconsistent,
+                                        result.numNonRadial, result.numInconsistentContour, result.numInconsistentRadial);
+                result.statsSeconds = WallTime() - start;
+
+                VertexProvenanceTable::Release(mesh);
+                delete mesh;
+            }
+
+            if (coherent)
+                coherentSurface = surface;
+            else
+            {
+                Subdiv::Release(surface);
+                delete surface;
+            }
+
+            printf("\nBENCH: frame %d %s%s: input faces %d, output faces %d, inconsistent %d (contour %d, radial %d), non-radial %d. "
+                   "SurfaceToMesh %.3fs, refinement %.3fs, stats %.3fs\n",
+                   frame, RefinementName(refinements[r]), result.reused ? " (reused)" : "", result.inputFaces, result.outputFaces, result.numInconsistent,
+                   result.numInconsistentContour, result.numInconsistentRadial, result.numNonRadial,
+                   result.meshSeconds, result.refineSeconds, result.statsSeconds);
+
+            if (report != NULL)
+                WriteReport(report, meshFilename, cameraFilename, frame, refinements[r], subdivisionLevel, maxSubdivisionLevel, refinePatches, result);
+
+            BenchResult & total = totals[r];
+            total.inputFaces += result.inputFaces;
+            total.outputFaces += result.outputFaces;
+            total.numInconsistent += result.numInconsistent;
+            total.meshSeconds += result.meshSeconds;
+            total.refineSeconds += result.refineSeconds;
+            total.statsSeconds += result.statsSeconds;
+        }
+    }
+
+    coherentMesh.Release();
+    if (coherentSurface != NULL)
+    {
+        Subdiv::Release(coherentSurface);
+        delete coherentSurface;
+    }
+
+    if (report != NULL)
+        fclose(report);
+
+    printf("\n%s, %d cameras\n", meshFilename, (int)cameras.size());
+    printf("%-20s %12s %12s %12s %12s %12s\n", "refinement", "out faces", "inconsistent", "mesh (s)", "refine (s)", "stats (s)");
+    for(int r=0;r<(int)refinements.size();r++)
+        printf("%-20s %12d %12d %12.3f %12.3f %12.3f\n", RefinementName(refinements[r]), totals[r].outputFaces,
+               totals[r].numInconsistent, totals[r].meshSeconds, totals[r].refineSeconds, totals[r].statsSeconds);
+
+    return 0;
+}
@@ -54,22 +54,22 @@ ParamPointCC RootFindContour(RootFindMode mode,
     real lengths[3];
 
     for(int i=0; i<3; i++){
-        lengths[i] = sqrtl((abs[i][0] - abs[(i+1)%3][0])*(abs[i][0] - abs[(i+1)%3][0]) +
+        lengths[i] = sqrt((abs[i][0] - abs[(i+1)%3][0])*(abs[i][0] - abs[(i+1)%3][0]) +
                            (abs[i][1] - abs[(i+1)%3][1])*(abs[i][1] - abs[(i+1)%3][1]));
     }
 
     real halfp = real(0.5) * (lengths[0] + lengths[1] + lengths[2]);
-    real area = sqrtl(halfp*(halfp-lengths[0])*(halfp-lengths[1])*(halfp-lengths[2]));
+    real area = sqrt(halfp*(halfp-lengths[0])*(halfp-lengths[1])*(halfp-lengths[2]));
 
     const real threshold_r = mode == RF_CUSP ? 1e-6 : 0.00001;
     const real threshold_ndotv = mode != RF_RADIAL_INT ? CONTOUR_THRESHOLD : threshold_r;
 
-    if(fabsl(ndotv[0]) <= threshold_ndotv &&
-            fabsl(ndotv[1]) <= threshold_ndotv &&
-            fabsl(ndotv[2]) <= threshold_ndotv &&
-            fabsl(r[0]) <= threshold_r &&
-            fabsl(r[1]) <= threshold_r &&
-            fabsl(r[2]) <= threshold_r ){
+    if(fabs(ndotv[0]) <= threshold_ndotv &&
+            fabs(ndotv[1]) <= threshold_ndotv &&
+            fabs(ndotv[2]) <= threshold_ndotv &&
+            fabs(r[0]) <= threshold_r &&
+            fabs(r[1]) <= threshold_r &&
+            fabs(r[2]) <= threshold_r ){
         ParamPointCC res =  ParamPointCC::Interpolate(ParamPointCC::Interpolate(p[0], p[1], 0.5), p[2], 1.0/3);
         return res;
     }
@@ -250,7 +250,7 @@ bool ExtendRadialEdge(MeshFace *face, Mesh *mesh, const vec3 & cameraCenter,
     for(int i=0; i<3; i++){
         MeshVertex *v0 = face->GetVertex(i);
 
-        if(!v0->GetData().Radial() || (v0->GetData().Radial() && v0->GetData().radialOrg[0]->GetData().cusp))
+        if(!v0->GetData().Radial() || (v0->GetData().Radial() && v0->GetData().RadialOrg(0)->GetData().cusp))
             continue;
 
         MeshVertex *v1 = face->GetVertex((i+1)%3);
@@ -273,7 +273,7 @@ bool ExtendRadialEdge(MeshFace *face, Mesh *mesh, const vec3 & cameraCenter,
             continue;
 
         for(int k=0; k<v0->GetData().NumRadialOrg(); k++){
-            MeshVertex* cpt = v0->GetData().radialOrg[k];
+            MeshVertex* cpt = v0->GetData().RadialOrg(k);
 
             if(cpt==v1 || cpt==v2 || cpt==v3)
                 continue;
@@ -408,9 +408,8 @@ bool ExtendRadialEdge(MeshFace *face, Mesh *mesh, const vec3 & cameraCenter,
                     mesh->DeleteFace(adjacentFace);
                 }
 
-                v0->GetData().isShifted = true;
-                if(v0->GetData().origLoc.IsNull())
-                    v0->GetData().origLoc = v0->GetData().sourceLoc;
+                if(VertexProvenanceTable::Row(mesh, v0).origLoc.IsNull())
+                    VertexProvenanceTable::Row(mesh, v0).origLoc = v0->GetData().sourceLoc;
                 SetupVertex(v0->GetData(),bestLoc,cameraCenter);
 
                 if(v3 && !v0->GetEdge(v3) && !v3->GetEdge(v0)){
@@ -419,6 +418,7 @@ bool ExtendRadialEdge(MeshFace *face, Mesh *mesh, const vec3 & cameraCenter,
 #ifdef LINK_FREESTYLE
                             char str[200];
                             sprintf(str, "BUG");
+#pragma omp critical(rifDebugPoint)
                             addRIFDebugPoint(-1,double(v0->GetData().pos[0]),double(v0->GetData().pos[1]),double(v0->GetData().pos[2]),str,0);
 #endif
 #ifdef VERBOSE
@@ -439,6 +439,7 @@ bool ExtendRadialEdge(MeshFace *face, Mesh *mesh, const vec3 & cameraCenter,
 #ifdef LINK_FREESTYLE
                     char str[200];
                     sprintf(str, "v3");
+#pragma omp critical(rifDebugPoint)
                     addRIFDebugPoint(-1,double(v0->GetData().pos[0]),double(v0->GetData().pos[1]),double(v0->GetData().pos[2]),str,0);
 #endif
                     printf("\n  \n");
@@ -572,11 +573,14 @@ bool FlipAllowed(MeshVertex* v0, MeshVertex* v1, MeshVertex* v2, MeshVertex* v3,
 #ifdef LINK_FREESTYLE
             char str[200];
             sprintf(str, "v2");
+#pragma omp critical(rifDebugPoint)
+            {
             addRIFDebugPoint(-1, double(v2->GetData().pos[0]), double(v2->GetData().pos[1]), double(v2->GetData().pos[2]), str, NULL);
             sprintf(str, "v0");
             addRIFDebugPoint(-1, double(v0->GetData().pos[0]), double(v0->GetData().pos[1]), double(v0->GetData().pos[2]), str, NULL);
             sprintf(str, "v3");
             addRIFDebugPoint(-1, double(v3->GetData().pos[0]), double(v3->GetData().pos[1]), double(v3->GetData().pos[2]), str, NULL);
+            }
 #endif
             nonRadialFaces.Remove(adj1);
             wiggleQueue.Remove(adj1);
@@ -665,9 +669,12 @@ bool ImproveRadialConsistency(MeshVertex *cpt, Mesh *mesh, int & numFlip, Priori
 #ifdef LINK_FREESTYLE
                         char str[200];
                         sprintf(str, "v0");
+#pragma omp critical(rifDebugPoint)
+                        {
                         addRIFDebugPoint(-1, double(v0->GetData().pos[0]), double(v0->GetData().pos[1]), double(v0->GetData().pos[2]), str, 0);
                         sprintf(str, "v3");
                         addRIFDebugPoint(-1, double(v3->GetData().pos[0]), double(v3->GetData().pos[1]), double(v3->GetData().pos[2]), str, 0);
+                        }
 #endif
                         continue;
                     }
@@ -731,13 +738,13 @@ MeshVertex* SplitFace(MeshFace * face, Mesh * mesh,
     for(int i=0; i<3; i++){
         v[i] = face->GetVertex(i);
         for(int j=0; j<v[i]->GetData().NumRadialOrg(); j++)
-            v[i]->GetData().radialOrg[j] = NULL;
+            v[i]->GetData().provenance->radialOrg[j] = NULL;
     }
 
     MeshVertex* newV = mesh->NewVertex();
     SetupVertex(newV->GetData(),splitPointParam,cameraCenter);
     if(radialOrg)
-        newV->GetData().AddRadialOrg(radialOrg);
+        AddRadialOrg(mesh, newV, radialOrg);
 
     std::list<MeshFace*> f;
     bool skip[3] = {false, false, false};
@@ -1056,7 +1063,7 @@ bool InsertRadialEdge(MeshVertex* v0, MeshVertex* v1, MeshVertex* v2, const vec3
         if(!newPosParam.IsNull() && newPosParam.IsEvaluable()){
             printf("FOUND\n");
             MeshVertex* newV = SplitFace(face,mesh,newPosParam,cameraCenter,wiggleQueue,splitQueue,v0,false);
-            newV->GetData().AddRadialOrg(v1);
+            AddRadialOrg(mesh, newV, v1);
             return true;
         }else{
             printf("NOT FOUND\n");
@@ -1287,7 +1294,7 @@ bool InsertSmoothCusp(MeshFace * face, Mesh * mesh,const vec3 & cameraCenter, bo
                     if(!cuspParam.IsNull() && cuspParam.IsEvaluable()){
                         real r;
                         bool success = cuspParam.RadialCurvature(cameraCenter,r);
-                        if(Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD)!=CONTOUR || !success || fabsl(r)>0.01)
+                        if(Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD)!=CONTOUR || !success || fabs(r)>0.01)
                             return false;
 
                         MeshVertex* cPts[2]  = {NULL, NULL};
@@ -1319,6 +1326,7 @@ bool InsertSmoothCusp(MeshFace * face, Mesh * mesh,const vec3 & cameraCenter, bo
                         success = newV->GetData().sourceLoc.RadialCurvature(cameraCenter,r);
                         Facing(newV->GetData().sourceLoc,cameraCenter,CONTOUR_THRESHOLD,&ndotv);
                         sprintf(str, "SMOOTH CUSP POST (n.v=%.10f, r=%.10f, success=%d)",double(ndotv),double(r),success);
+#pragma omp critical(rifDebugPoint)
                         addRIFDebugPoint(3, double(newV->GetData().pos[0]), double(newV->GetData().pos[1]), double(newV->GetData().pos[2]), str, 0);
 #endif
                         return true;
@@ -1530,7 +1538,7 @@ bool InsertSmoothCuspFirst(MeshFace* face, Mesh* mesh, const vec3 & cameraCenter
     if(!cuspParam.IsNull()){
         real r;
         bool success = cuspParam.RadialCurvature(cameraCenter,r);
-        if(Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD)!=CONTOUR || !success || fabsl(r)>0.01){
+        if(Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD)!=CONTOUR || !success || fabs(r)>0.01){
             printf("\nSPURIOUS CUSP\n");
 #if LINK_FREESTYLE
             char str[200];
@@ -1539,6 +1547,7 @@ bool InsertSmoothCuspFirst(MeshFace* face, Mesh* mesh, const vec3 & cameraCenter
             bool success = cuspParam.RadialCurvature(cameraCenter,r);
             Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD,&ndotv);
             sprintf(str, "SPURIOUS CUSP (n.v=%.10f, r=%.10f, success=%d)",double(ndotv),double(r),success);
+#pragma omp critical(rifDebugPoint)
             addRIFDebugPoint(-1, double(limitPos[0][0]), double(limitPos[0][1]), double(limitPos[0][2]), str, 0);
 #endif
             return false;
@@ -1566,7 +1575,7 @@ bool InsertSmoothCuspFirst(MeshFace* face, Mesh* mesh, const vec3 & cameraCenter
             pts.push_back(v0->GetData().sourceLoc);
             pts.push_back(v1->GetData().sourceLoc);
             std::vector<vec2> abs;
-            ChartCC * chart = ParamPointCC::FindChart(pts,abs);
+            const ChartCC * chart = ParamPointCC::FindChart(pts,abs);
             if(chart == NULL){
                 printf("CHART NOT FOUND\n");
                 return false;
@@ -1636,6 +1645,7 @@ bool InsertSmoothCuspFirst(MeshFace* face, Mesh* mesh, const vec3 & cameraCenter
             bool success = cuspParam.RadialCurvature(cameraCenter,r);
             Facing(cuspParam,cameraCenter,CONTOUR_THRESHOLD,&ndotv);
             sprintf(str, "SMOOTH CUSP PRE (n.v=%.10f, r=%.10f, success=%d)",double(ndotv),double(r),success);
+#pragma omp critical(rifDebugPoint)
             addRIFDebugPoint(3, double(limitPos[0][0]), double(limitPos[0][1]), double(limitPos[0][2]), str, 0);
 #endif
         }
@@ -1875,8 +1885,11 @@ void RefineContourRadial(Mesh * mesh, const vec3 & cameraCenter,
 #if LINK_FREESTYLE
             char str[200];
             sprintf(str, "FAILURE TO INSERT CUSP");
+#pragma omp critical(rifDebugPoint)
+            {
             addRIFDebugPoint(-1, double((*it).first->GetData().pos[0]), double((*it).first->GetData().pos[1]), double((*it).first->GetData().pos[2]), str, 0);
             addRIFDebugPoint(-1, double((*it).second->GetData().pos[0]), double((*it).second->GetData().pos[1]), double((*it).second->GetData().pos[2]), str, 0);
+            }
 #endif
             numCUSPs--;
         }
@@ -1898,9 +1911,12 @@ void RefineContourRadial(Mesh * mesh, const vec3 & cameraCenter,
         if(numCpt==3){
             char str[200];
             sprintf(str, "BUG.");
+#pragma omp critical(rifDebugPoint)
+            {
             addRIFDebugPoint(-1, double(face->GetVertex(0)->GetData().pos[0]), double(face->GetVertex(0)->GetData().pos[1]), double(face->GetVertex(0)->GetData().pos[2]), str, 0);
             addRIFDebugPoint(-1, double(face->GetVertex(1)->GetData().pos[0]), double(face->GetVertex(1)->GetData().pos[1]), double(face->GetVertex(1)->GetData().pos[2]), str, 0);
             addRIFDebugPoint(-1, double(face->GetVertex(2)->GetData().pos[0]), double(face->GetVertex(2)->GetData().pos[1]), double(face->GetVertex(2)->GetData().pos[2]), str, 0);
+            }
         }
 #endif
     }